@@ -32,7 +32,8 @@
 
 /*
  * pmemobj_tx.cpp -- pmemobj_tx_alloc(), pmemobj_tx_free(),
- * pmemobj_tx_realloc(), pmemobj_tx_add_range() benchmarks.
+ * pmemobj_tx_realloc(), pmemobj_tx_add_range() and small transactions
+ * benchmarks.
  */
 #include <cassert>
 #include <cerrno>
@@ -403,6 +404,50 @@ realloc_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
 	return 0;
 }
 
+/*
+ * small_dram -- main operations for obj_tx_small benchmark in dram mode
+ */
+static int
+small_dram(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+	   size_t idx)
+{
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	memset(obj_worker->items[0], (int)idx, obj_bench->sizes[0]);
+	return 0;
+}
+
+/*
+ * small_pmem -- main operations for obj_tx_small benchmark in pmem mode
+ */
+static int
+small_pmem(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+	   size_t idx)
+{
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	pmemobj_memset_persist(obj_bench->pop,
+			       pmemobj_direct(obj_worker->oids[0].oid),
+			       (int)idx, obj_bench->sizes[0]);
+	return 0;
+}
+
+/*
+ * small_tx -- main operations for obj_tx_small benchmark in tx mode
+ */
+static int
+small_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+	 size_t idx)
+{
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	if (pmemobj_tx_add_range(obj_worker->oids[0].oid, 0,
+				 obj_bench->sizes[0]) != 0) {
+		perror("pmemobj_tx_add_range");
+		return -1;
+	}
+	memset(pmemobj_direct(obj_worker->oids[0].oid), (int)idx,
+	       obj_bench->sizes[0]);
+	return 0;
+}
+
 /*
  * add_range_nested_tx -- main operations of the obj_tx_add_range with nesting.
  */
@@ -596,6 +641,8 @@ static fn_op_t realloc_op[] = {realloc_dram, realloc_tx, realloc_pmem};
 
 static fn_op_t add_range_op[] = {add_range_tx, add_range_nested_tx};
 
+static fn_op_t small_op[] = {small_dram, small_tx, small_pmem};
+
 static fn_parse_t parse_op[] = {parse_op_mode, parse_op_mode_add_range};
 
 static fn_op_t nestings[] = {obj_op_sim, obj_op_tx};
@@ -926,6 +973,25 @@ obj_tx_realloc_init(struct benchmark *bench, struct benchmark_args *args)
 	return 0;
 }
 
+/*
+ * obj_tx_small_init -- specific part of the obj_tx_small initialization.
+ *
+ * Every operation of this benchmark is a short transaction which modifies
+ * a single, small object of the worker, so its results are dominated by the
+ * fixed cost of beginning and committing a transaction.
+ */
+static int
+obj_tx_small_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	if (obj_tx_init(bench, args) != 0)
+		return -1;
+
+	auto *obj_bench = (struct obj_tx_bench *)pmembench_get_priv(bench);
+	obj_bench->fn_op = small_op;
+	obj_bench->n_objs = 1;
+	return 0;
+}
+
 /*
  * obj_tx_init -- common part of the benchmark initialization for transactional
  * benchmarks in their init functions. Parses command line arguments, set
@@ -1092,6 +1158,7 @@ static struct benchmark_info obj_tx_alloc;
 static struct benchmark_info obj_tx_free;
 static struct benchmark_info obj_tx_realloc;
 static struct benchmark_info obj_tx_add_range;
+static struct benchmark_info obj_tx_small;
 
 CONSTRUCTOR(pmemobj_tx_constructor)
 void
@@ -1244,4 +1311,21 @@ pmemobj_tx_constructor(void)
 	obj_tx_add_range.rm_file = true;
 	obj_tx_add_range.allow_poolset = true;
 	REGISTER_BENCHMARK(obj_tx_add_range);
+
+	obj_tx_small.name = "obj_tx_small";
+	obj_tx_small.brief = "small transactions benchmark";
+	obj_tx_small.init = obj_tx_small_init;
+	obj_tx_small.exit = obj_tx_exit;
+	obj_tx_small.multithread = true;
+	obj_tx_small.multiops = true;
+	obj_tx_small.init_worker = obj_tx_init_worker_alloc_obj;
+	obj_tx_small.free_worker = obj_tx_exit_worker;
+	obj_tx_small.operation = obj_tx_op;
+	obj_tx_small.measure_time = true;
+	obj_tx_small.clos = obj_tx_clo;
+	obj_tx_small.nclos = ARRAY_SIZE(obj_tx_clo) - 3;
+	obj_tx_small.opts_size = sizeof(struct obj_tx_args);
+	obj_tx_small.rm_file = true;
+	obj_tx_small.allow_poolset = true;
+	REGISTER_BENCHMARK(obj_tx_small);
 }
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * checksum.c -- selection of the Fletcher64 implementation
+ */
+
+#include <string.h>
+
+#include "checksum.h"
+#include "os.h"
+#include "out.h"
+#include "util.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include "cpu.h"
+#endif
+
+/*
+ * checksum_init -- picks the fastest Fletcher64 inner loop supported
+ *	by the CPU
+ */
+void
+checksum_init(void)
+{
+	LOG(3, NULL);
+
+#if defined(__x86_64__) || defined(_M_X64)
+	char *e = os_getenv("PMEM_NO_CHECKSUM_SIMD");
+	if (e && strcmp(e, "1") == 0) {
+		LOG(3, "PMEM_NO_CHECKSUM_SIMD forced generic checksum");
+		return;
+	}
+
+#if AVX512F_AVAILABLE
+	/* opt-in, just like the AVX512F memcpy/memset in libpmem */
+	e = os_getenv("PMEM_AVX512F");
+	if (e && strcmp(e, "1") == 0 && is_cpu_avx512f_present()) {
+		LOG(3, "using AVX512F checksum");
+		util_checksum_set_seq_fn(checksum_seq_avx512f);
+		return;
+	}
+#endif
+
+	if (is_cpu_avx2_present()) {
+		LOG(3, "using AVX2 checksum");
+		util_checksum_set_seq_fn(checksum_seq_avx2);
+		return;
+	}
+#endif
+
+	LOG(3, "using generic checksum");
+}
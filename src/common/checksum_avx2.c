@@ -0,0 +1,100 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * checksum_avx2.c -- AVX2 implementation of the Fletcher64 inner loop
+ *
+ * Each of the 8 lanes keeps its own pair of running sums over every
+ * 8-th word. For n words, with lane sums A[j] and B[j], the result is:
+ *
+ *	lo += sum(A[j])
+ *	hi += n * lo + 8 * sum(B[j]) - sum(j * A[j])
+ *
+ * All arithmetic is modulo 2^32, like in the scalar loop.
+ */
+
+#include <immintrin.h>
+
+#include "checksum.h"
+
+#define LANES 8
+
+/*
+ * checksum_seq_avx2 -- compute sequential Fletcher64 checksum
+ */
+uint64_t
+checksum_seq_avx2(const void *addr, size_t len, uint64_t csum)
+{
+	const uint32_t *p32 = addr;
+	size_t nvec = len / 4 / LANES;
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+
+	if (nvec != 0) {
+		const __m256i *v = (const __m256i *)p32;
+		__m256i a = _mm256_setzero_si256();
+		__m256i b = _mm256_setzero_si256();
+
+		for (size_t i = 0; i < nvec; ++i) {
+			a = _mm256_add_epi32(a, _mm256_loadu_si256(v + i));
+			b = _mm256_add_epi32(b, a);
+		}
+
+		uint32_t av[LANES];
+		uint32_t bv[LANES];
+		_mm256_storeu_si256((__m256i *)av, a);
+		_mm256_storeu_si256((__m256i *)bv, b);
+
+		uint32_t sum_a = 0;
+		uint32_t sum_b = 0;
+		uint32_t sum_ja = 0;
+		for (uint32_t j = 0; j < LANES; ++j) {
+			sum_a += av[j];
+			sum_b += bv[j];
+			sum_ja += j * av[j];
+		}
+
+		hi32 += (uint32_t)(nvec * LANES) * lo32;
+		hi32 += LANES * sum_b - sum_ja;
+		lo32 += sum_a;
+		p32 += nvec * LANES;
+	}
+
+	const uint32_t *p32end = (const uint32_t *)((const char *)addr + len);
+	while (p32 < p32end) {
+		lo32 += *p32;
+		++p32;
+		hi32 += lo32;
+	}
+
+	return (uint64_t)hi32 << 32 | lo32;
+}
@@ -215,9 +215,10 @@ ctl_arg_##name
  * Declaration of a new read-write leaf. If used both read and write function
  * must be declared by CTL_READ_HANDLER and CTL_WRITE_HANDLER macros.
  */
-#define CTL_LEAF_RW(name)\
+#define CTL_LEAF_RW(name, ...)\
 {CTL_STR(name), CTL_NODE_LEAF,\
-	{CTL_READ_HANDLER(name), CTL_WRITE_HANDLER(name), NULL},\
+	{CTL_READ_HANDLER(name, __VA_ARGS__),\
+	CTL_WRITE_HANDLER(name, __VA_ARGS__), NULL},\
 	&CTL_ARG(name), NULL}
 
 #define CTL_REGISTER_MODULE(_ctl, name)\
@@ -86,6 +86,7 @@ int util_ddax_region_find(const char *path);
 ssize_t util_file_get_size(const char *path);
 ssize_t util_fd_get_size(int fd);
 size_t util_file_device_dax_alignment(const char *path);
+size_t util_fd_device_dax_alignment(int fd);
 void *util_file_map_whole(const char *path);
 int util_file_zero(const char *path, os_off_t off, size_t len);
 ssize_t util_file_pread(const char *path, void *buffer, size_t size,
@@ -204,26 +204,19 @@ util_file_dir_remove(const char *path)
 }
 
 /*
- * device_dax_alignment -- (internal) checks the alignment of given Device DAX
+ * device_dax_alignment -- (internal) checks the alignment of a Device DAX
+ *	described by given stat structure
  */
 static size_t
-device_dax_alignment(const char *path)
+device_dax_alignment(const os_stat_t *st)
 {
 	char spath[PATH_MAX];
 	size_t size = 0;
 	char *daxpath;
-	os_stat_t st;
 	int olderrno;
 
-	LOG(3, "path \"%s\"", path);
-
-	if (os_stat(path, &st) < 0) {
-		ERR("!stat \"%s\"", path);
-		return 0;
-	}
-
 	snprintf(spath, PATH_MAX, "/sys/dev/char/%u:%u",
-		os_major(st.st_rdev), os_minor(st.st_rdev));
+		os_major(st->st_rdev), os_minor(st->st_rdev));
 
 	daxpath = realpath(spath, NULL);
 	if (!daxpath) {
@@ -318,7 +311,31 @@ util_file_device_dax_alignment(const char *path)
 {
 	LOG(3, "path \"%s\"", path);
 
-	return device_dax_alignment(path);
+	os_stat_t st;
+	if (os_stat(path, &st) < 0) {
+		ERR("!stat \"%s\"", path);
+		return 0;
+	}
+
+	return device_dax_alignment(&st);
+}
+
+/*
+ * util_fd_device_dax_alignment -- returns internal Device DAX alignment
+ *	of the device behind a given file descriptor
+ */
+size_t
+util_fd_device_dax_alignment(int fd)
+{
+	LOG(3, "fd %d", fd);
+
+	os_stat_t st;
+	if (os_fstat(fd, &st) < 0) {
+		ERR("!fstat");
+		return 0;
+	}
+
+	return device_dax_alignment(&st);
 }
 
 /*
@@ -213,6 +213,17 @@ util_file_device_dax_alignment(const char *path)
 	return 0;
 }
 
+/*
+ * util_fd_device_dax_alignment -- returns internal Device DAX alignment
+ */
+size_t
+util_fd_device_dax_alignment(int fd)
+{
+	LOG(3, "fd %d", fd);
+
+	return 0;
+}
+
 /*
  * util_ddax_region_find -- returns DEV dax region id that contains file
  */
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2018, Intel Corporation
+ * Copyright 2015-2019, Intel Corporation
  * Copyright (c) 2016, Microsoft Corporation. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -165,6 +165,9 @@ void os_thread_self(os_thread_t *thread);
 int os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 	const os_cpu_set_t *set);
 
+unsigned os_thread_numa_node(void);
+int os_thread_cpu(void);
+
 int os_thread_atfork(void (*prepare)(void), void (*parent)(void),
 	void (*child)(void));
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2017-2018, Intel Corporation
+ * Copyright 2017-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -36,10 +36,13 @@
 
 #define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
 #ifdef __FreeBSD__
 #include <pthread_np.h>
 #endif
 #include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "os_thread.h"
 #include "util.h"
@@ -400,6 +403,44 @@ os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 		(cpu_set_t *)set);
 }
 
+/*
+ * os_thread_numa_node -- returns the NUMA node of the CPU on which the
+ *	calling thread is currently running
+ *
+ * The getcpu system call is used directly (instead of libnuma) so that no
+ * additional dependency is required. On systems that do not provide it, or
+ * when it fails, all threads are reported as running on node 0.
+ */
+unsigned
+os_thread_numa_node(void)
+{
+#ifdef SYS_getcpu
+	unsigned cpu;
+	unsigned node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		return node;
+#endif
+	return 0;
+}
+
+/*
+ * os_thread_cpu -- returns the CPU on which the calling thread is currently
+ *	running, or -1 if it cannot be determined
+ *
+ * Unlike the getcpu system call, sched_getcpu is served from the vDSO (or
+ * from the rseq area), which makes it cheap enough to be called often.
+ */
+int
+os_thread_cpu(void)
+{
+#ifdef __linux__
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+
 /*
  * os_cpu_zero -- CP_ZERO abstraction layer
  */
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2018, Intel Corporation
+ * Copyright 2015-2019, Intel Corporation
  * Copyright (c) 2016, Microsoft Corporation. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -594,6 +594,37 @@ os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 	return ret != 0 ? 0 : EINVAL;
 }
 
+/*
+ * os_thread_numa_node -- returns the NUMA node of the processor on which
+ *	the calling thread is currently running
+ */
+unsigned
+os_thread_numa_node(void)
+{
+	PROCESSOR_NUMBER proc;
+	USHORT node;
+
+	GetCurrentProcessorNumberEx(&proc);
+	if (!GetNumaProcessorNodeEx(&proc, &node))
+		return 0;
+
+	return node;
+}
+
+/*
+ * os_thread_cpu -- returns the processor on which the calling thread is
+ *	currently running
+ */
+int
+os_thread_cpu(void)
+{
+	PROCESSOR_NUMBER proc;
+
+	GetCurrentProcessorNumberEx(&proc);
+
+	return proc.Group * 64 + proc.Number;
+}
+
 /*
  * os_semaphore_init -- initializes a new semaphore instance
  */
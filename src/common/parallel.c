@@ -0,0 +1,162 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * parallel.c -- simple fork-join helper for embarrassingly parallel loops
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include "alloc.h"
+#include "os_thread.h"
+#include "out.h"
+#include "parallel.h"
+#include "util.h"
+
+struct parallel_ctx {
+	parallel_fn fn;
+	void *arg;
+	uint64_t n;
+
+	uint64_t next; /* next item to be claimed */
+	uint64_t failed; /* lowest item which failed, n if none */
+};
+
+/*
+ * parallel_run -- (internal) claims and processes items until there are
+ *	none left or one of the preceding items has failed
+ */
+static void
+parallel_run(struct parallel_ctx *ctx)
+{
+	for (;;) {
+		uint64_t idx = util_fetch_and_add64(&ctx->next, 1);
+		if (idx >= ctx->n)
+			return;
+
+		uint64_t failed;
+		util_atomic_load_explicit64(&ctx->failed, &failed,
+			memory_order_acquire);
+		if (idx > failed)
+			return;
+
+		if (ctx->fn(ctx->arg, idx) == 0)
+			continue;
+
+		do {
+			util_atomic_load_explicit64(&ctx->failed, &failed,
+				memory_order_acquire);
+			if (failed <= idx)
+				break;
+		} while (!util_bool_compare_and_swap64(&ctx->failed,
+			failed, idx));
+	}
+}
+
+/*
+ * parallel_worker -- (internal) worker thread entry point
+ */
+static void *
+parallel_worker(void *arg)
+{
+	parallel_run(arg);
+
+	return NULL;
+}
+
+/*
+ * parallel_for -- calls fn for every index in [0, n) using up to nthreads
+ *	threads, including the calling one
+ *
+ * Returns the value of the first (lowest index) call that failed, or 0.
+ * All of the items preceding the failed one are processed. Unlike in
+ * a sequential loop, some of the items past it might have been processed
+ * as well, by the threads which claimed them before the failure was noticed.
+ * Items claimed afterwards are skipped.
+ *
+ * The failed item is processed once more by the calling thread, so that
+ * errno and the error message are set in the caller's context. This requires
+ * fn to be idempotent, and to have no side effects that would be wrong for
+ * the items a sequential loop would never reach, e.g. a verification or
+ * a recovery step.
+ *
+ * If the worker threads cannot be created, the remaining work is done by
+ * the calling thread.
+ */
+int
+parallel_for(size_t n, unsigned nthreads, parallel_fn fn, void *arg)
+{
+	LOG(3, "n %zu nthreads %u", n, nthreads);
+
+	if (nthreads > n)
+		nthreads = (unsigned)n;
+
+	if (nthreads <= 1) {
+		for (size_t i = 0; i < n; ++i) {
+			int ret = fn(arg, i);
+			if (ret != 0)
+				return ret;
+		}
+		return 0;
+	}
+
+	struct parallel_ctx ctx = {fn, arg, n, 0, n};
+
+	unsigned nworkers = 0;
+	os_thread_t *workers = Malloc(sizeof(*workers) * (nthreads - 1));
+	if (workers == NULL) {
+		LOG(2, "!Malloc");
+	} else {
+		for (; nworkers < nthreads - 1; ++nworkers) {
+			int ret = os_thread_create(&workers[nworkers], NULL,
+					parallel_worker, &ctx);
+			if (ret != 0) {
+				errno = ret;
+				LOG(2, "!os_thread_create");
+				break;
+			}
+		}
+	}
+
+	parallel_run(&ctx);
+
+	for (unsigned i = 0; i < nworkers; ++i)
+		os_thread_join(&workers[i], NULL);
+
+	Free(workers);
+
+	if (ctx.failed == n)
+		return 0;
+
+	return fn(arg, ctx.failed);
+}
@@ -127,12 +127,63 @@ util_is_zeroed(const void *addr, size_t len)
 	return 0;
 }
 
+/*
+ * checksum_seq_generic -- (internal) portable Fletcher64 inner loop
+ */
+static uint64_t
+checksum_seq_generic(const void *addr, size_t len, uint64_t csum)
+{
+	const uint32_t *p32 = addr;
+	const uint32_t *p32end = (const uint32_t *)((const char *)addr + len);
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+	while (p32 < p32end) {
+		lo32 += le32toh(*p32);
+		++p32;
+		hi32 += lo32;
+	}
+	return (uint64_t)hi32 << 32 | lo32;
+}
+
+/* Fletcher64 inner loop, replaced by util_checksum_set_seq_fn */
+static util_checksum_seq_fn Checksum_seq = checksum_seq_generic;
+
+/*
+ * util_checksum_set_seq_fn -- set the implementation of the Fletcher64 inner
+ *	loop used by all the checksum routines
+ *
+ * Must be called before any checksum is computed, e.g. at library load time.
+ */
+void
+util_checksum_set_seq_fn(util_checksum_seq_fn fn)
+{
+	Checksum_seq = fn ? fn : checksum_seq_generic;
+}
+
+/*
+ * checksum_zeros -- (internal) merges 'nwords' 32-bit zeros into the checksum
+ */
+static inline uint64_t
+checksum_zeros(uint64_t csum, size_t nwords)
+{
+	uint32_t lo32 = (uint32_t)csum;
+	uint32_t hi32 = (uint32_t)(csum >> 32);
+
+	hi32 += (uint32_t)nwords * lo32;
+
+	return (uint64_t)hi32 << 32 | lo32;
+}
+
 /*
  * util_checksum_compute -- compute Fletcher64 checksum
  *
  * csump points to where the checksum lives, so that location
  * is treated as zeros while calculating the checksum. The
  * checksummed data is assumed to be in little endian order.
+ *
+ * Everything from skip_off to the end of the range is treated as zeros as
+ * well, in pairs of 32-bit words. Both zeroed regions are accounted for
+ * arithmetically, so the data in between is checksummed in one go.
  */
 uint64_t
 util_checksum_compute(void *addr, size_t len, uint64_t *csump, size_t skip_off)
@@ -140,32 +191,41 @@ util_checksum_compute(void *addr, size_t len, uint64_t *csump, size_t skip_off)
 	if (len % 4 != 0)
 		abort();
 
-	uint32_t *p32 = addr;
-	uint32_t *p32end = (uint32_t *)((char *)addr + len);
-	uint32_t *skip;
-	uint32_t lo32 = 0;
-	uint32_t hi32 = 0;
+	const char *p = addr;
+	size_t nwords = len / 4;
 
-	if (skip_off)
-		skip = (uint32_t *)((char *)addr + skip_off);
-	else
-		skip = (uint32_t *)((char *)addr + len);
-
-	while (p32 < p32end)
-		if (p32 == (uint32_t *)csump || p32 >= skip) {
-			/* lo32 += 0; treat first 32-bits as zero */
-			p32++;
-			hi32 += lo32;
-			/* lo32 += 0; treat second 32-bits as zero */
-			p32++;
-			hi32 += lo32;
-		} else {
-			lo32 += le32toh(*p32);
-			++p32;
-			hi32 += lo32;
+	/* index of the first word of the skipped tail */
+	size_t skip = skip_off ? (skip_off + 3) / 4 : nwords;
+	if (skip > nwords)
+		skip = nwords;
+
+	/* index of the checksum, if it lies before the skipped tail */
+	uintptr_t csum_off = (uintptr_t)csump - (uintptr_t)addr;
+	size_t csum_idx = skip;
+	if (csum_off % 4 == 0 && csum_off / 4 < skip)
+		csum_idx = (size_t)csum_off / 4;
+
+	uint64_t csum = util_checksum_seq(p, csum_idx * 4, 0);
+	size_t next = csum_idx;
+
+	if (csum_idx < skip) {
+		/* treat both 32-bit halves of the checksum as zeros */
+		csum = checksum_zeros(csum, 2);
+		next = csum_idx + 2;
+
+		if (next < skip) {
+			csum = util_checksum_seq(p + next * 4,
+					(skip - next) * 4, csum);
+			next = skip;
 		}
+	}
 
-	return (uint64_t)hi32 << 32 | lo32;
+	if (next < nwords) {
+		size_t zeros = nwords - next;
+		csum = checksum_zeros(csum, zeros + (zeros & 1));
+	}
+
+	return csum;
 }
 
 /*
@@ -202,16 +262,8 @@ util_checksum_seq(const void *addr, size_t len, uint64_t csum)
 {
 	if (len % 4 != 0)
 		abort();
-	const uint32_t *p32 = addr;
-	const uint32_t *p32end = (const uint32_t *)((const char *)addr + len);
-	uint32_t lo32 = (uint32_t)csum;
-	uint32_t hi32 = (uint32_t)(csum >> 32);
-	while (p32 < p32end) {
-		lo32 += le32toh(*p32);
-		++p32;
-		hi32 += lo32;
-	}
-	return (uint64_t)hi32 << 32 | lo32;
+
+	return Checksum_seq(addr, len, csum);
 }
 
 /*
@@ -80,6 +80,9 @@ uint64_t util_checksum_compute(void *addr, size_t len, uint64_t *csump,
 int util_checksum(void *addr, size_t len, uint64_t *csump,
 		int insert, size_t skip_off);
 uint64_t util_checksum_seq(const void *addr, size_t len, uint64_t csum);
+typedef uint64_t (*util_checksum_seq_fn)(const void *addr, size_t len,
+		uint64_t csum);
+void util_checksum_set_seq_fn(util_checksum_seq_fn fn);
 int util_parse_size(const char *str, size_t *sizep);
 char *util_fgets(char *buffer, int max, FILE *stream);
 char *util_getexecname(char *path, size_t pathlen);
@@ -52,10 +52,16 @@
 #define pmem_map_file pmem_map_fileW
 #define pmem_check_version pmem_check_versionW
 #define pmem_errormsg pmem_errormsgW
+#define pmem_ctl_get pmem_ctl_getW
+#define pmem_ctl_set pmem_ctl_setW
+#define pmem_ctl_exec pmem_ctl_execW
 #else
 #define pmem_map_file pmem_map_fileU
 #define pmem_check_version pmem_check_versionU
 #define pmem_errormsg pmem_errormsgU
+#define pmem_ctl_get pmem_ctl_getU
+#define pmem_ctl_set pmem_ctl_setU
+#define pmem_ctl_exec pmem_ctl_execU
 #endif
 
 #endif
@@ -154,6 +160,20 @@ const char *pmem_errormsgU(void);
 const wchar_t *pmem_errormsgW(void);
 #endif
 
+#ifndef _WIN32
+/* EXPERIMENTAL */
+int pmem_ctl_get(const char *name, void *arg);
+int pmem_ctl_set(const char *name, void *arg);
+int pmem_ctl_exec(const char *name, void *arg);
+#else
+int pmem_ctl_getU(const char *name, void *arg);
+int pmem_ctl_getW(const wchar_t *name, void *arg);
+int pmem_ctl_setU(const char *name, void *arg);
+int pmem_ctl_setW(const wchar_t *name, void *arg);
+int pmem_ctl_execU(const char *name, void *arg);
+int pmem_ctl_execW(const wchar_t *name, void *arg);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
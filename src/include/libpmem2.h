@@ -73,6 +73,9 @@ extern "C" {
 #define PMEM2_E_UNKNOWN_FILETYPE	7
 #define PMEM2_E_MAP_FAILED		8
 #define PMEM2_E_NOSUPP			9
+#define PMEM2_E_GRANULARITY_NOT_SUPPORTED	10
+#define PMEM2_E_MAP_EXISTS		11
+#define PMEM2_E_VM_RESERVATION_NOT_EMPTY	12
 
 /* config setup */
 
@@ -122,6 +125,25 @@ enum pmem2_granularity {
 int pmem2_config_set_required_store_granularity(struct pmem2_config *cfg,
 	enum pmem2_granularity g);
 
+/* virtual memory reservation */
+
+struct pmem2_vm_reservation;
+
+int pmem2_vm_reservation_new(struct pmem2_vm_reservation **rsv, void *addr,
+	size_t size);
+
+int pmem2_vm_reservation_delete(struct pmem2_vm_reservation **rsv);
+
+int pmem2_vm_reservation_extend(struct pmem2_vm_reservation *rsv,
+	size_t size);
+
+void *pmem2_vm_reservation_get_address(struct pmem2_vm_reservation *rsv);
+
+size_t pmem2_vm_reservation_get_size(struct pmem2_vm_reservation *rsv);
+
+int pmem2_config_set_vm_reservation(struct pmem2_config *cfg,
+	struct pmem2_vm_reservation *rsv, size_t offset);
+
 /* mapping */
 
 struct pmem2_map;
@@ -140,17 +162,17 @@ enum pmem2_granularity pmem2_map_get_store_granularity(struct pmem2_map *map);
 
 /* flushing */
 
-typedef void (*pmem2_persist_fn)(void *ptr, size_t size);
+typedef void (*pmem2_persist_fn)(const void *ptr, size_t size);
 
-typedef void (*pmem2_flush_fn)(void *ptr, size_t size);
+typedef void (*pmem2_flush_fn)(const void *ptr, size_t size);
 
 typedef void (*pmem2_drain_fn)(void);
 
-pmem2_persist_fn *pmem2_get_persist_fn(struct pmem2_map *map);
+pmem2_persist_fn pmem2_get_persist_fn(struct pmem2_map *map);
 
-pmem2_flush_fn *pmem2_get_flush_fn(struct pmem2_map *map);
+pmem2_flush_fn pmem2_get_flush_fn(struct pmem2_map *map);
 
-pmem2_drain_fn *pmem2_get_drain_fn(struct pmem2_map *map);
+pmem2_drain_fn pmem2_get_drain_fn(struct pmem2_map *map);
 
 #define PMEM2_F_MEM_NODRAIN	(1U << 0)
 
@@ -178,11 +200,32 @@ typedef void (*pmem2_memcpy_fn)(void *pmemdest, const void *src, size_t len,
 typedef void (*pmem2_memset_fn)(void *pmemdest, int c, size_t len,
 		unsigned flags);
 
-pmem2_memmove_fn *pmem2_get_memmove_fn(struct pmem2_map *map);
+pmem2_memmove_fn pmem2_get_memmove_fn(struct pmem2_map *map);
+
+pmem2_memcpy_fn pmem2_get_memcpy_fn(struct pmem2_map *map);
+
+pmem2_memset_fn pmem2_get_memset_fn(struct pmem2_map *map);
+
+/* batched flushing */
+
+struct pmem2_persist_batch;
+
+int pmem2_persist_batch_new(struct pmem2_map *map,
+	struct pmem2_persist_batch **batch);
+
+int pmem2_persist_batch_delete(struct pmem2_persist_batch **batch);
+
+int pmem2_persist_batch_add(struct pmem2_persist_batch *batch,
+	const void *ptr, size_t size, uint64_t *token);
+
+int pmem2_persist_batch_commit(struct pmem2_persist_batch *batch,
+	uint64_t *token);
 
-pmem2_memcpy_fn *pmem2_get_memcpy_fn(struct pmem2_map *map);
+int pmem2_persist_batch_poll(struct pmem2_persist_batch *batch,
+	uint64_t token);
 
-pmem2_memset_fn *pmem2_get_memset_fn(struct pmem2_map *map);
+int pmem2_persist_batch_wait(struct pmem2_persist_batch *batch,
+	uint64_t token);
 
 /* RAS */
 
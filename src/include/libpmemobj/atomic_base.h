@@ -69,6 +69,14 @@ int pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num, uint64_t flags,
 	pmemobj_constr constructor, void *arg);
 
+/*
+ * Allocates with flags 'cnt' new objects of the same size from the pool. All
+ * of them are reserved at once and published in a single redo log, either
+ * all of the objects are allocated, or none of them.
+ */
+int pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid *oidv, size_t cnt,
+	size_t size, uint64_t type_num, uint64_t flags);
+
 /*
  * Allocates a new zeroed object from the pool.
  */
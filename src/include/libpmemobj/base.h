@@ -274,6 +274,21 @@ int pmemobj_xflush(PMEMobjpool *pop, const void *addr, size_t len,
  */
 void pmemobj_drain(PMEMobjpool *pop);
 
+/*
+ * Result of the defragmentation.
+ */
+struct pobj_defrag_result {
+	size_t total; /* number of processed objects */
+	size_t relocated; /* number of relocated objects */
+};
+
+/*
+ * Relocates the objects out of sparsely populated runs and updates all of
+ * the provided references to them.
+ */
+int pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	struct pobj_defrag_result *result);
+
 /*
  * Version checking.
  */
@@ -166,6 +166,31 @@ struct pobj_alloc_class_desc {
 	unsigned class_id;
 };
 
+/*
+ * Maximum number of allocation classes in a proposal.
+ */
+#define POBJ_MAX_PROPOSED_ALLOC_CLASSES 16
+
+/*
+ * Allocation classes proposed for the observed allocation sizes, see
+ * heap.alloc_class.tune.proposal.
+ */
+struct pobj_alloc_class_proposal {
+	/*
+	 * The number of the proposed allocation classes, in ascending order
+	 * of unit size. Their class_id is always 0.
+	 */
+	unsigned nclasses;
+	struct pobj_alloc_class_desc classes[POBJ_MAX_PROPOSED_ALLOC_CLASSES];
+
+	/*
+	 * The number of bytes wasted by the internal fragmentation of the
+	 * observed allocations with the proposed and the current classes.
+	 */
+	uint64_t waste_proposed;
+	uint64_t waste_current;
+};
+
 #ifndef _WIN32
 /* EXPERIMENTAL */
 int pmemobj_ctl_get(PMEMobjpool *pop, const char *name, void *arg);
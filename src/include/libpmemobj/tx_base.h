@@ -136,6 +136,9 @@ typedef void (*pmemobj_tx_callback)(PMEMobjpool *pop, enum pobj_tx_stage stage,
 	POBJ_XADD_ASSUME_INITIALIZED |\
 	POBJ_XADD_NO_ABORT)
 
+#define POBJ_XWRITE_NO_ABORT		POBJ_FLAG_TX_NO_ABORT
+#define POBJ_XWRITE_VALID_FLAGS	(POBJ_XWRITE_NO_ABORT)
+
 #define POBJ_XLOCK_NO_ABORT		POBJ_FLAG_TX_NO_ABORT
 #define POBJ_XLOCK_VALID_FLAGS	(POBJ_XLOCK_NO_ABORT)
 
@@ -266,6 +269,39 @@ int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
+/*
+ * Buffers a write of 'size' bytes from 'src' to the object 'oid' at offset
+ * 'off' in the write set of the transaction. The write is not visible in
+ * the pool until the transaction commits, at which point all buffered writes
+ * are logged once in the redo log and applied. Old data is not snapshotted.
+ *
+ * If successful, returns zero.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_write(PMEMoid oid, uint64_t off, const void *src, size_t size);
+
+/*
+ * Behaves exactly the same as pmemobj_tx_write when 'flags' equals 0.
+ * 'Flags' is a bitmask of the following values:
+ *  - POBJ_XWRITE_NO_ABORT - if the function does not end successfully,
+ *  do not abort the transaction and return the error number.
+ */
+int pmemobj_tx_xwrite(PMEMoid oid, uint64_t off, const void *src, size_t size,
+		uint64_t flags);
+
+/*
+ * Reads 'size' bytes of the object 'oid' at offset 'off' into 'dest',
+ * including the writes buffered in the write set of the transaction.
+ *
+ * If successful, returns zero.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_read(PMEMoid oid, uint64_t off, void *dest, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
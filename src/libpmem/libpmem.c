@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2017, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -38,10 +38,55 @@
 #include <stdint.h>
 
 #include "libpmem.h"
+#include "ctl.h"
 
 #include "pmem.h"
 #include "pmemcommon.h"
 
+/*
+ * The variable from which the config is directly loaded. The string
+ * cannot contain any comments or extraneous white characters.
+ */
+#define PMEM_CONFIG_ENV_VARIABLE "PMEM_CONF"
+
+/*
+ * The variable that points to a config file from which the config is loaded.
+ */
+#define PMEM_CONFIG_FILE_ENV_VARIABLE "PMEM_CONF_FILE"
+
+/*
+ * pmem_ctl_load -- (static) loads configuration from env variable and file
+ */
+static int
+pmem_ctl_load(void)
+{
+	LOG(3, NULL);
+
+	char *env_config = os_getenv(PMEM_CONFIG_ENV_VARIABLE);
+	if (env_config != NULL) {
+		if (ctl_load_config_from_string(NULL, NULL, env_config) != 0) {
+			LOG(2, "unable to parse config stored in %s "
+				"environment variable",
+				PMEM_CONFIG_ENV_VARIABLE);
+			return -1;
+		}
+	}
+
+	char *env_config_file = os_getenv(PMEM_CONFIG_FILE_ENV_VARIABLE);
+	if (env_config_file != NULL && env_config_file[0] != '\0') {
+		if (ctl_load_config_from_file(NULL, NULL,
+				env_config_file) != 0) {
+			LOG(2, "unable to parse config stored in %s "
+				"file (from %s environment variable)",
+				env_config_file,
+				PMEM_CONFIG_FILE_ENV_VARIABLE);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 /*
  * libpmem_init -- load-time initialization for libpmem
  *
@@ -55,6 +100,9 @@ libpmem_init(void)
 			PMEM_MAJOR_VERSION, PMEM_MINOR_VERSION);
 	LOG(3, NULL);
 	pmem_init();
+
+	if (pmem_ctl_load())
+		FATAL("error: %s", pmem_errormsg());
 }
 
 /*
@@ -152,3 +200,122 @@ pmem_errormsgW(void)
 	return out_get_errormsgW();
 }
 #endif
+
+/*
+ * pmem_ctl_getU -- programmatically executes a read ctl query
+ */
+#ifndef _WIN32
+static inline
+#endif
+int
+pmem_ctl_getU(const char *name, void *arg)
+{
+	LOG(3, "name %s arg %p", name, arg);
+	return ctl_query(NULL, NULL, CTL_QUERY_PROGRAMMATIC, name,
+			CTL_QUERY_READ, arg);
+}
+
+/*
+ * pmem_ctl_setU -- programmatically executes a write ctl query
+ */
+#ifndef _WIN32
+static inline
+#endif
+int
+pmem_ctl_setU(const char *name, void *arg)
+{
+	LOG(3, "name %s arg %p", name, arg);
+	return ctl_query(NULL, NULL, CTL_QUERY_PROGRAMMATIC, name,
+			CTL_QUERY_WRITE, arg);
+}
+
+/*
+ * pmem_ctl_execU -- programmatically executes a runnable ctl query
+ */
+#ifndef _WIN32
+static inline
+#endif
+int
+pmem_ctl_execU(const char *name, void *arg)
+{
+	LOG(3, "name %s arg %p", name, arg);
+	return ctl_query(NULL, NULL, CTL_QUERY_PROGRAMMATIC, name,
+			CTL_QUERY_RUNNABLE, arg);
+}
+
+#ifndef _WIN32
+/*
+ * pmem_ctl_get -- programmatically executes a read ctl query
+ */
+int
+pmem_ctl_get(const char *name, void *arg)
+{
+	return pmem_ctl_getU(name, arg);
+}
+
+/*
+ * pmem_ctl_set -- programmatically executes a write ctl query
+ */
+int
+pmem_ctl_set(const char *name, void *arg)
+{
+	return pmem_ctl_setU(name, arg);
+}
+
+/*
+ * pmem_ctl_exec -- programmatically executes a runnable ctl query
+ */
+int
+pmem_ctl_exec(const char *name, void *arg)
+{
+	return pmem_ctl_execU(name, arg);
+}
+#else
+/*
+ * pmem_ctl_getW -- programmatically executes a read ctl query
+ */
+int
+pmem_ctl_getW(const wchar_t *name, void *arg)
+{
+	char *uname = util_toUTF8(name);
+	if (uname == NULL)
+		return -1;
+
+	int ret = pmem_ctl_getU(uname, arg);
+	util_free_UTF8(uname);
+
+	return ret;
+}
+
+/*
+ * pmem_ctl_setW -- programmatically executes a write ctl query
+ */
+int
+pmem_ctl_setW(const wchar_t *name, void *arg)
+{
+	char *uname = util_toUTF8(name);
+	if (uname == NULL)
+		return -1;
+
+	int ret = pmem_ctl_setU(uname, arg);
+	util_free_UTF8(uname);
+
+	return ret;
+}
+
+/*
+ * pmem_ctl_execW -- programmatically executes a runnable ctl query
+ */
+int
+pmem_ctl_execW(const wchar_t *name, void *arg)
+{
+	char *uname = util_toUTF8(name);
+	if (uname == NULL)
+		return -1;
+
+	int ret = pmem_ctl_execU(uname, arg);
+	util_free_UTF8(uname);
+
+	return ret;
+}
+#endif
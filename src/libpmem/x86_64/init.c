@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2018, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -30,22 +30,36 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <string.h>
+#include <time.h>
 #include <xmmintrin.h>
 #include "libpmem.h"
 
 #include "cpu.h"
+#include "ctl.h"
 #include "flush.h"
 #include "memcpy_memset.h"
 #include "os.h"
 #include "out.h"
 #include "pmem.h"
+#include "util.h"
 #include "valgrind_internal.h"
 
 #define MOVNT_THRESHOLD	256
 
 size_t Movnt_threshold = MOVNT_THRESHOLD;
 
+enum movnt_calibration {
+	MOVNT_CALIBRATION_OFF,
+	MOVNT_CALIBRATION_PENDING,
+	MOVNT_CALIBRATION_RUNNING,
+	MOVNT_CALIBRATION_DONE,
+};
+
+static unsigned Movnt_calibration = MOVNT_CALIBRATION_OFF;
+
 /*
  * predrain_fence_empty -- (internal) issue the pre-drain fence instruction
  */
@@ -113,6 +127,98 @@ flush_empty(const void *addr, size_t len)
 }
 
 #if SSE2_AVAILABLE || AVX_AVAILABLE || AVX512F_AVAILABLE
+/*
+ * Range of copy sizes examined by the movnt threshold calibration. Only copies
+ * of at least MOVNT_CALIBRATE_MAX bytes can trigger it, because the kernels are
+ * benchmarked on the destination of that copy.
+ */
+#define MOVNT_CALIBRATE_MIN	256
+#define MOVNT_CALIBRATE_MAX	(64 << 10)
+#define MOVNT_CALIBRATE_ROUNDS	4
+
+typedef void (*memmove_kernel)(char *dest, const char *src, size_t len);
+
+/*
+ * movnt_calibrate_time -- (internal) returns the best time (in ns) it takes
+ *	to copy MOVNT_CALIBRATE_MAX bytes in chunks of 'chunk' bytes
+ */
+static uint64_t
+movnt_calibrate_time(char *dest, const char *src, size_t chunk,
+		memmove_kernel kernel)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int r = 0; r < MOVNT_CALIBRATE_ROUNDS; ++r) {
+		struct timespec start;
+		struct timespec end;
+
+		os_clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t off = 0; off < MOVNT_CALIBRATE_MAX; off += chunk)
+			kernel(dest + off, src + off, chunk);
+		_mm_sfence();
+		os_clock_gettime(CLOCK_MONOTONIC, &end);
+
+		uint64_t t = (uint64_t)(end.tv_sec - start.tv_sec) *
+				1000000000ULL +
+				(uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+		if (t < best)
+			best = t;
+	}
+
+	return best;
+}
+
+/*
+ * movnt_calibrate -- (internal) measures the crossover point between temporal
+ *	and non-temporal copies on the destination of a large copy, sets
+ *	Movnt_threshold accordingly and then performs the copy
+ *
+ * Only one thread performs the measurement, all the others (and the calibrating
+ * thread, once it is done) use whatever Movnt_threshold is current.
+ */
+static void
+movnt_calibrate(char *dest, const char *src, size_t len,
+		memmove_kernel mov, memmove_kernel movnt)
+{
+	/* the measurement clobbers dest, which must not alias src */
+	int overlap = dest < src + len && src < dest + len;
+
+	if (!overlap && util_bool_compare_and_swap32(&Movnt_calibration,
+			MOVNT_CALIBRATION_PENDING, MOVNT_CALIBRATION_RUNNING)) {
+		/*
+		 * Walk from the largest chunk size down and stop at the first
+		 * size for which temporal stores win - the threshold is the
+		 * smallest size above which non-temporal stores always win.
+		 */
+		size_t threshold = MOVNT_CALIBRATE_MAX * 2;
+		for (size_t chunk = MOVNT_CALIBRATE_MAX;
+				chunk >= MOVNT_CALIBRATE_MIN; chunk /= 2) {
+			uint64_t t_mov = movnt_calibrate_time(dest, src,
+					chunk, mov);
+			uint64_t t_movnt = movnt_calibrate_time(dest, src,
+					chunk, movnt);
+
+			LOG(4, "chunk %zu mov %" PRIu64 "ns movnt %" PRIu64
+					"ns", chunk, t_mov, t_movnt);
+
+			if (t_movnt > t_mov)
+				break;
+			threshold = chunk;
+		}
+
+		LOG(3, "calibrated movnt threshold %zu", threshold);
+		util_atomic_store_explicit64(&Movnt_threshold, threshold,
+				memory_order_relaxed);
+		util_atomic_store_explicit32(&Movnt_calibration,
+				MOVNT_CALIBRATION_DONE, memory_order_release);
+	}
+
+	if (len < Movnt_threshold)
+		mov(dest, src, len);
+	else
+		movnt(dest, src, len);
+}
+
 #define PMEM_F_MEM_MOVNT (PMEM_F_MEM_WC | PMEM_F_MEM_NONTEMPORAL)
 #define PMEM_F_MEM_MOV   (PMEM_F_MEM_WB | PMEM_F_MEM_TEMPORAL)
 
@@ -130,6 +236,12 @@ memmove_nodrain_##isa##_##flush(void *dest, const void *src, size_t len, \
 		memmove_movnt_##isa ##_##flush(dest, src, len);\
 	else if (flags & PMEM_F_MEM_MOV)\
 		memmove_mov_##isa##_##flush(dest, src, len);\
+	else if (len >= MOVNT_CALIBRATE_MAX && \
+			unlikely(Movnt_calibration == \
+			MOVNT_CALIBRATION_PENDING))\
+		movnt_calibrate(dest, src, len,\
+			memmove_mov_##isa##_##flush,\
+			memmove_movnt_##isa##_##flush);\
 	else if (len < Movnt_threshold)\
 		memmove_mov_##isa##_##flush(dest, src, len);\
 	else\
@@ -410,6 +522,86 @@ pmem_cpuinfo_to_funcs(struct pmem_funcs *funcs, enum memcpy_impl *impl)
 	}
 }
 
+static int
+CTL_READ_HANDLER(movnt_threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	size_t *arg_out = arg;
+	util_atomic_load_explicit64(&Movnt_threshold, arg_out,
+			memory_order_relaxed);
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(movnt_threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		ERR("movnt threshold must not be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* an explicitly set threshold disables the calibration */
+	util_atomic_store_explicit32(&Movnt_calibration,
+			MOVNT_CALIBRATION_OFF, memory_order_relaxed);
+	util_atomic_store_explicit64(&Movnt_threshold, (size_t)arg_in,
+			memory_order_relaxed);
+
+	return 0;
+}
+
+static int
+CTL_READ_HANDLER(movnt_threshold_auto)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+	unsigned state;
+	util_atomic_load_explicit32(&Movnt_calibration, &state,
+			memory_order_acquire);
+
+	*arg_out = state != MOVNT_CALIBRATION_OFF;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(movnt_threshold_auto)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (!arg_in) {
+		util_atomic_store_explicit32(&Movnt_calibration,
+				MOVNT_CALIBRATION_OFF, memory_order_relaxed);
+		return 0;
+	}
+
+	/* a calibration that is already running will publish its own result */
+	if (util_bool_compare_and_swap32(&Movnt_calibration,
+			MOVNT_CALIBRATION_OFF, MOVNT_CALIBRATION_PENDING))
+		return 0;
+
+	util_bool_compare_and_swap32(&Movnt_calibration,
+			MOVNT_CALIBRATION_DONE, MOVNT_CALIBRATION_PENDING);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(movnt_threshold) = CTL_ARG_LONG_LONG;
+static const struct ctl_argument CTL_ARG(movnt_threshold_auto) =
+	CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(memcpy)[] = {
+	CTL_LEAF_RW(movnt_threshold),
+	CTL_LEAF_RW(movnt_threshold_auto),
+
+	CTL_NODE_END
+};
+
 /*
  * pmem_init_funcs -- initialize architecture-specific list of pmem operations
  */
@@ -445,7 +637,10 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 	 * It has no effect if movnt is not supported or disabled.
 	 */
 	ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
-	if (ptr) {
+	if (ptr && strcmp(ptr, "auto") == 0) {
+		LOG(3, "PMEM_MOVNT_THRESHOLD set to auto");
+		Movnt_calibration = MOVNT_CALIBRATION_PENDING;
+	} else if (ptr) {
 		long long val = atoll(ptr);
 
 		if (val < 0) {
@@ -456,6 +651,8 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 		}
 	}
 
+	CTL_REGISTER_MODULE(NULL, memcpy);
+
 	int flush;
 	char *e = os_getenv("PMEM_NO_FLUSH");
 	if (e && (strcmp(e, "1") == 0)) {
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * init.c -- aarch64 specific part of libpmem2 persist module
+ */
+
+#include <string.h>
+
+#include "flush.h"
+#include "out.h"
+#include "persist.h"
+#include "valgrind_internal.h"
+
+/*
+ * memory_barrier -- (internal) issue the fence instruction
+ */
+static void
+memory_barrier(void)
+{
+	LOG(15, NULL);
+
+	VALGRIND_DO_FENCE;
+	arm_store_memory_barrier();
+}
+
+/*
+ * flush_dcache -- (internal) flush the CPU cache
+ */
+static void
+flush_dcache(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_dcache_nolog(addr, len);
+	VALGRIND_DO_FLUSH(addr, len);
+}
+
+/*
+ * persist_dcache -- (internal) make stores persistent, using DC CVAC
+ */
+static void
+persist_dcache(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_dcache_nolog(addr, len);
+	arm_store_memory_barrier();
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * persist_noflush -- (internal) make stores persistent on a platform
+ *	which flushes CPU caches on power failure
+ */
+static void
+persist_noflush(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	arm_store_memory_barrier();
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * memmove_libc -- (internal) memmove to pmem, using DC CVAC to flush
+ */
+static void
+memmove_libc(void *pmemdest, const void *src, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p src %p len %zu flags 0x%x", pmemdest, src, len,
+			flags);
+
+	memmove(pmemdest, src, len);
+	if (!(flags & PMEM2_F_MEM_NOFLUSH))
+		flush_dcache(pmemdest, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN))
+		memory_barrier();
+}
+
+/*
+ * memset_libc -- (internal) memset to pmem, using DC CVAC to flush
+ */
+static void
+memset_libc(void *pmemdest, int c, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu flags 0x%x", pmemdest, c, len,
+			flags);
+
+	memset(pmemdest, c, len);
+	if (!(flags & PMEM2_F_MEM_NOFLUSH))
+		flush_dcache(pmemdest, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN))
+		memory_barrier();
+}
+
+/*
+ * memmove_libc_noflush -- (internal) memmove to pmem on a platform which
+ *	flushes CPU caches on power failure
+ */
+static void
+memmove_libc_noflush(void *pmemdest, const void *src, size_t len,
+		unsigned flags)
+{
+	LOG(15, "pmemdest %p src %p len %zu flags 0x%x", pmemdest, src, len,
+			flags);
+
+	memmove(pmemdest, src, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN))
+		memory_barrier();
+}
+
+/*
+ * memset_libc_noflush -- (internal) memset to pmem on a platform which
+ *	flushes CPU caches on power failure
+ */
+static void
+memset_libc_noflush(void *pmemdest, int c, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu flags 0x%x", pmemdest, c, len,
+			flags);
+
+	memset(pmemdest, c, len);
+	if (!(flags & PMEM2_F_MEM_NODRAIN))
+		memory_barrier();
+}
+
+/*
+ * pmem2_arch_init -- initialize architecture-specific flushing primitives
+ */
+void
+pmem2_arch_init(struct pmem2_arch_info *info)
+{
+	LOG(3, NULL);
+
+	info->persist = persist_dcache;
+	info->persist_noflush = persist_noflush;
+	info->flush = flush_dcache;
+	info->fence = memory_barrier;
+	info->memmove = memmove_libc;
+	info->memset = memset_libc;
+	info->memmove_noflush = memmove_libc_noflush;
+	info->memset_noflush = memset_libc_noflush;
+
+	LOG(3, "Synchronize VA to poc for ARM");
+}
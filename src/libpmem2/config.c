@@ -41,6 +41,7 @@
 #include "out.h"
 #include "pmem2.h"
 #include "pmem2_utils.h"
+#include "util.h"
 
 /*
  * config_init -- (internal) initialize cfg structure.
@@ -53,6 +54,15 @@ config_init(struct pmem2_config *cfg)
 #else
 	cfg->fd = INVALID_FD;
 #endif
+	cfg->offset = 0;
+	cfg->length = 0;
+	cfg->sharing = PMEM2_SHARED;
+	cfg->protection = PMEM2_PROT_FROM_FD;
+	cfg->addr_request = PMEM2_ADDRESS_ANY;
+	cfg->addr = NULL;
+	cfg->reserv = NULL;
+	cfg->reserv_offset = 0;
+	cfg->requested_max_granularity = PMEM2_GRANULARITY_PAGE;
 }
 
 /*
@@ -83,3 +93,145 @@ pmem2_config_delete(struct pmem2_config **cfg)
 	*cfg = NULL;
 	return 0;
 }
+
+/*
+ * pmem2_config_set_offset -- sets offset in the config struct
+ */
+int
+pmem2_config_set_offset(struct pmem2_config *cfg, size_t offset)
+{
+	/* mmap() and MapViewOfFile() take a signed 64-bit offset */
+	if (offset > (size_t)INT64_MAX) {
+		ERR("offset is greater than INT64_MAX");
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	cfg->offset = offset;
+	return 0;
+}
+
+/*
+ * pmem2_config_set_length -- sets length in the config struct
+ */
+int
+pmem2_config_set_length(struct pmem2_config *cfg, size_t length)
+{
+	cfg->length = length;
+	return 0;
+}
+
+/*
+ * pmem2_config_set_sharing -- sets the sharing type of the mapping
+ */
+int
+pmem2_config_set_sharing(struct pmem2_config *cfg, unsigned type)
+{
+	switch (type) {
+		case PMEM2_SHARED:
+		case PMEM2_PRIVATE:
+			cfg->sharing = type;
+			return 0;
+		default:
+			ERR("unknown sharing type %u", type);
+			return PMEM2_E_INVALID_ARG;
+	}
+}
+
+/*
+ * pmem2_config_set_protection -- sets the protection flags of the mapping
+ */
+int
+pmem2_config_set_protection(struct pmem2_config *cfg, unsigned flag)
+{
+	unsigned valid = PMEM2_PROT_EXEC | PMEM2_PROT_READ | PMEM2_PROT_WRITE;
+
+	if (flag & ~valid) {
+		ERR("invalid protection flags 0x%x", flag & ~valid);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	cfg->protection = flag;
+	return 0;
+}
+
+/*
+ * pmem2_config_use_anonymous_mapping -- not supported yet
+ */
+int
+pmem2_config_use_anonymous_mapping(struct pmem2_config *cfg, unsigned on)
+{
+	return PMEM2_E_NOSUPP;
+}
+
+/*
+ * pmem2_config_set_address -- sets the requested address of the mapping
+ */
+int
+pmem2_config_set_address(struct pmem2_config *cfg, unsigned type, void *addr)
+{
+	switch (type) {
+		case PMEM2_ADDRESS_ANY:
+			if (addr != NULL) {
+				ERR("address has to be NULL for "
+					"PMEM2_ADDRESS_ANY");
+				return PMEM2_E_INVALID_ARG;
+			}
+			break;
+		case PMEM2_ADDRESS_FIXED_REPLACE:
+		case PMEM2_ADDRESS_FIXED_NOREPLACE:
+			if (addr == NULL) {
+				ERR("fixed address cannot be NULL");
+				return PMEM2_E_INVALID_ARG;
+			}
+			if (!IS_PAGE_ALIGNED((uintptr_t)addr)) {
+				ERR("address %p is not page aligned", addr);
+				return PMEM2_E_INVALID_ARG;
+			}
+			break;
+		default:
+			ERR("unknown address request type %u", type);
+			return PMEM2_E_INVALID_ARG;
+	}
+
+	cfg->addr_request = type;
+	cfg->addr = addr;
+	return 0;
+}
+
+/*
+ * pmem2_config_set_vm_reservation -- sets the virtual memory reservation
+ *	the mapping has to be placed in
+ */
+int
+pmem2_config_set_vm_reservation(struct pmem2_config *cfg,
+		struct pmem2_vm_reservation *rsv, size_t offset)
+{
+	if (rsv == NULL && offset != 0) {
+		ERR("offset has to be 0 when no reservation is set");
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	cfg->reserv = rsv;
+	cfg->reserv_offset = offset;
+	return 0;
+}
+
+/*
+ * pmem2_config_set_required_store_granularity -- sets the coarsest store
+ *	granularity the application is able to handle
+ */
+int
+pmem2_config_set_required_store_granularity(struct pmem2_config *cfg,
+		enum pmem2_granularity g)
+{
+	switch (g) {
+		case PMEM2_GRANULARITY_BYTE:
+		case PMEM2_GRANULARITY_CACHE_LINE:
+		case PMEM2_GRANULARITY_PAGE:
+			cfg->requested_max_granularity = g;
+			return 0;
+		default:
+			ERR("unknown granularity value %d", g);
+			return PMEM2_E_INVALID_ARG;
+	}
+}
@@ -46,6 +46,20 @@ struct pmem2_config {
 #else
 	int fd;
 #endif
+	size_t offset; /* offset from the beginning of the file */
+	size_t length; /* length of the mapping, 0 means up to the end of file */
+	unsigned sharing; /* PMEM2_SHARED or PMEM2_PRIVATE */
+	unsigned protection; /* PMEM2_PROT_* flags or PMEM2_PROT_FROM_FD */
+
+	unsigned addr_request; /* PMEM2_ADDRESS_* */
+	void *addr; /* requested mapping address */
+
+	/* reservation the mapping has to be placed in, if any */
+	struct pmem2_vm_reservation *reserv;
+	size_t reserv_offset; /* offset of the mapping in the reservation */
+
+	/* the coarsest store granularity acceptable for the mapping */
+	enum pmem2_granularity requested_max_granularity;
 };
 
 void config_init(struct pmem2_config *cfg);
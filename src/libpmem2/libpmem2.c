@@ -39,6 +39,8 @@
 
 #include "libpmem2.h"
 
+#include "mmap.h"
+#include "persist.h"
 #include "pmem2.h"
 #include "pmemcommon.h"
 
@@ -56,7 +58,9 @@ libpmem2_init(void)
 			PMEM2_MAJOR_VERSION, PMEM2_MINOR_VERSION);
 
 	LOG(3, NULL);
-	/* XXX possible pmem2_init placeholder */
+
+	util_mmap_init();
+	pmem2_persist_init();
 }
 
 /*
@@ -70,6 +74,7 @@ libpmem2_fini(void)
 {
 	LOG(3, NULL);
 
+	util_mmap_fini();
 	out_fini();
 }
 
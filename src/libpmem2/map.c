@@ -0,0 +1,189 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map.c -- pmem2_map (common)
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "config.h"
+#include "libpmem2.h"
+#include "map.h"
+#include "os.h"
+#include "os_auto_flush.h"
+#include "out.h"
+#include "persist.h"
+#include "pmem2_utils.h"
+#include "util.h"
+
+#define GRANULARITY_FORCE_VAR "PMEM2_FORCE_GRANULARITY"
+
+static const char * const granularity_name[] = {
+	[PMEM2_GRANULARITY_BYTE] = "BYTE",
+	[PMEM2_GRANULARITY_CACHE_LINE] = "CACHE_LINE",
+	[PMEM2_GRANULARITY_PAGE] = "PAGE",
+};
+
+/*
+ * granularity_from_env -- (internal) reads the store granularity forced
+ *	by the user through an environment variable, returns 1 if found
+ */
+static int
+granularity_from_env(enum pmem2_granularity *g)
+{
+	char *e = os_getenv(GRANULARITY_FORCE_VAR);
+	if (e == NULL)
+		return 0;
+
+	for (unsigned i = 0; i < ARRAY_SIZE(granularity_name); ++i) {
+		if (strcmp(e, granularity_name[i]) == 0) {
+			*g = (enum pmem2_granularity)i;
+			LOG(3, "store granularity forced to %s", e);
+			return 1;
+		}
+	}
+
+	LOG(2, "invalid %s value \"%s\", ignored", GRANULARITY_FORCE_VAR, e);
+	return 0;
+}
+
+/*
+ * map_effective_granularity -- returns the store granularity of a newly
+ *	created mapping
+ *
+ * 'sync' indicates whether stores reach the medium without any msync(),
+ * that is if the mapping is a Device DAX or was created with MAP_SYNC.
+ */
+enum pmem2_granularity
+map_effective_granularity(const struct pmem2_config *cfg, int sync)
+{
+	/* stores to a private mapping never reach the file */
+	if (cfg->sharing == PMEM2_PRIVATE)
+		return PMEM2_GRANULARITY_BYTE;
+
+	enum pmem2_granularity g;
+	if (granularity_from_env(&g))
+		return g;
+
+	if (!sync)
+		return PMEM2_GRANULARITY_PAGE;
+
+	int eadr = os_auto_flush();
+	if (eadr < 0) {
+		LOG(1, "cannot check if the platform supports eADR");
+		eadr = 0;
+	}
+
+	return eadr ? PMEM2_GRANULARITY_BYTE : PMEM2_GRANULARITY_CACHE_LINE;
+}
+
+/*
+ * map_validate_granularity -- verifies the store granularity of the mapping
+ *	is not coarser than the one requested in the config
+ */
+int
+map_validate_granularity(const struct pmem2_config *cfg,
+	enum pmem2_granularity available)
+{
+	if (available <= cfg->requested_max_granularity)
+		return 0;
+
+	ERR("requested store granularity %s is not available, "
+		"the mapping provides %s",
+		granularity_name[cfg->requested_max_granularity],
+		granularity_name[available]);
+
+	return PMEM2_E_GRANULARITY_NOT_SUPPORTED;
+}
+
+/*
+ * map_new -- allocates and initializes the pmem2_map structure
+ */
+int
+map_new(const struct pmem2_config *cfg, void *addr, size_t length,
+	enum pmem2_granularity g, struct pmem2_map **map)
+{
+	int ret;
+	struct pmem2_map *m = pmem2_malloc(sizeof(*m), &ret);
+	if (ret)
+		return ret;
+
+	m->addr = addr;
+	m->length = length;
+	m->effective_granularity = g;
+	m->cfg = *cfg;
+
+	pmem2_set_flush_fns(m);
+	pmem2_set_mem_fns(m);
+
+	*map = m;
+	return 0;
+}
+
+/*
+ * pmem2_get_config -- returns the config the mapping was created with
+ */
+struct pmem2_config *
+pmem2_get_config(struct pmem2_map *map)
+{
+	return &map->cfg;
+}
+
+/*
+ * pmem2_map_get_address -- returns the base address of the mapping
+ */
+void *
+pmem2_map_get_address(struct pmem2_map *map)
+{
+	return map->addr;
+}
+
+/*
+ * pmem2_map_get_size -- returns the length of the mapping
+ */
+size_t
+pmem2_map_get_size(struct pmem2_map *map)
+{
+	return map->length;
+}
+
+/*
+ * pmem2_map_get_store_granularity -- returns the store granularity
+ *	of the mapping
+ */
+enum pmem2_granularity
+pmem2_map_get_store_granularity(struct pmem2_map *map)
+{
+	return map->effective_granularity;
+}
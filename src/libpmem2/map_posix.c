@@ -0,0 +1,333 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map_posix.c -- pmem2_map (POSIX)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+#include "config.h"
+#include "file.h"
+#include "libpmem2.h"
+#include "map.h"
+#include "mmap.h"
+#include "os.h"
+#include "out.h"
+#include "pmem2_utils.h"
+#include "sys_util.h"
+#include "util.h"
+#include "vm_reservation.h"
+
+/*
+ * get_map_protection -- (internal) translates the protection requested in
+ *	the config into mmap() flags
+ */
+static int
+get_map_protection(const struct pmem2_config *cfg, int *proto)
+{
+	if (cfg->protection == PMEM2_PROT_FROM_FD) {
+		int flags = fcntl(cfg->fd, F_GETFL);
+		if (flags == -1) {
+			ERR("!fcntl");
+			return PMEM2_E_EXTERNAL;
+		}
+
+		if ((flags & O_ACCMODE) == O_RDONLY)
+			*proto = PROT_READ;
+		else
+			*proto = PROT_READ | PROT_WRITE;
+
+		return 0;
+	}
+
+	*proto = PROT_NONE;
+	if (cfg->protection & PMEM2_PROT_READ)
+		*proto |= PROT_READ;
+	if (cfg->protection & PMEM2_PROT_WRITE)
+		*proto |= PROT_WRITE;
+	if (cfg->protection & PMEM2_PROT_EXEC)
+		*proto |= PROT_EXEC;
+
+	return 0;
+}
+
+/*
+ * get_map_address -- (internal) figures out the address and mmap() flags
+ *	for the requested address type
+ */
+static int
+get_map_address(const struct pmem2_config *cfg, size_t length,
+	size_t alignment, void **addr, int *flags)
+{
+	switch (cfg->addr_request) {
+		case PMEM2_ADDRESS_ANY:
+			*addr = util_map_hint(length, alignment);
+			if (*addr == MAP_FAILED) {
+				ERR("cannot find a contiguous region of "
+					"given size");
+				return PMEM2_E_MAP_FAILED;
+			}
+			return 0;
+		case PMEM2_ADDRESS_FIXED_REPLACE:
+			*addr = cfg->addr;
+			*flags |= MAP_FIXED;
+			return 0;
+		case PMEM2_ADDRESS_FIXED_NOREPLACE:
+			*addr = cfg->addr;
+#ifdef MAP_FIXED_NOREPLACE
+			*flags |= MAP_FIXED_NOREPLACE;
+#endif
+			return 0;
+		default:
+			ASSERT(0);
+			return PMEM2_E_INVALID_ARG;
+	}
+}
+
+/*
+ * get_reservation_address -- (internal) figures out the address of
+ *	the mapping placed in the reservation
+ *
+ * On success the reservation lock is held and has to be released by
+ * the caller once the mapping is added to the reservation.
+ */
+static int
+get_reservation_address(const struct pmem2_config *cfg, size_t length,
+	size_t alignment, void **addr, int *flags)
+{
+	struct pmem2_vm_reservation *rsv = cfg->reserv;
+
+	if (cfg->addr_request != PMEM2_ADDRESS_ANY) {
+		ERR("address cannot be requested for a mapping placed "
+			"in a reservation");
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	char *base = (char *)rsv->addr + cfg->reserv_offset;
+	if ((uintptr_t)base % alignment) {
+		ERR("address %p is not a multiple of %zu", base, alignment);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	util_mutex_lock(&rsv->lock);
+
+	int ret = vm_reservation_check_range(rsv, cfg->reserv_offset, length);
+	if (ret) {
+		util_mutex_unlock(&rsv->lock);
+		return ret;
+	}
+
+	*addr = base;
+	*flags |= MAP_FIXED;
+
+	return 0;
+}
+
+/*
+ * release_range -- (internal) unmaps the range or, if it belongs to
+ *	a reservation, puts it back into the reservation
+ */
+static int
+release_range(struct pmem2_vm_reservation *rsv, void *addr, size_t length)
+{
+	if (rsv == NULL)
+		return munmap(addr, length);
+
+	void *base = mmap(addr, length, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+
+	return base == MAP_FAILED ? -1 : 0;
+}
+
+/*
+ * pmem2_map -- map memory according to provided config
+ */
+int
+pmem2_map(const struct pmem2_config *cfg, struct pmem2_map **map_ptr)
+{
+	LOG(3, "cfg %p map_ptr %p", cfg, map_ptr);
+
+	int ret;
+
+	if (cfg->fd == INVALID_FD) {
+		ERR("file descriptor not set in the config");
+		return PMEM2_E_INVALID_HANDLE;
+	}
+
+	enum file_type type = util_fd_get_type(cfg->fd);
+	if (type < 0)
+		return PMEM2_E_UNKNOWN_FILETYPE;
+
+	ssize_t fsize = util_fd_get_size(cfg->fd);
+	if (fsize < 0)
+		return PMEM2_E_EXTERNAL;
+
+	size_t file_size = (size_t)fsize;
+	size_t alignment = Pagesize;
+	if (type == TYPE_DEVDAX) {
+		alignment = util_fd_device_dax_alignment(cfg->fd);
+		if (alignment == 0)
+			return PMEM2_E_EXTERNAL;
+	}
+
+	if (cfg->offset % alignment) {
+		ERR("offset %zu is not a multiple of %zu", cfg->offset,
+			alignment);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	if (cfg->offset >= file_size) {
+		ERR("offset %zu is beyond the end of the file (%zu)",
+			cfg->offset, file_size);
+		return PMEM2_E_MAP_RANGE;
+	}
+
+	size_t length = cfg->length;
+	if (length == 0)
+		length = file_size - cfg->offset;
+
+	if (length > file_size - cfg->offset) {
+		ERR("mapping of %zu bytes at offset %zu exceeds the file "
+			"size (%zu)", length, cfg->offset, file_size);
+		return PMEM2_E_MAP_RANGE;
+	}
+
+	if (type == TYPE_DEVDAX && length % alignment) {
+		ERR("length %zu is not a multiple of %zu", length, alignment);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	int proto;
+	ret = get_map_protection(cfg, &proto);
+	if (ret)
+		return ret;
+
+	int flags = cfg->sharing == PMEM2_PRIVATE ? MAP_PRIVATE : MAP_SHARED;
+
+	struct pmem2_vm_reservation *rsv = cfg->reserv;
+
+	void *addr;
+	if (rsv)
+		ret = get_reservation_address(cfg, length, alignment, &addr,
+			&flags);
+	else
+		ret = get_map_address(cfg, length,
+			type == TYPE_DEVDAX ? alignment : 0, &addr, &flags);
+	if (ret)
+		return ret;
+
+	int map_sync;
+	void *base = util_map_sync(addr, length, proto, flags, cfg->fd,
+		(os_off_t)cfg->offset, &map_sync);
+	if (base == MAP_FAILED) {
+		if (cfg->addr_request == PMEM2_ADDRESS_FIXED_NOREPLACE &&
+				errno == EEXIST) {
+			ERR("!mmap: requested range is already occupied");
+			return PMEM2_E_MAP_EXISTS;
+		}
+
+		ERR("!mmap %zu bytes", length);
+		ret = PMEM2_E_MAP_FAILED;
+		goto err_unlock;
+	}
+
+	/* older kernels treat MAP_FIXED_NOREPLACE as a hint only */
+	if (cfg->addr_request == PMEM2_ADDRESS_FIXED_NOREPLACE &&
+			base != cfg->addr) {
+		munmap(base, length);
+		ERR("requested range %p is already occupied", cfg->addr);
+		return PMEM2_E_MAP_EXISTS;
+	}
+
+	LOG(3, "mapped at %p", base);
+
+	enum pmem2_granularity g = map_effective_granularity(cfg,
+		map_sync || type == TYPE_DEVDAX);
+
+	ret = map_validate_granularity(cfg, g);
+	if (ret)
+		goto err_unmap;
+
+	ret = map_new(cfg, base, length, g, map_ptr);
+	if (ret)
+		goto err_unmap;
+
+	if (rsv) {
+		vm_reservation_add_map(rsv, *map_ptr);
+		util_mutex_unlock(&rsv->lock);
+	}
+
+	return 0;
+
+err_unmap:
+	release_range(rsv, base, length);
+err_unlock:
+	if (rsv)
+		util_mutex_unlock(&rsv->lock);
+	return ret;
+}
+
+/*
+ * pmem2_unmap -- unmap the specified mapping
+ */
+int
+pmem2_unmap(struct pmem2_map **map_ptr)
+{
+	LOG(3, "map_ptr %p", map_ptr);
+
+	struct pmem2_map *map = *map_ptr;
+	struct pmem2_vm_reservation *rsv = map->cfg.reserv;
+
+	if (rsv)
+		util_mutex_lock(&rsv->lock);
+
+	if (release_range(rsv, map->addr, map->length)) {
+		if (rsv)
+			util_mutex_unlock(&rsv->lock);
+		ERR("!munmap");
+		return PMEM2_E_EXTERNAL;
+	}
+
+	if (rsv) {
+		vm_reservation_remove_map(rsv, map);
+		util_mutex_unlock(&rsv->lock);
+	}
+
+	Free(map);
+	*map_ptr = NULL;
+
+	return 0;
+}
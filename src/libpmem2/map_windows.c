@@ -0,0 +1,218 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map_windows.c -- pmem2_map (Windows)
+ */
+
+#include <stdbool.h>
+
+#include "alloc.h"
+#include "config.h"
+#include "libpmem2.h"
+#include "map.h"
+#include "out.h"
+#include "pmem2_utils.h"
+#include "util.h"
+
+#define HIDWORD(x) ((DWORD)((x) >> 32))
+#define LODWORD(x) ((DWORD)((x) & 0xFFFFFFFF))
+
+/*
+ * get_map_protection -- (internal) translates the protection requested in
+ *	the config into CreateFileMapping() protection and MapViewOfFileEx()
+ *	access flags
+ */
+static int
+get_map_protection(const struct pmem2_config *cfg, DWORD *protect,
+	DWORD *access)
+{
+	/* XXX: winapi doesn't provide option to get open flags from HANDLE */
+	unsigned prot = cfg->protection;
+	if (prot == PMEM2_PROT_FROM_FD)
+		prot = PMEM2_PROT_READ | PMEM2_PROT_WRITE;
+
+	bool exec = (prot & PMEM2_PROT_EXEC) != 0;
+
+	if (prot & PMEM2_PROT_WRITE) {
+		*protect = exec ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+		*access = FILE_MAP_WRITE;
+	} else if (prot & PMEM2_PROT_READ) {
+		*protect = exec ? PAGE_EXECUTE_READ : PAGE_READONLY;
+		*access = FILE_MAP_READ;
+	} else {
+		/* PAGE_NOACCESS is not supported by CreateFileMapping */
+		ERR("mapping without read access is not supported");
+		return PMEM2_E_NOSUPP;
+	}
+
+	if (cfg->sharing == PMEM2_PRIVATE)
+		*access = FILE_MAP_COPY;
+
+	if (exec)
+		*access |= FILE_MAP_EXECUTE;
+
+	return 0;
+}
+
+/*
+ * pmem2_map -- map memory according to provided config
+ */
+int
+pmem2_map(const struct pmem2_config *cfg, struct pmem2_map **map_ptr)
+{
+	LOG(3, "cfg %p map_ptr %p", cfg, map_ptr);
+
+	int ret;
+
+	if (cfg->handle == INVALID_HANDLE_VALUE) {
+		ERR("file handle not set in the config");
+		return PMEM2_E_INVALID_HANDLE;
+	}
+
+	if (cfg->reserv) {
+		ERR("virtual memory reservations are not supported");
+		return PMEM2_E_NOSUPP;
+	}
+
+	if (cfg->addr_request == PMEM2_ADDRESS_FIXED_REPLACE) {
+		ERR("replacing existing mappings is not supported");
+		return PMEM2_E_NOSUPP;
+	}
+
+	LARGE_INTEGER filesize;
+	if (!GetFileSizeEx(cfg->handle, &filesize)) {
+		ERR("GetFileSizeEx, gle: 0x%08x", GetLastError());
+		return PMEM2_E_EXTERNAL;
+	}
+
+	size_t file_size = (size_t)filesize.QuadPart;
+
+	if (cfg->offset % Mmap_align) {
+		ERR("offset %zu is not a multiple of %llu", cfg->offset,
+			Mmap_align);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	if (cfg->offset >= file_size) {
+		ERR("offset %zu is beyond the end of the file (%zu)",
+			cfg->offset, file_size);
+		return PMEM2_E_MAP_RANGE;
+	}
+
+	size_t length = cfg->length;
+	if (length == 0)
+		length = file_size - cfg->offset;
+
+	if (length > file_size - cfg->offset) {
+		ERR("mapping of %zu bytes at offset %zu exceeds the file "
+			"size (%zu)", length, cfg->offset, file_size);
+		return PMEM2_E_MAP_RANGE;
+	}
+
+	DWORD protect;
+	DWORD access;
+	ret = get_map_protection(cfg, &protect, &access);
+	if (ret)
+		return ret;
+
+	size_t max_size = cfg->offset + length;
+	HANDLE mh = CreateFileMapping(cfg->handle,
+			NULL, /* security attributes */
+			protect,
+			HIDWORD(max_size),
+			LODWORD(max_size),
+			NULL);
+	if (mh == NULL) {
+		ERR("CreateFileMapping, gle: 0x%08x", GetLastError());
+		return PMEM2_E_EXTERNAL;
+	}
+
+	void *base = MapViewOfFileEx(mh,
+			access,
+			HIDWORD(cfg->offset),
+			LODWORD(cfg->offset),
+			length,
+			cfg->addr);
+	DWORD gle = GetLastError();
+
+	/* the view keeps a reference to the mapping object */
+	CloseHandle(mh);
+
+	if (base == NULL) {
+		ERR("MapViewOfFileEx, gle: 0x%08x", gle);
+		if (cfg->addr_request == PMEM2_ADDRESS_FIXED_NOREPLACE &&
+				gle == ERROR_INVALID_ADDRESS)
+			return PMEM2_E_MAP_EXISTS;
+		return PMEM2_E_MAP_FAILED;
+	}
+
+	LOG(3, "mapped at %p", base);
+
+	/* XXX: there is no way to tell if the view is DAX-mapped yet */
+	enum pmem2_granularity g = map_effective_granularity(cfg, 0);
+
+	ret = map_validate_granularity(cfg, g);
+	if (ret)
+		goto err_unmap;
+
+	ret = map_new(cfg, base, length, g, map_ptr);
+	if (ret)
+		goto err_unmap;
+
+	return 0;
+
+err_unmap:
+	UnmapViewOfFile(base);
+	return ret;
+}
+
+/*
+ * pmem2_unmap -- unmap the specified mapping
+ */
+int
+pmem2_unmap(struct pmem2_map **map_ptr)
+{
+	LOG(3, "map_ptr %p", map_ptr);
+
+	struct pmem2_map *map = *map_ptr;
+
+	if (!UnmapViewOfFile(map->addr)) {
+		ERR("UnmapViewOfFile, gle: 0x%08x", GetLastError());
+		return PMEM2_E_EXTERNAL;
+	}
+
+	Free(map);
+	*map_ptr = NULL;
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * persist.c -- pmem2_get_[persist|flush|drain]_fn and
+ *	pmem2_get_[memmove|memcpy|memset]_fn
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libpmem2.h"
+#include "map.h"
+#include "out.h"
+#include "persist.h"
+
+static struct pmem2_arch_info Info;
+
+/*
+ * pmem2_persist_init -- initialize persist module
+ */
+void
+pmem2_persist_init(void)
+{
+	LOG(3, NULL);
+
+	pmem2_arch_init(&Info);
+}
+
+/*
+ * pmem2_flush_nop -- (internal) flush for mappings whose stores are
+ *	persistent as soon as they become globally visible
+ */
+static void
+pmem2_flush_nop(const void *addr, size_t len)
+{
+	/* nothing to do */
+}
+
+/*
+ * pmem2_drain_nop -- (internal) drain for mappings which are flushed
+ *	synchronously
+ */
+static void
+pmem2_drain_nop(void)
+{
+	/* nothing to do */
+}
+
+/*
+ * pmem2_persist_pages -- (internal) flush the dirty pages of the range
+ *	back to the file
+ */
+static void
+pmem2_persist_pages(const void *addr, size_t len)
+{
+	if (pmem2_flush_file_buffers_os(addr, len)) {
+		/*
+		 * There's no way to report this error to the caller and
+		 * silently ignoring it would lead to data corruption, so
+		 * the only sane thing to do is to crash the application.
+		 */
+		abort();
+	}
+}
+
+/*
+ * pmem2_memmove_nonpmem -- (internal) memmove to a mapping which has to be
+ *	flushed by the operating system
+ */
+static void
+pmem2_memmove_nonpmem(void *pmemdest, const void *src, size_t len,
+		unsigned flags)
+{
+	LOG(15, "pmemdest %p src %p len %zu flags 0x%x", pmemdest, src, len,
+			flags);
+
+	memmove(pmemdest, src, len);
+
+	if (!(flags & PMEM2_F_MEM_NOFLUSH))
+		pmem2_persist_pages(pmemdest, len);
+}
+
+/*
+ * pmem2_memset_nonpmem -- (internal) memset to a mapping which has to be
+ *	flushed by the operating system
+ */
+static void
+pmem2_memset_nonpmem(void *pmemdest, int c, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu flags 0x%x", pmemdest, c, len,
+			flags);
+
+	memset(pmemdest, c, len);
+
+	if (!(flags & PMEM2_F_MEM_NOFLUSH))
+		pmem2_persist_pages(pmemdest, len);
+}
+
+/*
+ * pmem2_set_flush_fns -- set the flushing routines of the mapping
+ *
+ * The routines are picked once, when the mapping is created, so that
+ * the persist path does not have to check the granularity or the CPU
+ * features again.
+ */
+void
+pmem2_set_flush_fns(struct pmem2_map *map)
+{
+	switch (map->effective_granularity) {
+		case PMEM2_GRANULARITY_PAGE:
+			map->persist_fn = pmem2_persist_pages;
+			map->flush_fn = pmem2_persist_pages;
+			map->drain_fn = pmem2_drain_nop;
+			break;
+		case PMEM2_GRANULARITY_CACHE_LINE:
+			map->persist_fn = Info.persist;
+			map->flush_fn = Info.flush;
+			map->drain_fn = Info.fence;
+			break;
+		case PMEM2_GRANULARITY_BYTE:
+			/*
+			 * CPU caches are flushed on power failure, so only
+			 * the ordering of stores has to be guaranteed.
+			 */
+			map->persist_fn = Info.persist_noflush;
+			map->flush_fn = pmem2_flush_nop;
+			map->drain_fn = Info.fence;
+			break;
+		default:
+			ASSERT(0);
+	}
+}
+
+/*
+ * pmem2_set_mem_fns -- set the memmove/memcpy/memset routines of the mapping
+ *
+ * The routines are bound to the flush flavor of the mapping, so they never
+ * consult any global state to decide how to flush.
+ */
+void
+pmem2_set_mem_fns(struct pmem2_map *map)
+{
+	switch (map->effective_granularity) {
+		case PMEM2_GRANULARITY_PAGE:
+			map->memmove_fn = pmem2_memmove_nonpmem;
+			map->memset_fn = pmem2_memset_nonpmem;
+			break;
+		case PMEM2_GRANULARITY_CACHE_LINE:
+			map->memmove_fn = Info.memmove;
+			map->memset_fn = Info.memset;
+			break;
+		case PMEM2_GRANULARITY_BYTE:
+			map->memmove_fn = Info.memmove_noflush;
+			map->memset_fn = Info.memset_noflush;
+			break;
+		default:
+			ASSERT(0);
+	}
+
+	/* memmove handles non-overlapping ranges just as well */
+	map->memcpy_fn = map->memmove_fn;
+}
+
+/*
+ * pmem2_get_persist_fn -- returns persist function for the mapping
+ */
+pmem2_persist_fn
+pmem2_get_persist_fn(struct pmem2_map *map)
+{
+	return map->persist_fn;
+}
+
+/*
+ * pmem2_get_flush_fn -- returns flush function for the mapping
+ */
+pmem2_flush_fn
+pmem2_get_flush_fn(struct pmem2_map *map)
+{
+	return map->flush_fn;
+}
+
+/*
+ * pmem2_get_drain_fn -- returns drain function for the mapping
+ */
+pmem2_drain_fn
+pmem2_get_drain_fn(struct pmem2_map *map)
+{
+	return map->drain_fn;
+}
+
+/*
+ * pmem2_get_memmove_fn -- returns memmove function for the mapping
+ */
+pmem2_memmove_fn
+pmem2_get_memmove_fn(struct pmem2_map *map)
+{
+	return map->memmove_fn;
+}
+
+/*
+ * pmem2_get_memcpy_fn -- returns memcpy function for the mapping
+ */
+pmem2_memcpy_fn
+pmem2_get_memcpy_fn(struct pmem2_map *map)
+{
+	return map->memcpy_fn;
+}
+
+/*
+ * pmem2_get_memset_fn -- returns memset function for the mapping
+ */
+pmem2_memset_fn
+pmem2_get_memset_fn(struct pmem2_map *map)
+{
+	return map->memset_fn;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * persist.h -- internal definitions for libpmem2 persist module
+ */
+#ifndef PMEM2_PERSIST_H
+#define PMEM2_PERSIST_H
+
+#include <stddef.h>
+
+#include "libpmem2.h"
+#include "map.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * struct pmem2_arch_info -- architecture specific flushing primitives,
+ *	detected once when the library is loaded
+ */
+struct pmem2_arch_info {
+	/* flush the CPU cache and wait for the flushes to complete */
+	pmem2_persist_fn persist;
+	/* order stores without flushing the CPU cache */
+	pmem2_persist_fn persist_noflush;
+	/* flush the CPU cache */
+	pmem2_flush_fn flush;
+	/* wait for previous flushes and stores to complete */
+	pmem2_drain_fn fence;
+
+	/* memmove/memset flushing the CPU cache with the above flush */
+	pmem2_memmove_fn memmove;
+	pmem2_memset_fn memset;
+	/* memmove/memset not flushing the CPU cache */
+	pmem2_memmove_fn memmove_noflush;
+	pmem2_memset_fn memset_noflush;
+};
+
+void pmem2_arch_init(struct pmem2_arch_info *info);
+
+void pmem2_persist_init(void);
+void pmem2_set_flush_fns(struct pmem2_map *map);
+void pmem2_set_mem_fns(struct pmem2_map *map);
+
+int pmem2_flush_file_buffers_os(const void *addr, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
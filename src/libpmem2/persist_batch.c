@@ -0,0 +1,392 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * persist_batch.c -- pmem2_persist_batch_* implementation
+ *
+ * A persist batch collects ranges of a mapping which have to be made
+ * persistent. Ranges are rounded to the flush unit of the mapping (a cache
+ * line or a page) when they are added, so that on commit overlapping and
+ * adjacent ranges can be merged and every unit is flushed exactly once.
+ * The whole batch is then drained with a single fence.
+ *
+ * Ranges are grouped into generations. Adding a range returns the number
+ * of the currently open generation, which becomes a completion token:
+ * it can be polled by any thread and is complete once a commit which
+ * closed that generation has drained.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "libpmem2.h"
+#include "map.h"
+#include "os_thread.h"
+#include "out.h"
+#include "pmem2_utils.h"
+#include "sys_util.h"
+#include "util.h"
+
+#define PERSIST_BATCH_INIT_RANGES 64
+
+struct persist_range {
+	uintptr_t start;
+	uintptr_t end;
+};
+
+struct persist_range_vec {
+	struct persist_range *ranges;
+	size_t size;
+	size_t capacity;
+};
+
+struct pmem2_persist_batch {
+	struct pmem2_map *map;
+	uintptr_t align; /* flush unit of the mapping */
+	int track_ranges; /* 0 if the mapping does not need any flushing */
+
+	os_mutex_t lock; /* protects the fields below */
+	struct persist_range_vec pending; /* ranges of the open generation */
+	struct persist_range_vec flushing; /* spare vector used by commit */
+	int dirty; /* the open generation is not empty */
+	uint64_t open_gen; /* generation new ranges are added to */
+
+	os_mutex_t commit_lock; /* serializes commits */
+	uint64_t completed_gen; /* last generation known to be persistent */
+};
+
+/*
+ * persist_batch_range_cmp -- (internal) compare ranges by their start
+ */
+static int
+persist_batch_range_cmp(const void *lhs, const void *rhs)
+{
+	const struct persist_range *l = lhs;
+	const struct persist_range *r = rhs;
+
+	if (l->start < r->start)
+		return -1;
+	if (l->start > r->start)
+		return 1;
+	return 0;
+}
+
+/*
+ * persist_batch_append -- (internal) append the range to the pending vector,
+ *	merging it with the previous one if they touch
+ */
+static int
+persist_batch_append(struct pmem2_persist_batch *batch,
+		uintptr_t start, uintptr_t end)
+{
+	struct persist_range_vec *v = &batch->pending;
+
+	/* sequential writers produce long runs of adjacent ranges */
+	if (v->size > 0) {
+		struct persist_range *last = &v->ranges[v->size - 1];
+		if (start <= last->end && end >= last->start) {
+			if (start < last->start)
+				last->start = start;
+			if (end > last->end)
+				last->end = end;
+			return 0;
+		}
+	}
+
+	if (v->size == v->capacity) {
+		int ret;
+		size_t capacity = v->capacity ?
+			v->capacity * 2 : PERSIST_BATCH_INIT_RANGES;
+		struct persist_range *ranges = pmem2_realloc(v->ranges,
+			capacity * sizeof(*ranges), &ret);
+		if (ranges == NULL)
+			return ret;
+
+		v->ranges = ranges;
+		v->capacity = capacity;
+	}
+
+	v->ranges[v->size].start = start;
+	v->ranges[v->size].end = end;
+	v->size++;
+
+	return 0;
+}
+
+/*
+ * persist_batch_flush -- (internal) flush the ranges, merging the overlapping
+ *	and adjacent ones
+ */
+static void
+persist_batch_flush(struct pmem2_persist_batch *batch,
+		struct persist_range_vec *v)
+{
+	if (v->size == 0)
+		return;
+
+	qsort(v->ranges, v->size, sizeof(*v->ranges),
+		persist_batch_range_cmp);
+
+	pmem2_flush_fn flush = batch->map->flush_fn;
+	struct persist_range cur = v->ranges[0];
+
+	for (size_t i = 1; i < v->size; ++i) {
+		struct persist_range *r = &v->ranges[i];
+		if (r->start <= cur.end) {
+			if (r->end > cur.end)
+				cur.end = r->end;
+			continue;
+		}
+
+		flush((void *)cur.start, cur.end - cur.start);
+		cur = *r;
+	}
+
+	flush((void *)cur.start, cur.end - cur.start);
+
+	v->size = 0;
+}
+
+/*
+ * pmem2_persist_batch_new -- create a persist batch for the mapping
+ */
+int
+pmem2_persist_batch_new(struct pmem2_map *map,
+		struct pmem2_persist_batch **batch)
+{
+	LOG(3, "map %p batch %p", map, batch);
+
+	int ret;
+	struct pmem2_persist_batch *b = pmem2_malloc(sizeof(*b), &ret);
+	if (b == NULL)
+		return ret;
+
+	b->map = map;
+
+	switch (map->effective_granularity) {
+		case PMEM2_GRANULARITY_PAGE:
+			b->align = (uintptr_t)Pagesize;
+			b->track_ranges = 1;
+			break;
+		case PMEM2_GRANULARITY_CACHE_LINE:
+			b->align = (uintptr_t)CACHELINE_SIZE;
+			b->track_ranges = 1;
+			break;
+		case PMEM2_GRANULARITY_BYTE:
+			/* only the final fence matters */
+			b->align = (uintptr_t)CACHELINE_SIZE;
+			b->track_ranges = 0;
+			break;
+		default:
+			ASSERT(0);
+	}
+
+	b->pending.ranges = NULL;
+	b->pending.size = 0;
+	b->pending.capacity = 0;
+	b->flushing = b->pending;
+	b->dirty = 0;
+	b->open_gen = 1;
+	b->completed_gen = 0;
+
+	util_mutex_init(&b->lock);
+	util_mutex_init(&b->commit_lock);
+
+	*batch = b;
+
+	return PMEM2_E_OK;
+}
+
+/*
+ * pmem2_persist_batch_add -- queue the range for flushing
+ */
+int
+pmem2_persist_batch_add(struct pmem2_persist_batch *batch,
+		const void *ptr, size_t size, uint64_t *token)
+{
+	LOG(15, "batch %p ptr %p size %zu", batch, ptr, size);
+
+	uintptr_t map_start = (uintptr_t)batch->map->addr;
+	uintptr_t map_end = map_start + batch->map->length;
+	uintptr_t start = (uintptr_t)ptr;
+
+	if (start < map_start || size > map_end - start) {
+		ERR("range %p-%p is outside of the mapping", ptr,
+			(char *)ptr + size);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	uintptr_t end = start + size;
+	start &= ~(batch->align - 1);
+	end = (end + batch->align - 1) & ~(batch->align - 1);
+
+	int ret = 0;
+
+	util_mutex_lock(&batch->lock);
+
+	if (batch->track_ranges && start != end)
+		ret = persist_batch_append(batch, start, end);
+
+	if (ret == 0) {
+		batch->dirty = 1;
+		if (token)
+			*token = batch->open_gen;
+	}
+
+	util_mutex_unlock(&batch->lock);
+
+	return ret;
+}
+
+/*
+ * pmem2_persist_batch_commit -- flush all the queued ranges and drain once
+ */
+int
+pmem2_persist_batch_commit(struct pmem2_persist_batch *batch,
+		uint64_t *token)
+{
+	LOG(15, "batch %p", batch);
+
+	util_mutex_lock(&batch->commit_lock);
+	util_mutex_lock(&batch->lock);
+
+	if (!batch->dirty) {
+		/* all closed generations were already drained */
+		if (token)
+			*token = batch->open_gen - 1;
+
+		util_mutex_unlock(&batch->lock);
+		util_mutex_unlock(&batch->commit_lock);
+
+		return PMEM2_E_OK;
+	}
+
+	/*
+	 * Close the generation and take its ranges, so that other threads
+	 * can keep adding to the next one while this one is being flushed.
+	 */
+	uint64_t gen = batch->open_gen++;
+	batch->dirty = 0;
+
+	struct persist_range_vec v = batch->pending;
+	batch->pending = batch->flushing;
+
+	util_mutex_unlock(&batch->lock);
+
+	persist_batch_flush(batch, &v);
+	batch->map->drain_fn();
+
+	batch->flushing = v;
+	util_atomic_store_explicit64(&batch->completed_gen, gen,
+		memory_order_release);
+
+	util_mutex_unlock(&batch->commit_lock);
+
+	if (token)
+		*token = gen;
+
+	return PMEM2_E_OK;
+}
+
+/*
+ * pmem2_persist_batch_poll -- check whether the generation identified by
+ *	the token is persistent
+ */
+int
+pmem2_persist_batch_poll(struct pmem2_persist_batch *batch, uint64_t token)
+{
+	uint64_t completed;
+	util_atomic_load_explicit64(&batch->completed_gen, &completed,
+		memory_order_acquire);
+
+	return token <= completed;
+}
+
+/*
+ * pmem2_persist_batch_wait -- make sure the generation identified by
+ *	the token is persistent, committing the batch if needed
+ */
+int
+pmem2_persist_batch_wait(struct pmem2_persist_batch *batch, uint64_t token)
+{
+	LOG(15, "batch %p token %" PRIu64, batch, token);
+
+	if (pmem2_persist_batch_poll(batch, token))
+		return PMEM2_E_OK;
+
+	util_mutex_lock(&batch->lock);
+	uint64_t open_gen = batch->open_gen;
+	util_mutex_unlock(&batch->lock);
+
+	if (token > open_gen) {
+		ERR("invalid token %" PRIu64, token);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	int ret = pmem2_persist_batch_commit(batch, NULL);
+	if (ret)
+		return ret;
+
+	ASSERT(pmem2_persist_batch_poll(batch, token));
+
+	return PMEM2_E_OK;
+}
+
+/*
+ * pmem2_persist_batch_delete -- commit the remaining ranges and free
+ *	the batch
+ */
+int
+pmem2_persist_batch_delete(struct pmem2_persist_batch **batch)
+{
+	LOG(3, "batch %p", batch);
+
+	struct pmem2_persist_batch *b = *batch;
+	if (b == NULL)
+		return PMEM2_E_OK;
+
+	int ret = pmem2_persist_batch_commit(b, NULL);
+	if (ret)
+		return ret;
+
+	util_mutex_destroy(&b->lock);
+	util_mutex_destroy(&b->commit_lock);
+
+	Free(b->pending.ranges);
+	Free(b->flushing.ranges);
+	Free(b);
+
+	*batch = NULL;
+
+	return PMEM2_E_OK;
+}
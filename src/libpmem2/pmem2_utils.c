@@ -60,3 +60,24 @@ pmem2_malloc(size_t size, int *err)
 
 	return ptr;
 }
+
+/*
+ * pmem2_realloc -- reallocate buffer and handle error
+ */
+void *
+pmem2_realloc(void *ptr, size_t size, int *err)
+{
+	void *newptr = Realloc(ptr, size);
+	*err = 0;
+
+	if (newptr == NULL) {
+		ERR("!realloc(%zu)", size);
+
+		if (errno == ENOMEM)
+			*err = PMEM2_E_NOMEM;
+		else
+			*err = PMEM2_E_EXTERNAL;
+	}
+
+	return newptr;
+}
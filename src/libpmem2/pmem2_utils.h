@@ -38,5 +38,6 @@
 #define PMEM2_UTILS_H 1
 
 void *pmem2_malloc(size_t size, int *err);
+void *pmem2_realloc(void *ptr, size_t size, int *err);
 
 #endif /* PMEM2_UTILS_H */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vm_reservation.c -- implementation of virtual memory reservation API
+ *	common for all platforms
+ */
+
+#include "libpmem2.h"
+#include "map.h"
+#include "out.h"
+#include "vm_reservation.h"
+
+/*
+ * pmem2_vm_reservation_get_address -- returns the base address
+ *	of the reservation
+ */
+void *
+pmem2_vm_reservation_get_address(struct pmem2_vm_reservation *rsv)
+{
+	return rsv->addr;
+}
+
+/*
+ * pmem2_vm_reservation_get_size -- returns the length of the reservation
+ */
+size_t
+pmem2_vm_reservation_get_size(struct pmem2_vm_reservation *rsv)
+{
+	return rsv->size;
+}
+
+/*
+ * vm_reservation_check_range -- verifies the range fits in the reservation
+ *	and does not overlap any mapping placed in it
+ *
+ * The caller must hold the reservation lock.
+ */
+int
+vm_reservation_check_range(struct pmem2_vm_reservation *rsv,
+		size_t offset, size_t length)
+{
+	if (offset > rsv->size || length > rsv->size - offset) {
+		ERR("mapping of %zu bytes at offset %zu exceeds the "
+			"reservation size (%zu)", length, offset, rsv->size);
+		return PMEM2_E_MAP_RANGE;
+	}
+
+	char *start = (char *)rsv->addr + offset;
+	char *end = start + length;
+
+	struct pmem2_map *map;
+	PMDK_LIST_FOREACH(map, &rsv->maps, reserv_entry) {
+		char *map_start = map->addr;
+		char *map_end = map_start + map->length;
+
+		if (start < map_end && map_start < end) {
+			ERR("range %p-%p overlaps mapping %p-%p", start, end,
+				map_start, map_end);
+			return PMEM2_E_MAP_EXISTS;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * vm_reservation_add_map -- adds the mapping to the list of mappings placed
+ *	in the reservation
+ *
+ * The caller must hold the reservation lock.
+ */
+void
+vm_reservation_add_map(struct pmem2_vm_reservation *rsv,
+		struct pmem2_map *map)
+{
+	PMDK_LIST_INSERT_HEAD(&rsv->maps, map, reserv_entry);
+}
+
+/*
+ * vm_reservation_remove_map -- removes the mapping from the list of mappings
+ *	placed in the reservation
+ *
+ * The caller must hold the reservation lock.
+ */
+void
+vm_reservation_remove_map(struct pmem2_vm_reservation *rsv,
+		struct pmem2_map *map)
+{
+	PMDK_LIST_REMOVE(map, reserv_entry);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vm_reservation_posix.c -- implementation of virtual memory reservation API
+ *	(POSIX)
+ *
+ * The reservation is an inaccessible, anonymous mapping which does not
+ * commit any memory. File mappings placed in it replace parts of that
+ * mapping with MAP_FIXED and are replaced back by an inaccessible mapping
+ * when unmapped, so the address range is never released to the system
+ * while the reservation exists.
+ */
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+#include "libpmem2.h"
+#include "mmap.h"
+#include "out.h"
+#include "pmem2_utils.h"
+#include "sys_util.h"
+#include "util.h"
+#include "vm_reservation.h"
+
+#define RESERV_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE)
+
+/*
+ * reserve_noreplace -- (internal) reserves the range at exactly the given
+ *	address, fails if any part of it is already occupied
+ */
+static int
+reserve_noreplace(void *addr, size_t size)
+{
+	int flags = RESERV_FLAGS;
+#ifdef MAP_FIXED_NOREPLACE
+	flags |= MAP_FIXED_NOREPLACE;
+#endif
+
+	void *base = mmap(addr, size, PROT_NONE, flags, -1, 0);
+	if (base == MAP_FAILED) {
+		if (errno == EEXIST) {
+			ERR("!mmap: requested range is already occupied");
+			return PMEM2_E_MAP_EXISTS;
+		}
+
+		ERR("!mmap %zu bytes", size);
+		return PMEM2_E_MAP_FAILED;
+	}
+
+	/* older kernels treat MAP_FIXED_NOREPLACE as a hint only */
+	if (base != addr) {
+		munmap(base, size);
+		ERR("requested range %p is already occupied", addr);
+		return PMEM2_E_MAP_EXISTS;
+	}
+
+	return 0;
+}
+
+/*
+ * pmem2_vm_reservation_new -- reserves the range of virtual address space
+ */
+int
+pmem2_vm_reservation_new(struct pmem2_vm_reservation **rsv_ptr, void *addr,
+		size_t size)
+{
+	LOG(3, "rsv_ptr %p addr %p size %zu", rsv_ptr, addr, size);
+
+	int ret;
+
+	if (size == 0 || size % Pagesize) {
+		ERR("size %zu is not a non-zero multiple of %llu", size,
+			Pagesize);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	if (!IS_PAGE_ALIGNED((uintptr_t)addr)) {
+		ERR("address %p is not page aligned", addr);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	struct pmem2_vm_reservation *rsv = pmem2_malloc(sizeof(*rsv), &ret);
+	if (ret)
+		return ret;
+
+	if (addr) {
+		ret = reserve_noreplace(addr, size);
+		if (ret)
+			goto err_free;
+	} else {
+		addr = util_map_hint(size, 0);
+		if (addr == MAP_FAILED) {
+			ERR("cannot find a contiguous region of given size");
+			ret = PMEM2_E_MAP_FAILED;
+			goto err_free;
+		}
+
+		addr = mmap(addr, size, PROT_NONE, RESERV_FLAGS, -1, 0);
+		if (addr == MAP_FAILED) {
+			ERR("!mmap %zu bytes", size);
+			ret = PMEM2_E_MAP_FAILED;
+			goto err_free;
+		}
+	}
+
+	LOG(3, "reserved %p-%p", addr, (char *)addr + size);
+
+	rsv->addr = addr;
+	rsv->size = size;
+	util_mutex_init(&rsv->lock);
+	PMDK_LIST_INIT(&rsv->maps);
+
+	*rsv_ptr = rsv;
+
+	return 0;
+
+err_free:
+	Free(rsv);
+	return ret;
+}
+
+/*
+ * pmem2_vm_reservation_delete -- releases the reservation, which must not
+ *	contain any mappings
+ */
+int
+pmem2_vm_reservation_delete(struct pmem2_vm_reservation **rsv_ptr)
+{
+	LOG(3, "rsv_ptr %p", rsv_ptr);
+
+	struct pmem2_vm_reservation *rsv = *rsv_ptr;
+
+	util_mutex_lock(&rsv->lock);
+
+	if (!PMDK_LIST_EMPTY(&rsv->maps)) {
+		util_mutex_unlock(&rsv->lock);
+		ERR("reservation %p still contains mappings", rsv->addr);
+		return PMEM2_E_VM_RESERVATION_NOT_EMPTY;
+	}
+
+	if (munmap(rsv->addr, rsv->size)) {
+		util_mutex_unlock(&rsv->lock);
+		ERR("!munmap");
+		return PMEM2_E_EXTERNAL;
+	}
+
+	util_mutex_unlock(&rsv->lock);
+	util_mutex_destroy(&rsv->lock);
+
+	Free(rsv);
+	*rsv_ptr = NULL;
+
+	return 0;
+}
+
+/*
+ * pmem2_vm_reservation_extend -- grows the reservation in place by reserving
+ *	the range right after its end
+ *
+ * Mappings already placed in the reservation are not affected, so pointers
+ * to them stay valid.
+ */
+int
+pmem2_vm_reservation_extend(struct pmem2_vm_reservation *rsv, size_t size)
+{
+	LOG(3, "rsv %p size %zu", rsv, size);
+
+	if (size == 0 || size % Pagesize) {
+		ERR("size %zu is not a non-zero multiple of %llu", size,
+			Pagesize);
+		return PMEM2_E_INVALID_ARG;
+	}
+
+	util_mutex_lock(&rsv->lock);
+
+	void *end = (char *)rsv->addr + rsv->size;
+	int ret = reserve_noreplace(end, size);
+	if (ret == 0) {
+		rsv->size += size;
+		LOG(3, "reservation %p extended to %zu bytes", rsv->addr,
+			rsv->size);
+	}
+
+	util_mutex_unlock(&rsv->lock);
+
+	return ret;
+}
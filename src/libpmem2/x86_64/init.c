@@ -0,0 +1,577 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * init.c -- x86_64 specific part of libpmem2 persist module
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+#include "cpu.h"
+#include "flush.h"
+#include "memcpy_memset.h"
+#include "os.h"
+#include "out.h"
+#include "persist.h"
+#include "valgrind_internal.h"
+
+#define MOVNT_THRESHOLD	256
+
+size_t Movnt_threshold = MOVNT_THRESHOLD;
+
+/*
+ * memory_barrier -- (internal) issue the fence instruction
+ */
+static void
+memory_barrier(void)
+{
+	LOG(15, NULL);
+
+	VALGRIND_DO_FENCE;
+	_mm_sfence();	/* ensure CLWB or CLFLUSHOPT completes */
+}
+
+/*
+ * fence_empty -- (internal) do not issue the fence instruction
+ */
+static void
+fence_empty(void)
+{
+	LOG(15, NULL);
+
+	VALGRIND_DO_FENCE;
+	/* nothing to do (because CLFLUSH did it for us) */
+}
+
+/*
+ * flush_clflush -- (internal) flush the CPU cache, using clflush
+ */
+static void
+flush_clflush(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clflush_nolog(addr, len);
+	VALGRIND_DO_FLUSH(addr, len);
+}
+
+/*
+ * flush_clflushopt -- (internal) flush the CPU cache, using clflushopt
+ */
+static void
+flush_clflushopt(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clflushopt_nolog(addr, len);
+	VALGRIND_DO_FLUSH(addr, len);
+}
+
+/*
+ * flush_clwb -- (internal) flush the CPU cache, using clwb
+ */
+static void
+flush_clwb(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clwb_nolog(addr, len);
+	VALGRIND_DO_FLUSH(addr, len);
+}
+
+/*
+ * persist_clflush -- (internal) make stores persistent, using clflush
+ *
+ * clflush is ordered with respect to other stores, so no fence is needed.
+ */
+static void
+persist_clflush(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clflush_nolog(addr, len);
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * persist_clflushopt -- (internal) make stores persistent, using clflushopt
+ */
+static void
+persist_clflushopt(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clflushopt_nolog(addr, len);
+	_mm_sfence();
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * persist_clwb -- (internal) make stores persistent, using clwb
+ */
+static void
+persist_clwb(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_clwb_nolog(addr, len);
+	_mm_sfence();
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * persist_noflush -- (internal) make stores persistent on a platform
+ *	which flushes CPU caches on power failure
+ */
+static void
+persist_noflush(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	_mm_sfence();
+	VALGRIND_DO_PERSIST(addr, len);
+}
+
+/*
+ * drain_clflush -- (internal) wait for clflush and non-temporal stores
+ *
+ * clflush is ordered with respect to other stores and the non-temporal
+ * kernels of this flavor fence themselves, so there is nothing to do.
+ */
+static force_inline void
+drain_clflush(void)
+{
+	VALGRIND_DO_FENCE;
+}
+
+/*
+ * drain_clflushopt -- (internal) wait for clflushopt to complete
+ */
+static force_inline void
+drain_clflushopt(void)
+{
+	VALGRIND_DO_FENCE;
+	_mm_sfence();
+}
+
+/*
+ * drain_clwb -- (internal) wait for clwb to complete
+ */
+static force_inline void
+drain_clwb(void)
+{
+	VALGRIND_DO_FENCE;
+	_mm_sfence();
+}
+
+/*
+ * drain_empty -- (internal) order stores on a platform which flushes
+ *	CPU caches on power failure
+ */
+static force_inline void
+drain_empty(void)
+{
+	VALGRIND_DO_FENCE;
+	_mm_sfence();
+}
+
+#ifdef DEBUG
+#define CHECK_MEM_FLAGS(flags) do {\
+	if ((flags) & ~PMEM2_F_MEM_VALID_FLAGS)\
+		ERR("invalid flags 0x%x", (flags));\
+} while (0)
+#else
+#define CHECK_MEM_FLAGS(flags) do {} while (0)
+#endif
+
+/*
+ * The functions below are generated for each combination of the instruction
+ * set and the flush flavor, so that the memmove/memset functions of
+ * a mapping do not have to dispatch on anything but the flags.
+ */
+
+#define MEMCPY_LIBC_TEMPLATE(flush)\
+static void \
+memmove_libc_##flush(void *dest, const void *src, size_t len, \
+		unsigned flags)\
+{\
+	LOG(15, "dest %p src %p len %zu flags 0x%x", dest, src, len, flags);\
+	CHECK_MEM_FLAGS(flags);\
+\
+	memmove(dest, src, len);\
+	if (!(flags & PMEM2_F_MEM_NOFLUSH)) {\
+		flush_##flush##_nolog(dest, len);\
+		VALGRIND_DO_FLUSH(dest, len);\
+	}\
+\
+	if (!(flags & PMEM2_F_MEM_NODRAIN))\
+		drain_##flush();\
+}
+
+#define MEMSET_LIBC_TEMPLATE(flush)\
+static void \
+memset_libc_##flush(void *dest, int c, size_t len, unsigned flags)\
+{\
+	LOG(15, "dest %p c 0x%x len %zu flags 0x%x", dest, c, len, flags);\
+	CHECK_MEM_FLAGS(flags);\
+\
+	memset(dest, c, len);\
+	if (!(flags & PMEM2_F_MEM_NOFLUSH)) {\
+		flush_##flush##_nolog(dest, len);\
+		VALGRIND_DO_FLUSH(dest, len);\
+	}\
+\
+	if (!(flags & PMEM2_F_MEM_NODRAIN))\
+		drain_##flush();\
+}
+
+MEMCPY_LIBC_TEMPLATE(clflush)
+MEMCPY_LIBC_TEMPLATE(clflushopt)
+MEMCPY_LIBC_TEMPLATE(clwb)
+MEMCPY_LIBC_TEMPLATE(empty)
+
+MEMSET_LIBC_TEMPLATE(clflush)
+MEMSET_LIBC_TEMPLATE(clflushopt)
+MEMSET_LIBC_TEMPLATE(clwb)
+MEMSET_LIBC_TEMPLATE(empty)
+
+#if SSE2_AVAILABLE || AVX_AVAILABLE || AVX512F_AVAILABLE
+#define PMEM2_F_MEM_MOVNT (PMEM2_F_MEM_WC | PMEM2_F_MEM_NONTEMPORAL)
+#define PMEM2_F_MEM_MOV   (PMEM2_F_MEM_WB | PMEM2_F_MEM_TEMPORAL)
+
+#define MEMCPY_TEMPLATE(isa, flush) \
+static void \
+memmove_##isa##_##flush(void *dest, const void *src, size_t len, \
+		unsigned flags)\
+{\
+	LOG(15, "dest %p src %p len %zu flags 0x%x", dest, src, len, flags);\
+	CHECK_MEM_FLAGS(flags);\
+\
+	if (len == 0 || src == dest) {\
+		/* nothing to copy */\
+	} else if (flags & PMEM2_F_MEM_NOFLUSH) \
+		memmove_mov_##isa##_empty(dest, src, len); \
+	else if (flags & PMEM2_F_MEM_MOVNT)\
+		memmove_movnt_##isa ##_##flush(dest, src, len);\
+	else if (flags & PMEM2_F_MEM_MOV)\
+		memmove_mov_##isa##_##flush(dest, src, len);\
+	else if (len < Movnt_threshold)\
+		memmove_mov_##isa##_##flush(dest, src, len);\
+	else\
+		memmove_movnt_##isa##_##flush(dest, src, len);\
+\
+	if (!(flags & PMEM2_F_MEM_NODRAIN))\
+		drain_##flush();\
+}
+
+#define MEMSET_TEMPLATE(isa, flush)\
+static void \
+memset_##isa##_##flush(void *dest, int c, size_t len, unsigned flags)\
+{\
+	LOG(15, "dest %p c 0x%x len %zu flags 0x%x", dest, c, len, flags);\
+	CHECK_MEM_FLAGS(flags);\
+\
+	if (len == 0) {\
+		/* nothing to set */\
+	} else if (flags & PMEM2_F_MEM_NOFLUSH) \
+		memset_mov_##isa##_empty(dest, c, len); \
+	else if (flags & PMEM2_F_MEM_MOVNT)\
+		memset_movnt_##isa##_##flush(dest, c, len);\
+	else if (flags & PMEM2_F_MEM_MOV)\
+		memset_mov_##isa##_##flush(dest, c, len);\
+	else if (len < Movnt_threshold)\
+		memset_mov_##isa##_##flush(dest, c, len);\
+	else\
+		memset_movnt_##isa##_##flush(dest, c, len);\
+\
+	if (!(flags & PMEM2_F_MEM_NODRAIN))\
+		drain_##flush();\
+}
+
+/*
+ * SET_MEM_FUNCS -- pick memmove/memset functions of the given instruction
+ *	set matching the flush flavor chosen in info
+ */
+#define SET_MEM_FUNCS(info, isa) do {\
+	if ((info)->flush == flush_clflush) {\
+		(info)->memmove = memmove_##isa##_clflush;\
+		(info)->memset = memset_##isa##_clflush;\
+	} else if ((info)->flush == flush_clflushopt) {\
+		(info)->memmove = memmove_##isa##_clflushopt;\
+		(info)->memset = memset_##isa##_clflushopt;\
+	} else if ((info)->flush == flush_clwb) {\
+		(info)->memmove = memmove_##isa##_clwb;\
+		(info)->memset = memset_##isa##_clwb;\
+	} else {\
+		ASSERT(0);\
+	}\
+	(info)->memmove_noflush = memmove_##isa##_empty;\
+	(info)->memset_noflush = memset_##isa##_empty;\
+} while (0)
+#endif
+
+#if SSE2_AVAILABLE
+MEMCPY_TEMPLATE(sse2, clflush)
+MEMCPY_TEMPLATE(sse2, clflushopt)
+MEMCPY_TEMPLATE(sse2, clwb)
+MEMCPY_TEMPLATE(sse2, empty)
+
+MEMSET_TEMPLATE(sse2, clflush)
+MEMSET_TEMPLATE(sse2, clflushopt)
+MEMSET_TEMPLATE(sse2, clwb)
+MEMSET_TEMPLATE(sse2, empty)
+#endif
+
+#if AVX_AVAILABLE
+MEMCPY_TEMPLATE(avx, clflush)
+MEMCPY_TEMPLATE(avx, clflushopt)
+MEMCPY_TEMPLATE(avx, clwb)
+MEMCPY_TEMPLATE(avx, empty)
+
+MEMSET_TEMPLATE(avx, clflush)
+MEMSET_TEMPLATE(avx, clflushopt)
+MEMSET_TEMPLATE(avx, clwb)
+MEMSET_TEMPLATE(avx, empty)
+#endif
+
+#if AVX512F_AVAILABLE
+MEMCPY_TEMPLATE(avx512f, clflush)
+MEMCPY_TEMPLATE(avx512f, clflushopt)
+MEMCPY_TEMPLATE(avx512f, clwb)
+MEMCPY_TEMPLATE(avx512f, empty)
+
+MEMSET_TEMPLATE(avx512f, clflush)
+MEMSET_TEMPLATE(avx512f, clflushopt)
+MEMSET_TEMPLATE(avx512f, clwb)
+MEMSET_TEMPLATE(avx512f, empty)
+#endif
+
+enum memcpy_impl {
+	MEMCPY_INVALID,
+	MEMCPY_LIBC,
+	MEMCPY_SSE2,
+	MEMCPY_AVX,
+	MEMCPY_AVX512F
+};
+
+/*
+ * use_libc_memcpy_memset -- (internal) use libc memmove/memset followed
+ *	by a flush
+ */
+static void
+use_libc_memcpy_memset(struct pmem2_arch_info *info, enum memcpy_impl *impl)
+{
+	*impl = MEMCPY_LIBC;
+
+	if (info->flush == flush_clflush) {
+		info->memmove = memmove_libc_clflush;
+		info->memset = memset_libc_clflush;
+	} else if (info->flush == flush_clflushopt) {
+		info->memmove = memmove_libc_clflushopt;
+		info->memset = memset_libc_clflushopt;
+	} else if (info->flush == flush_clwb) {
+		info->memmove = memmove_libc_clwb;
+		info->memset = memset_libc_clwb;
+	} else {
+		ASSERT(0);
+	}
+
+	info->memmove_noflush = memmove_libc_empty;
+	info->memset_noflush = memset_libc_empty;
+}
+
+/*
+ * use_sse2_memcpy_memset -- (internal) SSE2 detected, use it if possible
+ */
+static void
+use_sse2_memcpy_memset(struct pmem2_arch_info *info, enum memcpy_impl *impl)
+{
+#if SSE2_AVAILABLE
+	*impl = MEMCPY_SSE2;
+	SET_MEM_FUNCS(info, sse2);
+#else
+	LOG(3, "sse2 disabled at build time");
+#endif
+}
+
+/*
+ * use_avx_memcpy_memset -- (internal) AVX detected, use it if possible
+ */
+static void
+use_avx_memcpy_memset(struct pmem2_arch_info *info, enum memcpy_impl *impl)
+{
+#if AVX_AVAILABLE
+	LOG(3, "avx supported");
+
+	char *e = os_getenv("PMEM_AVX");
+	if (e == NULL || strcmp(e, "1") != 0) {
+		LOG(3, "PMEM_AVX not set or not == 1");
+		return;
+	}
+
+	LOG(3, "PMEM_AVX enabled");
+	*impl = MEMCPY_AVX;
+	SET_MEM_FUNCS(info, avx);
+#else
+	LOG(3, "avx supported, but disabled at build time");
+#endif
+}
+
+/*
+ * use_avx512f_memcpy_memset -- (internal) AVX512F detected, use it if possible
+ */
+static void
+use_avx512f_memcpy_memset(struct pmem2_arch_info *info,
+		enum memcpy_impl *impl)
+{
+#if AVX512F_AVAILABLE
+	LOG(3, "avx512f supported");
+
+	char *e = os_getenv("PMEM_AVX512F");
+	if (e == NULL || strcmp(e, "1") != 0) {
+		LOG(3, "PMEM_AVX512F not set or not == 1");
+		return;
+	}
+
+	LOG(3, "PMEM_AVX512F enabled");
+	*impl = MEMCPY_AVX512F;
+	SET_MEM_FUNCS(info, avx512f);
+#else
+	LOG(3, "avx512f supported, but disabled at build time");
+#endif
+}
+
+/*
+ * mem_funcs_init -- (internal) pick memmove/memset functions based on
+ *	CPUID and the flush flavor already chosen in info
+ */
+static void
+mem_funcs_init(struct pmem2_arch_info *info)
+{
+	enum memcpy_impl impl = MEMCPY_INVALID;
+
+	use_libc_memcpy_memset(info, &impl);
+
+	char *ptr = os_getenv("PMEM_NO_MOVNT");
+	if (ptr && strcmp(ptr, "1") == 0) {
+		LOG(3, "PMEM_NO_MOVNT forced no movnt");
+	} else {
+		use_sse2_memcpy_memset(info, &impl);
+
+		if (is_cpu_avx_present())
+			use_avx_memcpy_memset(info, &impl);
+
+		if (is_cpu_avx512f_present())
+			use_avx512f_memcpy_memset(info, &impl);
+	}
+
+	/*
+	 * For testing, allow overriding the default threshold
+	 * for using non-temporal stores.
+	 * It has no effect if movnt is not supported or disabled.
+	 */
+	ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
+	if (ptr) {
+		long long val = atoll(ptr);
+
+		if (val < 0) {
+			LOG(3, "Invalid PMEM_MOVNT_THRESHOLD");
+		} else {
+			LOG(3, "PMEM_MOVNT_THRESHOLD set to %zu", (size_t)val);
+			Movnt_threshold = (size_t)val;
+		}
+	}
+
+	if (impl == MEMCPY_AVX512F)
+		LOG(3, "using movnt AVX512F");
+	else if (impl == MEMCPY_AVX)
+		LOG(3, "using movnt AVX");
+	else if (impl == MEMCPY_SSE2)
+		LOG(3, "using movnt SSE2");
+	else if (impl == MEMCPY_LIBC)
+		LOG(3, "using libc memmove");
+	else
+		FATAL("invalid memcpy impl");
+}
+
+/*
+ * pmem2_arch_init -- configure libpmem2 based on CPUID
+ */
+void
+pmem2_arch_init(struct pmem2_arch_info *info)
+{
+	LOG(3, NULL);
+
+	info->persist = persist_clflush;
+	info->persist_noflush = persist_noflush;
+	info->flush = flush_clflush;
+	info->fence = fence_empty;
+
+	if (is_cpu_clflushopt_present()) {
+		LOG(3, "clflushopt supported");
+
+		char *e = os_getenv("PMEM_NO_CLFLUSHOPT");
+		if (e && strcmp(e, "1") == 0) {
+			LOG(3, "PMEM_NO_CLFLUSHOPT forced no clflushopt");
+		} else {
+			info->persist = persist_clflushopt;
+			info->flush = flush_clflushopt;
+			info->fence = memory_barrier;
+		}
+	}
+
+	if (is_cpu_clwb_present()) {
+		LOG(3, "clwb supported");
+
+		char *e = os_getenv("PMEM_NO_CLWB");
+		if (e && strcmp(e, "1") == 0) {
+			LOG(3, "PMEM_NO_CLWB forced no clwb");
+		} else {
+			info->persist = persist_clwb;
+			info->flush = flush_clwb;
+			info->fence = memory_barrier;
+		}
+	}
+
+	if (info->flush == flush_clwb)
+		LOG(3, "using clwb");
+	else if (info->flush == flush_clflushopt)
+		LOG(3, "using clflushopt");
+	else if (info->flush == flush_clflush)
+		LOG(3, "using clflush");
+	else
+		FATAL("invalid flush function address");
+
+	mem_funcs_init(info);
+}
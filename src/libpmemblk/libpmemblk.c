@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2018, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -40,6 +40,7 @@
 #include "libpmemblk.h"
 #include "ctl_global.h"
 
+#include "checksum.h"
 #include "pmemcommon.h"
 #include "blk.h"
 
@@ -116,6 +117,7 @@ libpmemblk_init(void)
 			PMEMBLK_LOG_FILE_VAR, PMEMBLK_MAJOR_VERSION,
 			PMEMBLK_MINOR_VERSION);
 	LOG(3, NULL);
+	checksum_init();
 }
 
 /*
@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2018, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -40,6 +40,7 @@
 #include "libpmemlog.h"
 #include "ctl_global.h"
 
+#include "checksum.h"
 #include "pmemcommon.h"
 #include "log.h"
 
@@ -116,6 +117,7 @@ libpmemlog_init(void)
 			PMEMLOG_LOG_FILE_VAR, PMEMLOG_MAJOR_VERSION,
 			PMEMLOG_MINOR_VERSION);
 	LOG(3, NULL);
+	checksum_init();
 }
 
 /*
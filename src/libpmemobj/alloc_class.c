@@ -150,6 +150,12 @@ struct alloc_class_collection {
 
 	int fail_on_missing_class;
 	int autogenerate_on_missing_class;
+
+	/*
+	 * The last class map index assigned to each of the tuned classes,
+	 * 0 if the class isn't tuned.
+	 */
+	size_t tuned_map_idx[MAX_ALLOCATION_CLASSES];
 };
 
 /*
@@ -283,20 +289,17 @@ alloc_class_delete(struct alloc_class_collection *ac,
 	LOG(10, NULL);
 
 	ac->aclasses[c->id] = NULL;
+	ac->tuned_map_idx[c->id] = 0;
 	Free(c);
 }
 
 /*
- * alloc_class_find_or_create -- (internal) searches for the
- * biggest allocation class for which unit_size is evenly divisible by n.
- * If no such class exists, create one.
+ * alloc_class_calc_run_size_idx -- (internal) calculates the number of chunks
+ *	of a run that fits the target number of allocations of the given size
  */
-static struct alloc_class *
-alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
+static uint32_t
+alloc_class_calc_run_size_idx(size_t n)
 {
-	LOG(10, NULL);
-
-	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
 	uint64_t required_size_bytes = n * RUN_MIN_NALLOCS;
 	uint32_t required_size_idx = 1;
 	if (required_size_bytes > RUN_DEFAULT_SIZE) {
@@ -307,6 +310,22 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 			required_size_idx = RUN_SIZE_IDX_CAP;
 	}
 
+	return required_size_idx;
+}
+
+/*
+ * alloc_class_find_or_create -- (internal) searches for the
+ * biggest allocation class for which unit_size is evenly divisible by n.
+ * If no such class exists, create one.
+ */
+static struct alloc_class *
+alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
+{
+	LOG(10, NULL);
+
+	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
+	uint32_t required_size_idx = alloc_class_calc_run_size_idx(n);
+
 	for (int i = MAX_ALLOCATION_CLASSES - 1; i >= 0; --i) {
 		struct alloc_class *c = ac->aclasses[i];
 
@@ -640,6 +659,226 @@ alloc_class_by_id(struct alloc_class_collection *ac, uint8_t id)
 	return ac->aclasses[id];
 }
 
+/*
+ * alloc_class_by_unit_size -- returns the run allocation class, without
+ *	custom alignment, with the given unit size and header type
+ */
+struct alloc_class *
+alloc_class_by_unit_size(struct alloc_class_collection *ac, size_t unit_size,
+	enum header_type htype)
+{
+	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct alloc_class *c = ac->aclasses[i];
+		if (c == NULL || c == ACLASS_RESERVED || c->type != CLASS_RUN)
+			continue;
+
+		if (c->unit_size == unit_size && c->header_type == htype &&
+		    (c->flags & CHUNK_FLAG_ALIGNED) == 0)
+			return c;
+	}
+
+	return NULL;
+}
+
+/*
+ * alloc_class_calc_run_nallocs -- calculates the number of units in a run
+ *	that the class generation algorithm would create for the unit size
+ */
+unsigned
+alloc_class_calc_run_nallocs(size_t unit_size)
+{
+	uint32_t size_idx = alloc_class_calc_run_size_idx(unit_size);
+
+	struct run_bitmap b;
+	memblock_run_bitmap(&size_idx, ALLOC_CLASS_DEFAULT_FLAGS, unit_size, 0,
+		NULL, &b);
+
+	return b.nbits;
+}
+
+/*
+ * alloc_class_propose -- proposes up to max_classes unit sizes, in ascending
+ *	order, which minimize the internal fragmentation of the allocations from
+ *	the histogram, returns the number of the proposed sizes or -1 on error
+ *
+ * Each recorded allocation is assumed to be served by a single unit of the
+ * smallest proposed class it fits in. The optimal unit sizes are always
+ * equal to the size of one of the histogram bins, together with the header,
+ * which makes this a partitioning of the non-empty bins into contiguous
+ * groups, solved with dynamic programming.
+ */
+int
+alloc_class_propose(const uint64_t *histogram, unsigned max_classes,
+	size_t *unit_sizes, uint64_t *waste)
+{
+	size_t hsize = header_type_to_size[HEADER_COMPACT];
+
+	size_t bins[ALLOC_HISTOGRAM_NBINS];
+	size_t nbins = 0;
+	for (size_t i = 1; i < ALLOC_HISTOGRAM_NBINS; ++i) {
+		if (histogram[i] != 0)
+			bins[nbins++] = i;
+	}
+
+	*waste = 0;
+
+	size_t nclasses = MIN(nbins, max_classes);
+	if (nclasses == 0)
+		return 0;
+
+	/*
+	 * count[i] and bytes[i] are the number of allocations and their total
+	 * size, with headers, in the first i non-empty bins.
+	 */
+	size_t npoints = nbins + 1;
+	uint64_t *count = Malloc(sizeof(uint64_t) * npoints * 2);
+	uint64_t *cost = Malloc(sizeof(uint64_t) * npoints * (nclasses + 1));
+	size_t *split = Malloc(sizeof(size_t) * npoints * (nclasses + 1));
+	if (count == NULL || cost == NULL || split == NULL) {
+		ERR("!Malloc");
+		Free(count);
+		Free(cost);
+		Free(split);
+		return -1;
+	}
+	uint64_t *bytes = count + npoints;
+
+#define BIN_UNIT_SIZE(i) (bins[(i)] * ALLOC_HISTOGRAM_GRANULARITY + hsize)
+#define COST(k, i) cost[(k) * npoints + (i)]
+#define SPLIT(k, i) split[(k) * npoints + (i)]
+
+	count[0] = 0;
+	bytes[0] = 0;
+	for (size_t i = 0; i < nbins; ++i) {
+		count[i + 1] = count[i] + histogram[bins[i]];
+		bytes[i + 1] = bytes[i] + histogram[bins[i]] *
+			BIN_UNIT_SIZE(i);
+	}
+
+	/* the waste of the first i bins split into k classes */
+	for (size_t i = 0; i < npoints; ++i)
+		COST(0, i) = i == 0 ? 0 : UINT64_MAX;
+
+	for (size_t k = 1; k <= nclasses; ++k) {
+		for (size_t i = 0; i < npoints; ++i) {
+			COST(k, i) = UINT64_MAX;
+			SPLIT(k, i) = 0;
+
+			/* the bins from j to i are served by the i-th one */
+			for (size_t j = k - 1; j < i; ++j) {
+				if (COST(k - 1, j) == UINT64_MAX)
+					continue;
+
+				uint64_t w = COST(k - 1, j) +
+					BIN_UNIT_SIZE(i - 1) *
+					(count[i] - count[j]) -
+					(bytes[i] - bytes[j]);
+				if (w < COST(k, i)) {
+					COST(k, i) = w;
+					SPLIT(k, i) = j;
+				}
+			}
+		}
+	}
+
+	*waste = COST(nclasses, nbins);
+
+	size_t i = nbins;
+	for (size_t k = nclasses; k > 0; --k) {
+		unit_sizes[k - 1] = BIN_UNIT_SIZE(i - 1);
+		i = SPLIT(k, i);
+	}
+
+#undef BIN_UNIT_SIZE
+#undef COST
+#undef SPLIT
+
+	Free(count);
+	Free(cost);
+	Free(split);
+
+	return (int)nclasses;
+}
+
+/*
+ * alloc_class_histogram_waste -- calculates the internal fragmentation of
+ *	the allocations from the histogram with the current allocation classes
+ */
+uint64_t
+alloc_class_histogram_waste(struct alloc_class_collection *ac,
+	const uint64_t *histogram)
+{
+	uint64_t waste = 0;
+	for (size_t i = 1; i < ALLOC_HISTOGRAM_NBINS; ++i) {
+		if (histogram[i] == 0)
+			continue;
+
+		size_t size = i * ALLOC_HISTOGRAM_GRANULARITY;
+		struct alloc_class *c = alloc_class_by_alloc_size(ac, size);
+		if (c == NULL)
+			continue;
+
+		size_t real_size = size + header_type_to_size[c->header_type];
+		size_t units = CALC_SIZE_IDX(c->unit_size, real_size);
+
+		waste += histogram[i] * (c->unit_size * units - real_size);
+	}
+
+	return waste;
+}
+
+/*
+ * alloc_class_tune -- makes the class handle the allocation sizes that fit in
+ *	a single unit of it, but don't fit in a smaller tuned class
+ *
+ * Tuned classes take precedence over the generated ones, a tuned class
+ * handles the sizes up to its unit size, starting with the sizes that are too
+ * big for the next smaller tuned class. The order in which the classes are
+ * tuned doesn't matter.
+ */
+int
+alloc_class_tune(struct alloc_class_collection *ac, struct alloc_class *c)
+{
+	if (c->type != CLASS_RUN || c->header_type == HEADER_NONE) {
+		ERR("only classes of runs with headers can be tuned");
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t hsize = header_type_to_size[c->header_type];
+	if (c->unit_size <= hsize) {
+		ERR("unit size of the class too small to be tuned");
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t last = (c->unit_size - hsize) / ac->granularity;
+	size_t max = SIZE_TO_CLASS_MAP_INDEX(ac->last_run_max_size - 1,
+		ac->granularity);
+	if (last > max)
+		last = max;
+
+	if (last == 0) {
+		ERR("unit size of the class too small to be tuned");
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t first = 1;
+	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		size_t idx = ac->tuned_map_idx[i];
+		if (i != c->id && idx < last && idx >= first)
+			first = idx + 1;
+	}
+
+	ac->tuned_map_idx[c->id] = last;
+
+	for (size_t i = first; i <= last; ++i)
+		ac->class_map_by_alloc_size[i] = c->id;
+
+	return 0;
+}
+
 /*
  * alloc_class_calc_size_idx -- calculates how many units does the size require
  */
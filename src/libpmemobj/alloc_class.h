@@ -50,6 +50,16 @@ extern "C" {
 #define DEFAULT_ALLOC_CLASS_ID (0)
 #define RUN_UNIT_MAX RUN_BITS_PER_VALUE
 
+/*
+ * The histogram of allocation sizes has a bin for every 16 bytes, bin i counts
+ * the sizes from the (16 * (i - 1), 16 * i] range. Bigger sizes than the
+ * maximum aren't recorded.
+ */
+#define ALLOC_HISTOGRAM_GRANULARITY 16
+#define ALLOC_HISTOGRAM_MAX_SIZE 4096
+#define ALLOC_HISTOGRAM_NBINS\
+	(ALLOC_HISTOGRAM_MAX_SIZE / ALLOC_HISTOGRAM_GRANULARITY + 1)
+
 struct alloc_class_collection;
 
 enum alloc_class_type {
@@ -104,6 +114,17 @@ alloc_class_new(int id, struct alloc_class_collection *ac,
 void alloc_class_delete(struct alloc_class_collection *ac,
 	struct alloc_class *c);
 
+struct alloc_class *alloc_class_by_unit_size(
+	struct alloc_class_collection *ac, size_t unit_size,
+	enum header_type htype);
+unsigned alloc_class_calc_run_nallocs(size_t unit_size);
+
+int alloc_class_propose(const uint64_t *histogram, unsigned max_classes,
+	size_t *unit_sizes, uint64_t *waste);
+uint64_t alloc_class_histogram_waste(struct alloc_class_collection *ac,
+	const uint64_t *histogram);
+int alloc_class_tune(struct alloc_class_collection *ac, struct alloc_class *c);
+
 
 #ifdef __cplusplus
 }
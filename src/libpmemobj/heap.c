@@ -46,10 +46,13 @@
 #include "sys_util.h"
 #include "valgrind_internal.h"
 #include "recycler.h"
+#include "tcache.h"
 #include "container_ravl.h"
 #include "container_seglists.h"
 #include "alloc_class.h"
+#include "os.h"
 #include "os_thread.h"
+#include "parallel.h"
 #include "set.h"
 
 #define MAX_RUN_LOCKS MAX_CHUNK
@@ -61,6 +64,12 @@
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 #define MAX_DEFAULT_ARENAS (1 << 10) /* 1024 arenas */
 
+/*
+ * Number of threads used to verify the heap and to recover the lanes when
+ * a pool is opened, 0 or 1 means that it's done sequentially.
+ */
+unsigned Heap_open_threads;
+
 struct arenas {
 	VEC(, struct arena *) vec;
 	size_t nactive;
@@ -86,6 +95,36 @@ struct arena {
 	int automatic;
 	size_t nthreads;
 	struct arenas *arenas;
+
+	/*
+	 * NUMA node of the threads that use this arena, or
+	 * HEAP_ARENA_NUMA_NODE_NONE if the arena wasn't yet
+	 * automatically assigned to any thread.
+	 */
+	int numa_node;
+
+	/* allocation sizes requested by the threads that use this arena */
+	uint64_t histogram[ALLOC_HISTOGRAM_NBINS];
+};
+
+/*
+ * heap_reclaimer -- state of the background reclaimer
+ *
+ * The reclaimer is a thread provided by the application which periodically
+ * recalculates the recyclers and gives the empty runs back to the heap, so
+ * that the allocating threads don't have to.
+ */
+struct heap_reclaimer {
+	os_mutex_t lock;
+	os_cond_t cond;
+
+	unsigned running;
+	int stop; /* the reclaimer is requested to exit */
+
+	unsigned interval_ms; /* time between the passes */
+
+	uint64_t passes;
+	uint64_t runs; /* empty runs given back to the heap */
 };
 
 struct heap_rt {
@@ -98,6 +137,12 @@ struct heap_rt {
 
 	struct recycler *recyclers[MAX_ALLOCATION_CLASSES];
 
+	struct tcache *tcache;
+
+	struct heap_reclaimer reclaimer;
+
+	unsigned histogram_enabled;
+
 	os_mutex_t run_locks[MAX_RUN_LOCKS];
 	unsigned nlocks;
 
@@ -139,6 +184,15 @@ heap_alloc_classes(struct palloc_heap *heap)
 	return heap->rt->alloc_classes;
 }
 
+/*
+ * heap_tcache -- returns the thread caches of the heap
+ */
+struct tcache *
+heap_tcache(struct palloc_heap *heap)
+{
+	return heap->rt->tcache;
+}
+
 /*
  * heap_arena_delete -- (internal) destroys arena instance
  */
@@ -167,6 +221,7 @@ heap_arena_new(struct palloc_heap *heap, int automatic)
 	arena->nthreads = 0;
 	arena->automatic = automatic;
 	arena->arenas = &heap->rt->arenas;
+	arena->numa_node = HEAP_ARENA_NUMA_NODE_NONE;
 
 	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
 	for (uint8_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
@@ -266,9 +321,29 @@ heap_get_arena_by_id(struct palloc_heap *heap, unsigned arena_id)
 	return VEC_ARR(&heap->rt->arenas.vec)[arena_id - 1];
 }
 
+/*
+ * heap_arena_least_used -- (internal) picks the less used of two arenas
+ */
+static struct arena *
+heap_arena_least_used(struct arena *least_used, struct arena *a)
+{
+	if (least_used == NULL || a->nthreads < least_used->nthreads)
+		return a;
+
+	return least_used;
+}
+
 /*
  * heap_thread_arena_assign -- (internal) assigns the least used arena
- *	to current thread
+ *	of the current NUMA node to current thread
+ *
+ * Arenas are bound to NUMA nodes lazily: a thread first tries to reuse an
+ * idle arena that is already bound to the node it runs on, then binds an
+ * arena that wasn't yet used by anyone, and only when there are none left
+ * it shares the least used arena of its node (or, if its node has no
+ * arenas at all, the least used arena in the heap). This way the runs
+ * cached in an arena's buckets are, for the most part, only ever touched
+ * by CPUs of a single socket.
  *
  * To avoid complexities with regards to races in the search for the least
  * used arena, a lock is used, but the nthreads counter of the arena is still
@@ -278,9 +353,13 @@ heap_get_arena_by_id(struct palloc_heap *heap, unsigned arena_id)
 static struct arena *
 heap_thread_arena_assign(struct palloc_heap *heap)
 {
+	int node = (int)os_thread_numa_node();
+
 	util_mutex_lock(&heap->rt->arenas.lock);
 
 	struct arena *least_used = NULL;
+	struct arena *least_used_node = NULL;
+	struct arena *least_used_unbound = NULL;
 
 	ASSERTne(VEC_SIZE(&heap->rt->arenas.vec), 0);
 
@@ -288,15 +367,31 @@ heap_thread_arena_assign(struct palloc_heap *heap)
 	VEC_FOREACH(a, &heap->rt->arenas.vec) {
 		if (!a->automatic)
 			continue;
-		if (least_used == NULL ||
-			a->nthreads < least_used->nthreads)
-			least_used = a;
-	}
 
-	LOG(4, "assigning %p arena to current thread", least_used);
+		least_used = heap_arena_least_used(least_used, a);
+		if (a->numa_node == node)
+			least_used_node =
+				heap_arena_least_used(least_used_node, a);
+		else if (a->numa_node == HEAP_ARENA_NUMA_NODE_NONE)
+			least_used_unbound =
+				heap_arena_least_used(least_used_unbound, a);
+	}
 
 	/* at least one automatic arena must exist */
 	ASSERTne(least_used, NULL);
+
+	if (least_used_node != NULL && least_used_node->nthreads == 0) {
+		least_used = least_used_node;
+	} else if (least_used_unbound != NULL) {
+		least_used = least_used_unbound;
+		least_used->numa_node = node;
+	} else if (least_used_node != NULL) {
+		least_used = least_used_node;
+	}
+
+	LOG(4, "assigning %p arena to current thread (node %d)",
+		least_used, node);
+
 	heap_arena_thread_attach(heap, least_used);
 
 	util_mutex_unlock(&heap->rt->arenas.lock);
@@ -318,6 +413,96 @@ heap_thread_arena(struct palloc_heap *heap)
 	return a;
 }
 
+/*
+ * heap_histogram_record -- records allocations of the given size in the
+ *	histogram of the arena of the calling thread, if enabled
+ */
+void
+heap_histogram_record(struct palloc_heap *heap, size_t size, size_t count)
+{
+	unsigned enabled;
+	util_atomic_load_explicit32(&heap->rt->histogram_enabled, &enabled,
+		memory_order_relaxed);
+	if (!enabled || size > ALLOC_HISTOGRAM_MAX_SIZE)
+		return;
+
+	ASSERTne(size, 0);
+	size_t bin = 1 + (size - 1) / ALLOC_HISTOGRAM_GRANULARITY;
+
+	struct arena *a = heap_thread_arena(heap);
+	util_fetch_and_add64(&a->histogram[bin], count);
+}
+
+/*
+ * heap_histogram_get -- sums up the histograms of allocation sizes of all
+ *	arenas, the histogram must have ALLOC_HISTOGRAM_NBINS bins
+ */
+void
+heap_histogram_get(struct palloc_heap *heap, uint64_t *histogram)
+{
+	struct heap_rt *rt = heap->rt;
+
+	memset(histogram, 0, sizeof(uint64_t) * ALLOC_HISTOGRAM_NBINS);
+
+	util_mutex_lock(&rt->arenas.lock);
+
+	struct arena *arena;
+	VEC_FOREACH(arena, &rt->arenas.vec) {
+		for (size_t i = 0; i < ALLOC_HISTOGRAM_NBINS; ++i) {
+			uint64_t count;
+			util_atomic_load64(&arena->histogram[i], &count);
+			histogram[i] += count;
+		}
+	}
+
+	util_mutex_unlock(&rt->arenas.lock);
+}
+
+/*
+ * heap_histogram_reset -- clears the histograms of allocation sizes
+ */
+void
+heap_histogram_reset(struct palloc_heap *heap)
+{
+	struct heap_rt *rt = heap->rt;
+
+	util_mutex_lock(&rt->arenas.lock);
+
+	struct arena *arena;
+	VEC_FOREACH(arena, &rt->arenas.vec) {
+		for (size_t i = 0; i < ALLOC_HISTOGRAM_NBINS; ++i)
+			util_atomic_store_explicit64(&arena->histogram[i], 0,
+				memory_order_relaxed);
+	}
+
+	util_mutex_unlock(&rt->arenas.lock);
+}
+
+/*
+ * heap_histogram_is_enabled -- returns whether the allocation sizes are
+ *	recorded
+ */
+int
+heap_histogram_is_enabled(struct palloc_heap *heap)
+{
+	unsigned enabled;
+	util_atomic_load_explicit32(&heap->rt->histogram_enabled, &enabled,
+		memory_order_relaxed);
+
+	return (int)enabled;
+}
+
+/*
+ * heap_histogram_set_enabled -- enables or disables recording of the
+ *	allocation sizes
+ */
+void
+heap_histogram_set_enabled(struct palloc_heap *heap, int enabled)
+{
+	util_atomic_store_explicit32(&heap->rt->histogram_enabled,
+		enabled ? 1U : 0U, memory_order_relaxed);
+}
+
 /*
  * heap_get_thread_arena_id -- returns the arena id assigned to the current
  *	thread
@@ -464,6 +649,26 @@ heap_zone_init(struct palloc_heap *heap, uint32_t zone_id,
 	pmemops_persist(&heap->p_ops, &z->header, sizeof(z->header));
 }
 
+/*
+ * heap_zone_update_if_needed -- (internal) updates the zone metadata if the
+ *	pool has been extended
+ *
+ * This is done lazily, when the zone gets activated, so that opening a pool
+ * doesn't have to touch every zone header.
+ */
+static void
+heap_zone_update_if_needed(struct palloc_heap *heap, uint32_t zone_id)
+{
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+	size_t size_idx = zone_calc_size_idx(zone_id, heap->rt->nzones,
+		*heap->sizep);
+	if (size_idx == z->header.size_idx)
+		return;
+
+	heap_zone_init(heap, zone_id, z->header.size_idx);
+}
+
 /*
  * heap_memblock_insert_block -- (internal) bucket insert wrapper for callbacks
  */
@@ -674,6 +879,8 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 
 	if (z->header.magic != ZONE_HEADER_MAGIC)
 		heap_zone_init(heap, zone_id, 0);
+	else
+		heap_zone_update_if_needed(heap, zone_id);
 
 	heap_reclaim_zone_garbage(heap, bucket, zone_id);
 
@@ -686,18 +893,14 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 }
 
 /*
- * heap_recycle_unused -- recalculate scores in the recycler and turn any
- *	empty runs into free chunks
- *
- * If force is not set, this function might effectively be a noop if not enough
- * of space was freed.
+ * heap_recycle_empty_runs -- (internal) turns the empty runs found in the
+ *	recycler into free chunks, returns ENOMEM if there were none
  */
 static int
-heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
-	struct bucket *defb, int force)
+heap_recycle_empty_runs(struct palloc_heap *heap, struct empty_runs *r,
+	struct bucket *defb)
 {
-	struct empty_runs r = recycler_recalc(recycler, force);
-	if (VEC_SIZE(&r) == 0)
+	if (VEC_SIZE(r) == 0)
 		return ENOMEM;
 
 	struct bucket *nb = defb == NULL ? heap_bucket_acquire(heap,
@@ -706,18 +909,34 @@ heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
 	ASSERT(defb != NULL || nb != NULL);
 
 	struct memory_block *nm;
-	VEC_FOREACH_BY_PTR(nm, &r) {
+	VEC_FOREACH_BY_PTR(nm, r) {
 		heap_run_into_free_chunk(heap, defb ? defb : nb, nm);
 	}
 
 	if (nb != NULL)
 		heap_bucket_release(heap, nb);
 
-	VEC_DELETE(&r);
+	VEC_DELETE(r);
 
 	return 0;
 }
 
+/*
+ * heap_recycle_unused -- recalculate scores in the recycler and turn any
+ *	empty runs into free chunks
+ *
+ * If force is not set, this function might effectively be a noop if not enough
+ * of space was freed.
+ */
+static int
+heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
+	struct bucket *defb, int force)
+{
+	struct empty_runs r = recycler_recalc(recycler, force);
+
+	return heap_recycle_empty_runs(heap, &r, defb);
+}
+
 /*
  * heap_reclaim_garbage -- (internal) creates volatile state of unused runs
  */
@@ -768,6 +987,20 @@ heap_ensure_huge_bucket_filled(struct palloc_heap *heap, struct bucket *bucket)
 	return ENOMEM;
 }
 
+/*
+ * heap_reclaimer_is_running -- (internal) checks whether the recyclers are
+ *	recalculated by the background reclaimer
+ */
+static unsigned
+heap_reclaimer_is_running(struct palloc_heap *heap)
+{
+	unsigned running;
+	util_atomic_load_explicit32(&heap->rt->reclaimer.running, &running,
+		memory_order_relaxed);
+
+	return running;
+}
+
 /*
  * heap_reuse_from_recycler -- (internal) try reusing runs that are currently
  *	in the recycler
@@ -783,7 +1016,12 @@ heap_reuse_from_recycler(struct palloc_heap *heap,
 	if (!force && recycler_get(r, &m) == 0)
 		return heap_run_reuse(heap, b, &m);
 
-	heap_recycle_unused(heap, r, NULL, force);
+	/*
+	 * The recalculation is left to the background reclaimer, if there is
+	 * one, so that it doesn't happen on the allocation path.
+	 */
+	if (force || !heap_reclaimer_is_running(heap))
+		heap_recycle_unused(heap, r, NULL, force);
 
 	if (recycler_get(r, &m) == 0)
 		return heap_run_reuse(heap, b, &m);
@@ -808,6 +1046,251 @@ heap_discard_run(struct palloc_heap *heap, struct memory_block *m)
 	}
 }
 
+/*
+ * heap_reclaimer_pass -- (internal) recalculates all the recyclers and gives
+ *	the empty runs back to the heap, returns the number of such runs
+ */
+static size_t
+heap_reclaimer_pass(struct palloc_heap *heap)
+{
+	size_t nruns = 0;
+	struct recycler *r;
+	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		/* new allocation classes can be registered concurrently */
+		util_atomic_load_explicit64(
+			(uint64_t *)&heap->rt->recyclers[i], (uint64_t *)&r,
+			memory_order_acquire);
+		if (r == NULL)
+			continue;
+
+		struct empty_runs runs = recycler_recalc_eager(r);
+		nruns += VEC_SIZE(&runs);
+
+		heap_recycle_empty_runs(heap, &runs, NULL);
+	}
+
+	return nruns;
+}
+
+/*
+ * heap_reclaimer_run -- turns the calling thread into the background
+ *	reclaimer, returns once the reclaimer is stopped
+ *
+ * There can be only one reclaimer per heap, EBUSY is returned if it's already
+ * running.
+ */
+int
+heap_reclaimer_run(struct palloc_heap *heap)
+{
+	struct heap_reclaimer *rc = &heap->rt->reclaimer;
+
+	util_mutex_lock(&rc->lock);
+
+	if (rc->running) {
+		util_mutex_unlock(&rc->lock);
+		return EBUSY;
+	}
+
+	util_atomic_store_explicit32(&rc->running, 1, memory_order_relaxed);
+
+	while (!rc->stop) {
+		util_mutex_unlock(&rc->lock);
+
+		size_t nruns = heap_reclaimer_pass(heap);
+
+		util_mutex_lock(&rc->lock);
+
+		rc->passes++;
+		rc->runs += nruns;
+
+		if (rc->stop)
+			break;
+
+		struct timespec deadline;
+		os_clock_gettime(CLOCK_REALTIME, &deadline);
+
+		uint64_t nsec = (uint64_t)deadline.tv_nsec +
+			(uint64_t)rc->interval_ms * 1000000ULL;
+		deadline.tv_sec += (time_t)(nsec / 1000000000ULL);
+		deadline.tv_nsec = (long)(nsec % 1000000000ULL);
+
+		os_cond_timedwait(&rc->cond, &rc->lock, &deadline);
+	}
+
+	rc->stop = 0;
+	util_atomic_store_explicit32(&rc->running, 0, memory_order_relaxed);
+	os_cond_broadcast(&rc->cond);
+
+	util_mutex_unlock(&rc->lock);
+
+	return 0;
+}
+
+/*
+ * heap_reclaimer_stop -- stops the background reclaimer, returns once it has
+ *	exited
+ *
+ * ESRCH is returned if the reclaimer isn't running. The request isn't kept
+ * in that case, a reclaimer that is yet to be started has to be stopped once
+ * it's running.
+ */
+int
+heap_reclaimer_stop(struct palloc_heap *heap)
+{
+	struct heap_reclaimer *rc = &heap->rt->reclaimer;
+
+	util_mutex_lock(&rc->lock);
+
+	if (!rc->running) {
+		util_mutex_unlock(&rc->lock);
+		return ESRCH;
+	}
+
+	rc->stop = 1;
+	os_cond_broadcast(&rc->cond);
+	while (rc->running)
+		os_cond_wait(&rc->cond, &rc->lock);
+
+	util_mutex_unlock(&rc->lock);
+
+	return 0;
+}
+
+/*
+ * heap_reclaimer_get_interval -- returns the time between the passes of the
+ *	background reclaimer, in milliseconds
+ */
+unsigned
+heap_reclaimer_get_interval(struct palloc_heap *heap)
+{
+	struct heap_reclaimer *rc = &heap->rt->reclaimer;
+
+	util_mutex_lock(&rc->lock);
+	unsigned interval_ms = rc->interval_ms;
+	util_mutex_unlock(&rc->lock);
+
+	return interval_ms;
+}
+
+/*
+ * heap_reclaimer_set_interval -- sets the time between the passes of the
+ *	background reclaimer, in milliseconds
+ */
+void
+heap_reclaimer_set_interval(struct palloc_heap *heap, unsigned interval_ms)
+{
+	struct heap_reclaimer *rc = &heap->rt->reclaimer;
+
+	util_mutex_lock(&rc->lock);
+	rc->interval_ms = interval_ms;
+	util_mutex_unlock(&rc->lock);
+}
+
+/*
+ * heap_reclaimer_get_stats -- returns the number of passes performed by the
+ *	background reclaimer and the number of runs it gave back to the heap
+ */
+void
+heap_reclaimer_get_stats(struct palloc_heap *heap, uint64_t *passes,
+	uint64_t *runs)
+{
+	struct heap_reclaimer *rc = &heap->rt->reclaimer;
+
+	util_mutex_lock(&rc->lock);
+	*passes = rc->passes;
+	*runs = rc->runs;
+	util_mutex_unlock(&rc->lock);
+}
+
+/*
+ * heap_reservation_clear -- drops a single reservation of a block from a run,
+ *	discards the run if it's no longer used by any bucket nor reservation
+ *
+ * If the reservation wasn't published and the run is still active in its
+ * bucket, the block is inserted back into the bucket.
+ */
+void
+heap_reservation_clear(struct palloc_heap *heap, const struct memory_block *m,
+	struct memory_block_reserved *mresv, int publish)
+{
+	struct bucket *b = mresv->bucket;
+
+	if (!publish) {
+		util_mutex_lock(&b->lock);
+		struct memory_block *am = &b->active_memory_block->m;
+
+		/*
+		 * If a memory block used for the action is the currently active
+		 * memory block of the bucket it can be inserted back to the
+		 * bucket. This way it will be available for future allocation
+		 * requests, improving performance.
+		 */
+		if (b->is_active &&
+		    am->chunk_id == m->chunk_id &&
+		    am->zone_id == m->zone_id) {
+			ASSERTeq(b->active_memory_block, mresv);
+			bucket_insert_block(b, m);
+		}
+
+		util_mutex_unlock(&b->lock);
+	}
+
+	if (util_fetch_and_sub64(&mresv->nresv, 1) == 1) {
+		VALGRIND_ANNOTATE_HAPPENS_AFTER(&mresv->nresv);
+		/*
+		 * If the memory block used for the action is not currently used
+		 * in any bucket nor action it can be discarded (given back to
+		 * the heap).
+		 */
+		heap_discard_run(heap, &mresv->m);
+		Free(mresv);
+	} else {
+		VALGRIND_ANNOTATE_HAPPENS_BEFORE(&mresv->nresv);
+	}
+}
+
+/*
+ * heap_detach_active_run -- (internal) gets rid of the active run in the bucket
+ */
+static void
+heap_detach_active_run(struct palloc_heap *heap, struct bucket *b)
+{
+	if (!b->is_active)
+		return;
+
+	b->c_ops->rm_all(b->container);
+	struct memory_block_reserved **active = &b->active_memory_block;
+	if (util_fetch_and_sub64(&(*active)->nresv, 1) == 1) {
+		VALGRIND_ANNOTATE_HAPPENS_AFTER(&(*active)->nresv);
+		heap_discard_run(heap, &(*active)->m);
+	} else {
+		VALGRIND_ANNOTATE_HAPPENS_BEFORE(&(*active)->nresv);
+		*active = Zalloc(sizeof(struct memory_block_reserved));
+	}
+	b->is_active = 0;
+}
+
+/*
+ * heap_bucket_detach_run -- detaches the active run of the bucket, so that
+ *	the bucket is refilled from the recycler, which prefers the fullest runs
+ */
+void
+heap_bucket_detach_run(struct palloc_heap *heap, uint8_t class_id,
+	uint16_t arena_id)
+{
+	struct recycler *r = heap->rt->recyclers[class_id];
+	if (r == NULL)
+		return;
+
+	struct bucket *b = heap_bucket_acquire(heap, class_id, arena_id);
+	heap_detach_active_run(heap, b);
+	heap_bucket_release(heap, b);
+
+	/* the runs with recently freed units have to be rated accordingly */
+	struct empty_runs runs = recycler_recalc_eager(r);
+	heap_recycle_empty_runs(heap, &runs, NULL);
+}
+
 /*
  * heap_ensure_run_bucket_filled -- (internal) refills the bucket if needed
  */
@@ -818,19 +1301,7 @@ heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
 	ASSERTeq(b->aclass->type, CLASS_RUN);
 	int ret = 0;
 
-	/* get rid of the active block in the bucket */
-	if (b->is_active) {
-		b->c_ops->rm_all(b->container);
-		struct memory_block_reserved **active = &b->active_memory_block;
-		if (util_fetch_and_sub64(&(*active)->nresv, 1) == 1) {
-			VALGRIND_ANNOTATE_HAPPENS_AFTER(&(*active)->nresv);
-			heap_discard_run(heap, &(*active)->m);
-		} else {
-			VALGRIND_ANNOTATE_HAPPENS_BEFORE(&(*active)->nresv);
-			*active = Zalloc(sizeof(struct memory_block_reserved));
-		}
-		b->is_active = 0;
-	}
+	heap_detach_active_run(heap, b);
 
 	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
 		goto out;
@@ -870,6 +1341,14 @@ heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
 	}
 	heap_bucket_release(heap, defb);
 
+	/*
+	 * There's no space left for a new run, the background reclaimer might
+	 * have not yet caught up with the recent frees.
+	 */
+	if (heap_reclaimer_is_running(heap))
+		heap_recycle_unused(heap,
+			heap->rt->recyclers[b->aclass->id], NULL, 0);
+
 	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
 		goto out;
 
@@ -1209,6 +1688,20 @@ heap_get_arena_auto(struct palloc_heap *heap, unsigned arena_id)
 	return a->automatic;
 }
 
+/*
+ * heap_get_arena_numa_node -- returns the NUMA node the arena is bound to
+ */
+int
+heap_get_arena_numa_node(struct palloc_heap *heap, unsigned arena_id)
+{
+	util_mutex_lock(&heap->rt->arenas.lock);
+	struct arena *a = heap_get_arena_by_id(heap, arena_id);
+	int node = a->numa_node;
+	util_mutex_unlock(&heap->rt->arenas.lock);
+
+	return node;
+}
+
 /*
  * heap_set_arena_auto -- sets arena automatic value
  */
@@ -1277,11 +1770,12 @@ int
 heap_create_alloc_class_buckets(struct palloc_heap *heap, struct alloc_class *c)
 {
 	struct heap_rt *h = heap->rt;
+	struct recycler *r = NULL;
 
 	if (c->type == CLASS_RUN) {
-		h->recyclers[c->id] = recycler_new(heap, c->run.nallocs,
+		r = recycler_new(heap, c->run.nallocs,
 			&heap->rt->arenas.nactive);
-		if (h->recyclers[c->id] == NULL)
+		if (r == NULL)
 			goto error_recycler_new;
 	}
 
@@ -1296,10 +1790,15 @@ heap_create_alloc_class_buckets(struct palloc_heap *heap, struct alloc_class *c)
 			goto error_cache_bucket_new;
 	}
 
+	/* the background reclaimer might be iterating over the recyclers */
+	if (r != NULL)
+		util_atomic_store_explicit64((uint64_t *)&h->recyclers[c->id],
+			(uint64_t)r, memory_order_release);
+
 	return 0;
 
 error_cache_bucket_new:
-	recycler_delete(h->recyclers[c->id]);
+	recycler_delete(r);
 
 	for (; i != 0; --i)
 		bucket_delete(VEC_ARR(&h->arenas.vec)[i - 1]->buckets[c->id]);
@@ -1360,8 +1859,9 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	pmemops_persist(&heap->p_ops, heap->sizep, sizeof(*heap->sizep));
 
 	/*
-	 * If interrupted after changing the size, the heap will just grow
-	 * automatically on the next heap_boot.
+	 * If interrupted after changing the size, the zone metadata is
+	 * updated once the zone gets activated in heap_populate_bucket,
+	 * see heap_zone_update_if_needed.
 	 */
 
 	uint32_t nzones = heap_max_zone(*heap->sizep);
@@ -1389,29 +1889,6 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	return 1;
 }
 
-/*
- * heap_zone_update_if_needed -- updates the zone metadata if the pool has been
- *	extended.
- */
-static void
-heap_zone_update_if_needed(struct palloc_heap *heap)
-{
-	struct zone *z;
-
-	for (uint32_t i = 0; i < heap->rt->nzones; ++i) {
-		z = ZID_TO_ZONE(heap->layout, i);
-		if (z->header.magic != ZONE_HEADER_MAGIC)
-			continue;
-
-		size_t size_idx = zone_calc_size_idx(i, heap->rt->nzones,
-			*heap->sizep);
-		if (size_idx == z->header.size_idx)
-			continue;
-
-		heap_zone_init(heap, i, z->header.size_idx);
-	}
-}
-
 /*
  * heap_boot -- opens the heap region of the pmemobj pool
  *
@@ -1477,6 +1954,22 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	heap->alloc_pattern = PALLOC_CTL_DEBUG_NO_PATTERN;
 	VALGRIND_DO_CREATE_MEMPOOL(heap->layout, 0, 0);
 
+	h->tcache = tcache_new(heap);
+	if (h->tcache == NULL) {
+		err = errno;
+		goto error_tcache_new;
+	}
+
+	util_mutex_init(&h->reclaimer.lock);
+	os_cond_init(&h->reclaimer.cond);
+	h->reclaimer.running = 0;
+	h->reclaimer.stop = 0;
+	h->reclaimer.interval_ms = HEAP_RECLAIMER_INTERVAL_DEFAULT;
+	h->reclaimer.passes = 0;
+	h->reclaimer.runs = 0;
+
+	h->histogram_enabled = 0;
+
 	for (unsigned i = 0; i < narenas_default; ++i) {
 		if (VEC_PUSH_BACK(&h->arenas.vec, heap_arena_new(heap, 1))) {
 			err = errno;
@@ -1487,11 +1980,13 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		h->recyclers[i] = NULL;
 
-	heap_zone_update_if_needed(heap);
-
 	return 0;
 
 error_vec_reserve:
+	os_cond_destroy(&h->reclaimer.cond);
+	util_mutex_destroy(&h->reclaimer.lock);
+	tcache_delete(h->tcache);
+error_tcache_new:
 	heap_arenas_fini(&h->arenas);
 error_arenas_malloc:
 	alloc_class_collection_delete(h->alloc_classes);
@@ -1568,6 +2063,15 @@ heap_cleanup(struct palloc_heap *heap)
 {
 	struct heap_rt *rt = heap->rt;
 
+	/* the reclaimer must not outlive the heap it works on */
+	(void) heap_reclaimer_stop(heap);
+
+	/* cached reservations are given back before the buckets are gone */
+	tcache_delete(rt->tcache);
+
+	os_cond_destroy(&rt->reclaimer.cond);
+	util_mutex_destroy(&rt->reclaimer.lock);
+
 	alloc_class_collection_delete(rt->alloc_classes);
 
 	os_tls_key_delete(rt->arenas.thread);
@@ -1690,9 +2194,23 @@ heap_verify_zone(struct zone *zone)
 	return 0;
 }
 
+/*
+ * heap_check_zone -- (internal) verifies the zone with the given id,
+ *	parallel_for callback
+ */
+static int
+heap_check_zone(void *arg, size_t zone_id)
+{
+	struct heap_layout *layout = arg;
+
+	return heap_verify_zone(ZID_TO_ZONE(layout, zone_id));
+}
+
 /*
  * heap_check -- verifies if the heap is consistent and can be opened properly
  *
+ * The zones are verified by up to Heap_open_threads threads.
+ *
  * If successful function returns zero. Otherwise an error number is returned.
  */
 int
@@ -1708,10 +2226,9 @@ heap_check(void *heap_start, uint64_t heap_size)
 	if (heap_verify_header(&layout->header))
 		return -1;
 
-	for (unsigned i = 0; i < heap_max_zone(heap_size); ++i) {
-		if (heap_verify_zone(ZID_TO_ZONE(layout, i)))
-			return -1;
-	}
+	if (parallel_for(heap_max_zone(heap_size), Heap_open_threads,
+			heap_check_zone, layout))
+		return -1;
 
 	return 0;
 }
@@ -57,6 +57,18 @@ extern "C" {
 #define BIT_IS_CLR(a, i)	(!((a) & (1ULL << (i))))
 #define HEAP_ARENA_PER_THREAD (0)
 
+/* arena that is not (yet) bound to any NUMA node */
+#define HEAP_ARENA_NUMA_NODE_NONE (-1)
+
+/* maximum number of threads used when opening a pool */
+#define HEAP_OPEN_THREADS_MAX 1024
+
+/* default and maximum time between the passes of the reclaimer, in ms */
+#define HEAP_RECLAIMER_INTERVAL_DEFAULT 10
+#define HEAP_RECLAIMER_INTERVAL_MAX 60000
+
+extern unsigned Heap_open_threads;
+
 int heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		uint64_t *sizep,
 		void *base, struct pmem_ops *p_ops,
@@ -83,6 +95,10 @@ heap_bucket_acquire(struct palloc_heap *heap, uint8_t class_id,
 void
 heap_bucket_release(struct palloc_heap *heap, struct bucket *b);
 
+void
+heap_bucket_detach_run(struct palloc_heap *heap, uint8_t class_id,
+	uint16_t arena_id);
+
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
 struct memory_block
@@ -94,6 +110,18 @@ os_mutex_t *heap_get_run_lock(struct palloc_heap *heap,
 void
 heap_discard_run(struct palloc_heap *heap, struct memory_block *m);
 
+void
+heap_reservation_clear(struct palloc_heap *heap, const struct memory_block *m,
+	struct memory_block_reserved *mresv, int publish);
+
+int heap_reclaimer_run(struct palloc_heap *heap);
+int heap_reclaimer_stop(struct palloc_heap *heap);
+unsigned heap_reclaimer_get_interval(struct palloc_heap *heap);
+void heap_reclaimer_set_interval(struct palloc_heap *heap,
+	unsigned interval_ms);
+void heap_reclaimer_get_stats(struct palloc_heap *heap, uint64_t *passes,
+	uint64_t *runs);
+
 void
 heap_memblock_on_free(struct palloc_heap *heap, const struct memory_block *m);
 
@@ -106,6 +134,8 @@ void heap_foreach_object(struct palloc_heap *heap, object_callback cb,
 
 struct alloc_class_collection *heap_alloc_classes(struct palloc_heap *heap);
 
+struct tcache *heap_tcache(struct palloc_heap *heap);
+
 void *heap_end(struct palloc_heap *heap);
 
 unsigned heap_get_narenas_total(struct palloc_heap *heap);
@@ -118,6 +148,13 @@ unsigned heap_get_narenas_auto(struct palloc_heap *heap);
 
 unsigned heap_get_thread_arena_id(struct palloc_heap *heap);
 
+void heap_histogram_record(struct palloc_heap *heap, size_t size,
+	size_t count);
+void heap_histogram_get(struct palloc_heap *heap, uint64_t *histogram);
+void heap_histogram_reset(struct palloc_heap *heap);
+int heap_histogram_is_enabled(struct palloc_heap *heap);
+void heap_histogram_set_enabled(struct palloc_heap *heap, int enabled);
+
 int heap_arena_create(struct palloc_heap *heap);
 
 struct bucket **
@@ -125,6 +162,8 @@ heap_get_arena_buckets(struct palloc_heap *heap, unsigned arena_id);
 
 int heap_get_arena_auto(struct palloc_heap *heap, unsigned arena_id);
 
+int heap_get_arena_numa_node(struct palloc_heap *heap, unsigned arena_id);
+
 int heap_set_arena_auto(struct palloc_heap *heap, unsigned arena_id,
 		int automatic);
 
@@ -41,15 +41,18 @@
 #include <inttypes.h>
 #include <errno.h>
 #include <limits.h>
-#include <sched.h>
 
 #include "libpmemobj.h"
 #include "critnib.h"
+#include "ctl.h"
+#include "heap.h"
 #include "lane.h"
 #include "out.h"
 #include "util.h"
 #include "obj.h"
 #include "os_thread.h"
+#include "parallel.h"
+#include "sys_util.h"
 #include "valgrind_internal.h"
 #include "memops.h"
 #include "palloc.h"
@@ -57,6 +60,14 @@
 
 static os_tls_key_t Lane_info_key;
 
+/* lane geometry of the pools created from now on */
+static struct lane_geometry Lane_at_create = {
+	OBJ_NLANES,
+	LANE_REDO_INTERNAL_SIZE,
+	LANE_REDO_EXTERNAL_SIZE,
+	LANE_UNDO_SIZE,
+};
+
 static __thread struct critnib *Lane_info_ht;
 static __thread struct lane_info *Lane_info_records;
 static __thread struct lane_info *Lane_info_cache;
@@ -172,11 +183,10 @@ lane_info_cleanup(PMEMobjpool *pop)
 /*
  * lane_get_layout -- (internal) calculates the real pointer of the lane layout
  */
-static struct lane_layout *
+static void *
 lane_get_layout(PMEMobjpool *pop, uint64_t lane_idx)
 {
-	return (void *)((char *)pop + pop->lanes_offset +
-		sizeof(struct lane_layout) * lane_idx);
+	return OBJ_LANE_LAYOUT(pop, lane_idx);
 }
 
 /*
@@ -218,7 +228,8 @@ lane_undo_extend(void *base, uint64_t *redo, uint64_t gen_num)
 static int
 lane_redo_extend(void *base, uint64_t *redo, uint64_t gen_num)
 {
-	size_t s = SIZEOF_ALIGNED_ULOG(LANE_REDO_EXTERNAL_SIZE);
+	PMEMobjpool *pop = base;
+	size_t s = SIZEOF_ALIGNED_ULOG(OBJ_LANE_REDO_EXTERNAL_SIZE(pop));
 
 	return pmalloc_construct(base, redo, s, lane_ulog_constructor, &gen_num,
 		0, OBJ_INTERNAL_OBJECT_MASK, 0);
@@ -228,28 +239,48 @@ lane_redo_extend(void *base, uint64_t *redo, uint64_t gen_num)
  * lane_init -- (internal) initializes a single lane runtime variables
  */
 static int
-lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
+lane_init(PMEMobjpool *pop, struct lane *lane, void *layout)
 {
 	ASSERTne(lane, NULL);
 
 	lane->layout = layout;
+	lane->ncontended = 0;
+	lane->nwaits = 0;
 
-	lane->internal = operation_new((struct ulog *)&layout->internal,
-		LANE_REDO_INTERNAL_SIZE,
+	lane->internal = operation_new(OBJ_LANE_REDO_INTERNAL(pop, layout),
+		OBJ_LANE_REDO_INTERNAL_SIZE(pop),
 		NULL, NULL, &pop->p_ops,
 		LOG_TYPE_REDO);
 	if (lane->internal == NULL)
 		goto error_internal_new;
 
-	lane->external = operation_new((struct ulog *)&layout->external,
-		LANE_REDO_EXTERNAL_SIZE,
+	lane->external = operation_new(OBJ_LANE_REDO_EXTERNAL(pop, layout),
+		OBJ_LANE_REDO_EXTERNAL_SIZE(pop),
 		lane_redo_extend, (ulog_free_fn)pfree, &pop->p_ops,
 		LOG_TYPE_REDO);
 	if (lane->external == NULL)
 		goto error_external_new;
 
-	lane->undo = operation_new((struct ulog *)&layout->undo,
-		LANE_UNDO_SIZE,
+	/*
+	 * Changes to a pool with remote replicas are replicated using the
+	 * lane of the calling thread, so no other threads can apply them.
+	 */
+	if (!pop->has_remote_replicas) {
+		operation_set_parallel_apply(lane->internal, 1);
+		operation_set_parallel_apply(lane->external, 1);
+	}
+
+	/*
+	 * Flushes of a pool with any replicas copy the flushed range, which
+	 * must not include bytes modified concurrently under other locks.
+	 */
+	if (pop->replica == NULL) {
+		operation_set_line_flush(lane->internal, 1);
+		operation_set_line_flush(lane->external, 1);
+	}
+
+	lane->undo = operation_new(OBJ_LANE_UNDO(pop, layout),
+		OBJ_LANE_UNDO_SIZE(pop),
 		lane_undo_extend, (ulog_free_fn)pfree, &pop->p_ops,
 		LOG_TYPE_UNDO);
 	if (lane->undo == NULL)
@@ -292,6 +323,7 @@ lane_boot(PMEMobjpool *pop)
 	}
 
 	pop->lanes_desc.next_lane_idx = 0;
+	pop->lanes_desc.nwaiters = 0;
 
 	pop->lanes_desc.lane_locks =
 		Zalloc(sizeof(*pop->lanes_desc.lane_locks) * pop->nlanes);
@@ -302,11 +334,11 @@ lane_boot(PMEMobjpool *pop)
 
 	/* add lanes to pmemcheck ignored list */
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE((char *)pop + pop->lanes_offset,
-		(sizeof(struct lane_layout) * pop->nlanes));
+		(OBJ_LANE_SIZE(pop) * pop->nlanes));
 
 	uint64_t i;
 	for (i = 0; i < pop->nlanes; ++i) {
-		struct lane_layout *layout = lane_get_layout(pop, i);
+		void *layout = lane_get_layout(pop, i);
 
 		if ((err = lane_init(pop, &pop->lanes_desc.lane[i], layout))) {
 			ERR("!lane_init");
@@ -314,6 +346,9 @@ lane_boot(PMEMobjpool *pop)
 		}
 	}
 
+	util_mutex_init(&pop->lanes_desc.wait_lock);
+	os_cond_init(&pop->lanes_desc.wait_cond);
+
 	return 0;
 
 error_lane_init:
@@ -334,20 +369,23 @@ error_lanes_malloc:
 void
 lane_init_data(PMEMobjpool *pop)
 {
-	struct lane_layout *layout;
+	void *layout;
 
 	for (uint64_t i = 0; i < pop->nlanes; ++i) {
 		layout = lane_get_layout(pop, i);
-		ulog_construct(OBJ_PTR_TO_OFF(pop, &layout->internal),
-			LANE_REDO_INTERNAL_SIZE, 0, 0, 0, &pop->p_ops);
-		ulog_construct(OBJ_PTR_TO_OFF(pop, &layout->external),
-			LANE_REDO_EXTERNAL_SIZE, 0, 0, 0, &pop->p_ops);
-		ulog_construct(OBJ_PTR_TO_OFF(pop, &layout->undo),
-			LANE_UNDO_SIZE, 0, 0, 0, &pop->p_ops);
+		ulog_construct(OBJ_PTR_TO_OFF(pop,
+			OBJ_LANE_REDO_INTERNAL(pop, layout)),
+			OBJ_LANE_REDO_INTERNAL_SIZE(pop), 0, 0, 0, &pop->p_ops);
+		ulog_construct(OBJ_PTR_TO_OFF(pop,
+			OBJ_LANE_REDO_EXTERNAL(pop, layout)),
+			OBJ_LANE_REDO_EXTERNAL_SIZE(pop), 0, 0, 0, &pop->p_ops);
+		ulog_construct(OBJ_PTR_TO_OFF(pop,
+			OBJ_LANE_UNDO(pop, layout)),
+			OBJ_LANE_UNDO_SIZE(pop), 0, 0, 0, &pop->p_ops);
 	}
 	layout = lane_get_layout(pop, 0);
 	pmemops_xpersist(&pop->p_ops, layout,
-		pop->nlanes * sizeof(struct lane_layout),
+		pop->nlanes * OBJ_LANE_SIZE(pop),
 		PMEMOBJ_F_RELAXED);
 }
 
@@ -365,9 +403,34 @@ lane_cleanup(PMEMobjpool *pop)
 	Free(pop->lanes_desc.lane_locks);
 	pop->lanes_desc.lane_locks = NULL;
 
+	ASSERTeq(pop->lanes_desc.nwaiters, 0);
+	os_cond_destroy(&pop->lanes_desc.wait_cond);
+	util_mutex_destroy(&pop->lanes_desc.wait_lock);
+
 	lane_info_cleanup(pop);
 }
 
+/*
+ * lane_recover_redo -- (internal) recovers the redo logs of a single lane,
+ *	parallel_for callback
+ */
+static int
+lane_recover_redo(void *arg, size_t idx)
+{
+	PMEMobjpool *pop = arg;
+	void *layout = lane_get_layout(pop, idx);
+
+	/* no whole cache lines can be flushed on replicated pools */
+	unsigned nthreads = pop->replica == NULL ? 1 : ULOG_APPLY_IN_ORDER;
+
+	ulog_recover(OBJ_LANE_REDO_INTERNAL(pop, layout),
+		OBJ_OFF_IS_VALID_FROM_CTX, nthreads, &pop->p_ops);
+	ulog_recover(OBJ_LANE_REDO_EXTERNAL(pop, layout),
+		OBJ_OFF_IS_VALID_FROM_CTX, nthreads, &pop->p_ops);
+
+	return 0;
+}
+
 /*
  * lane_recover_and_section_boot -- performs initialization and recovery of all
  * lanes
@@ -381,20 +444,14 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 
 	int err = 0;
 	uint64_t i; /* lane index */
-	struct lane_layout *layout;
 
 	/*
 	 * First we need to recover the internal/external redo logs so that the
-	 * allocator state is consistent before we boot it.
+	 * allocator state is consistent before we boot it. The lanes are
+	 * independent of each other, so this can be done in parallel.
+	 * lane_recover_redo cannot fail, so the result needs no checking.
 	 */
-	for (i = 0; i < pop->nlanes; ++i) {
-		layout = lane_get_layout(pop, i);
-
-		ulog_recover((struct ulog *)&layout->internal,
-			OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops);
-		ulog_recover((struct ulog *)&layout->external,
-			OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops);
-	}
+	parallel_for(pop->nlanes, Heap_open_threads, lane_recover_redo, pop);
 
 	if ((err = pmalloc_boot(pop)) != 0)
 		return err;
@@ -423,61 +480,247 @@ lane_section_cleanup(PMEMobjpool *pop)
 	return pmalloc_cleanup(pop);
 }
 
+/*
+ * lane_check_one -- (internal) performs check of a single lane,
+ *	parallel_for callback
+ */
+static int
+lane_check_one(void *arg, size_t idx)
+{
+	PMEMobjpool *pop = arg;
+	void *layout = lane_get_layout(pop, idx);
+
+	int err = ulog_check(OBJ_LANE_REDO_INTERNAL(pop, layout),
+		OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops);
+	if (err != 0)
+		LOG(2, "lane %zu internal redo failed: %d", idx, err);
+
+	return err;
+}
+
 /*
  * lane_check -- performs check of all lanes
  */
 int
 lane_check(PMEMobjpool *pop)
 {
-	int err = 0;
-	uint64_t j; /* lane index */
-	struct lane_layout *layout;
-
-	for (j = 0; j < pop->nlanes; ++j) {
-		layout = lane_get_layout(pop, j);
-		if (ulog_check((struct ulog *)&layout->internal,
-		    OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops) != 0) {
-			LOG(2, "lane %" PRIu64 " internal redo failed: %d",
-				j, err);
-			return err;
-		}
+	return parallel_for(pop->nlanes, Heap_open_threads, lane_check_one,
+		pop);
+}
+
+/*
+ * lane_geometry_at_create -- returns the lane geometry of a newly created pool
+ */
+void
+lane_geometry_at_create(struct lane_geometry *geometry)
+{
+	*geometry = Lane_at_create;
+}
+
+/*
+ * lane_geometry_is_default -- checks whether the geometry can be used with
+ *	pools that do not have the POOL_FEAT_LANES feature
+ */
+int
+lane_geometry_is_default(const struct lane_geometry *geometry)
+{
+	return geometry->nlanes == OBJ_NLANES &&
+		geometry->redo_internal_size == LANE_REDO_INTERNAL_SIZE &&
+		geometry->redo_external_size == LANE_REDO_EXTERNAL_SIZE &&
+		geometry->undo_size == LANE_UNDO_SIZE;
+}
+
+/*
+ * lane_geometry_size -- (internal) returns the value stored in the pool
+ *	descriptor for the given log capacity
+ */
+static uint64_t
+lane_geometry_size(uint64_t size, uint64_t default_size)
+{
+	return size == default_size ? 0 : size;
+}
+
+/*
+ * lane_init_geometry -- stores the lane geometry in the descriptor of
+ *	a pool that is being created
+ */
+int
+lane_init_geometry(PMEMobjpool *pop, const struct lane_geometry *geometry,
+	size_t poolsize)
+{
+	pop->nlanes = geometry->nlanes;
+	pop->lane_redo_internal_size = lane_geometry_size(
+		geometry->redo_internal_size, LANE_REDO_INTERNAL_SIZE);
+	pop->lane_redo_external_size = lane_geometry_size(
+		geometry->redo_external_size, LANE_REDO_EXTERNAL_SIZE);
+	pop->lane_undo_size = lane_geometry_size(
+		geometry->undo_size, LANE_UNDO_SIZE);
+
+	if (pop->lanes_offset + pop->nlanes * OBJ_LANE_SIZE(pop) >= poolsize) {
+		ERR("pool size %zu too small for %" PRIu64 " lanes of size %"
+			PRIu64, poolsize, pop->nlanes, OBJ_LANE_SIZE(pop));
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * lane_check_size -- (internal) checks a log capacity from the pool
+ *	descriptor
+ */
+static int
+lane_check_size(uint64_t size, uint64_t default_size)
+{
+	if (size == 0)
+		return 0;
+
+	return size < default_size || size > LANE_LOG_SIZE_MAX ||
+		size % CACHELINE_SIZE != 0;
+}
+
+/*
+ * lane_check_geometry -- validates the lane geometry of an existing pool
+ */
+int
+lane_check_geometry(PMEMobjpool *pop)
+{
+	if (pop->nlanes == 0 || pop->nlanes > OBJ_NLANES ||
+	    lane_check_size(pop->lane_redo_internal_size,
+		LANE_REDO_INTERNAL_SIZE) ||
+	    lane_check_size(pop->lane_redo_external_size,
+		LANE_REDO_EXTERNAL_SIZE) ||
+	    lane_check_size(pop->lane_undo_size, LANE_UNDO_SIZE)) {
+		ERR("invalid lane geometry");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pop->lanes_offset + pop->nlanes * OBJ_LANE_SIZE(pop) >
+			pop->heap_offset) {
+		ERR("lanes overlap with the heap");
+		errno = EINVAL;
+		return -1;
 	}
 
 	return 0;
 }
 
+/*
+ * lane_cpu_primary -- (internal) returns the primary lane of the given CPU
+ *
+ * The lanes of consecutive CPUs are LANE_JUMP apart, so that they don't share
+ * cache lines of the lane locks array. CPUs that wrap around the number of
+ * lanes are shifted to use the lanes in between.
+ */
+static inline uint64_t
+lane_cpu_primary(unsigned cpu, uint64_t nlanes)
+{
+	uint64_t idx = (uint64_t)cpu * LANE_JUMP;
+
+	return (idx + idx / nlanes) % nlanes;
+}
+
+/*
+ * lane_try_acquire -- (internal) tries to acquire any free lane, starting
+ *	from the primary lane of the thread, returns 0 on success
+ */
+static inline int
+lane_try_acquire(uint64_t *locks, struct lane_info *info, uint64_t nlocks)
+{
+	uint64_t idx = info->primary % nlocks;
+
+	for (uint64_t n = 0; n < nlocks; ++n) {
+		/*
+		 * The lock is checked before the compare and swap so that
+		 * the cache lines of taken lanes are not needlessly written to.
+		 */
+		uint64_t locked;
+		util_atomic_load_explicit64(&locks[idx], &locked,
+			memory_order_relaxed);
+
+		if (locked == 0 &&
+		    util_bool_compare_and_swap64(&locks[idx], 0, 1)) {
+			info->lane_idx = idx;
+			return 0;
+		}
+
+		if (++idx == nlocks)
+			idx = 0;
+	}
+
+	return -1;
+}
+
+/*
+ * lane_wait -- (internal) waits until a lane is released and acquires it
+ *
+ * The waiter is registered before the lanes are checked again and
+ * lane_release checks for waiters after releasing a lane, which means that
+ * either the waiting thread finds the released lane, or it is woken up.
+ * The number of lanes is read again on every attempt because it might have
+ * been changed in the meantime (waiters are woken up when that happens).
+ */
+static void
+lane_wait(PMEMobjpool *pop, struct lane_info *info)
+{
+	struct lane_descriptor *desc = &pop->lanes_desc;
+
+	util_mutex_lock(&desc->wait_lock);
+	util_fetch_and_add32(&desc->nwaiters, 1);
+
+	for (;;) {
+		uint64_t nlocks = desc->runtime_nlanes;
+		if (lane_try_acquire(desc->lane_locks, info, nlocks) == 0)
+			break;
+
+		if (pop->stats->enabled) {
+			util_fetch_and_add64(
+				&desc->lane[info->primary % nlocks].nwaits, 1);
+		}
+		os_cond_wait(&desc->wait_cond, &desc->wait_lock);
+	}
+
+	util_fetch_and_sub32(&desc->nwaiters, 1);
+	util_mutex_unlock(&desc->wait_lock);
+}
+
 /*
  * get_lane -- (internal) get free lane index
  */
 static inline void
-get_lane(uint64_t *locks, struct lane_info *info, uint64_t nlocks)
+get_lane(PMEMobjpool *pop, struct lane_info *info, uint64_t nlocks)
 {
-	info->lane_idx = info->primary;
-	while (1) {
-		do {
-			info->lane_idx %= nlocks;
-			if (likely(util_bool_compare_and_swap64(
-					&locks[info->lane_idx], 0, 1))) {
-				if (info->lane_idx == info->primary) {
-					info->primary_attempts =
-						LANE_PRIMARY_ATTEMPTS;
-				} else if (info->primary_attempts == 0) {
-					info->primary = info->lane_idx;
-					info->primary_attempts =
-						LANE_PRIMARY_ATTEMPTS;
-				}
-				return;
-			}
+	int cpu = os_thread_cpu();
+	if (cpu >= 0)
+		info->primary = lane_cpu_primary((unsigned)cpu, nlocks);
+
+	if (unlikely(lane_try_acquire(pop->lanes_desc.lane_locks,
+			info, nlocks) != 0))
+		lane_wait(pop, info);
 
-			if (info->lane_idx == info->primary &&
-					info->primary_attempts > 0) {
-				info->primary_attempts--;
-			}
+	uint64_t primary = info->primary % nlocks;
+	if (likely(info->lane_idx == primary)) {
+		info->primary_attempts = LANE_PRIMARY_ATTEMPTS;
+		return;
+	}
 
-			++info->lane_idx;
-		} while (info->lane_idx < nlocks);
+	if (pop->stats->enabled) {
+		util_fetch_and_add64(
+			&pop->lanes_desc.lane[primary].ncontended, 1);
+	}
 
-		sched_yield();
+	/*
+	 * A thread whose primary lane is repeatedly taken switches to the lane
+	 * it has found instead. This only lasts until the next hold if the
+	 * primary lane is assigned based on the CPU.
+	 */
+	if (info->primary_attempts > 0) {
+		info->primary_attempts--;
+	} else {
+		info->primary = info->lane_idx;
+		info->primary_attempts = LANE_PRIMARY_ATTEMPTS;
 	}
 }
 
@@ -550,10 +793,9 @@ lane_hold(PMEMobjpool *pop, struct lane **lanep)
 			&pop->lanes_desc.next_lane_idx, LANE_JUMP);
 	} /* handles wraparound */
 
-	uint64_t *llocks = pop->lanes_desc.lane_locks;
 	/* grab next free lane from lanes available at runtime */
 	if (!lane->nest_count++) {
-		get_lane(llocks, lane, pop->lanes_desc.runtime_nlanes);
+		get_lane(pop, lane, pop->lanes_desc.runtime_nlanes);
 	}
 
 	struct lane *l = &pop->lanes_desc.lane[lane->lane_idx];
@@ -561,7 +803,7 @@ lane_hold(PMEMobjpool *pop, struct lane **lanep)
 	/* reinitialize lane's content only if in outermost hold */
 	if (lanep && lane->nest_count == 1) {
 		VALGRIND_ANNOTATE_NEW_MEMORY(l, sizeof(*l));
-		VALGRIND_ANNOTATE_NEW_MEMORY(l->layout, sizeof(*l->layout));
+		VALGRIND_ANNOTATE_NEW_MEMORY(l->layout, OBJ_LANE_SIZE(pop));
 		operation_init(l->external);
 		operation_init(l->internal);
 		operation_init(l->undo);
@@ -592,10 +834,428 @@ lane_release(PMEMobjpool *pop)
 	if (unlikely(lane->nest_count == 0)) {
 		FATAL("lane_release");
 	} else if (--(lane->nest_count) == 0) {
+		struct lane_descriptor *desc = &pop->lanes_desc;
 		if (unlikely(!util_bool_compare_and_swap64(
-				&pop->lanes_desc.lane_locks[lane->lane_idx],
+				&desc->lane_locks[lane->lane_idx],
 				1, 0))) {
 			FATAL("util_bool_compare_and_swap64");
 		}
+
+		/* see lane_wait */
+		unsigned nwaiters;
+		util_atomic_load_explicit32(&desc->nwaiters, &nwaiters,
+			memory_order_relaxed);
+		if (unlikely(nwaiters != 0)) {
+			util_mutex_lock(&desc->wait_lock);
+			os_cond_signal(&desc->wait_cond);
+			util_mutex_unlock(&desc->wait_lock);
+		}
+	}
+}
+
+/*
+ * lane_detach -- detaches the lane held by the current thread without
+ *	releasing it, so that its ownership can be handed over to a different
+ *	thread (which has to call lane_attach)
+ *
+ * Only a lane that is not held recursively can be detached.
+ */
+int
+lane_detach(PMEMobjpool *pop, unsigned *lane_idx)
+{
+	if (unlikely(!pop->lanes_desc.runtime_nlanes))
+		return -1;
+
+	struct lane_info *lane = get_lane_info_record(pop);
+
+	ASSERTne(lane->lane_idx, UINT64_MAX);
+
+	if (lane->nest_count != 1)
+		return -1;
+
+	lane->nest_count = 0;
+	*lane_idx = (unsigned)lane->lane_idx;
+
+	return 0;
+}
+
+/*
+ * lane_attach -- makes the current thread the owner of a lane that has been
+ *	detached by a different thread, the lane has to be dropped with
+ *	lane_release
+ */
+struct lane *
+lane_attach(PMEMobjpool *pop, unsigned lane_idx)
+{
+	struct lane_info *lane = get_lane_info_record(pop);
+
+	ASSERTeq(lane->nest_count, 0);
+	ASSERT(lane_idx < pop->nlanes);
+
+	lane->lane_idx = lane_idx;
+	lane->nest_count = 1;
+
+	return &pop->lanes_desc.lane[lane_idx];
+}
+
+/*
+ * CTL_READ_HANDLER(runtime_nlanes) -- returns the number of lanes available
+ *	at runtime
+ */
+static int
+CTL_READ_HANDLER(runtime_nlanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+	*arg_out = pop->lanes_desc.runtime_nlanes;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(runtime_nlanes) -- changes the number of lanes available
+ *	at runtime
+ */
+static int
+CTL_WRITE_HANDLER(runtime_nlanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct lane_descriptor *desc = &pop->lanes_desc;
+
+	long long arg_in = *(long long *)arg;
+
+	if (pop->has_remote_replicas) {
+		ERR("the number of lanes cannot be changed for a pool with "
+			"remote replicas");
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	if (arg_in < 1 || (uint64_t)arg_in > pop->nlanes) {
+		ERR("invalid number of lanes, must be between 1 and %" PRIu64,
+			pop->nlanes);
+		errno = EINVAL;
+		return -1;
 	}
+
+	/*
+	 * Lanes above the new limit that are currently held remain valid
+	 * until they are released. The waiters are woken up so that they
+	 * can look for a free lane in the new range.
+	 */
+	util_mutex_lock(&desc->wait_lock);
+	util_atomic_store_explicit32(&desc->runtime_nlanes,
+		(unsigned)arg_in, memory_order_release);
+	os_cond_broadcast(&desc->wait_cond);
+	util_mutex_unlock(&desc->wait_lock);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(runtime_nlanes) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(nlanes, pool) -- returns the number of lanes in the pool
+ */
+static int
+CTL_READ_HANDLER(nlanes, pool)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+	*arg_out = pop->nlanes;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(redo_internal_size, pool) -- returns the capacity of
+ *	the internal redo log of the pool's lanes
+ */
+static int
+CTL_READ_HANDLER(redo_internal_size, pool)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+	*arg_out = OBJ_LANE_REDO_INTERNAL_SIZE(pop);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(redo_external_size, pool) -- returns the capacity of
+ *	the external redo log of the pool's lanes
+ */
+static int
+CTL_READ_HANDLER(redo_external_size, pool)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+	*arg_out = OBJ_LANE_REDO_EXTERNAL_SIZE(pop);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(undo_size, pool) -- returns the capacity of the undo log
+ *	of the pool's lanes
+ */
+static int
+CTL_READ_HANDLER(undo_size, pool)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+	*arg_out = OBJ_LANE_UNDO_SIZE(pop);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(lane)[] = {
+	CTL_LEAF_RW(runtime_nlanes),
+	CTL_LEAF_RO(nlanes, pool),
+	CTL_LEAF_RO(redo_internal_size, pool),
+	CTL_LEAF_RO(redo_external_size, pool),
+	CTL_LEAF_RO(undo_size, pool),
+
+	CTL_NODE_END
+};
+
+/*
+ * lane_ctl_register -- registers ctl nodes for "lane" module
+ */
+void
+lane_ctl_register(PMEMobjpool *pop)
+{
+	CTL_REGISTER_MODULE(pop->ctl, lane);
+}
+
+/*
+ * CTL_READ_HANDLER(nlanes) -- returns the number of lanes of newly created
+ *	pools
+ */
+static int
+CTL_READ_HANDLER(nlanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	uint64_t *arg_out = arg;
+	*arg_out = Lane_at_create.nlanes;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(nlanes) -- sets the number of lanes of newly created
+ *	pools
+ */
+static int
+CTL_WRITE_HANDLER(nlanes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 1 || arg_in > OBJ_NLANES) {
+		ERR("invalid number of lanes, must be between 1 and %d",
+			OBJ_NLANES);
+		errno = EINVAL;
+		return -1;
+	}
+
+	Lane_at_create.nlanes = (uint64_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(nlanes) = CTL_ARG_LONG_LONG;
+
+/*
+ * lane_set_log_size -- (internal) validates and sets the capacity of a log
+ *	of newly created pools
+ */
+static int
+lane_set_log_size(uint64_t *size, long long arg_in, uint64_t default_size)
+{
+	if (arg_in < (long long)default_size ||
+	    (unsigned long long)arg_in > LANE_LOG_SIZE_MAX ||
+	    (unsigned long long)arg_in % CACHELINE_SIZE != 0) {
+		ERR("invalid log size, must be a multiple of %llu between "
+			"%" PRIu64 " and %llu", CACHELINE_SIZE, default_size,
+			LANE_LOG_SIZE_MAX);
+		errno = EINVAL;
+		return -1;
+	}
+
+	*size = (uint64_t)arg_in;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(redo_internal_size) -- returns the capacity of the
+ *	internal redo log of newly created pools
+ */
+static int
+CTL_READ_HANDLER(redo_internal_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	uint64_t *arg_out = arg;
+	*arg_out = Lane_at_create.redo_internal_size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(redo_internal_size) -- sets the capacity of the
+ *	internal redo log of newly created pools
+ */
+static int
+CTL_WRITE_HANDLER(redo_internal_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	return lane_set_log_size(&Lane_at_create.redo_internal_size,
+		*(long long *)arg, LANE_REDO_INTERNAL_SIZE);
+}
+
+static const struct ctl_argument CTL_ARG(redo_internal_size) =
+	CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(redo_external_size) -- returns the capacity of the
+ *	external redo log of newly created pools
+ */
+static int
+CTL_READ_HANDLER(redo_external_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	uint64_t *arg_out = arg;
+	*arg_out = Lane_at_create.redo_external_size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(redo_external_size) -- sets the capacity of the
+ *	external redo log of newly created pools
+ */
+static int
+CTL_WRITE_HANDLER(redo_external_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	return lane_set_log_size(&Lane_at_create.redo_external_size,
+		*(long long *)arg, LANE_REDO_EXTERNAL_SIZE);
+}
+
+static const struct ctl_argument CTL_ARG(redo_external_size) =
+	CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(undo_size) -- returns the capacity of the undo log of
+ *	newly created pools
+ */
+static int
+CTL_READ_HANDLER(undo_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	uint64_t *arg_out = arg;
+	*arg_out = Lane_at_create.undo_size;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(undo_size) -- sets the capacity of the undo log of
+ *	newly created pools
+ */
+static int
+CTL_WRITE_HANDLER(undo_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	return lane_set_log_size(&Lane_at_create.undo_size,
+		*(long long *)arg, LANE_UNDO_SIZE);
+}
+
+static const struct ctl_argument CTL_ARG(undo_size) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(at_create)[] = {
+	CTL_LEAF_RW(nlanes),
+	CTL_LEAF_RW(redo_internal_size),
+	CTL_LEAF_RW(redo_external_size),
+	CTL_LEAF_RW(undo_size),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(apply_threads) -- returns the maximum number of threads
+ *	which apply a single redo log
+ */
+static int
+CTL_READ_HANDLER(apply_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+
+	*arg_out = (int)Ulog_apply_threads;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(apply_threads) -- sets the maximum number of threads
+ *	which apply a single redo log
+ */
+static int
+CTL_WRITE_HANDLER(apply_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 1 || arg_in > ULOG_APPLY_THREADS_MAX) {
+		ERR("incorrect number of threads, must be between 1 and %d",
+			ULOG_APPLY_THREADS_MAX);
+		errno = EINVAL;
+		return -1;
+	}
+
+	Ulog_apply_threads = (unsigned)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(apply_threads) = CTL_ARG_INT;
+
+static const struct ctl_node CTL_NODE(redo)[] = {
+	CTL_LEAF_RW(apply_threads),
+
+	CTL_NODE_END
+};
+
+/*
+ * The global part of the "lane" module, it has to be available before any
+ * pool is created.
+ */
+static const struct ctl_node CTL_NODE(lane, global)[] = {
+	CTL_CHILD(at_create),
+	CTL_CHILD(redo),
+
+	CTL_NODE_END
+};
+
+/*
+ * lane_global_ctl_register -- registers global ctl nodes for "lane" module
+ */
+void
+lane_global_ctl_register(void)
+{
+	ctl_register_module_node(NULL, "lane",
+		(struct ctl_node *)CTL_NODE(lane, global));
 }
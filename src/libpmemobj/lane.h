@@ -40,6 +40,7 @@
 #include <stdint.h>
 #include "ulog.h"
 #include "libpmemobj.h"
+#include "os_thread.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -82,6 +83,14 @@ extern "C" {
 #define LANE_REDO_EXTERNAL_SIZE 640
 #define LANE_REDO_INTERNAL_SIZE 192
 
+/*
+ * The sizes above describe the default lane geometry. The number of lanes and
+ * capacities of their logs can be changed at pool creation (but not below the
+ * defaults), in which case they are stored in the pool descriptor.
+ */
+#define LANE_LOG_SIZE_MAX (1ULL << 30)
+
+/* layout of a single lane with the default geometry */
 struct lane_layout {
 	/*
 	 * Redo log for self-contained and 'one-shot' allocator operations.
@@ -100,11 +109,26 @@ struct lane_layout {
 	struct ULOG(LANE_UNDO_SIZE) undo;
 };
 
+/* the number of lanes and capacities of their logs */
+struct lane_geometry {
+	uint64_t nlanes;
+	uint64_t redo_internal_size;
+	uint64_t redo_external_size;
+	uint64_t undo_size;
+};
+
 struct lane {
-	struct lane_layout *layout; /* pointer to persistent layout */
+	void *layout; /* pointer to persistent layout */
 	struct operation_context *internal; /* context for internal ulog */
 	struct operation_context *external; /* context for external ulog */
 	struct operation_context *undo; /* context for undo ulog */
+
+	/*
+	 * Contention statistics, attributed to the primary lane of the
+	 * acquiring thread and counted only if statistics are enabled.
+	 */
+	uint64_t ncontended; /* the lane was taken by a different thread */
+	uint64_t nwaits; /* the thread had to wait for any lane to be freed */
 };
 
 struct lane_descriptor {
@@ -117,6 +141,11 @@ struct lane_descriptor {
 	unsigned next_lane_idx;
 	uint64_t *lane_locks;
 	struct lane *lane;
+
+	/* threads waiting for a lane when all of them are taken */
+	unsigned nwaiters;
+	os_mutex_t wait_lock;
+	os_cond_t wait_cond;
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop, void *data, unsigned length);
@@ -141,7 +170,8 @@ struct lane_info {
 	/*
 	 * The index of the primary lane for the thread. A thread will always
 	 * try to acquire the primary lane first, and only if that fails it will
-	 * look for a different available lane.
+	 * look for a different available lane. If the CPU on which the thread
+	 * runs is known, the primary lane is the one assigned to that CPU.
 	 */
 	uint64_t primary;
 	int primary_attempts;
@@ -152,6 +182,11 @@ struct lane_info {
 void lane_info_boot(void);
 void lane_info_destroy(void);
 
+void lane_geometry_at_create(struct lane_geometry *geometry);
+int lane_geometry_is_default(const struct lane_geometry *geometry);
+int lane_init_geometry(PMEMobjpool *pop,
+	const struct lane_geometry *geometry, size_t poolsize);
+int lane_check_geometry(PMEMobjpool *pop);
 void lane_init_data(PMEMobjpool *pop);
 int lane_boot(PMEMobjpool *pop);
 void lane_cleanup(PMEMobjpool *pop);
@@ -162,6 +197,12 @@ int lane_check(PMEMobjpool *pop);
 unsigned lane_hold(PMEMobjpool *pop, struct lane **lane);
 void lane_release(PMEMobjpool *pop);
 
+int lane_detach(PMEMobjpool *pop, unsigned *lane_idx);
+struct lane *lane_attach(PMEMobjpool *pop, unsigned lane_idx);
+
+void lane_ctl_register(PMEMobjpool *pop);
+void lane_global_ctl_register(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2017, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -34,6 +34,7 @@
  * libpmemobj.c -- pmem entry points for libpmemobj
  */
 
+#include "checksum.h"
 #include "pmemcommon.h"
 #include "obj.h"
 
@@ -50,6 +51,7 @@ libpmemobj_init(void)
 			PMEMOBJ_LOG_FILE_VAR, PMEMOBJ_MAJOR_VERSION,
 			PMEMOBJ_MINOR_VERSION);
 	LOG(3, NULL);
+	checksum_init();
 	obj_init();
 }
 
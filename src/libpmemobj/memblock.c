@@ -1227,6 +1227,31 @@ run_calc_free(const struct memory_block *m,
 	}
 }
 
+/*
+ * run_fill_pct -- calculates the percentage of allocated units in a run
+ */
+static unsigned
+run_fill_pct(const struct memory_block *m)
+{
+	struct run_bitmap b;
+	run_get_bitmap(m, &b);
+
+	/* the bits past the end of the bitmap are always set */
+	unsigned clearbits = 0;
+	for (unsigned i = 0; i < b.nvalues; ++i) {
+		uint64_t value = ~b.values[i];
+		if (value == 0)
+			continue;
+
+		clearbits += util_popcount64(value);
+	}
+
+	ASSERT(b.nbits >= clearbits);
+	unsigned setbits = b.nbits - clearbits;
+
+	return (100 * setbits) / b.nbits;
+}
+
 static const struct memory_block_ops mb_ops[MAX_MEMORY_BLOCK] = {
 	[MEMORY_BLOCK_HUGE] = {
 		.block_size = huge_block_size,
@@ -1248,6 +1273,7 @@ static const struct memory_block_ops mb_ops[MAX_MEMORY_BLOCK] = {
 		.iterate_used = huge_iterate_used,
 		.reinit_chunk = huge_reinit_chunk,
 		.calc_free = NULL,
+		.fill_pct = NULL,
 		.get_bitmap = NULL,
 	},
 	[MEMORY_BLOCK_RUN] = {
@@ -1270,6 +1296,7 @@ static const struct memory_block_ops mb_ops[MAX_MEMORY_BLOCK] = {
 		.iterate_used = run_iterate_used,
 		.reinit_chunk = run_reinit_chunk,
 		.calc_free = run_calc_free,
+		.fill_pct = run_fill_pct,
 		.get_bitmap = run_get_bitmap,
 	}
 };
@@ -238,6 +238,9 @@ struct memory_block_ops {
 	void (*calc_free)(const struct memory_block *m,
 		uint32_t *free_space, uint32_t *max_free_block);
 
+	/* returns the percentage of allocated units, valid only for runs */
+	unsigned (*fill_pct)(const struct memory_block *m);
+
 	/* this is called exactly once for every existing chunk */
 	void (*reinit_chunk)(const struct memory_block *m);
 
@@ -54,6 +54,12 @@
 #define ULOG_BASE_SIZE 1024
 #define OP_MERGE_SEARCH 64
 
+/* the retained ulogs high watermark decays by 1/16th with every operation */
+#define OP_ULOG_RETAIN_DECAY 4
+
+/* maximum number of cache lines whose flushes are deferred by an operation */
+#define OP_DIRTY_LINES_MAX 64
+
 struct operation_log {
 	size_t capacity; /* capacity of the ulog log */
 	size_t offset; /* data offset inside of the log */
@@ -84,6 +90,10 @@ struct operation_context {
 	size_t ulog_capacity; /* sum of capacity, incl all next ulog logs */
 	int ulog_auto_reserve; /* allow or do not to auto ulog reservation */
 	int ulog_any_user_buffer; /* set if any user buffer is added */
+	size_t ulog_retain_max; /* max capacity of next ulogs kept on finish */
+	size_t ulog_retain_hwm; /* decaying high watermark of logged bytes */
+	int ulog_parallel_apply; /* redo log can be applied by many threads */
+	int ulog_line_flush; /* modified cache lines can be flushed as a whole */
 
 	struct ulog_next next; /* vector of 'next' fields of persistent ulog */
 
@@ -94,8 +104,60 @@ struct operation_context {
 
 	/* collection used to look for potential merge candidates */
 	VECQ(, struct ulog_entry_val *) merge_entries;
+
+	/*
+	 * Cache lines modified by the persistent value entries, they are
+	 * flushed once each after all entries are applied. If there are
+	 * more than OP_DIRTY_LINES_MAX of them, or the lines cannot be
+	 * flushed as a whole, every entry is flushed as it is applied.
+	 */
+	uintptr_t dirty_lines[OP_DIRTY_LINES_MAX];
+	size_t ndirty_lines;
 };
 
+/*
+ * operation_log_alloc -- (internal) allocates a zeroed volatile log
+ *
+ * The log is cacheline aligned, just like the persistent ulogs, because
+ * buffer entries are created in it directly.
+ */
+static struct ulog *
+operation_log_alloc(size_t capacity)
+{
+	struct ulog *ulog = util_aligned_malloc(CACHELINE_SIZE,
+		SIZEOF_ULOG(capacity));
+	if (ulog == NULL) {
+		ERR("!util_aligned_malloc");
+		return NULL;
+	}
+
+	memset(ulog, 0, SIZEOF_ULOG(capacity));
+
+	return ulog;
+}
+
+/*
+ * operation_log_grow -- (internal) increases the capacity of a volatile log
+ */
+static int
+operation_log_grow(struct operation_log *log, size_t ncapacity)
+{
+	struct ulog *ulog = util_aligned_malloc(CACHELINE_SIZE,
+		SIZEOF_ULOG(ncapacity));
+	if (ulog == NULL) {
+		ERR("!util_aligned_malloc");
+		return -1;
+	}
+
+	memcpy(ulog, log->ulog, SIZEOF_ULOG(log->capacity));
+	util_aligned_free(log->ulog);
+
+	log->ulog = ulog;
+	log->capacity = ncapacity;
+
+	return 0;
+}
+
 /*
  * operation_log_transient_init -- (internal) initialize operation log
  *	containing transient memory resident changes
@@ -106,12 +168,9 @@ operation_log_transient_init(struct operation_log *log)
 	log->capacity = ULOG_BASE_SIZE;
 	log->offset = 0;
 
-	struct ulog *src = Zalloc(sizeof(struct ulog) +
-		ULOG_BASE_SIZE);
-	if (src == NULL) {
-		ERR("!Zalloc");
+	struct ulog *src = operation_log_alloc(ULOG_BASE_SIZE);
+	if (src == NULL)
 		return -1;
-	}
 
 	/* initialize underlying redo log structure */
 	src->capacity = ULOG_BASE_SIZE;
@@ -132,12 +191,9 @@ operation_log_persistent_init(struct operation_log *log,
 	log->capacity = ULOG_BASE_SIZE;
 	log->offset = 0;
 
-	struct ulog *src = Zalloc(sizeof(struct ulog) +
-		ULOG_BASE_SIZE);
-	if (src == NULL) {
-		ERR("!Zalloc");
+	struct ulog *src = operation_log_alloc(ULOG_BASE_SIZE);
+	if (src == NULL)
 		return -1;
-	}
 
 	/* initialize underlying redo log structure */
 	src->capacity = ulog_base_nbytes;
@@ -160,6 +216,17 @@ operation_transient_clean(void *base, const void *addr, size_t len,
 	return 0;
 }
 
+/*
+ * operation_flush_deferred -- flush callback of entries whose cache lines
+ *	are flushed once the whole operation is applied
+ */
+static int
+operation_flush_deferred(void *base, const void *addr, size_t len,
+	unsigned flags)
+{
+	return 0;
+}
+
 /*
  * operation_transient_memcpy -- transient memcpy wrapper
  */
@@ -170,6 +237,14 @@ operation_transient_memcpy(void *base, void *dest, const void *src, size_t len,
 	return memcpy(dest, src, len);
 }
 
+/*
+ * operation_transient_drain -- transient drain wrapper
+ */
+static void
+operation_transient_drain(void *base)
+{
+}
+
 /*
  * operation_new -- creates new operation context
  */
@@ -196,6 +271,10 @@ operation_new(struct ulog *ulog, size_t ulog_base_nbytes,
 	ctx->p_ops = p_ops;
 	ctx->type = type;
 	ctx->ulog_any_user_buffer = 0;
+	ctx->ulog_retain_max = 0;
+	ctx->ulog_retain_hwm = 0;
+	ctx->ulog_parallel_apply = 0;
+	ctx->ulog_line_flush = 0;
 
 	ctx->ulog_curr_offset = 0;
 	ctx->ulog_curr_capacity = 0;
@@ -208,6 +287,7 @@ operation_new(struct ulog *ulog, size_t ulog_base_nbytes,
 	ctx->s_ops.base = p_ops->base;
 	ctx->s_ops.flush = operation_transient_clean;
 	ctx->s_ops.memcpy = operation_transient_memcpy;
+	ctx->s_ops.drain = operation_transient_drain;
 
 	VECQ_INIT(&ctx->merge_entries);
 
@@ -234,8 +314,8 @@ operation_delete(struct operation_context *ctx)
 {
 	VECQ_DELETE(&ctx->merge_entries);
 	VEC_DELETE(&ctx->next);
-	Free(ctx->pshadow_ops.ulog);
-	Free(ctx->transient_ops.ulog);
+	util_aligned_free(ctx->pshadow_ops.ulog);
+	util_aligned_free(ctx->transient_ops.ulog);
 	Free(ctx);
 }
 
@@ -357,6 +437,33 @@ operation_merge_entry_add(struct operation_context *ctx,
 	}
 }
 
+/*
+ * operation_dirty_line_add -- (internal) records the cache line modified by
+ *	a persistent value entry
+ */
+static void
+operation_dirty_line_add(struct operation_context *ctx, const void *ptr)
+{
+	if (!ctx->ulog_line_flush || ctx->ndirty_lines > OP_DIRTY_LINES_MAX)
+		return;
+
+	uintptr_t line = ALIGN_DOWN((uintptr_t)ptr, CACHELINE_SIZE);
+
+	/* adjacent words are usually modified one after another */
+	for (size_t i = ctx->ndirty_lines; i > 0; --i) {
+		if (ctx->dirty_lines[i - 1] == line)
+			return;
+	}
+
+	/* too many lines, they will be flushed along with the entries */
+	if (ctx->ndirty_lines == OP_DIRTY_LINES_MAX) {
+		ctx->ndirty_lines++;
+		return;
+	}
+
+	ctx->dirty_lines[ctx->ndirty_lines++] = line;
+}
+
 /*
  * operation_add_typed_value -- adds new entry to the current operation, if the
  *	same ptr address already exists and the operation type is set,
@@ -375,17 +482,22 @@ operation_add_typed_entry(struct operation_context *ctx,
 	 * ulog log entry creation has enough room for zeroing.
 	 */
 	if (oplog->offset + CACHELINE_SIZE == oplog->capacity) {
-		size_t ncapacity = oplog->capacity + ULOG_BASE_SIZE;
-		struct ulog *ulog = Realloc(oplog->ulog,
-			SIZEOF_ULOG(ncapacity));
-		if (ulog == NULL)
+		if (operation_log_grow(oplog,
+		    oplog->capacity + ULOG_BASE_SIZE) != 0)
 			return -1;
-		oplog->capacity += ULOG_BASE_SIZE;
-		oplog->ulog = ulog;
 
 		/*
-		 * Realloc invalidated the ulog entries that are inside of this
-		 * vector, need to clear it to avoid use after free.
+		 * The transient log is processed directly, so its header has
+		 * to describe all of the entries. The header of the persistent
+		 * shadow is stored in the lane log and must keep describing
+		 * the base capacity of the lane log.
+		 */
+		if (log_type == LOG_TRANSIENT)
+			oplog->ulog->capacity = oplog->capacity;
+
+		/*
+		 * Reallocation invalidated the ulog entries that are inside
+		 * of this vector, need to clear it to avoid use after free.
 		 */
 		VECQ_CLEAR(&ctx->merge_entries);
 	}
@@ -394,6 +506,9 @@ operation_add_typed_entry(struct operation_context *ctx,
 		operation_try_merge_entry(ctx, ptr, value, type) != 0)
 		return 0;
 
+	if (log_type == LOG_PERSISTENT)
+		operation_dirty_line_add(ctx, ptr);
+
 	struct ulog_entry_val *entry = ulog_entry_val_create(
 		oplog->ulog, oplog->offset, ptr, value, type,
 		log_type == LOG_TRANSIENT ? &ctx->t_ops : &ctx->s_ops);
@@ -424,6 +539,86 @@ operation_add_entry(struct operation_context *ctx, void *ptr, uint64_t value,
 		from_pool ? LOG_PERSISTENT : LOG_TRANSIENT);
 }
 
+/*
+ * operation_redo_space -- (internal) returns the number of bytes left, from
+ *	the given offset of the shadow log, in the persistent ulog in which that
+ *	offset is going to be stored
+ */
+static size_t
+operation_redo_space(struct operation_context *ctx, size_t offset)
+{
+	size_t end = ctx->ulog_base_nbytes;
+
+	uint64_t next;
+	VEC_FOREACH(next, &ctx->next) {
+		if (offset < end)
+			break;
+
+		end += ulog_by_offset(next, ctx->p_ops)->capacity;
+	}
+
+	return offset < end ? end - offset : 0;
+}
+
+/*
+ * operation_add_redo_buffer -- (internal) adds a buffer operation to the
+ *	shadow copy of the redo log
+ *
+ * The shadow log is stored in the persistent ulogs as-is, so the buffer is
+ * split into entries that do not cross the boundaries of these ulogs.
+ * Buffer entries have to be cacheline aligned, which is why all of them have
+ * to be added before any value entry.
+ */
+static int
+operation_add_redo_buffer(struct operation_context *ctx,
+	void *dest, void *src, size_t size, ulog_operation_type type)
+{
+	struct operation_log *oplog = &ctx->pshadow_ops;
+
+	ASSERTeq(oplog->offset % CACHELINE_SIZE, 0);
+
+	while (size != 0) {
+		size_t entry_size = ALIGN_UP(size +
+			sizeof(struct ulog_entry_buf), CACHELINE_SIZE);
+
+		/* one more cacheline for the entry that terminates the log */
+		size_t nbytes = oplog->offset + entry_size + CACHELINE_SIZE;
+		if (operation_reserve(ctx, nbytes) != 0)
+			return -1;
+
+		if (nbytes > oplog->capacity) {
+			if (operation_log_grow(oplog,
+			    ALIGN_UP(nbytes, ULOG_BASE_SIZE)) != 0)
+				return -1;
+
+			/* see operation_add_typed_entry */
+			VECQ_CLEAR(&ctx->merge_entries);
+		}
+
+		entry_size = MIN(entry_size,
+			operation_redo_space(ctx, oplog->offset));
+		ASSERT(entry_size > sizeof(struct ulog_entry_buf));
+
+		size_t data_size = MIN(size,
+			entry_size - sizeof(struct ulog_entry_buf));
+
+		struct ulog_entry_buf *e = ulog_entry_buf_create(oplog->ulog,
+			oplog->offset, oplog->ulog->gen_num,
+			dest, src, data_size, type, &ctx->s_ops);
+		ASSERTeq(entry_size, ulog_entry_size(&e->base));
+
+		oplog->offset += entry_size;
+		memset(oplog->ulog->data + oplog->offset, 0,
+			sizeof(struct ulog_entry_base));
+
+		dest = (char *)dest + data_size;
+		src = (char *)src + data_size;
+		size -= data_size;
+	}
+
+	return 0;
+}
+
 /*
  * operation_add_buffer -- adds a buffer operation to the log
  */
@@ -431,6 +626,9 @@ int
 operation_add_buffer(struct operation_context *ctx,
 	void *dest, void *src, size_t size, ulog_operation_type type)
 {
+	if (ctx->type == LOG_TYPE_REDO)
+		return operation_add_redo_buffer(ctx, dest, src, size, type);
+
 	size_t real_size = size + sizeof(struct ulog_entry_buf);
 
 	/* if there's no space left in the log, reserve some more */
@@ -631,6 +829,68 @@ operation_set_auto_reserve(struct operation_context *ctx, int auto_reserve)
 	ctx->ulog_auto_reserve = auto_reserve;
 }
 
+/*
+ * operation_set_parallel_apply -- allows the redo log of the context to be
+ *	applied by many threads
+ */
+void
+operation_set_parallel_apply(struct operation_context *ctx, int parallel)
+{
+	ctx->ulog_parallel_apply = parallel;
+}
+
+/*
+ * operation_set_line_flush -- allows the cache lines modified by the redo log
+ *	of the context to be flushed as a whole
+ *
+ * A flush of the whole line also covers the bytes modified concurrently by
+ * other operations, which is only safe if the flush doesn't copy the data
+ * anywhere, i.e., the pool has no replicas.
+ */
+void
+operation_set_line_flush(struct operation_context *ctx, int line_flush)
+{
+	ctx->ulog_line_flush = line_flush;
+}
+
+/*
+ * operation_set_ulog_retain -- sets the maximum capacity of the next ulogs
+ *	which are kept linked to the first one once the operation finishes
+ */
+void
+operation_set_ulog_retain(struct operation_context *ctx, size_t nbytes)
+{
+	ctx->ulog_retain_max = nbytes;
+}
+
+/*
+ * operation_ulog_retain -- (internal) returns the capacity of the next ulogs
+ *	which should be kept for reuse by the following operations
+ *
+ * The high watermark of the logged bytes tracks the recent operations and
+ * decays with every finished one, so that the logs allocated by a single
+ * unusually large operation are eventually returned to the heap.
+ */
+static size_t
+operation_ulog_retain(struct operation_context *ctx)
+{
+	if (ctx->ulog_retain_max == 0) {
+		ctx->ulog_retain_hwm = 0;
+		return 0;
+	}
+
+	ctx->ulog_retain_hwm -= ctx->ulog_retain_hwm >>
+		OP_ULOG_RETAIN_DECAY;
+	if (ctx->total_logged > ctx->ulog_retain_hwm)
+		ctx->ulog_retain_hwm = ctx->total_logged;
+
+	if (ctx->ulog_retain_hwm <= ctx->ulog_base_nbytes)
+		return 0;
+
+	return MIN(ctx->ulog_retain_hwm - ctx->ulog_base_nbytes,
+		ctx->ulog_retain_max);
+}
+
 /*
  * operation_set_any_user_buffer -- set ulog_any_user_buffer value for context
  */
@@ -662,8 +922,33 @@ operation_process_persistent_redo(struct operation_context *ctx)
 		ctx->pshadow_ops.offset, ctx->ulog_base_nbytes,
 		&ctx->next, ctx->p_ops);
 
-	ulog_process(ctx->pshadow_ops.ulog, OBJ_OFF_IS_VALID_FROM_CTX,
-		ctx->p_ops);
+	/*
+	 * Both ways of flushing the value entries can be combined with the
+	 * parallel apply, which matters mostly for logs with few, but large,
+	 * buffer entries. The sorted application flushes whole cache lines,
+	 * so it's used only if that is allowed.
+	 */
+	unsigned nthreads = !ctx->ulog_line_flush ? ULOG_APPLY_IN_ORDER :
+		ctx->ulog_parallel_apply ? Ulog_apply_threads : 1;
+
+	if (!ctx->ulog_line_flush || ctx->ndirty_lines > OP_DIRTY_LINES_MAX) {
+		ulog_process(ctx->pshadow_ops.ulog, OBJ_OFF_IS_VALID_FROM_CTX,
+			nthreads, ctx->p_ops);
+	} else {
+		/*
+		 * All of the modified cache lines are known upfront, defer
+		 * the flushes of the individual entries and issue exactly
+		 * one per line. Buffer entries are still flushed by memcpy.
+		 */
+		struct pmem_ops ops = *ctx->p_ops;
+		ops.flush = operation_flush_deferred;
+		ulog_process(ctx->pshadow_ops.ulog, OBJ_OFF_IS_VALID_FROM_CTX,
+			nthreads, &ops);
+
+		for (size_t i = 0; i < ctx->ndirty_lines; ++i)
+			pmemops_xflush(ctx->p_ops, (void *)ctx->dirty_lines[i],
+				CACHELINE_SIZE, PMEMOBJ_F_RELAXED);
+	}
 
 	ulog_clobber(ctx->ulog, &ctx->next, ctx->p_ops);
 }
@@ -676,7 +961,7 @@ operation_process_persistent_undo(struct operation_context *ctx)
 {
 	ASSERTeq(ctx->pshadow_ops.capacity % CACHELINE_SIZE, 0);
 
-	ulog_process(ctx->ulog, OBJ_OFF_IS_VALID_FROM_CTX, ctx->p_ops);
+	ulog_process(ctx->ulog, OBJ_OFF_IS_VALID_FROM_CTX, 1, ctx->p_ops);
 }
 
 /*
@@ -704,6 +989,18 @@ operation_reserve(struct operation_context *ctx, size_t new_capacity)
 	return 0;
 }
 
+/*
+ * operation_reserve_entries -- reserves space in the persistent ulog for
+ *	nbytes worth of entries, in addition to the entries already added to
+ *	the shadow copy of the log
+ */
+int
+operation_reserve_entries(struct operation_context *ctx, size_t nbytes)
+{
+	return operation_reserve(ctx,
+		ctx->pshadow_ops.offset + nbytes + CACHELINE_SIZE);
+}
+
 /*
  * operation_init -- initializes runtime state of an operation
  */
@@ -721,6 +1018,7 @@ operation_init(struct operation_context *ctx)
 	tlog->offset = 0;
 	plog->offset = 0;
 	VECQ_REINIT(&ctx->merge_entries);
+	ctx->ndirty_lines = 0;
 
 	ctx->ulog_curr_offset = 0;
 	ctx->ulog_curr_capacity = 0;
@@ -798,7 +1096,7 @@ operation_process(struct operation_context *ctx)
 
 	/* process transient entries with transient memory ops */
 	if (ctx->transient_ops.offset != 0)
-		ulog_process(ctx->transient_ops.ulog, NULL, &ctx->t_ops);
+		ulog_process(ctx->transient_ops.ulog, NULL, 1, &ctx->t_ops);
 }
 
 /*
@@ -836,7 +1134,7 @@ operation_finish(struct operation_context *ctx, unsigned flags)
 	if (ctx->type == LOG_TYPE_UNDO) {
 		int ret = ulog_clobber_data(ctx->ulog,
 			ctx->total_logged, ctx->ulog_base_nbytes,
-			&ctx->next, ctx->ulog_free,
+			&ctx->next, operation_ulog_retain(ctx), ctx->ulog_free,
 			operation_user_buffer_remove,
 			ctx->p_ops, flags);
 		if (ret == 0)
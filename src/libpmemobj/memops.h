@@ -96,12 +96,19 @@ void operation_add_user_buffer(struct operation_context *ctx,
 		struct user_buffer_def *userbuf);
 void operation_set_auto_reserve(struct operation_context *ctx,
 		int auto_reserve);
+void operation_set_parallel_apply(struct operation_context *ctx,
+	int parallel);
+void operation_set_line_flush(struct operation_context *ctx,
+	int line_flush);
+void operation_set_ulog_retain(struct operation_context *ctx,
+	size_t nbytes);
 void operation_set_any_user_buffer(struct operation_context *ctx,
 	int any_user_buffer);
 int operation_get_any_user_buffer(struct operation_context *ctx);
 int operation_user_buffer_range_cmp(const void *lhs, const void *rhs);
 
 int operation_reserve(struct operation_context *ctx, size_t new_capacity);
+int operation_reserve_entries(struct operation_context *ctx, size_t nbytes);
 void operation_process(struct operation_context *ctx);
 void operation_finish(struct operation_context *ctx, unsigned flags);
 void operation_cancel(struct operation_context *ctx);
@@ -54,6 +54,7 @@
 #include "pmemops.h"
 #include "set.h"
 #include "sync.h"
+#include "tcache.h"
 #include "tx.h"
 #include "sys_util.h"
 
@@ -193,6 +194,7 @@ obj_ctl_init_and_load(PMEMobjpool *pop)
 		pmalloc_ctl_register(pop);
 		stats_ctl_register(pop);
 		debug_ctl_register(pop);
+		lane_ctl_register(pop);
 	}
 
 	char *env_config = os_getenv(OBJ_CONFIG_ENV_VARIABLE);
@@ -306,11 +308,15 @@ obj_init(void)
 	 * subsequent call to this function for individual pools.
 	 */
 	ctl_global_register();
+	pmalloc_global_ctl_register();
+	lane_global_ctl_register();
 
 	if (obj_ctl_init_and_load(NULL))
 		FATAL("error: %s", pmemobj_errormsg());
 
 	lane_info_boot();
+	tx_boot();
+	tcache_boot();
 
 	util_remote_init();
 }
@@ -329,6 +335,8 @@ obj_fini(void)
 		critnib_delete(pools_ht);
 	if (pools_tree)
 		critnib_delete(pools_tree);
+	tx_fini();
+	tcache_fini();
 	lane_info_destroy();
 	util_remote_fini();
 
@@ -884,7 +892,8 @@ obj_runtime_cleanup_common(PMEMobjpool *pop)
  * obj_descr_create -- (internal) create obj pool descriptor
  */
 static int
-obj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
+obj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize,
+	const struct lane_geometry *geometry)
 {
 	LOG(3, "pop %p layout %s poolsize %zu", pop, layout, poolsize);
 
@@ -900,13 +909,14 @@ obj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 	struct pmem_ops *p_ops = &pop->p_ops;
 
 	pop->lanes_offset = OBJ_LANES_OFFSET;
-	pop->nlanes = OBJ_NLANES;
+	if (lane_init_geometry(pop, geometry, poolsize) != 0)
+		return -1;
 
 	/* zero all lanes */
 	lane_init_data(pop);
 
 	pop->heap_offset = pop->lanes_offset +
-		pop->nlanes * sizeof(struct lane_layout);
+		pop->nlanes * OBJ_LANE_SIZE(pop);
 	pop->heap_offset = (pop->heap_offset + Pagesize - 1) & ~(Pagesize - 1);
 
 	size_t heap_size = pop->set->poolsize - pop->heap_offset;
@@ -992,6 +1002,9 @@ obj_descr_check(PMEMobjpool *pop, const char *layout, size_t poolsize)
 		return -1;
 	}
 
+	if (lane_check_geometry(pop) != 0)
+		return -1;
+
 	return 0;
 }
 
@@ -1210,7 +1223,9 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
 
-	pop->lanes_desc.runtime_nlanes = nlanes;
+	/* pools created with a custom geometry might have fewer lanes */
+	pop->lanes_desc.runtime_nlanes = nlanes < pop->nlanes ?
+		nlanes : (unsigned)pop->nlanes;
 
 	pop->tx_params = tx_params_new();
 	if (pop->tx_params == NULL)
@@ -1368,6 +1383,12 @@ pmemobj_createU(const char *path, const char *layout,
 	else
 		adj_pool_attr.features.incompat &= ~POOL_FEAT_SDS;
 
+	/* older versions must not open pools with a different lane layout */
+	struct lane_geometry geometry;
+	lane_geometry_at_create(&geometry);
+	if (!lane_geometry_is_default(&geometry))
+		adj_pool_attr.features.incompat |= POOL_FEAT_LANES;
+
 	if (util_pool_create(&set, path, poolsize, PMEMOBJ_MIN_POOL,
 			PMEMOBJ_MIN_PART, &adj_pool_attr, &runtime_nlanes,
 			REPLICAS_ENABLED) != 0) {
@@ -1407,7 +1428,7 @@ pmemobj_createU(const char *path, const char *layout,
 	pop->set = set;
 
 	/* create pool descriptor */
-	if (obj_descr_create(pop, layout, set->poolsize) != 0) {
+	if (obj_descr_create(pop, layout, set->poolsize, &geometry) != 0) {
 		LOG(2, "creation of pool descriptor failed");
 		goto err;
 	}
@@ -1704,7 +1725,7 @@ obj_replicas_check_basic(PMEMobjpool *pop)
 
 	/* copy lanes */
 	void *src = (void *)((uintptr_t)pop + pop->lanes_offset);
-	size_t len = pop->nlanes * sizeof(struct lane_layout);
+	size_t len = pop->nlanes * OBJ_LANE_SIZE(pop);
 
 	for (unsigned r = 1; r < pop->set->nreplicas; r++) {
 		rep = pop->set->replica[r]->part[0].addr;
@@ -1943,11 +1964,13 @@ obj_pool_cleanup(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	/* waits for the post commit workers, which still use the pool */
+	tx_params_delete(pop->tx_params);
+
 	ravl_delete(pop->ulog_user_buffers.map);
 	util_mutex_destroy(&pop->ulog_user_buffers.lock);
 
 	stats_delete(pop, pop->stats);
-	tx_params_delete(pop->tx_params);
 	ctl_delete(pop->ctl);
 
 	obj_pool_lock_cleanup(pop);
@@ -3039,6 +3062,48 @@ pmemobj_xreserve(PMEMobjpool *pop, struct pobj_action *act,
 	return oid;
 }
 
+/*
+ * pmemobj_xreserve_batch -- reserves a collection of objects of the same size
+ */
+int
+pmemobj_xreserve_batch(PMEMobjpool *pop, struct pobj_action *actv,
+	PMEMoid *oidv, size_t actvcnt, size_t size, uint64_t type_num,
+	uint64_t flags)
+{
+	LOG(3, "pop %p actv %p oidv %p actvcnt %zu size %zu type_num %llx "
+		"flags %llx", pop, actv, oidv, actvcnt, size,
+		(unsigned long long)type_num, (unsigned long long)flags);
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	if (palloc_reserve_batch(&pop->heap, size, constructor_alloc, &carg,
+		type_num, 0, CLASS_ID_FROM_FLAG(flags),
+		ARENA_ID_FROM_FLAG(flags), actv, actvcnt) != 0) {
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	for (size_t i = 0; oidv != NULL && i < actvcnt; ++i) {
+		oidv[i].off = actv[i].heap.offset;
+		oidv[i].pool_uuid_lo = pop->uuid_lo;
+	}
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
 /*
  * pmemobj_set_value -- creates an action to set a value
  */
@@ -3060,18 +3125,18 @@ pmemobj_defer_free(PMEMobjpool *pop, PMEMoid oid, struct pobj_action *act)
 }
 
 /*
- * pmemobj_publish -- publishes a collection of actions
+ * obj_publish -- (internal) publishes a collection of actions
  */
-int
-pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+static int
+obj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
 {
-	PMEMOBJ_API_START();
 	struct operation_context *ctx = pmalloc_operation_hold(pop);
 
 	size_t entries_size = actvcnt * sizeof(struct ulog_entry_val);
 
 	if (operation_reserve(ctx, entries_size) != 0) {
-		PMEMOBJ_API_END();
+		operation_cancel(ctx);
+		pmalloc_operation_release(pop);
 		return -1;
 	}
 
@@ -3079,10 +3144,121 @@ pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
 
 	pmalloc_operation_release(pop);
 
-	PMEMOBJ_API_END();
 	return 0;
 }
 
+/*
+ * pmemobj_publish -- publishes a collection of actions
+ */
+int
+pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+{
+	PMEMOBJ_API_START();
+
+	int ret = obj_publish(pop, actv, actvcnt);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_alloc_batch -- allocates a collection of objects of the same size,
+ *	all published at once
+ */
+int
+pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid *oidv, size_t cnt,
+	size_t size, uint64_t type_num, uint64_t flags)
+{
+	LOG(3, "pop %p oidv %p cnt %zu size %zu type_num %llx flags %llx",
+		pop, oidv, cnt, size, (unsigned long long)type_num,
+		(unsigned long long)flags);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (cnt == 0)
+		return 0;
+
+	if (cnt > SIZE_MAX / (sizeof(struct pobj_action) * 3)) {
+		ERR("too many objects");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/*
+	 * If the destination is in the pool, both fields of each PMEMoid are
+	 * set by additional actions, in the same redo log as the allocations.
+	 */
+	int oidv_in_pool = oidv != NULL && OBJ_PTR_FROM_POOL(pop, oidv);
+	size_t actvcnt = oidv_in_pool ? cnt * 3 : cnt;
+
+	PMEMOBJ_API_START();
+
+	struct pobj_action *actv = Malloc(sizeof(*actv) * actvcnt);
+	if (actv == NULL) {
+		ERR("!Malloc");
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	int ret = palloc_reserve_batch(&pop->heap, size, constructor_alloc,
+		&carg, type_num, 0, CLASS_ID_FROM_FLAG(flags),
+		ARENA_ID_FROM_FLAG(flags), actv, cnt);
+	if (ret != 0)
+		goto out;
+
+	for (size_t i = 0; oidv_in_pool && i < cnt; ++i) {
+		struct pobj_action *oid_actv = &actv[cnt + i * 2];
+		palloc_set_value(&pop->heap, &oid_actv[0],
+			&oidv[i].pool_uuid_lo, pop->uuid_lo);
+		palloc_set_value(&pop->heap, &oid_actv[1],
+			&oidv[i].off, actv[i].heap.offset);
+	}
+
+	/* all objects are published in a single redo log */
+	if ((ret = obj_publish(pop, actv, actvcnt)) != 0) {
+		palloc_cancel(&pop->heap, actv, actvcnt);
+		goto out;
+	}
+
+	/* volatile destination is written only after the publication */
+	for (size_t i = 0; oidv != NULL && !oidv_in_pool && i < cnt; ++i) {
+		oidv[i].off = actv[i].heap.offset;
+		oidv[i].pool_uuid_lo = pop->uuid_lo;
+	}
+
+out:
+	Free(actv);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /*
  * pmemobj_cancel -- cancels collection of actions
  */
@@ -3094,6 +3270,68 @@ pmemobj_cancel(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
 	PMEMOBJ_API_END();
 }
 
+/*
+ * pmemobj_defrag -- relocates the objects out of sparsely populated runs and
+ *	updates the provided references to them
+ */
+int
+pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	struct pobj_defrag_result *result)
+{
+	LOG(3, "pop %p oidv %p oidcnt %zu result %p", pop, oidv, oidcnt,
+		result);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	struct pobj_defrag_result r = {0, 0};
+
+	if (result != NULL)
+		*result = r;
+
+	if (oidcnt == 0)
+		return 0;
+
+	PMEMOBJ_API_START();
+
+	uint64_t **objv = Malloc(sizeof(*objv) * oidcnt);
+	if (objv == NULL) {
+		ERR("!Malloc");
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	int ret = -1;
+	size_t objcnt = 0;
+	for (size_t i = 0; i < oidcnt; ++i) {
+		if (OBJ_OID_IS_NULL(*oidv[i]))
+			continue;
+
+		if (oidv[i]->pool_uuid_lo != pop->uuid_lo) {
+			ERR("not all PMEMoids belong to the provided pool");
+			errno = EINVAL;
+			goto out;
+		}
+
+		objv[objcnt++] = &oidv[i]->off;
+	}
+
+	struct operation_context *ctx = pmalloc_operation_hold_no_start(pop);
+
+	ret = palloc_defrag(&pop->heap, objv, objcnt, ctx, &r);
+
+	pmalloc_operation_release(pop);
+
+	if (result != NULL)
+		*result = r;
+
+out:
+	Free(objv);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /*
  * pmemobj_list_insert -- adds object to a list
  */
@@ -74,11 +74,43 @@ static const features_t obj_format_feat_default = OBJ_FORMAT_FEAT_CHECK;
 /* size of the persistent part of PMEMOBJ pool descriptor (2kB) */
 #define OBJ_DSC_P_SIZE		2048
 /* size of unused part of the persistent part of PMEMOBJ pool descriptor */
-#define OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 40)
+#define OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 64)
 
 #define OBJ_LANES_OFFSET	8192	/* lanes offset (8kB) */
 #define OBJ_NLANES		1024	/* number of lanes */
 
+/*
+ * Capacities of the logs of a single lane. Pools created with the default
+ * lane geometry have zeros stored in the pool descriptor.
+ */
+#define OBJ_LANE_REDO_INTERNAL_SIZE(pop)\
+	((pop)->lane_redo_internal_size != 0 ?\
+	(pop)->lane_redo_internal_size : LANE_REDO_INTERNAL_SIZE)
+#define OBJ_LANE_REDO_EXTERNAL_SIZE(pop)\
+	((pop)->lane_redo_external_size != 0 ?\
+	(pop)->lane_redo_external_size : LANE_REDO_EXTERNAL_SIZE)
+#define OBJ_LANE_UNDO_SIZE(pop)\
+	((pop)->lane_undo_size != 0 ?\
+	(pop)->lane_undo_size : LANE_UNDO_SIZE)
+
+/* size of a single lane, the logs are laid out as in struct lane_layout */
+#define OBJ_LANE_SIZE(pop)\
+	(SIZEOF_ULOG(OBJ_LANE_REDO_INTERNAL_SIZE(pop)) +\
+	SIZEOF_ULOG(OBJ_LANE_REDO_EXTERNAL_SIZE(pop)) +\
+	SIZEOF_ULOG(OBJ_LANE_UNDO_SIZE(pop)))
+
+#define OBJ_LANE_LAYOUT(pop, idx)\
+	((void *)((uintptr_t)(pop) + (pop)->lanes_offset +\
+	OBJ_LANE_SIZE(pop) * (idx)))
+#define OBJ_LANE_REDO_INTERNAL(pop, layout)\
+	((struct ulog *)(layout))
+#define OBJ_LANE_REDO_EXTERNAL(pop, layout)\
+	((struct ulog *)((uintptr_t)(layout) +\
+	SIZEOF_ULOG(OBJ_LANE_REDO_INTERNAL_SIZE(pop))))
+#define OBJ_LANE_UNDO(pop, layout)\
+	((struct ulog *)((uintptr_t)OBJ_LANE_REDO_EXTERNAL(pop, layout) +\
+	SIZEOF_ULOG(OBJ_LANE_REDO_EXTERNAL_SIZE(pop))))
+
 #define OBJ_OFF_TO_PTR(pop, off) ((void *)((uintptr_t)(pop) + (off)))
 #define OBJ_PTR_TO_OFF(pop, ptr) ((uintptr_t)(ptr) - (uintptr_t)(pop))
 #define OBJ_OID_IS_NULL(oid)	((oid).off == 0)
@@ -89,7 +121,7 @@ static const features_t obj_format_feat_default = OBJ_FORMAT_FEAT_CHECK;
 #define OBJ_OFF_FROM_LANES(pop, off)\
 	((off) >= (pop)->lanes_offset &&\
 	(off) < (pop)->lanes_offset +\
-	(pop)->nlanes * sizeof(struct lane_layout))
+	(pop)->nlanes * OBJ_LANE_SIZE(pop))
 
 #define OBJ_PTR_FROM_POOL(pop, ptr)\
 	((uintptr_t)(ptr) >= (uintptr_t)(pop) &&\
@@ -131,6 +163,10 @@ struct pmemobjpool {
 	uint64_t nlanes;
 	uint64_t heap_offset;
 	uint64_t unused3;
+	/* lane log capacities, zero for the defaults (see POOL_FEAT_LANES) */
+	uint64_t lane_redo_internal_size;
+	uint64_t lane_redo_external_size;
+	uint64_t lane_undo_size;
 	unsigned char unused[OBJ_DSC_P_UNUSED]; /* must be zero */
 	uint64_t checksum;	/* checksum of above fields */
 
@@ -212,7 +248,7 @@ struct pmemobjpool {
 
 	/* padding to align size of this structure to page boundary */
 	/* sizeof(unused2) == 8192 - offsetof(struct pmemobjpool, unused2) */
-	char unused2[924];
+	char unused2[824];
 };
 
 /*
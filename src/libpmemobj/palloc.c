@@ -64,6 +64,7 @@
 #include "out.h"
 #include "sys_util.h"
 #include "palloc.h"
+#include "tcache.h"
 
 struct pobj_action_internal {
 	/* type of operation (alloc/free vs set) */
@@ -175,33 +176,47 @@ alloc_prep_block(struct palloc_heap *heap, const struct memory_block *m,
 }
 
 /*
- * palloc_reservation_create -- creates a volatile reservation of a
- *	memory block.
- *
- * The first step in the allocation of a new block is reserving it in
- * the transient heap - which is represented by the bucket abstraction.
- *
- * To provide optimal scaling for multi-threaded applications and reduce
- * fragmentation the appropriate bucket is chosen depending on the
- * current thread context and to which allocation class the requested
- * size falls into.
+ * palloc_reservation_create_cached -- (internal) creates a volatile reservation
+ *	of a single unit memory block taken from the thread cache
  *
- * Once the bucket is selected, just enough memory is reserved for the
- * requested size. The underlying block allocation algorithm
- * (best-fit, next-fit, ...) varies depending on the bucket container.
+ * The block is already reserved, it doesn't require the bucket lock.
  */
 static int
-palloc_reservation_create(struct palloc_heap *heap, size_t size,
-	palloc_constr constructor, void *arg,
+palloc_reservation_create_cached(struct palloc_heap *heap, struct tcache *tc,
+	struct alloc_class *c, palloc_constr constructor, void *arg,
 	uint64_t extra_field, uint16_t object_flags,
-	uint16_t class_id, uint16_t arena_id,
 	struct pobj_action_internal *out)
 {
-	int err = 0;
-
 	struct memory_block *new_block = &out->m;
 	out->type = POBJ_ACTION_TYPE_HEAP;
 
+	int err = tcache_get(tc, c, new_block, &out->mresv);
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+
+	if (alloc_prep_block(heap, new_block, constructor, arg,
+		extra_field, object_flags, &out->offset) != 0) {
+		tcache_put(tc, c, new_block, out->mresv);
+		errno = ECANCELED;
+		return -1;
+	}
+
+	out->lock = new_block->m_ops->get_lock(new_block);
+	out->new_state = MEMBLOCK_ALLOCATED;
+
+	return 0;
+}
+
+/*
+ * palloc_reservation_class -- (internal) returns the allocation class for
+ *	the reservation and the number of its units the reservation takes
+ */
+static struct alloc_class *
+palloc_reservation_class(struct palloc_heap *heap, size_t size,
+	uint16_t class_id, uint32_t *size_idx)
+{
 	ASSERT(class_id < UINT8_MAX);
 	struct alloc_class *c = class_id == 0 ?
 		heap_get_best_class(heap, size) :
@@ -211,7 +226,7 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	if (c == NULL) {
 		ERR("no allocation class for size %lu bytes", size);
 		errno = EINVAL;
-		return -1;
+		return NULL;
 	}
 
 	/*
@@ -222,22 +237,38 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	 * For example, to allocate 500 bytes from a bucket that
 	 * provides 256 byte blocks two memory 'units' are required.
 	 */
-	ssize_t size_idx = alloc_class_calc_size_idx(c, size);
-	if (size_idx < 0) {
+	ssize_t sidx = alloc_class_calc_size_idx(c, size);
+	if (sidx < 0) {
 		ERR("allocation class not suitable for size %lu bytes",
 			size);
 		errno = EINVAL;
-		return -1;
+		return NULL;
 	}
-	ASSERT(size_idx <= UINT32_MAX);
-	*new_block = MEMORY_BLOCK_NONE;
-	new_block->size_idx = (uint32_t)size_idx;
+	ASSERT(sidx <= UINT32_MAX);
+	*size_idx = (uint32_t)sidx;
 
-	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
+	return c;
+}
 
-	err = heap_get_bestfit_block(heap, b, new_block);
+/*
+ * palloc_reservation_create_locked -- (internal) reserves a memory block
+ *	from an already acquired bucket, returns an error number on failure
+ */
+static int
+palloc_reservation_create_locked(struct palloc_heap *heap, struct bucket *b,
+	uint32_t size_idx, palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	struct pobj_action_internal *out)
+{
+	struct memory_block *new_block = &out->m;
+	out->type = POBJ_ACTION_TYPE_HEAP;
+
+	*new_block = MEMORY_BLOCK_NONE;
+	new_block->size_idx = size_idx;
+
+	int err = heap_get_bestfit_block(heap, b, new_block);
 	if (err != 0)
-		goto out;
+		return err;
 
 	if (alloc_prep_block(heap, new_block, constructor, arg,
 		extra_field, object_flags, &out->offset) != 0) {
@@ -248,8 +279,7 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 		if (new_block->type == MEMORY_BLOCK_HUGE) {
 			bucket_insert_block(b, new_block);
 		}
-		err = ECANCELED;
-		goto out;
+		return ECANCELED;
 	}
 
 	/*
@@ -264,7 +294,56 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	out->lock = new_block->m_ops->get_lock(new_block);
 	out->new_state = MEMBLOCK_ALLOCATED;
 
-out:
+	return 0;
+}
+
+/*
+ * palloc_reservation_create -- creates a volatile reservation of a
+ *	memory block.
+ *
+ * The first step in the allocation of a new block is reserving it in
+ * the transient heap - which is represented by the bucket abstraction.
+ *
+ * To provide optimal scaling for multi-threaded applications and reduce
+ * fragmentation the appropriate bucket is chosen depending on the
+ * current thread context and to which allocation class the requested
+ * size falls into.
+ *
+ * Once the bucket is selected, just enough memory is reserved for the
+ * requested size. The underlying block allocation algorithm
+ * (best-fit, next-fit, ...) varies depending on the bucket container.
+ */
+static int
+palloc_reservation_create(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action_internal *out)
+{
+	uint32_t size_idx;
+	struct alloc_class *c = palloc_reservation_class(heap, size,
+		class_id, &size_idx);
+	if (c == NULL)
+		return -1;
+
+	if (class_id == 0)
+		heap_histogram_record(heap, size, 1);
+
+	/*
+	 * Small allocations from the arena of the calling thread are served
+	 * from the thread cache, if enabled.
+	 */
+	struct tcache *tc = heap_tcache(heap);
+	if (size_idx == 1 && c->type == CLASS_RUN &&
+	    arena_id == HEAP_ARENA_PER_THREAD && tcache_is_enabled(tc))
+		return palloc_reservation_create_cached(heap, tc, c,
+			constructor, arg, extra_field, object_flags, out);
+
+	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
+
+	int err = palloc_reservation_create_locked(heap, b, size_idx,
+		constructor, arg, extra_field, object_flags, out);
+
 	heap_bucket_release(heap, b);
 
 	if (err == 0)
@@ -344,41 +423,7 @@ palloc_reservation_clear(struct palloc_heap *heap,
 	if (act->mresv == NULL)
 		return;
 
-	struct memory_block_reserved *mresv = act->mresv;
-	struct bucket *b = mresv->bucket;
-
-	if (!publish) {
-		util_mutex_lock(&b->lock);
-		struct memory_block *am = &b->active_memory_block->m;
-
-		/*
-		 * If a memory block used for the action is the currently active
-		 * memory block of the bucket it can be inserted back to the
-		 * bucket. This way it will be available for future allocation
-		 * requests, improving performance.
-		 */
-		if (b->is_active &&
-		    am->chunk_id == act->m.chunk_id &&
-		    am->zone_id == act->m.zone_id) {
-			ASSERTeq(b->active_memory_block, mresv);
-			bucket_insert_block(b, &act->m);
-		}
-
-		util_mutex_unlock(&b->lock);
-	}
-
-	if (util_fetch_and_sub64(&mresv->nresv, 1) == 1) {
-		VALGRIND_ANNOTATE_HAPPENS_AFTER(&mresv->nresv);
-		/*
-		 * If the memory block used for the action is not currently used
-		 * in any bucket nor action it can be discarded (given back to
-		 * the heap).
-		 */
-		heap_discard_run(heap, &mresv->m);
-		Free(mresv);
-	} else {
-		VALGRIND_ANNOTATE_HAPPENS_BEFORE(&mresv->nresv);
-	}
+	heap_reservation_clear(heap, &act->m, act->mresv, publish);
 }
 
 /*
@@ -605,6 +650,52 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 		(struct pobj_action_internal *)act);
 }
 
+/*
+ * palloc_reserve_batch -- creates a collection of reservations of the same
+ *	size, all taken from a single bucket acquired once
+ *
+ * Either all of the reservations are created, or none of them.
+ */
+int
+palloc_reserve_batch(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action *actv, size_t actvcnt)
+{
+	uint32_t size_idx;
+	struct alloc_class *c = palloc_reservation_class(heap, size,
+		class_id, &size_idx);
+	if (c == NULL)
+		return -1;
+
+	if (class_id == 0)
+		heap_histogram_record(heap, size, actvcnt);
+
+	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
+
+	int err = 0;
+	size_t i;
+	for (i = 0; i < actvcnt; ++i) {
+		err = palloc_reservation_create_locked(heap, b, size_idx,
+			constructor, arg, extra_field, object_flags,
+			(struct pobj_action_internal *)&actv[i]);
+		if (err != 0)
+			break;
+	}
+
+	heap_bucket_release(heap, b);
+
+	if (err == 0)
+		return 0;
+
+	/* the bucket has to be released before canceling the reservations */
+	palloc_cancel(heap, actv, i);
+
+	errno = err;
+	return -1;
+}
+
 /*
  * palloc_defer_free -- creates an internal deferred free action
  */
@@ -667,6 +758,335 @@ palloc_publish(struct palloc_heap *heap,
 		(struct pobj_action_internal *)actv, actvcnt);
 }
 
+/*
+ * Objects are moved only out of the runs with at most this percentage of
+ * units allocated, and only into the runs that are at least as full.
+ */
+#define PALLOC_DEFRAG_RUN_FILL_PCT 50
+
+/* maximum number of objects relocated with a single redo log */
+#define PALLOC_DEFRAG_BATCH 128
+
+/* a reference to an object, provided for defragmentation */
+struct palloc_defrag_ref {
+	uint64_t *ptr; /* location of the reference */
+	uint64_t off; /* offset of the object at the start of defragmentation */
+};
+
+/* a relocated object */
+struct palloc_defrag_reloc {
+	uint64_t old_off; /* offset of the object before relocation */
+	uint64_t new_off; /* offset of the object after relocation */
+	size_t size; /* usable size of the object */
+};
+
+/*
+ * palloc_defrag_ref_compare -- (internal) orders the references by the offsets
+ *	of their objects, in descending order
+ */
+static int
+palloc_defrag_ref_compare(const void *lhs, const void *rhs)
+{
+	const struct palloc_defrag_ref *l = lhs;
+	const struct palloc_defrag_ref *r = rhs;
+
+	if (l->off > r->off)
+		return -1;
+	if (l->off < r->off)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * palloc_defrag_fill_pct -- (internal) returns the percentage of allocated
+ *	units of the run in which the memory block resides
+ */
+static unsigned
+palloc_defrag_fill_pct(const struct memory_block *m)
+{
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+
+	util_mutex_lock(lock);
+	unsigned fill_pct = m->m_ops->fill_pct(m);
+	util_mutex_unlock(lock);
+
+	return fill_pct;
+}
+
+/*
+ * palloc_defrag_run_class -- (internal) returns the allocation class of the
+ *	run in which the memory block resides
+ */
+static struct alloc_class *
+palloc_defrag_run_class(struct palloc_heap *heap, const struct memory_block *m)
+{
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
+	struct chunk_run *run = heap_get_chunk_run(heap, m);
+
+	return alloc_class_by_run(heap_alloc_classes(heap),
+		run->hdr.block_size, hdr->flags, hdr->size_idx);
+}
+
+/*
+ * palloc_defrag_reserve -- (internal) reserves a new block for the object in
+ *	a run that is at least as full as the one the object resides in
+ *
+ * Returns ECANCELED if there's no such run, or an error number if the
+ * reservation failed.
+ */
+static int
+palloc_defrag_reserve(struct palloc_heap *heap, const struct memory_block *m,
+	struct alloc_class *c, unsigned fill_pct, uint16_t arena_id,
+	struct pobj_action_internal *act)
+{
+	size_t size = m->m_ops->get_user_size(m);
+
+	for (int attempt = 0; ; ++attempt) {
+		if (palloc_reservation_create(heap, size, NULL, NULL,
+		    m->m_ops->get_extra(m), m->m_ops->get_flags(m),
+		    c->id, arena_id, act) != 0)
+			return errno;
+
+		/* moving an object into the same, or a sparser, run is moot */
+		const struct memory_block *nm = &act->m;
+		int same_run = nm->zone_id == m->zone_id &&
+			nm->chunk_id == m->chunk_id;
+		if (!same_run && palloc_defrag_fill_pct(nm) >= fill_pct)
+			return 0;
+
+		action_funcs[act->type].on_cancel(heap, act);
+
+		if (attempt != 0)
+			return ECANCELED;
+
+		/* the active run is sparse, try the fullest one instead */
+		heap_bucket_detach_run(heap, c->id, arena_id);
+	}
+}
+
+/*
+ * palloc_defrag_translate -- (internal) returns the location of a reference
+ *	which takes into account the relocation of the object it resides in
+ *
+ * The relocations are sorted by the original offsets, in descending order.
+ */
+static uint64_t *
+palloc_defrag_translate(struct palloc_heap *heap,
+	const struct palloc_defrag_reloc *relocv, size_t reloccnt,
+	uint64_t *ptr)
+{
+	/* references outside of the heap yield offsets that match nothing */
+	uint64_t off = HEAP_PTR_TO_OFF(heap, ptr);
+
+	/* find the first relocation that starts at, or below, the reference */
+	size_t lo = 0;
+	size_t hi = reloccnt;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (relocv[mid].old_off > off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == reloccnt || off - relocv[lo].old_off >= relocv[lo].size)
+		return ptr;
+
+	return HEAP_OFF_TO_PTR(heap,
+		relocv[lo].new_off + (off - relocv[lo].old_off));
+}
+
+/*
+ * palloc_defrag_publish -- (internal) copies the objects relocated in this
+ *	batch and atomically publishes their new locations
+ */
+static int
+palloc_defrag_publish(struct palloc_heap *heap,
+	struct pobj_action_internal *actv, size_t actvcnt,
+	const struct palloc_defrag_reloc *relocv, size_t reloccnt,
+	size_t batch_first, struct operation_context *ctx)
+{
+	/*
+	 * References residing in the relocated objects have to be updated in
+	 * their new locations, and only after the objects are copied.
+	 */
+	for (size_t i = 0; i < actvcnt; ++i) {
+		if (actv[i].type == POBJ_ACTION_TYPE_MEM)
+			actv[i].ptr = palloc_defrag_translate(heap,
+				relocv, reloccnt, actv[i].ptr);
+	}
+
+	/* the copies are drained before the redo log is processed */
+	for (size_t i = batch_first; i < reloccnt; ++i) {
+		pmemops_memcpy(&heap->p_ops,
+			HEAP_OFF_TO_PTR(heap, relocv[i].new_off),
+			HEAP_OFF_TO_PTR(heap, relocv[i].old_off),
+			relocv[i].size, PMEMOBJ_F_MEM_NODRAIN);
+	}
+
+	operation_start(ctx);
+
+	if (operation_reserve(ctx,
+	    actvcnt * sizeof(struct ulog_entry_val)) != 0) {
+		operation_cancel(ctx);
+		return -1;
+	}
+
+	palloc_exec_actions(heap, ctx, actv, actvcnt);
+
+	return 0;
+}
+
+/*
+ * palloc_defrag -- relocates the objects out of sparsely populated runs
+ *	and updates all of the provided references to them
+ *
+ * The references are processed in descending order of the offsets of their
+ * objects. This places the references to the same object next to each other
+ * and tends to move the objects towards the beginning of the heap.
+ *
+ * Each relocation is a reservation of a new block in a fuller run of the same
+ * allocation class, a deferred free of the old block and updates of the
+ * references, and these are published in batches, each in a single redo log.
+ * The objects are copied only right before their batch is published, so that
+ * the references which reside in them are carried over.
+ *
+ * The operation context must be held, but not started.
+ */
+int
+palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
+	struct operation_context *ctx, struct pobj_defrag_result *result)
+{
+	if (objcnt == 0)
+		return 0;
+
+	struct palloc_defrag_ref *refv = Malloc(sizeof(*refv) * objcnt);
+	if (refv == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	for (size_t i = 0; i < objcnt; ++i) {
+		refv[i].ptr = objv[i];
+		refv[i].off = *objv[i];
+	}
+
+	qsort(refv, objcnt, sizeof(*refv), palloc_defrag_ref_compare);
+
+	int ret = -1;
+	VEC(, struct pobj_action_internal) actv = VEC_INITIALIZER;
+	VEC(, struct palloc_defrag_reloc) relocv = VEC_INITIALIZER;
+	size_t batch_first = 0;
+
+	/*
+	 * The reservations are made directly from the bucket of the calling
+	 * thread's arena, bypassing its cache, so that the bucket can be made
+	 * to refill from a fuller run.
+	 */
+	uint16_t arena_id = (uint16_t)heap_get_thread_arena_id(heap);
+
+	struct pobj_action_internal act;
+	uint64_t new_off = 0; /* zero if the object wasn't relocated */
+
+	for (size_t i = 0; i < objcnt; ++i) {
+		uint64_t off = refv[i].off;
+
+		if (i != 0 && off == refv[i - 1].off) {
+			if (new_off == 0)
+				continue;
+
+			palloc_set_value(heap, (struct pobj_action *)&act,
+				refv[i].ptr, new_off);
+			if (VEC_PUSH_BACK(&actv, act) != 0)
+				goto out;
+
+			continue;
+		}
+
+		new_off = 0;
+		if (off == 0)
+			continue;
+
+		result->total++;
+
+		size_t nrelocs = VEC_SIZE(&relocv) - batch_first;
+		if (nrelocs == PALLOC_DEFRAG_BATCH) {
+			if (palloc_defrag_publish(heap, VEC_ARR(&actv),
+			    VEC_SIZE(&actv), VEC_ARR(&relocv),
+			    VEC_SIZE(&relocv), batch_first, ctx) != 0)
+				goto out;
+
+			VEC_CLEAR(&actv);
+			batch_first = VEC_SIZE(&relocv);
+			result->relocated += nrelocs;
+		}
+
+		struct memory_block m = memblock_from_offset(heap, off);
+		if (m.type != MEMORY_BLOCK_RUN)
+			continue;
+
+		unsigned fill_pct = palloc_defrag_fill_pct(&m);
+		if (fill_pct > PALLOC_DEFRAG_RUN_FILL_PCT)
+			continue;
+
+		struct alloc_class *c = palloc_defrag_run_class(heap, &m);
+		if (c == NULL)
+			continue;
+
+		int err = palloc_defrag_reserve(heap, &m, c, fill_pct,
+			arena_id, &act);
+		if (err == ENOMEM) /* no room left to relocate objects into */
+			break;
+		if (err != 0)
+			continue;
+
+		size_t size = m.m_ops->get_user_size(&m);
+		if (VEC_PUSH_BACK(&actv, act) != 0) {
+			action_funcs[act.type].on_cancel(heap, &act);
+			goto out;
+		}
+
+		struct palloc_defrag_reloc reloc = {off, act.offset, size};
+		if (VEC_PUSH_BACK(&relocv, reloc) != 0)
+			goto out;
+
+		new_off = act.offset;
+
+		palloc_defer_free_create(heap, off, &act);
+		if (VEC_PUSH_BACK(&actv, act) != 0)
+			goto out;
+
+		palloc_set_value(heap, (struct pobj_action *)&act,
+			refv[i].ptr, new_off);
+		if (VEC_PUSH_BACK(&actv, act) != 0)
+			goto out;
+	}
+
+	if (VEC_SIZE(&actv) != 0) {
+		if (palloc_defrag_publish(heap, VEC_ARR(&actv),
+		    VEC_SIZE(&actv), VEC_ARR(&relocv),
+		    VEC_SIZE(&relocv), batch_first, ctx) != 0)
+			goto out;
+
+		VEC_CLEAR(&actv);
+		result->relocated += VEC_SIZE(&relocv) - batch_first;
+	}
+
+	ret = 0;
+
+out:
+	/* the reservations of a batch that failed to publish are canceled */
+	palloc_cancel(heap, (struct pobj_action *)VEC_ARR(&actv),
+		VEC_SIZE(&actv));
+
+	VEC_DELETE(&relocv);
+	VEC_DELETE(&actv);
+	Free(refv);
+
+	return ret;
+}
+
 /*
  * palloc_operation -- persistent memory operation. Takes a NULL pointer
  *	or an existing memory block and modifies it to occupy, at least, 'size'
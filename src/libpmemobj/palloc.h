@@ -85,6 +85,13 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 	uint16_t class_id, uint16_t arena_id,
 	struct pobj_action *act);
 
+int
+palloc_reserve_batch(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action *actv, size_t actvcnt);
+
 void
 palloc_defer_free(struct palloc_heap *heap, uint64_t off,
 	struct pobj_action *act);
@@ -102,6 +109,10 @@ void
 palloc_set_value(struct palloc_heap *heap, struct pobj_action *act,
 	uint64_t *ptr, uint64_t value);
 
+int
+palloc_defrag(struct palloc_heap *heap, uint64_t **objv, size_t objcnt,
+	struct operation_context *ctx, struct pobj_defrag_result *result);
+
 uint64_t palloc_first(struct palloc_heap *heap);
 uint64_t palloc_next(struct palloc_heap *heap, uint64_t off);
 
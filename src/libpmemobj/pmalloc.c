@@ -50,6 +50,7 @@
 #include "pmalloc.h"
 #include "alloc_class.h"
 #include "set.h"
+#include "tcache.h"
 #include "mmap.h"
 
 enum pmalloc_operation_type {
@@ -235,6 +236,26 @@ pmalloc_cleanup(PMEMobjpool *pop)
 	return 0;
 }
 
+/*
+ * pmalloc_header_type -- (internal) converts the header type of the public
+ *	interface into the internal one, returns MAX_HEADER_TYPES if invalid
+ */
+static enum header_type
+pmalloc_header_type(enum pobj_header_type htype)
+{
+	switch (htype) {
+		case POBJ_HEADER_LEGACY:
+			return HEADER_LEGACY;
+		case POBJ_HEADER_COMPACT:
+			return HEADER_COMPACT;
+		case POBJ_HEADER_NONE:
+			return HEADER_NONE;
+		case MAX_POBJ_HEADER_TYPES:
+		default:
+			return MAX_HEADER_TYPES;
+	}
+}
+
 /*
  * CTL_WRITE_HANDLER(desc) -- creates a new allocation class
  */
@@ -265,22 +286,11 @@ CTL_WRITE_HANDLER(desc)(void *ctx,
 		return -1;
 	}
 
-	enum header_type lib_htype = MAX_HEADER_TYPES;
-	switch (p->header_type) {
-		case POBJ_HEADER_LEGACY:
-			lib_htype = HEADER_LEGACY;
-			break;
-		case POBJ_HEADER_COMPACT:
-			lib_htype = HEADER_COMPACT;
-			break;
-		case POBJ_HEADER_NONE:
-			lib_htype = HEADER_NONE;
-			break;
-		case MAX_POBJ_HEADER_TYPES:
-		default:
-			ERR("invalid header type");
-			errno = EINVAL;
-			return -1;
+	enum header_type lib_htype = pmalloc_header_type(p->header_type);
+	if (lib_htype == MAX_HEADER_TYPES) {
+		ERR("invalid header type");
+		errno = EINVAL;
+		return -1;
 	}
 
 	if (PMDK_SLIST_EMPTY(indexes)) {
@@ -447,9 +457,185 @@ static const struct ctl_node CTL_NODE(new)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(enabled, histogram) -- reads whether the allocation sizes
+ *	are recorded
+ */
+static int
+CTL_READ_HANDLER(enabled, histogram)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = heap_histogram_is_enabled(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled, histogram) -- enables or disables recording of
+ *	the allocation sizes
+ */
+static int
+CTL_WRITE_HANDLER(enabled, histogram)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	heap_histogram_set_enabled(&pop->heap, arg_in);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(reset) -- clears the histogram of allocation sizes
+ */
+static int
+CTL_RUNNABLE_HANDLER(reset)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	heap_histogram_reset(&pop->heap);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(histogram)[] = {
+	CTL_LEAF_RW(enabled, histogram),
+	CTL_LEAF_RUNNABLE(reset),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmalloc_propose_classes -- (internal) proposes the allocation classes for
+ *	the allocation sizes recorded in the histogram
+ */
+static int
+pmalloc_propose_classes(PMEMobjpool *pop,
+	struct pobj_alloc_class_proposal *p)
+{
+	uint64_t histogram[ALLOC_HISTOGRAM_NBINS];
+	heap_histogram_get(&pop->heap, histogram);
+
+	size_t unit_sizes[POBJ_MAX_PROPOSED_ALLOC_CLASSES];
+	int nclasses = alloc_class_propose(histogram,
+		POBJ_MAX_PROPOSED_ALLOC_CLASSES, unit_sizes,
+		&p->waste_proposed);
+	if (nclasses < 0)
+		return -1;
+
+	p->nclasses = (unsigned)nclasses;
+	for (unsigned i = 0; i < p->nclasses; ++i) {
+		struct pobj_alloc_class_desc *d = &p->classes[i];
+		d->unit_size = unit_sizes[i];
+		d->alignment = 0;
+		d->units_per_block =
+			alloc_class_calc_run_nallocs(unit_sizes[i]);
+		d->header_type = POBJ_HEADER_COMPACT;
+		d->class_id = 0;
+	}
+
+	p->waste_current = alloc_class_histogram_waste(
+		heap_alloc_classes(&pop->heap), histogram);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(proposal) -- proposes the allocation classes which
+ *	minimize the internal fragmentation of the recorded allocation sizes
+ */
+static int
+CTL_READ_HANDLER(proposal)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	return pmalloc_propose_classes(pop, arg);
+}
+
+/*
+ * CTL_WRITE_HANDLER(desc, tune) -- creates a new allocation class, or reuses
+ *	an existing one, and makes it handle the allocation sizes it fits best
+ */
+static int
+CTL_WRITE_HANDLER(desc, tune)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct alloc_class_collection *ac = heap_alloc_classes(&pop->heap);
+	struct pobj_alloc_class_desc *p = arg;
+
+	enum header_type lib_htype = pmalloc_header_type(p->header_type);
+	if (lib_htype == MAX_HEADER_TYPES || lib_htype == HEADER_NONE) {
+		ERR("invalid header type of a tuned class");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (p->unit_size <= header_type_to_size[lib_htype]) {
+		ERR("unit size of a tuned class must exceed its header");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct alloc_class *c = p->alignment == 0 ?
+		alloc_class_by_unit_size(ac, p->unit_size, lib_htype) : NULL;
+	if (c == NULL) {
+		if (CTL_WRITE_HANDLER(desc)(ctx, source, arg, indexes) != 0)
+			return -1;
+
+		c = alloc_class_by_id(ac, (uint8_t)p->class_id);
+	} else {
+		p->class_id = c->id;
+		p->units_per_block = c->run.nallocs;
+	}
+
+	return alloc_class_tune(ac, c);
+}
+
+/*
+ * CTL_RUNNABLE_HANDLER(apply) -- creates and tunes the proposed allocation
+ *	classes
+ */
+static int
+CTL_RUNNABLE_HANDLER(apply)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_alloc_class_proposal p;
+
+	if (pmalloc_propose_classes(pop, &p) != 0)
+		return -1;
+
+	for (unsigned i = 0; i < p.nclasses; ++i) {
+		if (CTL_WRITE_HANDLER(desc, tune)(ctx, source,
+				&p.classes[i], indexes) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(tune)[] = {
+	CTL_LEAF_RO(proposal),
+	CTL_LEAF_RUNNABLE(apply),
+	CTL_LEAF_WO(desc, tune),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(alloc_class)[] = {
 	CTL_INDEXED(class_id),
 	CTL_INDEXED(new),
+	CTL_CHILD(histogram),
+	CTL_CHILD(tune),
 
 	CTL_NODE_END
 };
@@ -704,6 +890,39 @@ CTL_READ_HANDLER(automatic)(void *ctx,
 
 static struct ctl_argument CTL_ARG(automatic) = CTL_ARG_BOOLEAN;
 
+/*
+ * CTL_READ_HANDLER(numa_node) -- reads the NUMA node the arena is bound to
+ */
+static int
+CTL_READ_HANDLER(numa_node)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+	unsigned arena_id;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+	arena_id = (unsigned)idx->value;
+
+	unsigned narenas = heap_get_narenas_total(&pop->heap);
+
+	/*
+	 * check if index is not bigger than number of arenas
+	 * or if it is not equal zero
+	 */
+	if (arena_id < 1 || arena_id > narenas) {
+		LOG(1, "arena id outside of the allowed range: <1,%u>",
+			narenas);
+		errno = ERANGE;
+		return -1;
+	}
+
+	*arg_out = heap_get_arena_numa_node(&pop->heap, arena_id);
+
+	return 0;
+}
+
 static const struct ctl_node CTL_NODE(size)[] = {
 	CTL_LEAF_RW(granularity),
 	CTL_LEAF_RUNNABLE(extend),
@@ -779,9 +998,229 @@ CTL_RUNNABLE_HANDLER(create)(void *ctx,
 	return 0;
 }
 
+/*
+ * CTL_READ_HANDLER(enabled) -- reads whether the thread caches are enabled
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = tcache_is_enabled(heap_tcache(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- enables or disables the thread caches
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	tcache_set_enabled(heap_tcache(&pop->heap), arg_in);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(batch_size) -- reads the number of blocks reserved at once
+ *	by a thread cache
+ */
+static int
+CTL_READ_HANDLER(batch_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = (int)tcache_get_batch_size(heap_tcache(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(batch_size) -- sets the number of blocks reserved at once
+ *	by a thread cache
+ */
+static int
+CTL_WRITE_HANDLER(batch_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 1 || arg_in > TCACHE_BATCH_SIZE_MAX) {
+		ERR("incorrect tcache batch size, must be between 1 and %d",
+			TCACHE_BATCH_SIZE_MAX);
+		errno = EINVAL;
+		return -1;
+	}
+
+	tcache_set_batch_size(heap_tcache(&pop->heap), (unsigned)arg_in);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(batch_size) = CTL_ARG_INT;
+
+/*
+ * CTL_RUNNABLE_HANDLER(drain) -- gives back the blocks cached by the calling
+ *	thread
+ */
+static int
+CTL_RUNNABLE_HANDLER(drain)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	tcache_drain(heap_tcache(&pop->heap));
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(tcache)[] = {
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RW(batch_size),
+	CTL_LEAF_RUNNABLE(drain),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(interval_ms) -- reads the time between the passes of the
+ *	background reclaimer
+ */
+static int
+CTL_READ_HANDLER(interval_ms)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int *arg_out = arg;
+
+	*arg_out = (int)heap_reclaimer_get_interval(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(interval_ms) -- sets the time between the passes of the
+ *	background reclaimer
+ */
+static int
+CTL_WRITE_HANDLER(interval_ms)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 1 || arg_in > HEAP_RECLAIMER_INTERVAL_MAX) {
+		ERR("invalid reclaimer interval, must be between 1 and %d",
+			HEAP_RECLAIMER_INTERVAL_MAX);
+		errno = EINVAL;
+		return -1;
+	}
+
+	heap_reclaimer_set_interval(&pop->heap, (unsigned)arg_in);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(interval_ms) = CTL_ARG_INT;
+
+/*
+ * CTL_READ_HANDLER(worker) -- turns the calling thread into the background
+ *	reclaimer, returns once the reclaimer is stopped
+ */
+static int
+CTL_READ_HANDLER(worker)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int ret = heap_reclaimer_run(&pop->heap);
+	if (ret != 0) {
+		ERR("the background reclaimer is already running");
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(stop) -- stops the background reclaimer, returns once it
+ *	has exited
+ */
+static int
+CTL_READ_HANDLER(stop)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int ret = heap_reclaimer_stop(&pop->heap);
+	if (ret != 0) {
+		ERR("the background reclaimer is not running");
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(passes) -- reads the number of passes performed by the
+ *	background reclaimer
+ */
+static int
+CTL_READ_HANDLER(passes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	uint64_t *arg_out = arg;
+	uint64_t runs;
+
+	heap_reclaimer_get_stats(&pop->heap, arg_out, &runs);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(runs) -- reads the number of empty runs given back to the
+ *	heap by the background reclaimer
+ */
+static int
+CTL_READ_HANDLER(runs)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	uint64_t *arg_out = arg;
+	uint64_t passes;
+
+	heap_reclaimer_get_stats(&pop->heap, &passes, arg_out);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(reclaimer)[] = {
+	CTL_LEAF_RW(interval_ms),
+	CTL_LEAF_RO(worker),
+	CTL_LEAF_RO(stop),
+	CTL_LEAF_RO(passes),
+	CTL_LEAF_RO(runs),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(arena_id)[] = {
 	CTL_LEAF_RO(size),
 	CTL_LEAF_RW(automatic),
+	CTL_LEAF_RO(numa_node),
 
 	CTL_NODE_END
 };
@@ -813,6 +1252,8 @@ static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_CHILD(size),
 	CTL_CHILD(thread),
 	CTL_CHILD(narenas),
+	CTL_CHILD(tcache),
+	CTL_CHILD(reclaimer),
 
 	CTL_NODE_END
 };
@@ -825,3 +1266,65 @@ pmalloc_ctl_register(PMEMobjpool *pop)
 {
 	CTL_REGISTER_MODULE(pop->ctl, heap);
 }
+
+/*
+ * CTL_READ_HANDLER(threads) -- reads the number of threads used to open pools
+ */
+static int
+CTL_READ_HANDLER(threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+
+	*arg_out = (int)Heap_open_threads;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(threads) -- sets the number of threads used to open pools
+ */
+static int
+CTL_WRITE_HANDLER(threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0 || arg_in > HEAP_OPEN_THREADS_MAX) {
+		ERR("incorrect number of threads, must be between 0 and %d",
+			HEAP_OPEN_THREADS_MAX);
+		return -1;
+	}
+
+	Heap_open_threads = (unsigned)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(threads) = CTL_ARG_INT;
+
+static const struct ctl_node CTL_NODE(open)[] = {
+	CTL_LEAF_RW(threads),
+
+	CTL_NODE_END
+};
+
+/*
+ * The global part of the "heap" module, it has to be available before any
+ * pool is opened.
+ */
+static const struct ctl_node CTL_NODE(heap, global)[] = {
+	CTL_CHILD(open),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmalloc_global_ctl_register -- registers global ctl nodes for "heap" module
+ */
+void
+pmalloc_global_ctl_register(void)
+{
+	ctl_register_module_node(NULL, "heap",
+		(struct ctl_node *)CTL_NODE(heap, global));
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2018, Intel Corporation
+ * Copyright 2015-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -68,6 +68,7 @@ struct operation_context *pmalloc_operation_hold_no_start(PMEMobjpool *pop);
 void pmalloc_operation_release(PMEMobjpool *pop);
 
 void pmalloc_ctl_register(PMEMobjpool *pop);
+void pmalloc_global_ctl_register(void);
 
 int pmalloc_cleanup(PMEMobjpool *pop);
 int pmalloc_boot(PMEMobjpool *pop);
@@ -227,23 +227,18 @@ out:
 }
 
 /*
- * recycler_recalc -- recalculates the scores of runs in the recycler to match
- *	the updated persistent state
+ * recycler_recalc_threshold -- (internal) recalculates the scores of runs in
+ *	the recycler if the number of unaccounted units reached the threshold
  */
-struct empty_runs
-recycler_recalc(struct recycler *r, int force)
+static struct empty_runs
+recycler_recalc_threshold(struct recycler *r, int force,
+	uint64_t recalc_threshold)
 {
 	struct empty_runs runs;
 	VEC_INIT(&runs);
 
 	uint64_t units = r->unaccounted_total;
 
-	size_t peak_arenas;
-	util_atomic_load64(r->peak_arenas, &peak_arenas);
-
-	uint64_t recalc_threshold =
-		THRESHOLD_MUL * peak_arenas * r->nallocs;
-
 	if (!force && units < recalc_threshold)
 		return runs;
 
@@ -319,6 +314,33 @@ recycler_recalc(struct recycler *r, int force)
 	return runs;
 }
 
+/*
+ * recycler_recalc -- recalculates the scores of runs in the recycler to match
+ *	the updated persistent state
+ */
+struct empty_runs
+recycler_recalc(struct recycler *r, int force)
+{
+	size_t peak_arenas;
+	util_atomic_load64(r->peak_arenas, &peak_arenas);
+
+	return recycler_recalc_threshold(r, force,
+		THRESHOLD_MUL * peak_arenas * r->nallocs);
+}
+
+/*
+ * recycler_recalc_eager -- recalculates the scores of runs in the recycler
+ *	as soon as a single run worth of units is unaccounted for
+ *
+ * This is meant to be called periodically from outside of the allocation path,
+ * so that the recalculations are small and rarely reach the regular threshold.
+ */
+struct empty_runs
+recycler_recalc_eager(struct recycler *r)
+{
+	return recycler_recalc_threshold(r, 0, r->nallocs);
+}
+
 /*
  * recycler_inc_unaccounted -- increases the number of unaccounted units in the
  *	recycler
@@ -70,6 +70,7 @@ int recycler_put(struct recycler *r, const struct memory_block *m,
 int recycler_get(struct recycler *r, struct memory_block *m);
 
 struct empty_runs recycler_recalc(struct recycler *r, int force);
+struct empty_runs recycler_recalc_eager(struct recycler *r);
 
 void recycler_inc_unaccounted(struct recycler *r,
 	const struct memory_block *m);
@@ -45,6 +45,78 @@ static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * stats_lane -- (internal) returns the lane specified in the query indexes,
+ *	or NULL if the index is out of range
+ */
+static struct lane *
+stats_lane(PMEMobjpool *pop, struct ctl_indexes *indexes)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "lane_id"), 0);
+
+	unsigned nlanes = pop->lanes_desc.runtime_nlanes;
+	if (idx->value < 0 || (unsigned long)idx->value >= nlanes) {
+		LOG(1, "lane id outside of the allowed range: <0,%u)",
+			nlanes);
+		errno = ERANGE;
+		return NULL;
+	}
+
+	return &pop->lanes_desc.lane[idx->value];
+}
+
+/*
+ * CTL_READ_HANDLER(contended) -- returns the number of times the lane was
+ *	found taken by a thread for which it was the primary lane
+ */
+static int
+CTL_READ_HANDLER(contended)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct lane *lane = stats_lane(ctx, indexes);
+	if (lane == NULL)
+		return -1;
+
+	util_atomic_load_explicit64(&lane->ncontended, (uint64_t *)arg,
+		memory_order_acquire);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(waits) -- returns the number of times a thread for which
+ *	the lane was the primary lane had to wait for any lane to be released
+ */
+static int
+CTL_READ_HANDLER(waits)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct lane *lane = stats_lane(ctx, indexes);
+	if (lane == NULL)
+		return -1;
+
+	util_atomic_load_explicit64(&lane->nwaits, (uint64_t *)arg,
+		memory_order_acquire);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(lane_id)[] = {
+	CTL_LEAF_RO(contended),
+	CTL_LEAF_RO(waits),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(lane)[] = {
+	CTL_INDEXED(lane_id),
+
+	CTL_NODE_END
+};
+
 /*
  * CTL_READ_HANDLER(enabled) -- returns whether or not statistics are enabled
  */
@@ -83,6 +155,7 @@ static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
 
 static const struct ctl_node CTL_NODE(stats)[] = {
 	CTL_CHILD(heap),
+	CTL_CHILD(lane),
 	CTL_LEAF_RW(enabled),
 
 	CTL_NODE_END
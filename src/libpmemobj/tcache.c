@@ -0,0 +1,459 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tcache.c -- implementation of thread-local block caches
+ *
+ * Each thread that allocates from the heap gets its own cache, lazily, on
+ * the first allocation that is eligible for caching. The cache has one bin
+ * per allocation class, bins are refilled with a batch of blocks reserved
+ * under a single bucket lock.
+ *
+ * Every cached block holds a reservation of the run it comes from, just like
+ * a not yet published pobj_action, which prevents the run from being
+ * discarded. The blocks are given back to their buckets when the thread
+ * exits, when the cache is explicitly drained or when the heap is cleaned up.
+ *
+ * The caches of a thread, one per heap it allocated from, are reachable through
+ * a single library-wide key, whose destructor doesn't depend on any of the
+ * heaps still being open. A heap that is cleaned up detaches the caches of all
+ * threads under a global lock, the detached caches are freed by their threads.
+ */
+
+#include "heap.h"
+#include "os_thread.h"
+#include "out.h"
+#include "queue.h"
+#include "sys_util.h"
+#include "tcache.h"
+#include "valgrind_internal.h"
+#include "vec.h"
+
+struct tcache_block {
+	struct memory_block m;
+	struct memory_block_reserved *mresv;
+};
+
+struct tcache_thread {
+	struct tcache *tc;
+	unsigned detached; /* the heap no longer exists */
+	PMDK_LIST_ENTRY(tcache_thread) entry; /* caches of the heap */
+	PMDK_LIST_ENTRY(tcache_thread) thread_entry; /* caches of the thread */
+
+	/* one bin per allocation class */
+	VEC(, struct tcache_block) bins[MAX_ALLOCATION_CLASSES];
+};
+
+struct tcache {
+	struct palloc_heap *heap;
+
+	unsigned enabled;
+	unsigned batch_size;
+
+	/* caches of all the threads, protected by Tcache_lock */
+	PMDK_LIST_HEAD(tcache_threads, tcache_thread) threads;
+};
+
+PMDK_LIST_HEAD(tcache_thread_caches, tcache_thread);
+
+/* stores a pointer to the list of the calling thread's caches */
+static os_tls_key_t Tcache_key;
+
+/* protects the lists of caches of the heaps and the detaching of caches */
+static os_mutex_t Tcache_lock;
+
+/*
+ * tcache_thread_drain -- (internal) gives back all the cached blocks of
+ *	a thread
+ */
+static void
+tcache_thread_drain(struct palloc_heap *heap, struct tcache_thread *t)
+{
+	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct tcache_block *tb;
+		VEC_FOREACH_BY_PTR(tb, &t->bins[i]) {
+			if (tb->mresv != NULL)
+				heap_reservation_clear(heap, &tb->m,
+					tb->mresv, 0 /* publish */);
+		}
+		VEC_CLEAR(&t->bins[i]);
+	}
+}
+
+/*
+ * tcache_thread_detach -- (internal) gives back the blocks of a thread cache
+ *	and detaches it from its heap, must be called with Tcache_lock taken
+ */
+static void
+tcache_thread_detach(struct tcache_thread *t)
+{
+	tcache_thread_drain(t->tc->heap, t);
+
+	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
+		VEC_DELETE(&t->bins[i]);
+
+	PMDK_LIST_REMOVE(t, entry);
+
+	/* read without the lock by the thread looking for its cache */
+	util_atomic_store_explicit32(&t->detached, 1, memory_order_release);
+}
+
+/*
+ * tcache_thread_gc -- (internal) frees the caches of the calling thread that
+ *	were detached from their heaps, if all is set frees all of them
+ */
+static void
+tcache_thread_gc(struct tcache_thread_caches *caches, int all)
+{
+	util_mutex_lock(&Tcache_lock);
+
+	struct tcache_thread *t = PMDK_LIST_FIRST(caches);
+	while (t != NULL) {
+		struct tcache_thread *next = PMDK_LIST_NEXT(t, thread_entry);
+
+		if (!t->detached && all)
+			tcache_thread_detach(t);
+
+		if (t->detached) {
+			PMDK_LIST_REMOVE(t, thread_entry);
+			Free(t);
+		}
+
+		t = next;
+	}
+
+	util_mutex_unlock(&Tcache_lock);
+}
+
+/*
+ * tcache_thread_destructor -- (internal) gives back the caches of an exiting
+ *	thread
+ */
+static void
+tcache_thread_destructor(void *arg)
+{
+	struct tcache_thread_caches *caches = arg;
+
+	tcache_thread_gc(caches, 1 /* all */);
+
+	Free(caches);
+}
+
+/*
+ * tcache_thread_find -- (internal) returns the calling thread's cache of
+ *	the given heap, if there is one
+ */
+static struct tcache_thread *
+tcache_thread_find(struct tcache *tc)
+{
+	struct tcache_thread_caches *caches = os_tls_get(Tcache_key);
+	if (caches == NULL)
+		return NULL;
+
+	/*
+	 * The detached caches are skipped, a heap created later can reuse
+	 * the address of the one they belonged to.
+	 */
+	struct tcache_thread *t;
+	PMDK_LIST_FOREACH(t, caches, thread_entry) {
+		unsigned detached;
+		util_atomic_load_explicit32(&t->detached, &detached,
+			memory_order_acquire);
+
+		if (!detached && t->tc == tc)
+			return t;
+	}
+
+	return NULL;
+}
+
+/*
+ * tcache_thread -- (internal) returns the cache of the calling thread,
+ *	creates it if necessary
+ */
+static struct tcache_thread *
+tcache_thread(struct tcache *tc)
+{
+	struct tcache_thread *t = tcache_thread_find(tc);
+	if (t != NULL)
+		return t;
+
+	struct tcache_thread_caches *caches = os_tls_get(Tcache_key);
+	if (caches == NULL) {
+		caches = Malloc(sizeof(*caches));
+		if (caches == NULL)
+			return NULL;
+
+		PMDK_LIST_INIT(caches);
+		os_tls_set(Tcache_key, caches);
+	} else {
+		/* the caches of closed heaps are no longer of any use */
+		tcache_thread_gc(caches, 0 /* all */);
+	}
+
+	t = Zalloc(sizeof(*t));
+	if (t == NULL)
+		return NULL;
+
+	t->tc = tc;
+	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
+		VEC_INIT(&t->bins[i]);
+
+	util_mutex_lock(&Tcache_lock);
+	PMDK_LIST_INSERT_HEAD(&tc->threads, t, entry);
+	PMDK_LIST_INSERT_HEAD(caches, t, thread_entry);
+	util_mutex_unlock(&Tcache_lock);
+
+	return t;
+}
+
+/*
+ * tcache_refill -- (internal) reserves a batch of single unit blocks from
+ *	the bucket of the given class
+ */
+static int
+tcache_refill(struct tcache *tc, struct alloc_class *c,
+	struct tcache_thread *t)
+{
+	struct palloc_heap *heap = tc->heap;
+	unsigned batch_size = tc->batch_size;
+
+	if (VEC_RESERVE(&t->bins[c->id], batch_size) != 0)
+		return ENOMEM;
+
+	int err = 0;
+	struct bucket *b = heap_bucket_acquire(heap, c->id,
+		HEAP_ARENA_PER_THREAD);
+
+	for (unsigned i = 0; i < batch_size; ++i) {
+		struct tcache_block tb;
+		tb.m = MEMORY_BLOCK_NONE;
+		tb.m.size_idx = 1;
+
+		if ((err = heap_get_bestfit_block(heap, b, &tb.m)) != 0)
+			break;
+
+		/* the run of the block can change between the iterations */
+		if ((tb.mresv = b->active_memory_block) != NULL)
+			util_fetch_and_add64(&tb.mresv->nresv, 1);
+
+		/* can't fail, the capacity was reserved upfront */
+		VEC_PUSH_BACK(&t->bins[c->id], tb);
+	}
+
+	heap_bucket_release(heap, b);
+
+	/* a partial batch is still good enough to serve this allocation */
+	return VEC_SIZE(&t->bins[c->id]) == 0 ? err : 0;
+}
+
+/*
+ * tcache_get -- takes a single unit block of the given class from the calling
+ *	thread's cache, along with its reservation
+ */
+int
+tcache_get(struct tcache *tc, struct alloc_class *c,
+	struct memory_block *m, struct memory_block_reserved **mresv)
+{
+	ASSERTeq(c->type, CLASS_RUN);
+
+	struct tcache_thread *t = tcache_thread(tc);
+	if (t == NULL)
+		return ENOMEM;
+
+	if (VEC_SIZE(&t->bins[c->id]) == 0) {
+		int err = tcache_refill(tc, c, t);
+		if (err != 0)
+			return err;
+	}
+
+	struct tcache_block *tb = &VEC_BACK(&t->bins[c->id]);
+	*m = tb->m;
+	*mresv = tb->mresv;
+	VEC_POP_BACK(&t->bins[c->id]);
+
+	return 0;
+}
+
+/*
+ * tcache_put -- puts a block previously taken from the cache back, used when
+ *	the reservation of the block has been rolled back
+ */
+void
+tcache_put(struct tcache *tc, struct alloc_class *c,
+	const struct memory_block *m, struct memory_block_reserved *mresv)
+{
+	struct tcache_thread *t = tcache_thread_find(tc);
+	ASSERTne(t, NULL);
+
+	struct tcache_block tb;
+	tb.m = *m;
+	tb.mresv = mresv;
+
+	if (VEC_PUSH_BACK(&t->bins[c->id], tb) != 0) {
+		if (mresv != NULL)
+			heap_reservation_clear(tc->heap, m, mresv,
+				0 /* publish */);
+	}
+}
+
+/*
+ * tcache_drain -- gives back all the blocks cached by the calling thread
+ */
+void
+tcache_drain(struct tcache *tc)
+{
+	struct tcache_thread *t = tcache_thread_find(tc);
+	if (t != NULL)
+		tcache_thread_drain(tc->heap, t);
+}
+
+/*
+ * tcache_is_enabled -- returns whether the allocations use thread caches
+ */
+int
+tcache_is_enabled(struct tcache *tc)
+{
+	unsigned enabled;
+	util_atomic_load_explicit32(&tc->enabled, &enabled,
+		memory_order_relaxed);
+
+	return enabled != 0;
+}
+
+/*
+ * tcache_set_enabled -- enables or disables the thread caches
+ *
+ * Disabling the caches doesn't give back the blocks that are already cached,
+ * that happens when the threads exit, drain their caches or the heap is
+ * cleaned up.
+ */
+void
+tcache_set_enabled(struct tcache *tc, int enabled)
+{
+	util_atomic_store_explicit32(&tc->enabled, enabled != 0,
+		memory_order_relaxed);
+}
+
+/*
+ * tcache_get_batch_size -- returns the number of blocks reserved at once
+ */
+unsigned
+tcache_get_batch_size(struct tcache *tc)
+{
+	return tc->batch_size;
+}
+
+/*
+ * tcache_set_batch_size -- sets the number of blocks reserved at once
+ */
+void
+tcache_set_batch_size(struct tcache *tc, unsigned batch_size)
+{
+	ASSERTne(batch_size, 0);
+	ASSERT(batch_size <= TCACHE_BATCH_SIZE_MAX);
+
+	tc->batch_size = batch_size;
+}
+
+/*
+ * tcache_new -- creates the thread caches of a heap, initially disabled
+ */
+struct tcache *
+tcache_new(struct palloc_heap *heap)
+{
+	struct tcache *tc = Malloc(sizeof(*tc));
+	if (tc == NULL)
+		return NULL;
+
+	tc->heap = heap;
+	tc->enabled = 0;
+	tc->batch_size = TCACHE_BATCH_SIZE_DEFAULT;
+
+	PMDK_LIST_INIT(&tc->threads);
+
+	return tc;
+}
+
+/*
+ * tcache_delete -- gives back the blocks cached by all threads and deletes
+ *	the thread caches
+ */
+void
+tcache_delete(struct tcache *tc)
+{
+	/*
+	 * The caches stay on the lists of their threads, which free them
+	 * later, this is also what makes it safe against the destructors of
+	 * the threads that are exiting right now.
+	 */
+	util_mutex_lock(&Tcache_lock);
+
+	struct tcache_thread *t;
+	while ((t = PMDK_LIST_FIRST(&tc->threads)) != NULL)
+		tcache_thread_detach(t);
+
+	util_mutex_unlock(&Tcache_lock);
+
+	Free(tc);
+}
+
+/*
+ * tcache_boot -- initializes the key used to give back the caches of exiting
+ *	threads
+ */
+void
+tcache_boot(void)
+{
+	util_mutex_init(&Tcache_lock);
+
+	int result = os_tls_key_create(&Tcache_key, tcache_thread_destructor);
+	if (result != 0) {
+		errno = result;
+		FATAL("!os_tls_key_create");
+	}
+}
+
+/*
+ * tcache_fini -- frees the caches of the current thread and deletes the
+ *	per-thread key
+ */
+void
+tcache_fini(void)
+{
+	struct tcache_thread_caches *caches = os_tls_get(Tcache_key);
+	if (caches != NULL)
+		tcache_thread_destructor(caches);
+
+	(void) os_tls_key_delete(Tcache_key);
+	util_mutex_destroy(&Tcache_lock);
+}
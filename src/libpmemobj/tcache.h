@@ -0,0 +1,83 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tcache.h -- internal definitions of thread-local block caches
+ *
+ * A thread cache holds a small number of memory blocks reserved in advance
+ * from the buckets of the current thread's arena, so that most of the small
+ * allocations don't have to lock a bucket. The blocks are reserved only in
+ * the transient state of the heap, a crash simply makes them free again.
+ */
+
+#ifndef LIBPMEMOBJ_TCACHE_H
+#define LIBPMEMOBJ_TCACHE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc_class.h"
+#include "memblock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TCACHE_BATCH_SIZE_DEFAULT 32
+#define TCACHE_BATCH_SIZE_MAX 1024
+
+struct tcache;
+
+struct tcache *tcache_new(struct palloc_heap *heap);
+void tcache_delete(struct tcache *tc);
+
+int tcache_get(struct tcache *tc, struct alloc_class *c,
+	struct memory_block *m, struct memory_block_reserved **mresv);
+void tcache_put(struct tcache *tc, struct alloc_class *c,
+	const struct memory_block *m, struct memory_block_reserved *mresv);
+
+void tcache_drain(struct tcache *tc);
+
+int tcache_is_enabled(struct tcache *tc);
+void tcache_set_enabled(struct tcache *tc, int enabled);
+
+unsigned tcache_get_batch_size(struct tcache *tc);
+void tcache_set_batch_size(struct tcache *tc, unsigned batch_size);
+
+void tcache_boot(void);
+void tcache_fini(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -40,17 +40,88 @@
 #include "queue.h"
 #include "ravl.h"
 #include "obj.h"
+#include "os.h"
 #include "out.h"
 #include "pmalloc.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 #include "memops.h"
+#include "sys_util.h"
 
 struct tx_data {
 	PMDK_SLIST_ENTRY(tx_data) tx_entry;
 	jmp_buf env;
 };
 
+struct tx_range_def {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t flags;
+};
+
+/*
+ * Number of snapshot ranges above which the ranges are indexed by a tree
+ * instead of the flat sorted array.
+ */
+#define TX_RANGES_FLAT_MAX 256
+
+/*
+ * Maximum number of elements of the per-thread action vectors that are kept
+ * allocated after a transaction ends. Vectors which grew larger than that
+ * are freed, so that a single large transaction doesn't pin its buffers
+ * for the lifetime of the thread.
+ */
+#define TX_VEC_RETAIN_MAX 1024
+
+/*
+ * tx_ranges -- index of the ranges snapshotted or allocated in a transaction
+ *
+ * Most transactions contain only a handful of ranges, for which a sorted
+ * array with binary search is much cheaper than a tree: lookups don't chase
+ * pointers and inserts don't allocate memory. The array is only cleared at
+ * the end of a transaction, so its buffer is reused by all the transactions
+ * of a thread. Once the array grows beyond TX_RANGES_FLAT_MAX entries, all
+ * of them are moved to a tree for the rest of the transaction.
+ */
+struct tx_ranges {
+	VEC(, struct tx_range_def) flat; /* sorted by offset */
+	struct ravl *tree; /* NULL if the flat array is used */
+};
+
+/*
+ * Capacity of the write set buffer above which it is freed at the end of
+ * a transaction instead of being retained for the next one.
+ */
+#define TX_WSET_RETAIN_MAX (1 << 16)
+
+/*
+ * tx_wset_entry -- range of the pool modified by the writes buffered in
+ *	a transaction
+ */
+struct tx_wset_entry {
+	uint64_t offset;
+	uint64_t size;
+	size_t pos; /* position of the new data in the write set buffer */
+};
+
+/*
+ * tx_wset -- volatile write set of a transaction
+ *
+ * The writes of a transaction are kept in a buffer and applied through the
+ * redo log at commit, which means that each modified cache line is written
+ * and flushed only once. The entries are sorted by offset and never overlap
+ * or touch each other - a write that does is merged with the existing
+ * entries, so that it can be logged as a single buffer.
+ */
+struct tx_wset {
+	VEC(, struct tx_wset_entry) entries;
+	char *buf;
+	size_t buf_size;
+	size_t buf_capacity;
+	size_t buf_dead; /* bytes of the buffer no longer used by any entry */
+	size_t log_nbytes; /* estimated size of the redo log entries */
+};
+
 struct tx {
 	PMEMobjpool *pop;
 	enum pobj_tx_stage stage;
@@ -59,16 +130,90 @@ struct tx {
 	PMDK_SLIST_HEAD(txl, tx_lock_data) tx_locks;
 	PMDK_SLIST_HEAD(txd, tx_data) tx_entries;
 
-	struct ravl *ranges;
+	struct tx_ranges ranges;
+	struct tx_wset wset;
 
 	VEC(, struct pobj_action) actions;
 	VEC(, struct user_buffer_def) redo_userbufs;
 	size_t redo_userbufs_capacity;
 
+	/* entries retained for reuse by the next transactions of the thread */
+	PMDK_SLIST_HEAD(txd_cache, tx_data) tx_entries_cache;
+	PMDK_SLIST_HEAD(txl_cache, tx_lock_data) tx_locks_cache;
+
 	pmemobj_tx_callback stage_callback;
 	void *stage_callback_arg;
 
 	int first_snapshot;
+
+	int tls_registered; /* set once the thread destructor is registered */
+
+	/* set if the transaction is counted as a potential group member */
+	int commit_group_active;
+};
+
+static os_tls_key_t Tx_key;
+
+/*
+ * tx_commit_group_member -- transaction that waits for the leader of its
+ *	commit group to make its modifications durable
+ */
+struct tx_commit_group_member {
+	PMDK_SLIST_ENTRY(tx_commit_group_member) next;
+	struct tx *tx;
+	int done;
+};
+
+PMDK_SLIST_HEAD(tx_commit_group_members, tx_commit_group_member);
+
+/*
+ * tx_commit_group -- runtime state of the group commit of a pool
+ *
+ * The first transaction that commits becomes the leader of a new group and,
+ * for at most the duration of the group window, collects the transactions
+ * that are concurrently committed on other lanes. The leader stops waiting
+ * early once the group is full, or once all the transactions that were
+ * running while group commit was enabled are in the group, which means that
+ * a lone committer never waits. The leader then flushes the modified ranges
+ * of all the members and makes them durable with a single drain, after
+ * which all of them proceed with the rest of the commit.
+ */
+struct tx_commit_group {
+	os_mutex_t lock;
+	os_cond_t cond; /* signaled by the leader once the group is durable */
+	os_cond_t join; /* signaled by the members joining the open group */
+
+	/* members of the group that is being collected, NULL if none */
+	struct tx_commit_group_members *open;
+	unsigned nmembers; /* number of members of the open group */
+
+	/* number of transactions which can still join a group */
+	uint64_t nactive;
+};
+
+/* maximum number of transactions committed by a single group */
+#define TX_COMMIT_GROUP_MEMBERS_MAX 64
+
+/*
+ * tx_post_commit_queue -- lanes of committed transactions whose post commit
+ *	work (cleanup of the undo log, freeing of the log extensions) is
+ *	deferred to the post commit workers
+ *
+ * Each task is a lane detached from the committing thread, which is released
+ * by the worker once the post commit work is done. The queue lives as long as
+ * the pool, only its storage is replaced when the depth is changed.
+ */
+struct tx_post_commit_queue {
+	os_mutex_t lock;
+	os_cond_t cond;
+
+	int stop; /* workers are requested to exit */
+	unsigned nworkers;
+
+	unsigned depth; /* 0 if the queue is disabled */
+	unsigned head; /* position of the oldest task */
+	unsigned ntasks;
+	unsigned *lanes;
 };
 
 /*
@@ -104,12 +249,6 @@ struct tx_alloc_args {
 #define ALLOC_ARGS(flags)\
 (struct tx_alloc_args){flags, NULL, 0}
 
-struct tx_range_def {
-	uint64_t offset;
-	uint64_t size;
-	uint64_t flags;
-};
-
 /*
  * tx_range_def_cmp -- compares two snapshot ranges
  */
@@ -127,6 +266,615 @@ tx_range_def_cmp(const void *lhs, const void *rhs)
 	return 0;
 }
 
+/*
+ * tx_ranges_bound -- (internal) returns the position of the first range in
+ *	the flat array that starts at or after (or, if upper is set, strictly
+ *	after) the given offset
+ */
+static size_t
+tx_ranges_bound(struct tx_ranges *ranges, uint64_t offset, int upper)
+{
+	struct tx_range_def *arr = VEC_ARR(&ranges->flat);
+	size_t lo = 0;
+	size_t hi = VEC_SIZE(&ranges->flat);
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (arr[mid].offset < offset ||
+		    (upper && arr[mid].offset == offset))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * tx_ranges_find -- (internal) returns the range that satisfies the predicate
+ *	(equal, less or less-equal) with respect to the given offset
+ */
+static struct tx_range_def *
+tx_ranges_find(struct tx_ranges *ranges, uint64_t offset,
+	enum ravl_predicate p)
+{
+	if (ranges->tree != NULL) {
+		struct tx_range_def search = {offset, 0, 0};
+		struct ravl_node *n = ravl_find(ranges->tree, &search, p);
+
+		return n == NULL ? NULL : ravl_data(n);
+	}
+
+	size_t pos;
+	switch (p) {
+	case RAVL_PREDICATE_EQUAL:
+		pos = tx_ranges_bound(ranges, offset, 0);
+		if (pos == VEC_SIZE(&ranges->flat) ||
+		    VEC_GET(&ranges->flat, pos)->offset != offset)
+			return NULL;
+		return VEC_GET(&ranges->flat, pos);
+	case RAVL_PREDICATE_LESS:
+		pos = tx_ranges_bound(ranges, offset, 0);
+		break;
+	case RAVL_PREDICATE_LESS_EQUAL:
+		pos = tx_ranges_bound(ranges, offset, 1);
+		break;
+	default:
+		ASSERT(0);
+		return NULL;
+	}
+
+	return pos == 0 ? NULL : VEC_GET(&ranges->flat, pos - 1);
+}
+
+/*
+ * tx_ranges_to_tree -- (internal) moves all the ranges from the flat array
+ *	to a tree
+ */
+static int
+tx_ranges_to_tree(struct tx_ranges *ranges)
+{
+	struct ravl *tree = ravl_new_sized(tx_range_def_cmp,
+		sizeof(struct tx_range_def));
+	if (tree == NULL)
+		return -1;
+
+	struct tx_range_def *r;
+	VEC_FOREACH_BY_PTR(r, &ranges->flat) {
+		if (ravl_emplace_copy(tree, r) != 0) {
+			ravl_delete(tree);
+			return -1;
+		}
+	}
+
+	VEC_CLEAR(&ranges->flat);
+	ranges->tree = tree;
+
+	return 0;
+}
+
+/*
+ * tx_ranges_insert -- (internal) inserts a copy of the range into the index
+ */
+static int
+tx_ranges_insert(struct tx_ranges *ranges, const struct tx_range_def *rdef)
+{
+	if (ranges->tree == NULL &&
+	    VEC_SIZE(&ranges->flat) == TX_RANGES_FLAT_MAX &&
+	    tx_ranges_to_tree(ranges) != 0)
+		return -1;
+
+	if (ranges->tree != NULL)
+		return ravl_emplace_copy(ranges->tree, rdef);
+
+	size_t pos = tx_ranges_bound(ranges, rdef->offset, 0);
+	size_t size = VEC_SIZE(&ranges->flat);
+	if (pos != size && VEC_GET(&ranges->flat, pos)->offset ==
+			rdef->offset) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	if (VEC_INC_BACK(&ranges->flat) != 0)
+		return -1;
+
+	struct tx_range_def *arr = VEC_ARR(&ranges->flat);
+	memmove(&arr[pos + 1], &arr[pos], (size - pos) * sizeof(*arr));
+	arr[pos] = *rdef;
+
+	return 0;
+}
+
+/*
+ * tx_ranges_remove -- (internal) removes the range from the index
+ */
+static void
+tx_ranges_remove(struct tx_ranges *ranges, struct tx_range_def *rdef)
+{
+	if (ranges->tree != NULL) {
+		struct ravl_node *n = ravl_find(ranges->tree, rdef,
+			RAVL_PREDICATE_EQUAL);
+		ASSERTne(n, NULL);
+		ravl_remove(ranges->tree, n);
+		return;
+	}
+
+	struct tx_range_def *arr = VEC_ARR(&ranges->flat);
+	size_t pos = (size_t)(rdef - arr);
+	size_t size = VEC_SIZE(&ranges->flat);
+	ASSERT(pos < size);
+
+	memmove(&arr[pos], &arr[pos + 1], (size - pos - 1) * sizeof(*arr));
+	VEC_POP_BACK(&ranges->flat);
+}
+
+/*
+ * tx_ranges_clear -- (internal) calls the callback for every range and
+ *	removes all of them from the index
+ */
+static void
+tx_ranges_clear(struct tx_ranges *ranges, ravl_cb cb, void *arg)
+{
+	if (ranges->tree != NULL) {
+		ravl_delete_cb(ranges->tree, cb, arg);
+		ranges->tree = NULL;
+		return;
+	}
+
+	struct tx_range_def *r;
+	VEC_FOREACH_BY_PTR(r, &ranges->flat)
+		cb(r, arg);
+
+	VEC_CLEAR(&ranges->flat);
+}
+
+/*
+ * tx_ranges_delete -- (internal) frees the memory of the index
+ */
+static void
+tx_ranges_delete(struct tx_ranges *ranges)
+{
+	if (ranges->tree != NULL) {
+		ravl_delete(ranges->tree);
+		ranges->tree = NULL;
+	}
+
+	VEC_DELETE(&ranges->flat);
+}
+
+/*
+ * tx_wset_entry_log_nbytes -- (internal) returns the estimated size of the
+ *	redo log entries of a write set entry
+ *
+ * The additional cache line accounts for the entry being split between
+ * two ulogs.
+ */
+static size_t
+tx_wset_entry_log_nbytes(const struct tx_wset_entry *e)
+{
+	return ALIGN_UP(sizeof(struct ulog_entry_buf) + e->size,
+		CACHELINE_SIZE) + CACHELINE_SIZE;
+}
+
+/*
+ * tx_wset_bound -- (internal) returns the position of the first entry of
+ *	the write set that ends at, or after, the given offset
+ */
+static size_t
+tx_wset_bound(struct tx_wset *wset, uint64_t offset)
+{
+	size_t lo = 0;
+	size_t hi = VEC_SIZE(&wset->entries);
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct tx_wset_entry *e = VEC_GET(&wset->entries, mid);
+		if (e->offset + e->size < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * tx_wset_buf_alloc -- (internal) allocates space in the write set buffer
+ */
+static int
+tx_wset_buf_alloc(struct tx_wset *wset, size_t size, size_t *pos)
+{
+	if (wset->buf_size + size > wset->buf_capacity) {
+		size_t ncapacity = MAX(wset->buf_capacity * 2,
+			wset->buf_size + size);
+		ncapacity = MAX(ncapacity, CACHELINE_SIZE * 16);
+
+		char *buf = Realloc(wset->buf, ncapacity);
+		if (buf == NULL) {
+			ERR("!Realloc");
+			return -1;
+		}
+
+		wset->buf = buf;
+		wset->buf_capacity = ncapacity;
+	}
+
+	*pos = wset->buf_size;
+	wset->buf_size += size;
+
+	return 0;
+}
+
+/*
+ * tx_wset_buf_compact -- (internal) moves the data of all the entries to
+ *	a new buffer, without the space left behind by the merged entries
+ */
+static int
+tx_wset_buf_compact(struct tx_wset *wset)
+{
+	size_t nbytes = wset->buf_size - wset->buf_dead;
+	char *buf = Malloc(MAX(nbytes, CACHELINE_SIZE * 16));
+	if (buf == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	size_t pos = 0;
+	struct tx_wset_entry *e;
+	VEC_FOREACH_BY_PTR(e, &wset->entries) {
+		memcpy(buf + pos, wset->buf + e->pos, e->size);
+		e->pos = pos;
+		pos += e->size;
+	}
+	ASSERTeq(pos, nbytes);
+
+	Free(wset->buf);
+	wset->buf = buf;
+	wset->buf_capacity = MAX(nbytes, CACHELINE_SIZE * 16);
+	wset->buf_size = nbytes;
+	wset->buf_dead = 0;
+
+	return 0;
+}
+
+/*
+ * tx_wset_add -- (internal) adds a write to the write set
+ */
+static int
+tx_wset_add(struct tx_wset *wset, uint64_t offset, const void *src,
+	size_t size)
+{
+	size_t i = tx_wset_bound(wset, offset);
+	size_t nentries = VEC_SIZE(&wset->entries);
+	struct tx_wset_entry *e = i == nentries ?
+		NULL : VEC_GET(&wset->entries, i);
+
+	/* overwrite of data that is already in the write set */
+	if (e != NULL && e->offset <= offset &&
+	    e->offset + e->size >= offset + size) {
+		memcpy(wset->buf + e->pos + (offset - e->offset), src, size);
+		return 0;
+	}
+
+	/* find all the entries that the new write overlaps or touches */
+	struct tx_wset_entry n = {offset, size, 0};
+	size_t j;
+	for (j = i; j < nentries; ++j) {
+		e = VEC_GET(&wset->entries, j);
+		if (e->offset > offset + size)
+			break;
+
+		uint64_t end = MAX(n.offset + n.size, e->offset + e->size);
+		n.offset = MIN(n.offset, e->offset);
+		n.size = end - n.offset;
+	}
+
+	/*
+	 * If the data of the first merged entry is at the end of the buffer,
+	 * which is the case for sequential writes, that entry is extended in
+	 * place. Otherwise the data of all the merged entries is left behind.
+	 */
+	e = j != i ? VEC_GET(&wset->entries, i) : NULL;
+	int in_place = e != NULL && e->pos + e->size == wset->buf_size;
+
+	/* reclaim the space left behind before the buffer has to grow */
+	if (!in_place && wset->buf_dead > wset->buf_size / 2 &&
+	    wset->buf_size + n.size > wset->buf_capacity &&
+	    tx_wset_buf_compact(wset) != 0)
+		return -1;
+
+	if (j == i && VEC_INC_BACK(&wset->entries) != 0)
+		return -1;
+
+	if (in_place) {
+		size_t pos;
+		if (tx_wset_buf_alloc(wset, n.size - e->size, &pos) != 0)
+			return -1;
+
+		n.pos = e->pos;
+		memmove(wset->buf + n.pos + (e->offset - n.offset),
+			wset->buf + e->pos, e->size);
+		wset->log_nbytes -= tx_wset_entry_log_nbytes(e);
+	} else if (tx_wset_buf_alloc(wset, n.size, &n.pos) != 0) {
+		if (j == i)
+			VEC_POP_BACK(&wset->entries);
+		return -1;
+	}
+
+	for (size_t k = in_place ? i + 1 : i; k < j; ++k) {
+		e = VEC_GET(&wset->entries, k);
+		memcpy(wset->buf + n.pos + (e->offset - n.offset),
+			wset->buf + e->pos, e->size);
+		wset->log_nbytes -= tx_wset_entry_log_nbytes(e);
+		wset->buf_dead += e->size;
+	}
+	memcpy(wset->buf + n.pos + (offset - n.offset), src, size);
+	wset->log_nbytes += tx_wset_entry_log_nbytes(&n);
+
+	/* replace the merged entries with the new one */
+	struct tx_wset_entry *arr = VEC_ARR(&wset->entries);
+	if (j == i) {
+		memmove(&arr[i + 1], &arr[i],
+			(nentries - i) * sizeof(*arr));
+	} else {
+		memmove(&arr[i + 1], &arr[j],
+			(nentries - j) * sizeof(*arr));
+		VEC_SIZE(&wset->entries) -= j - i - 1;
+	}
+	arr[i] = n;
+
+	return 0;
+}
+
+/*
+ * tx_wset_read -- (internal) copies the buffered writes that overlap with
+ *	the given range of the pool to the destination buffer
+ */
+static void
+tx_wset_read(struct tx_wset *wset, uint64_t offset, void *dest, size_t size)
+{
+	for (size_t i = tx_wset_bound(wset, offset);
+			i < VEC_SIZE(&wset->entries); ++i) {
+		struct tx_wset_entry *e = VEC_GET(&wset->entries, i);
+		if (e->offset >= offset + size)
+			break;
+
+		uint64_t begin = MAX(e->offset, offset);
+		uint64_t end = MIN(e->offset + e->size, offset + size);
+		if (begin >= end)
+			continue;
+
+		memcpy((char *)dest + (begin - offset),
+			wset->buf + e->pos + (begin - e->offset), end - begin);
+	}
+}
+
+/*
+ * tx_wset_log -- (internal) adds the writes of the write set to the redo
+ *	log of the transaction
+ */
+static int
+tx_wset_log(struct tx_wset *wset, PMEMobjpool *pop,
+	struct operation_context *ctx)
+{
+	struct tx_wset_entry *e;
+	VEC_FOREACH_BY_PTR(e, &wset->entries) {
+		if (operation_add_buffer(ctx, OBJ_OFF_TO_PTR(pop, e->offset),
+		    wset->buf + e->pos, e->size, ULOG_OPERATION_BUF_CPY) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_wset_clear -- (internal) discards the contents of the write set
+ */
+static void
+tx_wset_clear(struct tx_wset *wset)
+{
+	VEC_CLEAR(&wset->entries);
+	wset->buf_size = 0;
+	wset->buf_dead = 0;
+	wset->log_nbytes = 0;
+}
+
+/*
+ * tx_wset_delete -- (internal) frees the write set
+ */
+static void
+tx_wset_delete(struct tx_wset *wset)
+{
+	VEC_DELETE(&wset->entries);
+	Free(wset->buf);
+	wset->buf = NULL;
+	wset->buf_size = 0;
+	wset->buf_capacity = 0;
+	wset->buf_dead = 0;
+	wset->log_nbytes = 0;
+}
+
+/*
+ * tx_data_get -- (internal) returns a transaction entry, reusing one retained
+ *	by a previous transaction of the thread if possible
+ */
+static struct tx_data *
+tx_data_get(struct tx *tx)
+{
+	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries_cache);
+	if (txd != NULL) {
+		PMDK_SLIST_REMOVE_HEAD(&tx->tx_entries_cache, tx_entry);
+		return txd;
+	}
+
+	txd = Malloc(sizeof(*txd));
+	if (txd == NULL)
+		ERR("!Malloc");
+
+	return txd;
+}
+
+/*
+ * tx_data_put -- (internal) retains a transaction entry for reuse
+ */
+static void
+tx_data_put(struct tx *tx, struct tx_data *txd)
+{
+	PMDK_SLIST_INSERT_HEAD(&tx->tx_entries_cache, txd, tx_entry);
+}
+
+/*
+ * tx_lock_data_get -- (internal) returns a lock entry, reusing one retained
+ *	by a previous transaction of the thread if possible
+ */
+static struct tx_lock_data *
+tx_lock_data_get(struct tx *tx)
+{
+	struct tx_lock_data *txl = PMDK_SLIST_FIRST(&tx->tx_locks_cache);
+	if (txl != NULL) {
+		PMDK_SLIST_REMOVE_HEAD(&tx->tx_locks_cache, tx_lock);
+		return txl;
+	}
+
+	return Malloc(sizeof(*txl));
+}
+
+/*
+ * tx_lock_data_put -- (internal) retains a lock entry for reuse
+ */
+static void
+tx_lock_data_put(struct tx *tx, struct tx_lock_data *txl)
+{
+	PMDK_SLIST_INSERT_HEAD(&tx->tx_locks_cache, txl, tx_lock);
+}
+
+/*
+ * TX_VEC_RETAIN -- clears the vector for reuse by the next transaction,
+ *	or frees it if it grew too large to be worth keeping
+ */
+#define TX_VEC_RETAIN(vec) do {\
+	if (VEC_CAPACITY(vec) > TX_VEC_RETAIN_MAX)\
+		VEC_DELETE(vec);\
+	else\
+		VEC_CLEAR(vec);\
+} while (0)
+
+/*
+ * tx_thread_destroy -- (internal) frees the per-thread transaction state
+ */
+static void
+tx_thread_destroy(void *arg)
+{
+	struct tx *tx = arg;
+
+	tx_ranges_delete(&tx->ranges);
+
+	while (!PMDK_SLIST_EMPTY(&tx->tx_entries_cache)) {
+		struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries_cache);
+		PMDK_SLIST_REMOVE_HEAD(&tx->tx_entries_cache, tx_entry);
+		Free(txd);
+	}
+
+	while (!PMDK_SLIST_EMPTY(&tx->tx_locks_cache)) {
+		struct tx_lock_data *txl =
+			PMDK_SLIST_FIRST(&tx->tx_locks_cache);
+		PMDK_SLIST_REMOVE_HEAD(&tx->tx_locks_cache, tx_lock);
+		Free(txl);
+	}
+
+	VEC_DELETE(&tx->actions);
+	VEC_DELETE(&tx->redo_userbufs);
+	tx_wset_delete(&tx->wset);
+	tx->tls_registered = 0;
+}
+
+/*
+ * tx_boot -- initializes the key used to free the per-thread transaction
+ *	state when a thread exits
+ */
+void
+tx_boot(void)
+{
+	int result = os_tls_key_create(&Tx_key, tx_thread_destroy);
+	if (result != 0) {
+		errno = result;
+		FATAL("!os_tls_key_create");
+	}
+}
+
+/*
+ * tx_fini -- frees the transaction state of the current thread and deletes
+ *	the per-thread key
+ */
+void
+tx_fini(void)
+{
+	tx_thread_destroy(get_tx());
+	(void) os_tls_key_delete(Tx_key);
+}
+
+/*
+ * tx_post_commit_queue_new -- (internal) creates a new, disabled, post commit
+ *	queue
+ */
+static struct tx_post_commit_queue *
+tx_post_commit_queue_new(void)
+{
+	struct tx_post_commit_queue *q = Malloc(sizeof(*q));
+	if (q == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	util_mutex_init(&q->lock);
+	os_cond_init(&q->cond);
+	q->stop = 0;
+	q->nworkers = 0;
+	q->depth = 0;
+	q->head = 0;
+	q->ntasks = 0;
+	q->lanes = NULL;
+
+	return q;
+}
+
+/*
+ * tx_post_commit_queue_stop -- (internal) stops all post commit workers,
+ *	returns once all of them have performed the queued tasks and exited
+ */
+static void
+tx_post_commit_queue_stop(struct tx_post_commit_queue *q)
+{
+	util_mutex_lock(&q->lock);
+
+	q->stop = 1;
+	os_cond_broadcast(&q->cond);
+	while (q->nworkers != 0)
+		os_cond_wait(&q->cond, &q->lock);
+	q->stop = 0;
+
+	util_mutex_unlock(&q->lock);
+}
+
+/*
+ * tx_post_commit_queue_delete -- (internal) stops the workers and deletes the
+ *	post commit queue
+ */
+static void
+tx_post_commit_queue_delete(struct tx_post_commit_queue *q)
+{
+	/* the workers must not outlive the queue */
+	tx_post_commit_queue_stop(q);
+
+	/* tasks are queued only if there are workers, which drain the queue */
+	ASSERTeq(q->ntasks, 0);
+
+	os_cond_destroy(&q->cond);
+	util_mutex_destroy(&q->lock);
+	Free(q->lanes);
+	Free(q);
+}
+
 /*
  * tx_params_new -- creates a new transactional parameters instance and fills it
  *	with default values.
@@ -139,6 +887,31 @@ tx_params_new(void)
 		return NULL;
 
 	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	tx_params->commit_group_window_ns = 0;
+	tx_params->log_retain_bytes = 0;
+
+	struct tx_post_commit_queue *q = tx_post_commit_queue_new();
+	if (q == NULL) {
+		Free(tx_params);
+		return NULL;
+	}
+
+	struct tx_commit_group *group = Malloc(sizeof(*group));
+	if (group == NULL) {
+		tx_post_commit_queue_delete(q);
+		Free(tx_params);
+		return NULL;
+	}
+
+	util_mutex_init(&group->lock);
+	os_cond_init(&group->cond);
+	os_cond_init(&group->join);
+	group->open = NULL;
+	group->nmembers = 0;
+	group->nactive = 0;
+
+	tx_params->commit_group = group;
+	tx_params->post_commit = q;
 
 	return tx_params;
 }
@@ -149,6 +922,16 @@ tx_params_new(void)
 void
 tx_params_delete(struct tx_parameters *tx_params)
 {
+	tx_post_commit_queue_delete(tx_params->post_commit);
+
+	struct tx_commit_group *group = tx_params->commit_group;
+
+	ASSERTeq(group->open, NULL);
+	os_cond_destroy(&group->join);
+	os_cond_destroy(&group->cond);
+	util_mutex_destroy(&group->lock);
+	Free(group);
+
 	Free(tx_params);
 }
 
@@ -194,13 +977,14 @@ obj_tx_fail_null(int errnum, uint64_t flags)
 } while (0)
 
 /*
- * tx_action_reserve -- (internal) reserve space for the given number of actions
+ * tx_redo_reserve -- (internal) reserve space in the redo log for the actions
+ *	and the write set of the transaction, and the given number of bytes
  */
 static int
-tx_action_reserve(struct tx *tx, size_t n)
+tx_redo_reserve(struct tx *tx, size_t nbytes)
 {
-	size_t entries_size = (VEC_SIZE(&tx->actions) + n) *
-		sizeof(struct ulog_entry_val);
+	size_t entries_size = nbytes + tx->wset.log_nbytes +
+		VEC_SIZE(&tx->actions) * sizeof(struct ulog_entry_val);
 
 	/* take the provided user buffers into account when reserving */
 	entries_size -= MIN(tx->redo_userbufs_capacity, entries_size);
@@ -211,6 +995,15 @@ tx_action_reserve(struct tx *tx, size_t n)
 	return 0;
 }
 
+/*
+ * tx_action_reserve -- (internal) reserve space for the given number of actions
+ */
+static int
+tx_action_reserve(struct tx *tx, size_t n)
+{
+	return tx_redo_reserve(tx, n * sizeof(struct ulog_entry_val));
+}
+
 /*
  * tx_action_add -- (internal) reserve space and add a new tx action
  */
@@ -413,7 +1206,7 @@ tx_abort_set(PMEMobjpool *pop, struct lane *lane)
 {
 	LOG(7, NULL);
 
-	ulog_foreach_entry((struct ulog *)&lane->layout->undo,
+	ulog_foreach_entry(OBJ_LANE_UNDO(pop, lane->layout),
 		tx_undo_entry_apply, NULL, &pop->p_ops);
 	operation_finish(lane->undo, ULOG_INC_FIRST_GEN_NUM);
 }
@@ -455,12 +1248,129 @@ tx_pre_commit(struct tx *tx)
 {
 	LOG(5, NULL);
 
-	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
-	tx->ranges = NULL;
+	/* Flush all regions and clear the index. */
+	tx_ranges_clear(&tx->ranges, tx_flush_range, tx->pop);
 }
 
 
+/*
+ * tx_commit_group_activate -- (internal) counts a transaction that can join
+ *	a commit group
+ */
+static void
+tx_commit_group_activate(struct tx_commit_group *group)
+{
+	util_fetch_and_add64(&group->nactive, 1);
+}
+
+/*
+ * tx_commit_group_deactivate -- (internal) uncounts a finished transaction,
+ *	the leader of the open group might no longer have to wait for it
+ */
+static void
+tx_commit_group_deactivate(struct tx_commit_group *group)
+{
+	util_fetch_and_sub64(&group->nactive, 1);
+
+	util_mutex_lock(&group->lock);
+	if (group->open != NULL)
+		os_cond_signal(&group->join);
+	util_mutex_unlock(&group->lock);
+}
+
+/*
+ * tx_commit_group_deadline -- (internal) calculates the absolute time at
+ *	which the group window, starting now, ends
+ */
+static void
+tx_commit_group_deadline(struct timespec *deadline, uint64_t window_ns)
+{
+	os_clock_gettime(CLOCK_REALTIME, deadline);
+
+	uint64_t nsec = (uint64_t)deadline->tv_nsec + window_ns;
+	deadline->tv_sec += (time_t)(nsec / 1000000000ULL);
+	deadline->tv_nsec = (long)(nsec % 1000000000ULL);
+}
+
+/*
+ * tx_pre_commit_group -- (internal) pre-commit phase of a transaction that
+ *	shares the flushes and the drain with the transactions concurrently
+ *	committed by other threads
+ *
+ * Cache line flushes are coherent, so the leader of the group can flush the
+ * ranges modified by the other members once their stores are visible to it
+ * (which is guaranteed by the group lock). Non-temporal stores, however,
+ * are only ordered by a fence issued by the thread that made them, which is
+ * why every member drains on its own before joining the group. This drain
+ * is cheap, as there are no outstanding flushes at that point.
+ */
+static void
+tx_pre_commit_group(struct tx *tx)
+{
+	PMEMobjpool *pop = tx->pop;
+	struct tx_commit_group *group = pop->tx_params->commit_group;
+	uint64_t window_ns = pop->tx_params->commit_group_window_ns;
+
+	struct tx_commit_group_member self;
+	self.tx = tx;
+	self.done = 0;
+
+	pmemops_drain(&pop->p_ops);
+
+	util_mutex_lock(&group->lock);
+
+	if (group->open != NULL) {
+		/* follower, the leader will flush and drain for us */
+		PMDK_SLIST_INSERT_HEAD(group->open, &self, next);
+		group->nmembers++;
+		os_cond_signal(&group->join);
+
+		while (!self.done)
+			os_cond_wait(&group->cond, &group->lock);
+
+		util_mutex_unlock(&group->lock);
+		return;
+	}
+
+	struct tx_commit_group_members members;
+	PMDK_SLIST_INIT(&members);
+	PMDK_SLIST_INSERT_HEAD(&members, &self, next);
+	group->open = &members;
+	group->nmembers = 1;
+
+	struct timespec deadline;
+	tx_commit_group_deadline(&deadline, window_ns);
+	for (;;) {
+		uint64_t nactive;
+		util_atomic_load64(&group->nactive, &nactive);
+
+		/* no other transaction can join the group */
+		if (group->nmembers >= TX_COMMIT_GROUP_MEMBERS_MAX ||
+		    group->nmembers >= nactive)
+			break;
+
+		if (os_cond_timedwait(&group->join, &group->lock,
+		    &deadline) != 0)
+			break;
+	}
+
+	group->open = NULL;
+	group->nmembers = 0;
+	util_mutex_unlock(&group->lock);
+
+	struct tx_commit_group_member *m;
+	PMDK_SLIST_FOREACH(m, &members, next)
+		tx_pre_commit(m->tx);
+
+	pmemops_drain(&pop->p_ops);
+
+	util_mutex_lock(&group->lock);
+	PMDK_SLIST_FOREACH(m, &members, next)
+		m->done = 1;
+	os_cond_broadcast(&group->cond);
+	util_mutex_unlock(&group->lock);
+}
+
 /*
  * tx_abort -- (internal) abort all allocated objects
  */
@@ -473,10 +1383,9 @@ tx_abort(PMEMobjpool *pop, struct lane *lane)
 
 	tx_abort_set(pop, lane);
 
-	ravl_delete_cb(tx->ranges, tx_clean_range, pop);
+	tx_ranges_clear(&tx->ranges, tx_clean_range, pop);
 	palloc_cancel(&pop->heap,
 		VEC_ARR(&tx->actions), VEC_SIZE(&tx->actions));
-	tx->ranges = NULL;
 }
 
 /*
@@ -505,7 +1414,7 @@ add_to_tx_and_lock(struct tx *tx, enum pobj_tx_param type, void *lock)
 			return 0;
 	}
 
-	txl = Malloc(sizeof(*txl));
+	txl = tx_lock_data_get(tx);
 	if (txl == NULL)
 		return ENOMEM;
 
@@ -540,7 +1449,7 @@ add_to_tx_and_lock(struct tx *tx, enum pobj_tx_param type, void *lock)
 
 err:
 	errno = retval;
-	Free(txl);
+	tx_lock_data_put(tx, txl);
 
 	return retval;
 }
@@ -571,13 +1480,13 @@ release_and_free_tx_locks(struct tx *tx)
 				ASSERT(0);
 				break;
 		}
-		Free(tx_lock);
+		tx_lock_data_put(tx, tx_lock);
 	}
 }
 
 /*
- * tx_lane_ranges_insert_def -- (internal) allocates and inserts a new range
- *	definition into the ranges tree
+ * tx_lane_ranges_insert_def -- (internal) inserts a new range definition
+ *	into the ranges index
  */
 static int
 tx_lane_ranges_insert_def(PMEMobjpool *pop, struct tx *tx,
@@ -586,9 +1495,9 @@ tx_lane_ranges_insert_def(PMEMobjpool *pop, struct tx *tx,
 	LOG(3, "rdef->offset %"PRIu64" rdef->size %"PRIu64,
 		rdef->offset, rdef->size);
 
-	int ret = ravl_emplace_copy(tx->ranges, rdef);
+	int ret = tx_ranges_insert(&tx->ranges, rdef);
 	if (ret && errno == EEXIST)
-		FATAL("invalid state of ranges tree");
+		FATAL("invalid state of ranges index");
 	return ret;
 }
 
@@ -760,28 +1669,39 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		VALGRIND_START_TX;
 
 		lane_hold(pop, &tx->lane);
+		operation_set_ulog_retain(tx->lane->undo,
+			pop->tx_params->log_retain_bytes);
 		operation_start(tx->lane->undo);
 
-		VEC_INIT(&tx->actions);
-		VEC_INIT(&tx->redo_userbufs);
+		ASSERTeq(VEC_SIZE(&tx->actions), 0);
+		ASSERTeq(VEC_SIZE(&tx->redo_userbufs), 0);
+		ASSERTeq(VEC_SIZE(&tx->wset.entries), 0);
 		tx->redo_userbufs_capacity = 0;
 		PMDK_SLIST_INIT(&tx->tx_entries);
 		PMDK_SLIST_INIT(&tx->tx_locks);
 
-		tx->ranges = ravl_new_sized(tx_range_def_cmp,
-			sizeof(struct tx_range_def));
+		ASSERTeq(VEC_SIZE(&tx->ranges.flat), 0);
+		ASSERTeq(tx->ranges.tree, NULL);
+		if (!tx->tls_registered) {
+			os_tls_set(Tx_key, tx);
+			tx->tls_registered = 1;
+		}
 
 		tx->pop = pop;
 
 		tx->first_snapshot = 1;
+
+		if (pop->tx_params->commit_group_window_ns != 0) {
+			tx_commit_group_activate(pop->tx_params->commit_group);
+			tx->commit_group_active = 1;
+		}
 	} else {
 		FATAL("Invalid stage %d to begin new transaction", tx->stage);
 	}
 
-	struct tx_data *txd = Malloc(sizeof(*txd));
+	struct tx_data *txd = tx_data_get(tx);
 	if (txd == NULL) {
 		err = errno;
-		ERR("!Malloc");
 		goto err_abort;
 	}
 
@@ -965,10 +1885,123 @@ pmemobj_tx_errno(void)
 	return get_tx()->last_errnum;
 }
 
+/*
+ * tx_post_commit -- (internal) performs the cleanup of the undo log of
+ *	a committed transaction
+ *
+ * The transaction is already committed at this point (the redo log
+ * processed during commit invalidates the undo log), so this work can be
+ * safely done asynchronously.
+ */
 static void
-tx_post_commit(struct tx *tx)
+tx_post_commit(struct lane *lane)
+{
+	operation_finish(lane->undo, 0);
+}
+
+/*
+ * tx_post_commit_enqueue -- (internal) hands over the lane of a committed
+ *	transaction to the post commit workers, returns 0 on success
+ *
+ * The task isn't queued (and has to be performed by the committing thread)
+ * if there are no running workers or if the queue is full.
+ */
+static int
+tx_post_commit_enqueue(PMEMobjpool *pop)
+{
+	struct tx_post_commit_queue *q = pop->tx_params->post_commit;
+
+	int ret = -1;
+	unsigned lane_idx;
+
+	util_mutex_lock(&q->lock);
+
+	if (q->nworkers == 0 || q->stop || q->ntasks == q->depth)
+		goto out;
+
+	if (lane_detach(pop, &lane_idx) != 0)
+		goto out;
+
+	q->lanes[(q->head + q->ntasks) % q->depth] = lane_idx;
+	q->ntasks++;
+	os_cond_broadcast(&q->cond);
+	ret = 0;
+
+out:
+	util_mutex_unlock(&q->lock);
+	return ret;
+}
+
+/*
+ * tx_post_commit_worker -- (internal) performs the queued post commit tasks
+ *	until the workers are stopped and the queue is empty, returns -1 if the
+ *	queue is disabled
+ */
+static int
+tx_post_commit_worker(PMEMobjpool *pop, struct tx_post_commit_queue *q)
+{
+	util_mutex_lock(&q->lock);
+
+	if (q->depth == 0) {
+		util_mutex_unlock(&q->lock);
+		return -1;
+	}
+
+	q->nworkers++;
+
+	for (;;) {
+		while (q->ntasks == 0 && !q->stop)
+			os_cond_wait(&q->cond, &q->lock);
+
+		if (q->ntasks == 0)
+			break;
+
+		unsigned lane_idx = q->lanes[q->head];
+		q->head = (q->head + 1) % q->depth;
+		q->ntasks--;
+
+		util_mutex_unlock(&q->lock);
+
+		LOG(5, "post commit of lane %u", lane_idx);
+
+		struct lane *lane = lane_attach(pop, lane_idx);
+		tx_post_commit(lane);
+		lane_release(pop);
+
+		util_mutex_lock(&q->lock);
+	}
+
+	q->nworkers--;
+	os_cond_broadcast(&q->cond);
+	util_mutex_unlock(&q->lock);
+
+	return 0;
+}
+
+/*
+ * tx_wset_commit -- (internal) adds the write set of the transaction to the
+ *	redo log and makes sure that there's enough space left in the log for
+ *	the actions, aborts the transaction on failure
+ */
+static int
+tx_wset_commit(struct tx *tx)
 {
-	operation_finish(tx->lane->undo, 0);
+	struct operation_context *ctx = tx->lane->external;
+
+	if (tx_wset_log(&tx->wset, tx->pop, ctx) == 0 &&
+	    operation_reserve_entries(ctx, VEC_SIZE(&tx->actions) *
+	    sizeof(struct ulog_entry_val)) == 0)
+		return 0;
+
+	ERR("cannot log the write set of the transaction");
+
+	operation_cancel(ctx);
+	if (VEC_SIZE(&tx->redo_userbufs) != 0)
+		operation_free_logs(ctx, ULOG_ANY_USER_BUFFER);
+
+	obj_tx_abort(ENOMEM, 0);
+
+	return -1;
 }
 
 /*
@@ -997,23 +2030,39 @@ pmemobj_tx_commit(void)
 
 		PMEMobjpool *pop = tx->pop;
 
-		/* pre-commit phase */
-		tx_pre_commit(tx);
-
-		pmemops_drain(&pop->p_ops);
-
 		operation_start(tx->lane->external);
 
 		struct user_buffer_def *userbuf;
 		VEC_FOREACH_BY_PTR(userbuf, &tx->redo_userbufs)
 			operation_add_user_buffer(tx->lane->external, userbuf);
 
+		/*
+		 * The write set is logged before the pre-commit phase, which
+		 * flushes and forgets the snapshotted ranges, because it's
+		 * the last step that can still abort the transaction.
+		 */
+		if (VEC_SIZE(&tx->wset.entries) != 0 &&
+		    tx_wset_commit(tx) != 0) {
+			PMEMOBJ_API_END();
+			return;
+		}
+
+		/* pre-commit phase */
+		if (pop->tx_params->commit_group_window_ns != 0 &&
+				!On_valgrind) {
+			tx_pre_commit_group(tx);
+		} else {
+			tx_pre_commit(tx);
+			pmemops_drain(&pop->p_ops);
+		}
+
 		palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
 			VEC_SIZE(&tx->actions), tx->lane->external);
 
-		tx_post_commit(tx);
-
-		lane_release(pop);
+		if (tx_post_commit_enqueue(pop) != 0) {
+			tx_post_commit(tx->lane);
+			lane_release(pop);
+		}
 
 		tx->lane = NULL;
 	}
@@ -1051,7 +2100,7 @@ pmemobj_tx_end(void)
 	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
 	PMDK_SLIST_REMOVE_HEAD(&tx->tx_entries, tx_entry);
 
-	Free(txd);
+	tx_data_put(tx, txd);
 
 	VALGRIND_END_TX;
 
@@ -1059,10 +2108,21 @@ pmemobj_tx_end(void)
 		ASSERTeq(tx->lane, NULL);
 
 		release_and_free_tx_locks(tx);
+
+		if (tx->commit_group_active) {
+			tx_commit_group_deactivate(
+				tx->pop->tx_params->commit_group);
+			tx->commit_group_active = 0;
+		}
+
 		tx->pop = NULL;
 		tx->stage = TX_STAGE_NONE;
-		VEC_DELETE(&tx->actions);
-		VEC_DELETE(&tx->redo_userbufs);
+		TX_VEC_RETAIN(&tx->actions);
+		TX_VEC_RETAIN(&tx->redo_userbufs);
+		if (tx->wset.buf_capacity > TX_WSET_RETAIN_MAX)
+			tx_wset_delete(&tx->wset);
+		else
+			tx_wset_clear(&tx->wset);
 
 		if (tx->stage_callback) {
 			pmemobj_tx_callback cb = tx->stage_callback;
@@ -1179,7 +2239,8 @@ pmemobj_tx_add_snapshot(struct tx *tx, struct tx_range_def *snapshot)
 		if (action == NULL)
 			return -1;
 
-		uint64_t *n = &tx->lane->layout->undo.gen_num;
+		struct ulog *undo = OBJ_LANE_UNDO(tx->pop, tx->lane->layout);
+		uint64_t *n = &undo->gen_num;
 		palloc_set_value(&tx->pop->heap, action,
 			n, *n + 1);
 
@@ -1235,16 +2296,15 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 	 * snapshot.
 	 */
 	struct tx_range_def r = *args;
-	struct tx_range_def search = {0, 0, 0};
 	/*
 	 * If the range is directly adjacent to an existing one,
 	 * they can be merged, so search for less or equal elements.
 	 */
 	enum ravl_predicate p = RAVL_PREDICATE_LESS_EQUAL;
-	struct ravl_node *nprev = NULL;
+	struct tx_range_def *fprev = NULL;
 	while (r.size != 0) {
-		search.offset = r.offset + r.size;
-		struct ravl_node *n = ravl_find(tx->ranges, &search, p);
+		struct tx_range_def *f = tx_ranges_find(&tx->ranges,
+			r.offset + r.size, p);
 		/*
 		 * We have to skip searching for LESS_EQUAL because
 		 * the snapshot we would find is the one that was just
@@ -1252,8 +2312,6 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 		 */
 		p = RAVL_PREDICATE_LESS;
 
-		struct tx_range_def *f = n ? ravl_data(n) : NULL;
-
 		size_t fend = f == NULL ? 0: f->offset + f->size;
 		size_t rend = r.offset + r.size;
 		if (fend == 0 || fend < r.offset) {
@@ -1269,13 +2327,12 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			 * or	+--- (no overlap)
 			 * or	---+ (adjacent on on right side)
 			 */
-			if (nprev != NULL) {
+			if (fprev != NULL) {
 				/*
 				 * But, if we have an existing adjacent snapshot
 				 * on the right side, we can just extend it to
 				 * include the desired range.
 				 */
-				struct tx_range_def *fprev = ravl_data(nprev);
 				ASSERTeq(rend, fprev->offset);
 				fprev->offset -= r.size;
 				fprev->size += r.size;
@@ -1327,12 +2384,11 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			 * If there's a snapshot adjacent on right side, merge
 			 * the two ranges together.
 			 */
-			if (nprev != NULL) {
-				struct tx_range_def *fprev = ravl_data(nprev);
+			if (fprev != NULL) {
 				ASSERTeq(rend, fprev->offset);
 				f->size += fprev->size;
 				pmemobj_tx_merge_flags(f, fprev);
-				ravl_remove(tx->ranges, nprev);
+				tx_ranges_remove(&tx->ranges, fprev);
 			}
 		} else if (fend >= r.offset) {
 			/*
@@ -1351,7 +2407,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			 * on this information without risking overwritting an
 			 * existing one. We have to continue iterating, but we
 			 * keep the information about adjacent snapshots in the
-			 * nprev variable.
+			 * fprev variable.
 			 */
 			size_t overlap = rend - MAX(f->offset, r.offset);
 			r.size -= overlap;
@@ -1360,7 +2416,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			ASSERT(0);
 		}
 
-		nprev = n;
+		fprev = f;
 	}
 
 	if (ret != 0) {
@@ -1527,6 +2583,133 @@ pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
 	return ret;
 }
 
+/*
+ * pmemobj_tx_xwrite -- buffers a write to an object in the write set of the
+ *	transaction
+ */
+int
+pmemobj_tx_xwrite(PMEMoid oid, uint64_t off, const void *src, size_t size,
+	uint64_t flags)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret = 0;
+
+	if (flags & ~POBJ_XWRITE_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64, flags
+			& ~POBJ_XWRITE_VALID_FLAGS);
+		ret = obj_tx_fail_err(EINVAL, flags);
+		goto out;
+	}
+
+	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		ERR("invalid pool uuid");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		goto out;
+	}
+	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
+
+	uint64_t offset = oid.off + off;
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("write size too large");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		goto out;
+	}
+
+	if (offset < tx->pop->heap_offset ||
+		(offset + size) >
+		(tx->pop->heap_offset + tx->pop->heap_size)) {
+		ERR("object outside of heap");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		goto out;
+	}
+
+	if (size == 0)
+		goto out;
+
+	struct tx_wset_entry e = {offset, size, 0};
+	if (tx_redo_reserve(tx, tx_wset_entry_log_nbytes(&e)) != 0) {
+		ERR("cannot reserve space for the write in the redo log");
+		ret = obj_tx_fail_err(ENOMEM, flags);
+		goto out;
+	}
+
+	if (tx_wset_add(&tx->wset, offset, src, size) != 0) {
+		ERR("cannot add the write to the write set");
+		ret = obj_tx_fail_err(ENOMEM, flags);
+		goto out;
+	}
+
+out:
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_write -- buffers a write to an object in the write set of the
+ *	transaction
+ */
+int
+pmemobj_tx_write(PMEMoid oid, uint64_t off, const void *src, size_t size)
+{
+	return pmemobj_tx_xwrite(oid, off, src, size, 0);
+}
+
+/*
+ * pmemobj_tx_read -- reads an object, taking into account the writes
+ *	buffered in the write set of the transaction
+ */
+int
+pmemobj_tx_read(PMEMoid oid, uint64_t off, void *dest, size_t size)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret = 0;
+
+	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		ERR("invalid pool uuid");
+		ret = obj_tx_fail_err(EINVAL, 0);
+		goto out;
+	}
+	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
+
+	uint64_t offset = oid.off + off;
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("read size too large");
+		ret = obj_tx_fail_err(EINVAL, 0);
+		goto out;
+	}
+
+	if (offset < tx->pop->heap_offset ||
+		(offset + size) >
+		(tx->pop->heap_offset + tx->pop->heap_size)) {
+		ERR("object outside of heap");
+		ret = obj_tx_fail_err(EINVAL, 0);
+		goto out;
+	}
+
+	memcpy(dest, OBJ_OFF_TO_PTR(tx->pop, offset), size);
+	tx_wset_read(&tx->wset, offset, dest, size);
+
+out:
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /*
  * pmemobj_tx_alloc -- allocates a new object
  */
@@ -1808,23 +2991,21 @@ pmemobj_tx_xfree(PMEMoid oid, uint64_t flags)
 
 	struct pobj_action *action;
 
-	struct tx_range_def range = {oid.off, 0, 0};
-	struct ravl_node *n = ravl_find(tx->ranges, &range,
+	struct tx_range_def *r = tx_ranges_find(&tx->ranges, oid.off,
 		RAVL_PREDICATE_EQUAL);
 
 	/*
 	 * If attempting to free an object allocated within the same
 	 * transaction, simply cancel the alloc and remove it from the actions.
 	 */
-	if (n != NULL) {
+	if (r != NULL) {
 		VEC_FOREACH_BY_PTR(action, &tx->actions) {
 			if (action->type == POBJ_ACTION_TYPE_HEAP &&
 				action->heap.offset == oid.off) {
-				struct tx_range_def *r = ravl_data(n);
 				void *ptr = OBJ_OFF_TO_PTR(pop, r->offset);
 				VALGRIND_SET_CLEAN(ptr, r->size);
 				VALGRIND_REMOVE_FROM_TX(ptr, r->size);
-				ravl_remove(tx->ranges, n);
+				tx_ranges_remove(&tx->ranges, r);
 				palloc_cancel(&pop->heap, action, 1);
 				VEC_ERASE_BY_PTR(&tx->actions, action);
 				PMEMOBJ_API_END();
@@ -2211,6 +3392,15 @@ static int
 CTL_READ_HANDLER(queue_depth)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+	struct tx_post_commit_queue *q = pop->tx_params->post_commit;
+
+	int *arg_out = arg;
+
+	util_mutex_lock(&q->lock);
+	*arg_out = (int)q->depth;
+	util_mutex_unlock(&q->lock);
+
 	return 0;
 }
 
@@ -2221,28 +3411,87 @@ static int
 CTL_WRITE_HANDLER(queue_depth)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+	struct tx_post_commit_queue *q = pop->tx_params->post_commit;
+
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0 || arg_in > TX_POST_COMMIT_QUEUE_DEPTH_MAX) {
+		errno = EINVAL;
+		ERR("invalid queue depth, must be between 0 and %d",
+			TX_POST_COMMIT_QUEUE_DEPTH_MAX);
+		return -1;
+	}
+
+	unsigned *lanes = NULL;
+	if (arg_in != 0) {
+		lanes = Malloc(sizeof(*lanes) * (size_t)arg_in);
+		if (lanes == NULL) {
+			ERR("!Malloc");
+			return -1;
+		}
+	}
+
+	util_mutex_lock(&q->lock);
+
+	if (q->nworkers != 0) {
+		util_mutex_unlock(&q->lock);
+		Free(lanes);
+
+		errno = EBUSY;
+		ERR("cannot change the queue depth with running workers");
+		return -1;
+	}
+
+	/* tasks are queued only if there are workers, which drain the queue */
+	ASSERTeq(q->ntasks, 0);
+
+	unsigned *old_lanes = q->lanes;
+	q->lanes = lanes;
+	q->depth = (unsigned)arg_in;
+	q->head = 0;
+
+	util_mutex_unlock(&q->lock);
+
+	Free(old_lanes);
+
 	return 0;
 }
 
 static const struct ctl_argument CTL_ARG(queue_depth) = CTL_ARG_INT;
 
 /*
- * CTL_READ_HANDLER(worker) -- launches the post commit worker thread function
+ * CTL_READ_HANDLER(worker) -- turns the calling thread into a post commit
+ * worker, returns once the workers are stopped
  */
 static int
 CTL_READ_HANDLER(worker)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+	struct tx_post_commit_queue *q = pop->tx_params->post_commit;
+
+	if (tx_post_commit_worker(pop, q) != 0) {
+		errno = EINVAL;
+		ERR("post commit queue depth is not set");
+		return -1;
+	}
+
 	return 0;
 }
 
 /*
- * CTL_READ_HANDLER(stop) -- stops all post commit workers
+ * CTL_READ_HANDLER(stop) -- stops all post commit workers, returns once
+ * all of them have exited
  */
 static int
 CTL_READ_HANDLER(stop)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+
+	tx_post_commit_queue_stop(pop->tx_params->post_commit);
+
 	return 0;
 }
 
@@ -2254,10 +3503,110 @@ static const struct ctl_node CTL_NODE(post_commit)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(group_window_ns) -- returns the time a committing
+ * transaction waits for other transactions to join its commit group
+ */
+static int
+CTL_READ_HANDLER(group_window_ns)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long *arg_out = arg;
+
+	*arg_out = (long long)pop->tx_params->commit_group_window_ns;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(group_window_ns) -- sets the time a committing
+ * transaction waits for other transactions to join its commit group
+ */
+static int
+CTL_WRITE_HANDLER(group_window_ns)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > TX_COMMIT_GROUP_WINDOW_MAX) {
+		errno = EINVAL;
+		ERR("invalid group window, must be between 0 and %d",
+			TX_COMMIT_GROUP_WINDOW_MAX);
+		return -1;
+	}
+
+	pop->tx_params->commit_group_window_ns = (uint64_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(group_window_ns) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(commit)[] = {
+	CTL_LEAF_RW(group_window_ns),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(retain_bytes) -- returns the capacity of the undo log
+ * extensions which are kept by each lane between transactions
+ */
+static int
+CTL_READ_HANDLER(retain_bytes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long *arg_out = arg;
+
+	*arg_out = (long long)pop->tx_params->log_retain_bytes;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(retain_bytes) -- sets the capacity of the undo log
+ * extensions which are kept by each lane between transactions
+ */
+static int
+CTL_WRITE_HANDLER(retain_bytes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0 || arg_in > (long long)TX_LOG_RETAIN_BYTES_MAX) {
+		errno = EINVAL;
+		ERR("invalid log retain size, must be between 0 and %llu",
+			TX_LOG_RETAIN_BYTES_MAX);
+		return -1;
+	}
+
+	pop->tx_params->log_retain_bytes = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(retain_bytes) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(log)[] = {
+	CTL_LEAF_RW(retain_bytes),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(tx)[] = {
 	CTL_CHILD(debug),
 	CTL_CHILD(cache),
 	CTL_CHILD(post_commit),
+	CTL_CHILD(commit),
+	CTL_CHILD(log),
 
 	CTL_NODE_END
 };
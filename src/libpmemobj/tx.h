@@ -61,8 +61,30 @@ extern "C" {
 #define TX_INTENT_LOG_BUFFER_OVERHEAD sizeof(struct ulog)
 #define TX_INTENT_LOG_ENTRY_OVERHEAD sizeof(struct ulog_entry_val)
 
+/* maximum time a committing transaction can wait for its commit group */
+#define TX_COMMIT_GROUP_WINDOW_MAX 1000000 /* 1 millisecond */
+
+/* maximum number of post commit tasks waiting for a worker */
+#define TX_POST_COMMIT_QUEUE_DEPTH_MAX 1024
+
+/* maximum capacity of the undo log extensions retained by a single lane */
+#define TX_LOG_RETAIN_BYTES_MAX (1ULL << 30)
+
+struct tx_commit_group;
+struct tx_post_commit_queue;
+
 struct tx_parameters {
 	size_t cache_size;
+
+	/* capacity of the undo log extensions kept by a lane, see memops.c */
+	size_t log_retain_bytes;
+
+	/* 0 disables group commit */
+	uint64_t commit_group_window_ns;
+	struct tx_commit_group *commit_group;
+
+	/* post commit tasks are performed by the committer if it's disabled */
+	struct tx_post_commit_queue *post_commit;
 };
 
 /*
@@ -73,6 +95,9 @@ PMEMobjpool *tx_get_pop(void);
 
 void tx_ctl_register(PMEMobjpool *pop);
 
+void tx_boot(void);
+void tx_fini(void);
+
 struct tx_parameters *tx_params_new(void);
 void tx_params_delete(struct tx_parameters *tx_params);
 
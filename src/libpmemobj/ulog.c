@@ -38,6 +38,8 @@
 #include <string.h>
 
 #include "libpmemobj.h"
+#include "alloc.h"
+#include "parallel.h"
 #include "ulog.h"
 #include "out.h"
 #include "util.h"
@@ -56,6 +58,14 @@
 #define IS_CACHELINE_ALIGNED(ptr)\
 	(((uintptr_t)(ptr) & (CACHELINE_SIZE - 1)) == 0)
 
+/* minimum number of entries for which the log is sorted before processing */
+#define ULOG_SORT_MIN_ENTRIES 16
+
+/* minimum number of entries applied by a single thread */
+#define ULOG_APPLY_MIN_ENTRIES_PER_THREAD 1024
+
+unsigned Ulog_apply_threads = 1;
+
 /*
  * ulog_by_offset -- calculates the ulog pointer
  */
@@ -596,6 +606,35 @@ ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 	VALGRIND_REMOVE_FROM_TX(dst, dst_size);
 }
 
+/*
+ * ulog_entry_apply_noflush -- (internal) applies a value entry without
+ *	flushing the modified word
+ */
+static void
+ulog_entry_apply_noflush(const struct ulog_entry_base *e,
+	const struct pmem_ops *p_ops)
+{
+	const struct ulog_entry_val *ev = (const struct ulog_entry_val *)e;
+	uint64_t *dst = (uint64_t *)((uintptr_t)p_ops->base +
+		ulog_entry_offset(e));
+
+	VALGRIND_ADD_TO_TX(dst, sizeof(*dst));
+	switch (ulog_entry_type(e)) {
+		case ULOG_OPERATION_AND:
+			*dst &= ev->value;
+			break;
+		case ULOG_OPERATION_OR:
+			*dst |= ev->value;
+			break;
+		case ULOG_OPERATION_SET:
+			*dst = ev->value;
+			break;
+		default:
+			ASSERT(0);
+	}
+	VALGRIND_REMOVE_FROM_TX(dst, sizeof(*dst));
+}
+
 /*
  * ulog_process_entry -- (internal) processes a single ulog entry
  */
@@ -717,11 +756,14 @@ ulog_clobber(struct ulog *dest, struct ulog_next *next,
 
 /*
  * ulog_clobber_data -- zeroes out 'nbytes' of data in the logs
+ *
+ * The second ulog is always kept for reuse, the following ones only as long
+ * as the total capacity of the kept ulogs does not exceed 'retain' bytes.
  */
 int
 ulog_clobber_data(struct ulog *ulog_first,
 	size_t nbytes, size_t ulog_base_nbytes,
-	struct ulog_next *next, ulog_free_fn ulog_free,
+	struct ulog_next *next, size_t retain, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags)
 {
@@ -777,10 +819,30 @@ ulog_clobber_data(struct ulog *ulog_first,
 		 * each transaction is an acceptable overhead for the average
 		 * case.
 		 */
-		if (flags & ULOG_FREE_AFTER_FIRST)
+		if (flags & ULOG_FREE_AFTER_FIRST) {
 			u = ulog_first;
-		else
+		} else {
+			/*
+			 * Transactions which regularly overflow the first two
+			 * ulogs can keep the following ones as well, which
+			 * saves them allocating and freeing the same logs
+			 * over and over again. Just like the second one, the
+			 * retained ulogs need their generation numbers kept
+			 * consistent with the first ulog. User buffers cannot
+			 * be retained, they are unpinned at the end of the
+			 * transaction.
+			 */
 			u = ulog_second;
+			size_t retained = u == NULL ? 0 : u->capacity;
+			struct ulog *n;
+			while (u != NULL && !(flags & ULOG_ANY_USER_BUFFER) &&
+				(n = ulog_by_offset(u->next, p_ops)) != NULL &&
+				retained + n->capacity <= retain) {
+				ulog_inc_gen_num(n, NULL);
+				retained += n->capacity;
+				u = n;
+			}
+		}
 	}
 
 	if (u == NULL)
@@ -789,12 +851,264 @@ ulog_clobber_data(struct ulog *ulog_first,
 	return ulog_free_next(u, p_ops, ulog_free, user_buff_remove, flags);
 }
 
+/*
+ * ulog_apply_entry -- a log entry along with the range it modifies
+ */
+struct ulog_apply_entry {
+	uint64_t begin; /* offset of the modified range */
+	uint64_t end; /* end of the modified range */
+	size_t seq; /* position of the entry in the log */
+	const struct ulog_entry_base *e;
+};
+
+/*
+ * ulog_apply -- entries of the log sorted by the modified ranges and split
+ *	into parts which do not share any cache lines
+ */
+struct ulog_apply {
+	struct ulog_apply_entry *entries;
+	size_t nentries;
+
+	size_t parts[ULOG_APPLY_THREADS_MAX + 1];
+	size_t nparts;
+
+	const struct pmem_ops *p_ops;
+};
+
+/*
+ * ulog_count_entry -- (internal) counts the valid entries of the log
+ */
+static int
+ulog_count_entry(struct ulog_entry_base *e, void *arg,
+	const struct pmem_ops *p_ops)
+{
+	size_t *nentries = arg;
+	(*nentries)++;
+
+	return 0;
+}
+
+/*
+ * ulog_apply_entry_add -- (internal) appends the entry to the array of the
+ *	entries to be applied
+ */
+static int
+ulog_apply_entry_add(struct ulog_entry_base *e, void *arg,
+	const struct pmem_ops *p_ops)
+{
+	struct ulog_apply *a = arg;
+	struct ulog_apply_entry *ae = &a->entries[a->nentries];
+
+	size_t size = sizeof(uint64_t);
+	switch (ulog_entry_type(e)) {
+		case ULOG_OPERATION_BUF_SET:
+		case ULOG_OPERATION_BUF_CPY:
+			size = ((struct ulog_entry_buf *)e)->size;
+			break;
+		default:
+			break;
+	}
+
+	ae->begin = ulog_entry_offset(e);
+	ae->end = ae->begin + size;
+	ae->seq = a->nentries++;
+	ae->e = e;
+
+	return 0;
+}
+
+/*
+ * ulog_apply_entry_cmp -- (internal) orders the entries by the modified
+ *	ranges, the entries which modify the same range stay in the log order
+ */
+static int
+ulog_apply_entry_cmp(const void *lhs, const void *rhs)
+{
+	const struct ulog_apply_entry *l = lhs;
+	const struct ulog_apply_entry *r = rhs;
+
+	if (l->begin != r->begin)
+		return l->begin < r->begin ? -1 : 1;
+
+	return l->seq < r->seq ? -1 : 1;
+}
+
+/*
+ * ulog_entry_is_buf -- (internal) checks if the entry is a buffer entry
+ */
+static inline int
+ulog_entry_is_buf(const struct ulog_entry_base *e)
+{
+	ulog_operation_type t = ulog_entry_type(e);
+
+	return t == ULOG_OPERATION_BUF_SET || t == ULOG_OPERATION_BUF_CPY;
+}
+
+/*
+ * ulog_apply_disjoint -- (internal) checks if the order in which the sorted
+ *	entries are applied does not change the outcome
+ *
+ * This is the case when the modified ranges do not overlap, apart from the
+ * value entries which modify the same word, as those retain their log order.
+ */
+static int
+ulog_apply_disjoint(const struct ulog_apply *a)
+{
+	for (size_t i = 1; i < a->nentries; ++i) {
+		const struct ulog_apply_entry *prev = &a->entries[i - 1];
+		const struct ulog_apply_entry *curr = &a->entries[i];
+
+		if (curr->begin >= prev->end)
+			continue;
+
+		if (curr->begin == prev->begin && curr->end == prev->end &&
+			!ulog_entry_is_buf(curr->e) &&
+			!ulog_entry_is_buf(prev->e))
+			continue;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * ulog_apply_split -- (internal) splits the sorted entries into at most
+ *	'nthreads' parts, so that no cache line is modified by two parts
+ */
+static void
+ulog_apply_split(struct ulog_apply *a, unsigned nthreads)
+{
+	size_t n = a->nentries;
+	size_t nparts = MIN(nthreads, n / ULOG_APPLY_MIN_ENTRIES_PER_THREAD);
+	if (nparts == 0)
+		nparts = 1;
+
+	a->parts[0] = 0;
+	for (size_t i = 1; i < nparts; ++i) {
+		size_t b = MAX(i * n / nparts, a->parts[i - 1]);
+		while (b < n && b != 0 &&
+			ALIGN_DOWN(a->entries[b].begin, CACHELINE_SIZE) <
+			ALIGN_UP(a->entries[b - 1].end, CACHELINE_SIZE))
+			b++;
+		a->parts[i] = b;
+	}
+	a->parts[nparts] = n;
+	a->nparts = nparts;
+}
+
+/*
+ * ulog_apply_flush -- (internal) flushes the range of the modified lines
+ */
+static inline void
+ulog_apply_flush(const struct pmem_ops *p_ops, uint64_t begin, uint64_t end)
+{
+	if (begin == end)
+		return;
+
+	pmemops_xflush(p_ops, (void *)((uintptr_t)p_ops->base + begin),
+		end - begin, PMEMOBJ_F_RELAXED);
+}
+
+/*
+ * ulog_apply_part -- (internal) applies a single part of the sorted entries,
+ *	all value entries which modify the same or adjacent cache lines are
+ *	flushed together
+ */
+static int
+ulog_apply_part(void *arg, size_t idx)
+{
+	struct ulog_apply *a = arg;
+	const struct pmem_ops *p_ops = a->p_ops;
+
+	uint64_t flush_begin = 0;
+	uint64_t flush_end = 0;
+
+	for (size_t i = a->parts[idx]; i < a->parts[idx + 1]; ++i) {
+		const struct ulog_apply_entry *ae = &a->entries[i];
+
+		if (ulog_entry_is_buf(ae->e)) {
+			/* buffers are flushed by the memcpy/memset */
+			ulog_apply_flush(p_ops, flush_begin, flush_end);
+			flush_begin = flush_end = 0;
+
+			ulog_entry_apply(ae->e, 0, p_ops);
+			continue;
+		}
+
+		uint64_t begin = ALIGN_DOWN(ae->begin, CACHELINE_SIZE);
+		if (begin > flush_end) {
+			ulog_apply_flush(p_ops, flush_begin, flush_end);
+			flush_begin = begin;
+		}
+		flush_end = MAX(flush_end, ALIGN_UP(ae->end, CACHELINE_SIZE));
+
+		ulog_entry_apply_noflush(ae->e, p_ops);
+	}
+
+	ulog_apply_flush(p_ops, flush_begin, flush_end);
+
+	/* each thread has to wait for its own flushes */
+	if (a->nparts > 1)
+		pmemops_drain(p_ops);
+
+	return 0;
+}
+
+/*
+ * ulog_process_sorted -- (internal) applies the entries of the log ordered by
+ *	their destination, returns -1 if the log has to be processed in order
+ */
+static int
+ulog_process_sorted(struct ulog *ulog, unsigned nthreads,
+	const struct pmem_ops *p_ops)
+{
+	size_t nentries = 0;
+	ulog_foreach_entry(ulog, ulog_count_entry, &nentries, p_ops);
+	if (nentries < ULOG_SORT_MIN_ENTRIES)
+		return -1;
+
+	struct ulog_apply a;
+	a.entries = Malloc(nentries * sizeof(*a.entries));
+	if (a.entries == NULL) {
+		LOG(2, "!Malloc");
+		return -1;
+	}
+	a.nentries = 0;
+	a.p_ops = p_ops;
+
+	ulog_foreach_entry(ulog, ulog_apply_entry_add, &a, p_ops);
+	ASSERTeq(a.nentries, nentries);
+
+	qsort(a.entries, a.nentries, sizeof(*a.entries),
+		ulog_apply_entry_cmp);
+
+	if (!ulog_apply_disjoint(&a)) {
+		Free(a.entries);
+		return -1;
+	}
+
+	ulog_apply_split(&a, nthreads);
+	parallel_for(a.nparts, (unsigned)a.nparts, ulog_apply_part, &a);
+
+	Free(a.entries);
+
+	return 0;
+}
+
 /*
  * ulog_process -- process ulog entries
+ *
+ * Large logs are applied in the order of the modified addresses, so that all
+ * the changes to a single cache line are flushed at once, and, if 'nthreads'
+ * is greater than one, ranges which do not share cache lines can be applied
+ * by many threads. ULOG_APPLY_IN_ORDER disables that, for when a flush of
+ * the whole line might cover bytes modified concurrently by other threads
+ * and the flush itself isn't harmless, e.g. it's copied to replicas.
  */
 void
 ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
-	const struct pmem_ops *p_ops)
+	unsigned nthreads, const struct pmem_ops *p_ops)
 {
 	LOG(15, "ulog %p", ulog);
 
@@ -803,6 +1117,10 @@ ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
 		ulog_check(ulog, check, p_ops);
 #endif
 
+	if (nthreads != ULOG_APPLY_IN_ORDER &&
+	    ulog_process_sorted(ulog, nthreads, p_ops) == 0)
+		return;
+
 	ulog_foreach_entry(ulog, ulog_process_entry, NULL, p_ops);
 }
 
@@ -846,16 +1164,17 @@ ulog_recovery_needed(struct ulog *ulog, int verify_checksum)
 /*
  * ulog_recover -- recovery of ulog
  *
- * The ulog_recover shall be preceded by ulog_check call.
+ * The ulog_recover shall be preceded by ulog_check call. 'nthreads' has the
+ * same meaning as in ulog_process.
  */
 void
 ulog_recover(struct ulog *ulog, ulog_check_offset_fn check,
-	const struct pmem_ops *p_ops)
+	unsigned nthreads, const struct pmem_ops *p_ops)
 {
 	LOG(15, "ulog %p", ulog);
 
 	if (ulog_recovery_needed(ulog, 1)) {
-		ulog_process(ulog, check, p_ops);
+		ulog_process(ulog, check, nthreads, p_ops);
 		ulog_clobber(ulog, NULL, p_ops);
 	}
 }
@@ -116,6 +116,18 @@ typedef uint64_t ulog_operation_type;
 /* informs if there was any buffer allocated by user in the tx  */
 #define ULOG_ANY_USER_BUFFER (1U << 2)
 
+/* maximum number of threads which apply a single log */
+#define ULOG_APPLY_THREADS_MAX 64
+
+/*
+ * Number of threads for ulog_process which applies the entries in the log
+ * order and flushes each one on its own, without the sorted application
+ * that flushes whole cache lines.
+ */
+#define ULOG_APPLY_IN_ORDER 0
+
+extern unsigned Ulog_apply_threads;
+
 typedef int (*ulog_check_offset_fn)(void *ctx, uint64_t offset);
 typedef int (*ulog_extend_fn)(void *, uint64_t *, uint64_t);
 typedef int (*ulog_entry_cb)(struct ulog_entry_base *e, void *arg,
@@ -153,14 +165,14 @@ void ulog_clobber(struct ulog *dest, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
 int ulog_clobber_data(struct ulog *dest,
 	size_t nbytes, size_t ulog_base_nbytes,
-	struct ulog_next *next, ulog_free_fn ulog_free,
+	struct ulog_next *next, size_t retain, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags);
 void ulog_clobber_entry(const struct ulog_entry_base *e,
 	const struct pmem_ops *p_ops);
 
 void ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
-	const struct pmem_ops *p_ops);
+	unsigned nthreads, const struct pmem_ops *p_ops);
 
 size_t ulog_base_nbytes(struct ulog *ulog);
 int ulog_recovery_needed(struct ulog *ulog, int verify_checksum);
@@ -186,7 +198,7 @@ void ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 size_t ulog_entry_size(const struct ulog_entry_base *entry);
 
 void ulog_recover(struct ulog *ulog, ulog_check_offset_fn check,
-	const struct pmem_ops *p_ops);
+	unsigned nthreads, const struct pmem_ops *p_ops);
 int ulog_check(struct ulog *ulog, ulog_check_offset_fn check,
 	const struct pmem_ops *p_ops);
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2018, Intel Corporation
+ * Copyright 2016-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -39,6 +39,7 @@
 #include <errno.h>
 #include <sys/param.h>
 
+#include "checksum.h"
 #include "pmemcommon.h"
 #include "libpmempool.h"
 #include "pmempool.h"
@@ -67,6 +68,7 @@ libpmempool_init(void)
 		PMEMPOOL_LOG_FILE_VAR, PMEMPOOL_MAJOR_VERSION,
 		PMEMPOOL_MINOR_VERSION);
 	LOG(3, NULL);
+	checksum_init();
 #ifdef USE_RPMEM
 	util_remote_init();
 	rpmem_util_cmds_init();
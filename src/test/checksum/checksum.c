@@ -1,5 +1,5 @@
 /*
- * Copyright 2014-2018, Intel Corporation
+ * Copyright 2014-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -34,11 +34,15 @@
  * checksum.c -- unit test for library internal checksum routine
  *
  * usage: checksum files...
+ *
+ * The implementation under test is picked by checksum_init(), so it depends
+ * on the CPU and the PMEM_AVX512F and PMEM_NO_CHECKSUM_SIMD variables.
  */
 
 #include <endian.h>
 #include "unittest.h"
 #include "util.h"
+#include "checksum.h"
 #include <inttypes.h>
 
 /*
@@ -73,6 +77,9 @@ main(int argc, char *argv[])
 	if (argc < 2)
 		UT_FATAL("usage: %s files...", argv[0]);
 
+	/* use the same implementation as the libraries do */
+	checksum_init();
+
 	for (int arg = 1; arg < argc; arg++) {
 		int fd = OPEN(argv[arg], O_RDONLY);
 
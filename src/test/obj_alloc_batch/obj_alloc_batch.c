@@ -0,0 +1,261 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_alloc_batch.c -- tests for the batched reservations and allocations
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "alloc_batch"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 4)
+
+#define TYPE_RESERVE 1
+#define TYPE_ALLOC 2
+
+#define RESERVE_SIZE 128
+#define NRESERVE 100
+
+#define ALLOC_SIZE 64
+#define NALLOC 1000
+
+#define HUGE_SIZE (512 * 1024)
+#define NHUGE 4
+
+/* more than the whole pool */
+#define TOO_MANY_HUGE 128
+
+/*
+ * allocated -- returns the number of bytes currently allocated in the pool
+ */
+static size_t
+allocated(PMEMobjpool *pop)
+{
+	size_t value;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * count_objects -- returns the number of objects of the given type
+ */
+static size_t
+count_objects(PMEMobjpool *pop, uint64_t type_num)
+{
+	size_t n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) == type_num)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * check_objects -- verifies that the objects are distinct and usable
+ */
+static void
+check_objects(PMEMobjpool *pop, PMEMoid *oidv, size_t cnt, size_t size,
+	uint64_t type_num, int zeroed)
+{
+	for (size_t i = 0; i < cnt; ++i) {
+		UT_ASSERT(!OID_IS_NULL(oidv[i]));
+		UT_ASSERT(pmemobj_alloc_usable_size(oidv[i]) >= size);
+		UT_ASSERTeq(pmemobj_type_num(oidv[i]), type_num);
+
+		char *buf = pmemobj_direct(oidv[i]);
+		for (size_t j = 0; zeroed && j < size; ++j)
+			UT_ASSERTeq(buf[j], 0);
+
+		pmemobj_memset_persist(pop, buf, (int)(i % 256), size);
+	}
+
+	for (size_t i = 0; i < cnt; ++i) {
+		char *buf = pmemobj_direct(oidv[i]);
+		for (size_t j = 0; j < size; ++j)
+			UT_ASSERTeq((unsigned char)buf[j], i % 256);
+	}
+}
+
+/*
+ * test_reserve_batch -- reserves a batch of objects, cancels and publishes it
+ */
+static void
+test_reserve_batch(PMEMobjpool *pop)
+{
+	struct pobj_action actv[NRESERVE];
+	PMEMoid oidv[NRESERVE];
+
+	size_t base = allocated(pop);
+
+	int ret = pmemobj_xreserve_batch(pop, actv, oidv, NRESERVE,
+		RESERVE_SIZE, TYPE_RESERVE, POBJ_XALLOC_ZERO);
+	UT_ASSERTeq(ret, 0);
+	check_objects(pop, oidv, NRESERVE, RESERVE_SIZE, TYPE_RESERVE, 1);
+
+	/* reserved objects don't exist until they are published */
+	UT_ASSERTeq(count_objects(pop, TYPE_RESERVE), 0);
+	UT_ASSERTeq(allocated(pop), base);
+
+	pmemobj_cancel(pop, actv, NRESERVE);
+	UT_ASSERTeq(count_objects(pop, TYPE_RESERVE), 0);
+	UT_ASSERTeq(allocated(pop), base);
+
+	ret = pmemobj_xreserve_batch(pop, actv, NULL, NRESERVE,
+		RESERVE_SIZE, TYPE_RESERVE, 0);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_publish(pop, actv, NRESERVE);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_RESERVE), NRESERVE);
+	UT_ASSERT(allocated(pop) >= base + NRESERVE * RESERVE_SIZE);
+
+	/* invalid flags */
+	ret = pmemobj_xreserve_batch(pop, actv, oidv, NRESERVE,
+		RESERVE_SIZE, TYPE_RESERVE, POBJ_XALLOC_NO_FLUSH);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_alloc_batch -- allocates batches of small and huge objects
+ */
+static void
+test_alloc_batch(PMEMobjpool *pop)
+{
+	PMEMoid *oidv = MALLOC(sizeof(*oidv) * NALLOC);
+
+	int ret = pmemobj_alloc_batch(pop, oidv, NALLOC, ALLOC_SIZE,
+		TYPE_ALLOC, POBJ_XALLOC_ZERO);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), NALLOC);
+	check_objects(pop, oidv, NALLOC, ALLOC_SIZE, TYPE_ALLOC, 1);
+
+	for (size_t i = 0; i < NALLOC; ++i)
+		pmemobj_free(&oidv[i]);
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), 0);
+
+	ret = pmemobj_alloc_batch(pop, oidv, NHUGE, HUGE_SIZE, TYPE_ALLOC, 0);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), NHUGE);
+	check_objects(pop, oidv, NHUGE, HUGE_SIZE, TYPE_ALLOC, 0);
+
+	for (size_t i = 0; i < NHUGE; ++i)
+		pmemobj_free(&oidv[i]);
+
+	/* the handles are stored in the pool along with the allocations */
+	PMEMoid poidv;
+	ret = pmemobj_zalloc(pop, &poidv, sizeof(*oidv) * NALLOC, 0);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid *pool_oidv = pmemobj_direct(poidv);
+	ret = pmemobj_alloc_batch(pop, pool_oidv, NALLOC, ALLOC_SIZE,
+		TYPE_ALLOC, POBJ_XALLOC_ZERO);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), NALLOC);
+	check_objects(pop, pool_oidv, NALLOC, ALLOC_SIZE, TYPE_ALLOC, 1);
+
+	for (size_t i = 0; i < NALLOC; ++i)
+		pmemobj_free(&pool_oidv[i]);
+	pmemobj_free(&poidv);
+
+	/* nothing to do */
+	ret = pmemobj_alloc_batch(pop, oidv, 0, ALLOC_SIZE, TYPE_ALLOC, 0);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_alloc_batch(pop, oidv, NALLOC, 0, TYPE_ALLOC, 0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_alloc_batch(pop, oidv, NALLOC, ALLOC_SIZE, TYPE_ALLOC,
+		POBJ_XALLOC_NO_FLUSH);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	FREE(oidv);
+}
+
+/*
+ * test_alloc_batch_oom -- checks that a batch that doesn't fit in the pool
+ *	doesn't allocate anything
+ */
+static void
+test_alloc_batch_oom(PMEMobjpool *pop)
+{
+	PMEMoid oidv[TOO_MANY_HUGE];
+
+	size_t base = allocated(pop);
+
+	int ret = pmemobj_alloc_batch(pop, oidv, TOO_MANY_HUGE, HUGE_SIZE,
+		TYPE_ALLOC, 0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOMEM);
+
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), 0);
+	UT_ASSERTeq(allocated(pop), base);
+
+	/* the memory of the canceled reservations can be used again */
+	ret = pmemobj_alloc_batch(pop, oidv, NHUGE, HUGE_SIZE, TYPE_ALLOC, 0);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_ALLOC), NHUGE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_batch");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	test_reserve_batch(pop);
+	test_alloc_batch(pop);
+	test_alloc_batch_oom(pop);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
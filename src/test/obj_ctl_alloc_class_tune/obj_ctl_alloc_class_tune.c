@@ -0,0 +1,270 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_alloc_class_tune.c -- tests for the allocation classes tuned for
+ *	the recorded allocation sizes
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "ctl_alloc_class_tune"
+
+#define HEADER_SIZE 16 /* compact header */
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 4)
+
+static const struct {
+	size_t size;
+	size_t count;
+	size_t unit_size; /* of the proposed class */
+} Workload[] = {
+	{40, 1000, 64},
+	{100, 1000, 128},
+	{200, 500, 224},
+	{1000, 100, 1024},
+};
+
+#define WORKLOAD_SIZES (sizeof(Workload) / sizeof(Workload[0]))
+
+/*
+ * get_proposal -- reads the allocation classes proposed for the recorded
+ *	allocation sizes
+ */
+static void
+get_proposal(PMEMobjpool *pop, struct pobj_alloc_class_proposal *p)
+{
+	int ret = pmemobj_ctl_get(pop, "heap.alloc_class.tune.proposal", p);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * usable_size -- allocates an object and returns its usable size
+ */
+static size_t
+usable_size(PMEMobjpool *pop, size_t size)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, size, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	size_t usable = pmemobj_alloc_usable_size(oid);
+	pmemobj_free(&oid);
+
+	return usable;
+}
+
+/*
+ * test_histogram -- verifies recording of the allocation sizes
+ */
+static void
+test_histogram(PMEMobjpool *pop)
+{
+	struct pobj_alloc_class_proposal p;
+
+	int enabled;
+	int ret = pmemobj_ctl_get(pop, "heap.alloc_class.histogram.enabled",
+		&enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	/* nothing is recorded by default */
+	usable_size(pop, Workload[0].size);
+	get_proposal(pop, &p);
+	UT_ASSERTeq(p.nclasses, 0);
+	UT_ASSERTeq(p.waste_proposed, 0);
+	UT_ASSERTeq(p.waste_current, 0);
+
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.histogram.enabled",
+		&enabled);
+	UT_ASSERTeq(ret, 0);
+
+	usable_size(pop, Workload[0].size);
+	get_proposal(pop, &p);
+	UT_ASSERTeq(p.nclasses, 1);
+
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.histogram.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+	get_proposal(pop, &p);
+	UT_ASSERTeq(p.nclasses, 0);
+
+	/* explicitly chosen classes and big objects aren't recorded */
+	PMEMoid oid;
+	ret = pmemobj_xalloc(pop, &oid, Workload[0].size, 0,
+		POBJ_CLASS_ID(1), NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	usable_size(pop, 1 << 20);
+
+	get_proposal(pop, &p);
+	UT_ASSERTeq(p.nclasses, 0);
+}
+
+/*
+ * test_tune -- tunes the allocation classes for a workload
+ */
+static void
+test_tune(PMEMobjpool *pop)
+{
+	size_t nobjs = 0;
+	for (size_t i = 0; i < WORKLOAD_SIZES; ++i)
+		nobjs += Workload[i].count;
+
+	PMEMoid *oids = MALLOC(sizeof(*oids) * nobjs);
+
+	size_t n = 0;
+	for (size_t i = 0; i < WORKLOAD_SIZES; ++i) {
+		for (size_t j = 0; j < Workload[i].count; ++j) {
+			int ret = pmemobj_alloc(pop, &oids[n++],
+				Workload[i].size, 0, NULL, NULL);
+			UT_ASSERTeq(ret, 0);
+		}
+	}
+
+	struct pobj_alloc_class_proposal p;
+	get_proposal(pop, &p);
+
+	/* there's a perfect fit for each of the sizes */
+	UT_ASSERTeq(p.nclasses, WORKLOAD_SIZES);
+	UT_ASSERTeq(p.waste_proposed, 0);
+	UT_ASSERT(p.waste_current > 0);
+
+	for (size_t i = 0; i < WORKLOAD_SIZES; ++i) {
+		UT_ASSERTeq(p.classes[i].unit_size, Workload[i].unit_size);
+		UT_ASSERTeq(p.classes[i].alignment, 0);
+		UT_ASSERTeq(p.classes[i].header_type, POBJ_HEADER_COMPACT);
+		UT_ASSERT(p.classes[i].units_per_block > 0);
+	}
+
+	/* the smallest objects don't fit any of the default classes */
+	UT_ASSERTne(usable_size(pop, Workload[0].size),
+		Workload[0].unit_size - HEADER_SIZE);
+
+	int ret = pmemobj_ctl_exec(pop, "heap.alloc_class.tune.apply", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	for (size_t i = 0; i < WORKLOAD_SIZES; ++i) {
+		UT_ASSERTeq(usable_size(pop, Workload[i].size),
+			Workload[i].unit_size - HEADER_SIZE);
+	}
+
+	/* the objects allocated before tuning are intact */
+	for (size_t i = 0; i < nobjs; ++i)
+		pmemobj_free(&oids[i]);
+
+	/* the current classes are as good as the proposed ones */
+	get_proposal(pop, &p);
+	UT_ASSERTeq(p.nclasses, WORKLOAD_SIZES);
+	UT_ASSERTeq(p.waste_current, 0);
+
+	FREE(oids);
+}
+
+/*
+ * test_tune_desc -- verifies tuning of a single allocation class
+ */
+static void
+test_tune_desc(PMEMobjpool *pop)
+{
+	struct pobj_alloc_class_desc desc;
+	desc.unit_size = 96;
+	desc.alignment = 0;
+	desc.units_per_block = 1000;
+	desc.header_type = POBJ_HEADER_NONE;
+
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.tune.desc", &desc);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	desc.unit_size = HEADER_SIZE;
+	desc.header_type = POBJ_HEADER_COMPACT;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.tune.desc", &desc);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	/* takes over the sizes between the 64 and 128 byte classes */
+	desc.unit_size = 96;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.tune.desc", &desc);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(desc.class_id, 0);
+
+	UT_ASSERTeq(usable_size(pop, 40), 48);
+	UT_ASSERTeq(usable_size(pop, 60), 80);
+	UT_ASSERTeq(usable_size(pop, 100), 112);
+
+	/* an existing class is reused */
+	unsigned class_id = desc.class_id;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.tune.desc", &desc);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(desc.class_id, class_id);
+}
+
+/*
+ * test_config -- verifies the class tuned through the configuration
+ */
+static void
+test_config(PMEMobjpool *pop)
+{
+	UT_ASSERTeq(usable_size(pop, 10), 64);
+	UT_ASSERTeq(usable_size(pop, 60), 64);
+	UT_ASSERTne(usable_size(pop, 70), 64);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_alloc_class_tune");
+
+	if (argc != 3 || strchr("tc", argv[2][0]) == NULL)
+		UT_FATAL("usage: %s file-name t|c", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	if (argv[2][0] == 't') {
+		test_histogram(pop);
+		test_tune(pop);
+		test_tune_desc(pop);
+	} else {
+		test_config(pop);
+	}
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -49,6 +49,8 @@
  * non-exists arena id
  *
  * obj_ctl_arenas <file> m - test for heap.narenas.max (RW)
+ *
+ * obj_ctl_arenas <file> b - test for heap.arena.[idx].numa_node
  */
 
 #include <sched.h>
@@ -275,7 +277,7 @@ main(int argc, char *argv[])
 	START(argc, argv, "obj_ctl_arenas");
 
 	if (argc != 3)
-		UT_FATAL("usage: %s poolset [n|s|c|f|q|m|a]", argv[0]);
+		UT_FATAL("usage: %s poolset [n|s|c|f|q|m|a|b]", argv[0]);
 
 	const char *path = argv[1];
 	char t = argv[2][0];
@@ -486,6 +488,70 @@ main(int argc, char *argv[])
 		ret = pmemobj_ctl_get(pop, "heap.narenas.max", &max);
 		UT_ASSERTeq(ret, 0);
 		UT_ASSERTeq(DEFAULT_ARENAS_MAX + 1, max);
+	} else if (t == 'b') {
+		char arena_idx_node[CTL_QUERY_LEN];
+		unsigned total;
+		unsigned arena_id;
+		int node;
+
+		ret = pmemobj_ctl_get(pop, "heap.narenas.total", &total);
+		UT_ASSERTeq(ret, 0);
+
+		/* no thread was assigned to any arena yet */
+		for (unsigned i = 1; i <= total; i++) {
+			ret = snprintf(arena_idx_node, CTL_QUERY_LEN,
+					"heap.arena.%u.numa_node", i);
+			if (ret < 0 || ret >= CTL_QUERY_LEN)
+				UT_FATAL("!snprintf arena_idx_node");
+
+			ret = pmemobj_ctl_get(pop, arena_idx_node, &node);
+			UT_ASSERTeq(ret, 0);
+			UT_ASSERTeq(node, -1);
+		}
+
+		/* first allocation binds the arena to the node of the thread */
+		PMEMoid oid;
+		ret = pmemobj_alloc(pop, &oid, CHUNKSIZE / 4, 0, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		ret = pmemobj_ctl_get(pop, "heap.thread.arena_id", &arena_id);
+		UT_ASSERTeq(ret, 0);
+
+		ret = snprintf(arena_idx_node, CTL_QUERY_LEN,
+				"heap.arena.%u.numa_node", arena_id);
+		if (ret < 0 || ret >= CTL_QUERY_LEN)
+			UT_FATAL("!snprintf arena_idx_node");
+
+		ret = pmemobj_ctl_get(pop, arena_idx_node, &node);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERT(node >= 0);
+
+		pmemobj_free(&oid);
+
+		/* manually created arenas are not bound to any node */
+		ret = pmemobj_ctl_exec(pop, "heap.arena.create", &arena_id);
+		UT_ASSERTeq(ret, 0);
+
+		ret = snprintf(arena_idx_node, CTL_QUERY_LEN,
+				"heap.arena.%u.numa_node", arena_id);
+		if (ret < 0 || ret >= CTL_QUERY_LEN)
+			UT_FATAL("!snprintf arena_idx_node");
+
+		ret = pmemobj_ctl_get(pop, arena_idx_node, &node);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(node, -1);
+
+		/* arena id outside of the allowed range */
+		ret = pmemobj_ctl_get(pop, "heap.arena.0.numa_node", &node);
+		UT_ASSERTne(ret, 0);
+
+		ret = snprintf(arena_idx_node, CTL_QUERY_LEN,
+				"heap.arena.%u.numa_node", arena_id + 1);
+		if (ret < 0 || ret >= CTL_QUERY_LEN)
+			UT_FATAL("!snprintf arena_idx_node");
+
+		ret = pmemobj_ctl_get(pop, arena_idx_node, &node);
+		UT_ASSERTne(ret, 0);
 	} else {
 		UT_ASSERT(0);
 	}
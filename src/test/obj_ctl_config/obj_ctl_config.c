@@ -1,5 +1,5 @@
 /*
- * Copyright 2017, Intel Corporation
+ * Copyright 2017-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -58,6 +58,8 @@ main(int argc, char *argv[])
 	UT_OUT("%d", result);
 	pmemobj_ctl_get(pop, "prefault.at_create", &result);
 	UT_OUT("%d", result);
+	pmemobj_ctl_get(pop, "heap.open.threads", &result);
+	UT_OUT("%d", result);
 
 	pmemobj_close(pop);
 
@@ -0,0 +1,305 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ctl_lane.c -- tests for the lane ctl entry points
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "ctl_lane"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 2)
+
+#define NLANES 16
+#define UNDO_SIZE (1 << 16)
+#define REDO_EXTERNAL_SIZE (1 << 13)
+#define OBJ_SIZE (1 << 15)
+
+/* default geometry */
+#define DEFAULT_NLANES 1024
+#define DEFAULT_UNDO_SIZE 2048
+#define DEFAULT_REDO_EXTERNAL_SIZE 640
+#define DEFAULT_REDO_INTERNAL_SIZE 192
+
+/*
+ * ctl_get_u64 -- reads an uint64_t ctl entry point
+ */
+static uint64_t
+ctl_get_u64(PMEMobjpool *pop, const char *name)
+{
+	uint64_t value;
+	int ret = pmemobj_ctl_get(pop, name, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * ctl_set_ll -- writes a long long ctl entry point
+ */
+static int
+ctl_set_ll(PMEMobjpool *pop, const char *name, long long value)
+{
+	return pmemobj_ctl_set(pop, name, &value);
+}
+
+/*
+ * test_at_create_invalid -- sets invalid lane geometry of new pools
+ */
+static void
+test_at_create_invalid(void)
+{
+	const char *sizes[] = {
+		"lane.at_create.undo_size",
+		"lane.at_create.redo_external_size",
+		"lane.at_create.redo_internal_size",
+	};
+
+	for (unsigned i = 0; i < ARRAY_SIZE(sizes); ++i) {
+		/* smaller than the default */
+		int ret = ctl_set_ll(NULL, sizes[i], 64);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+
+		/* not a multiple of the cacheline size */
+		ret = ctl_set_ll(NULL, sizes[i], (1 << 16) + 1);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+	}
+
+	int ret = ctl_set_ll(NULL, "lane.at_create.nlanes", 0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = ctl_set_ll(NULL, "lane.at_create.nlanes", DEFAULT_NLANES + 1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(ctl_get_u64(NULL, "lane.at_create.nlanes"),
+		DEFAULT_NLANES);
+	UT_ASSERTeq(ctl_get_u64(NULL, "lane.at_create.undo_size"),
+		DEFAULT_UNDO_SIZE);
+	UT_ASSERTeq(ctl_get_u64(NULL, "lane.at_create.redo_external_size"),
+		DEFAULT_REDO_EXTERNAL_SIZE);
+	UT_ASSERTeq(ctl_get_u64(NULL, "lane.at_create.redo_internal_size"),
+		DEFAULT_REDO_INTERNAL_SIZE);
+}
+
+/*
+ * check_geometry -- verifies the lane geometry of an open pool
+ */
+static void
+check_geometry(PMEMobjpool *pop, uint64_t nlanes, uint64_t undo_size,
+	uint64_t redo_external_size)
+{
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.nlanes"), nlanes);
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.runtime_nlanes"), nlanes);
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.undo_size"), undo_size);
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.redo_external_size"),
+		redo_external_size);
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.redo_internal_size"),
+		DEFAULT_REDO_INTERNAL_SIZE);
+}
+
+/*
+ * test_custom_geometry -- creates a pool with fewer but larger lanes and
+ *	performs a transaction which fits in the undo log of a single lane
+ */
+static void
+test_custom_geometry(const char *path)
+{
+	int ret = ctl_set_ll(NULL, "lane.at_create.nlanes", NLANES);
+	UT_ASSERTeq(ret, 0);
+	ret = ctl_set_ll(NULL, "lane.at_create.undo_size", UNDO_SIZE);
+	UT_ASSERTeq(ret, 0);
+	ret = ctl_set_ll(NULL, "lane.at_create.redo_external_size",
+		REDO_EXTERNAL_SIZE);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	check_geometry(pop, NLANES, UNDO_SIZE, REDO_EXTERNAL_SIZE);
+
+	PMEMoid root = pmemobj_root(pop, OBJ_SIZE);
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 0, OBJ_SIZE);
+		pmemobj_memset_persist(pop, pmemobj_direct(root), 0xc,
+			OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 0, OBJ_SIZE);
+		pmemobj_memset_persist(pop, pmemobj_direct(root), 0xd,
+			OBJ_SIZE);
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	pmemobj_close(pop);
+
+	/* the geometry is stored in the pool */
+	ret = ctl_set_ll(NULL, "lane.at_create.nlanes", DEFAULT_NLANES);
+	UT_ASSERTeq(ret, 0);
+	ret = ctl_set_ll(NULL, "lane.at_create.undo_size", DEFAULT_UNDO_SIZE);
+	UT_ASSERTeq(ret, 0);
+	ret = ctl_set_ll(NULL, "lane.at_create.redo_external_size",
+		DEFAULT_REDO_EXTERNAL_SIZE);
+	UT_ASSERTeq(ret, 0);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	check_geometry(pop, NLANES, UNDO_SIZE, REDO_EXTERNAL_SIZE);
+
+	root = pmemobj_root(pop, OBJ_SIZE);
+	char *buf = pmemobj_direct(root);
+	for (size_t i = 0; i < OBJ_SIZE; ++i)
+		UT_ASSERTeq(buf[i], 0xc);
+
+	/* the number of lanes used at runtime can be changed */
+	ret = ctl_set_ll(pop, "lane.runtime_nlanes", 1);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(ctl_get_u64(pop, "lane.runtime_nlanes"), 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 0, OBJ_SIZE);
+		pmemobj_memset_persist(pop, buf, 0xe, OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	ret = ctl_set_ll(pop, "lane.runtime_nlanes", 0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = ctl_set_ll(pop, "lane.runtime_nlanes", NLANES + 1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = ctl_set_ll(pop, "lane.runtime_nlanes", NLANES);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_close(pop);
+
+	UNLINK(path);
+}
+
+/*
+ * test_default_geometry -- creates a pool with the default lane geometry
+ */
+static void
+test_default_geometry(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	check_geometry(pop, DEFAULT_NLANES, DEFAULT_UNDO_SIZE,
+		DEFAULT_REDO_EXTERNAL_SIZE);
+
+	pmemobj_close(pop);
+
+	UNLINK(path);
+}
+
+/*
+ * test_too_small -- creates a pool which cannot fit the lanes
+ */
+static void
+test_too_small(const char *path)
+{
+	int ret = ctl_set_ll(NULL, "lane.at_create.undo_size", 1 << 20);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	UT_ASSERTeq(pop, NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = ctl_set_ll(NULL, "lane.at_create.undo_size", DEFAULT_UNDO_SIZE);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * test_redo_apply_threads -- sets the number of threads applying redo logs
+ */
+static void
+test_redo_apply_threads(void)
+{
+	int nthreads;
+	int ret = pmemobj_ctl_get(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(nthreads, 1);
+
+	nthreads = 0;
+	ret = pmemobj_ctl_set(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	nthreads = 65;
+	ret = pmemobj_ctl_set(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	nthreads = 4;
+	ret = pmemobj_ctl_set(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_lane");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	test_at_create_invalid();
+	test_redo_apply_threads();
+	test_custom_geometry(path);
+	test_default_geometry(path);
+	test_too_small(path);
+
+	DONE(NULL);
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_reclaimer.c -- tests for the background reclaimer
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "ctl_reclaimer"
+
+#define OBJ_SIZE 128
+#define NOBJS 20000
+
+#define INTERVAL_DEFAULT 10
+#define INTERVAL_MAX 60000
+
+static PMEMobjpool *Pop;
+
+/*
+ * reclaimer_stat -- reads one of the statistics of the reclaimer
+ */
+static uint64_t
+reclaimer_stat(PMEMobjpool *pop, const char *name)
+{
+	uint64_t value;
+	int ret = pmemobj_ctl_get(pop, name, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * reclaimer -- runs the background reclaimer until it's stopped
+ */
+static void *
+reclaimer(void *arg)
+{
+	int dummy;
+	int ret = pmemobj_ctl_get(Pop, "heap.reclaimer.worker", &dummy);
+	UT_ASSERTeq(ret, 0);
+
+	return NULL;
+}
+
+/*
+ * test_params -- verifies the default and invalid reclaimer parameters
+ */
+static void
+test_params(PMEMobjpool *pop)
+{
+	int interval;
+	int ret = pmemobj_ctl_get(pop, "heap.reclaimer.interval_ms",
+		&interval);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(interval, INTERVAL_DEFAULT);
+
+	interval = 0;
+	ret = pmemobj_ctl_set(pop, "heap.reclaimer.interval_ms", &interval);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	interval = INTERVAL_MAX + 1;
+	ret = pmemobj_ctl_set(pop, "heap.reclaimer.interval_ms", &interval);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	interval = 1;
+	ret = pmemobj_ctl_set(pop, "heap.reclaimer.interval_ms", &interval);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "heap.reclaimer.interval_ms", &interval);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(interval, 1);
+
+	UT_ASSERTeq(reclaimer_stat(pop, "heap.reclaimer.passes"), 0);
+	UT_ASSERTeq(reclaimer_stat(pop, "heap.reclaimer.runs"), 0);
+
+	/*
+	 * a reclaimer that isn't running can't be stopped, the reclaimer
+	 * started later by test_reclaim doesn't exit right away
+	 */
+	int dummy;
+	ret = pmemobj_ctl_get(pop, "heap.reclaimer.stop", &dummy);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ESRCH);
+}
+
+/*
+ * test_reclaim -- frees a lot of small objects and waits for the reclaimer
+ *	to give back the emptied runs
+ */
+static void
+test_reclaim(PMEMobjpool *pop)
+{
+	Pop = pop;
+
+	os_thread_t thread;
+	PTHREAD_CREATE(&thread, NULL, reclaimer, NULL);
+
+	while (reclaimer_stat(pop, "heap.reclaimer.passes") == 0)
+		;
+
+	/* there can be only one reclaimer */
+	int dummy;
+	int ret = pmemobj_ctl_get(pop, "heap.reclaimer.worker", &dummy);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EBUSY);
+
+	PMEMoid *oids = MALLOC(sizeof(*oids) * NOBJS);
+
+	for (int n = 0; n < 2; ++n) {
+		for (size_t i = 0; i < NOBJS; ++i) {
+			ret = pmemobj_alloc(pop, &oids[i], OBJ_SIZE, 0,
+				NULL, NULL);
+			UT_ASSERTeq(ret, 0);
+		}
+
+		for (size_t i = 0; i < NOBJS; ++i)
+			pmemobj_free(&oids[i]);
+	}
+
+	while (reclaimer_stat(pop, "heap.reclaimer.runs") == 0)
+		;
+
+	ret = pmemobj_ctl_get(pop, "heap.reclaimer.stop", &dummy);
+	UT_ASSERTeq(ret, 0);
+
+	PTHREAD_JOIN(&thread, NULL);
+
+	/* the reclaimed space can be used by a different allocation class */
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, OBJ_SIZE * NOBJS / 2, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	/* the reclaimer can be started again */
+	uint64_t passes = reclaimer_stat(pop, "heap.reclaimer.passes");
+
+	PTHREAD_CREATE(&thread, NULL, reclaimer, NULL);
+
+	while (reclaimer_stat(pop, "heap.reclaimer.passes") == passes)
+		;
+
+	ret = pmemobj_ctl_get(pop, "heap.reclaimer.stop", &dummy);
+	UT_ASSERTeq(ret, 0);
+
+	PTHREAD_JOIN(&thread, NULL);
+
+	FREE(oids);
+}
+
+/*
+ * test_close -- closes the pool with the reclaimer still running
+ */
+static void
+test_close(PMEMobjpool *pop)
+{
+	Pop = pop;
+
+	uint64_t passes = reclaimer_stat(pop, "heap.reclaimer.passes");
+
+	os_thread_t thread;
+	PTHREAD_CREATE(&thread, NULL, reclaimer, NULL);
+
+	while (reclaimer_stat(pop, "heap.reclaimer.passes") == passes)
+		;
+
+	/* closing the pool stops the reclaimer */
+	pmemobj_close(pop);
+
+	PTHREAD_JOIN(&thread, NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_reclaimer");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_params(pop);
+	test_reclaim(pop);
+	test_close(pop);
+
+	DONE(NULL);
+}
@@ -92,6 +92,24 @@ main(int argc, char *argv[])
 	UT_ASSERTeq(ret, 0);
 	UT_ASSERTeq(allocated, oid_size);
 
+	uint64_t contended = UINT64_MAX;
+	ret = pmemobj_ctl_get(pop, "stats.lane.0.contended", &contended);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(contended, 0);
+
+	uint64_t waits = UINT64_MAX;
+	ret = pmemobj_ctl_get(pop, "stats.lane.0.waits", &waits);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(waits, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.lane.1000000.waits", &waits);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+
+	ret = pmemobj_ctl_get(pop, "stats.lane.-1.waits", &waits);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+
 	pmemobj_close(pop);
 
 	DONE(NULL);
@@ -0,0 +1,394 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ctl_tcache.c -- tests for the thread-local block caches
+ */
+
+#include "sys_util.h"
+#include "unittest.h"
+
+#define LAYOUT "ctl_tcache"
+
+#define OBJ_SIZE 64
+#define NOBJS 1000
+#define NTHREADS 8
+#define NOPS 1000
+
+#define BATCH_SIZE_DEFAULT 32
+#define BATCH_SIZE_MAX 1024
+
+static PMEMobjpool *Pop;
+
+static os_mutex_t Lock;
+static os_cond_t Cond;
+static unsigned Nready;
+static int Reopened;
+
+/*
+ * allocated -- returns the number of bytes currently allocated in the pool
+ */
+static size_t
+allocated(PMEMobjpool *pop)
+{
+	size_t value;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * tcache_enable -- enables or disables the thread caches
+ */
+static void
+tcache_enable(PMEMobjpool *pop, int enabled)
+{
+	int ret = pmemobj_ctl_set(pop, "heap.tcache.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * constructor_fail -- object constructor that always fails
+ */
+static int
+constructor_fail(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	return -1;
+}
+
+/*
+ * test_params -- verifies the default and invalid tcache parameters
+ */
+static void
+test_params(PMEMobjpool *pop)
+{
+	int enabled;
+	int ret = pmemobj_ctl_get(pop, "heap.tcache.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	int batch_size;
+	ret = pmemobj_ctl_get(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(batch_size, BATCH_SIZE_DEFAULT);
+
+	batch_size = 0;
+	ret = pmemobj_ctl_set(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	batch_size = BATCH_SIZE_MAX + 1;
+	ret = pmemobj_ctl_set(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	batch_size = BATCH_SIZE_MAX;
+	ret = pmemobj_ctl_set(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(batch_size, BATCH_SIZE_MAX);
+
+	batch_size = BATCH_SIZE_DEFAULT;
+	ret = pmemobj_ctl_set(pop, "heap.tcache.batch_size", &batch_size);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * test_alloc -- allocates and frees objects through the cache of a single
+ *	thread
+ */
+static void
+test_alloc(PMEMobjpool *pop)
+{
+	size_t base = allocated(pop);
+
+	tcache_enable(pop, 1);
+
+	PMEMoid *oids = MALLOC(sizeof(*oids) * NOBJS);
+
+	/* cached, but not yet allocated, blocks aren't accounted for */
+	int ret = pmemobj_alloc(pop, &oids[0], OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	size_t obj_size = allocated(pop) - base;
+	UT_ASSERT(obj_size >= OBJ_SIZE);
+
+	for (size_t i = 1; i < NOBJS; ++i) {
+		ret = pmemobj_alloc(pop, &oids[i], OBJ_SIZE, 0, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+	UT_ASSERTeq(allocated(pop), base + obj_size * NOBJS);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		*(size_t *)pmemobj_direct(oids[i]) = i;
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		UT_ASSERTeq(*(size_t *)pmemobj_direct(oids[i]), i);
+
+	/* a failed constructor doesn't lose the block */
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, 0, constructor_fail, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ECANCELED);
+	UT_ASSERTeq(allocated(pop), base + obj_size * NOBJS);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+	UT_ASSERTeq(allocated(pop), base);
+
+	ret = pmemobj_ctl_exec(pop, "heap.tcache.drain", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	/* the drained blocks are available with and without the cache */
+	tcache_enable(pop, 0);
+	ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	tcache_enable(pop, 1);
+	ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+	UT_ASSERTeq(allocated(pop), base);
+
+	FREE(oids);
+}
+
+/*
+ * worker -- allocates and frees objects, the thread cache is given back
+ *	when the thread exits
+ */
+static void *
+worker(void *arg)
+{
+	PMEMoid *oids = arg;
+
+	for (size_t i = 0; i < NOPS; ++i) {
+		size_t n = i % (NOPS / 10);
+		if (!OID_IS_NULL(oids[n]))
+			pmemobj_free(&oids[n]);
+
+		int ret = pmemobj_alloc(Pop, &oids[n], OBJ_SIZE, 0,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	return NULL;
+}
+
+/*
+ * test_threads -- allocates from multiple threads, each with its own cache
+ */
+static void
+test_threads(PMEMobjpool *pop)
+{
+	size_t base = allocated(pop);
+
+	tcache_enable(pop, 1);
+
+	Pop = pop;
+
+	os_thread_t threads[NTHREADS];
+	PMEMoid *oids = ZALLOC(sizeof(*oids) * NTHREADS * NOPS / 10);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, worker,
+			&oids[i * NOPS / 10]);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	for (unsigned i = 0; i < NTHREADS * NOPS / 10; ++i) {
+		UT_ASSERT(!OID_IS_NULL(oids[i]));
+		pmemobj_free(&oids[i]);
+	}
+
+	UT_ASSERTeq(allocated(pop), base);
+
+	FREE(oids);
+}
+
+/*
+ * count_objects -- returns the number of objects in the pool
+ */
+static unsigned
+count_objects(PMEMobjpool *pop)
+{
+	unsigned n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid)
+		n++;
+
+	return n;
+}
+
+/*
+ * test_reopen -- closes the pool with blocks still cached, none of them
+ *	should be visible once the pool is opened again
+ */
+static PMEMobjpool *
+test_reopen(PMEMobjpool *pop, const char *path)
+{
+	tcache_enable(pop, 1);
+
+	unsigned nobjs = count_objects(pop);
+
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(count_objects(pop), nobjs + 1);
+
+	/* the setting isn't persistent */
+	int enabled;
+	ret = pmemobj_ctl_get(pop, "heap.tcache.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	return pop;
+}
+
+/*
+ * worker_reopen -- caches blocks of a pool that gets closed and opened again
+ *	while the thread is still alive
+ */
+static void *
+worker_reopen(void *arg)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(Pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	util_mutex_lock(&Lock);
+	Nready++;
+	os_cond_broadcast(&Cond);
+	while (!Reopened)
+		os_cond_wait(&Cond, &Lock);
+	util_mutex_unlock(&Lock);
+
+	/* the cache of the closed pool is replaced by a new one */
+	tcache_enable(Pop, 1);
+	ret = pmemobj_alloc(Pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	return NULL;
+}
+
+/*
+ * test_reopen_threads -- closes the pool while the threads that have cached
+ *	blocks are still running
+ */
+static PMEMobjpool *
+test_reopen_threads(PMEMobjpool *pop, const char *path)
+{
+	tcache_enable(pop, 1);
+
+	unsigned nobjs = count_objects(pop);
+
+	util_mutex_init(&Lock);
+	os_cond_init(&Cond);
+	Nready = 0;
+	Reopened = 0;
+	Pop = pop;
+
+	os_thread_t threads[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, worker_reopen, NULL);
+
+	util_mutex_lock(&Lock);
+	while (Nready != NTHREADS)
+		os_cond_wait(&Cond, &Lock);
+	util_mutex_unlock(&Lock);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(count_objects(pop), nobjs);
+
+	util_mutex_lock(&Lock);
+	Pop = pop;
+	Reopened = 1;
+	os_cond_broadcast(&Cond);
+	util_mutex_unlock(&Lock);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	UT_ASSERTeq(count_objects(pop), nobjs);
+
+	os_cond_destroy(&Cond);
+	util_mutex_destroy(&Lock);
+
+	return pop;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_tcache");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	test_params(pop);
+	test_alloc(pop);
+	test_threads(pop);
+	pop = test_reopen(pop, path);
+	pop = test_reopen_threads(pop, path);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_tx_log.c -- tests for the retention of the transaction undo logs
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "ctl_tx_log"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 2)
+
+#define OBJ_SIZE (1 << 18)
+#define SMALL_SNAPSHOT 64
+#define RETAIN_BYTES (1 << 20)
+#define RETAIN_BYTES_MAX (1ULL << 30)
+
+/* number of small transactions after which the retained logs are freed */
+#define SMALL_TXS 256
+
+/*
+ * ctl_set_ll -- writes a long long ctl entry point
+ */
+static int
+ctl_set_ll(PMEMobjpool *pop, const char *name, long long value)
+{
+	return pmemobj_ctl_set(pop, name, &value);
+}
+
+/*
+ * allocated -- returns the number of bytes currently allocated in the pool
+ */
+static size_t
+allocated(PMEMobjpool *pop)
+{
+	size_t value;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * tx_snapshot -- snapshots the first 'size' bytes of the object and
+ *	overwrites them with 'c'
+ */
+static void
+tx_snapshot(PMEMobjpool *pop, PMEMoid oid, size_t size, int c, int abort)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, size);
+		pmemobj_memset_persist(pop, pmemobj_direct(oid), c, size);
+		if (abort)
+			pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERTeq(abort, 0);
+	} TX_ONABORT {
+		UT_ASSERTne(abort, 0);
+	} TX_END
+}
+
+/*
+ * check_object -- verifies the contents of the object
+ */
+static void
+check_object(PMEMoid oid, int c)
+{
+	unsigned char *buf = pmemobj_direct(oid);
+	for (size_t i = 0; i < OBJ_SIZE; ++i)
+		UT_ASSERTeq(buf[i], c);
+}
+
+/*
+ * test_invalid -- sets invalid log retain sizes
+ */
+static void
+test_invalid(PMEMobjpool *pop)
+{
+	int ret = ctl_set_ll(pop, "tx.log.retain_bytes", -1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = ctl_set_ll(pop, "tx.log.retain_bytes",
+		(long long)RETAIN_BYTES_MAX + 1);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	long long retain;
+	ret = pmemobj_ctl_get(pop, "tx.log.retain_bytes", &retain);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(retain, 0);
+}
+
+/*
+ * test_retain -- checks that large transactions reuse the retained logs and
+ *	that the logs are freed once the transactions become smaller
+ */
+static void
+test_retain(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, OBJ_SIZE);
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	/* all logs but the first extension are freed by default */
+	tx_snapshot(pop, root, OBJ_SIZE, 1, 0);
+	size_t freed = allocated(pop);
+	tx_snapshot(pop, root, OBJ_SIZE, 2, 0);
+	UT_ASSERTeq(allocated(pop), freed);
+
+	int ret = ctl_set_ll(pop, "tx.log.retain_bytes", RETAIN_BYTES);
+	UT_ASSERTeq(ret, 0);
+
+	tx_snapshot(pop, root, OBJ_SIZE, 3, 0);
+	size_t retained = allocated(pop);
+	UT_ASSERT(retained > freed + OBJ_SIZE / 2);
+
+	/* the retained logs are reused, both on commit and on abort */
+	tx_snapshot(pop, root, OBJ_SIZE, 4, 0);
+	UT_ASSERTeq(allocated(pop), retained);
+	tx_snapshot(pop, root, OBJ_SIZE, 5, 1);
+	UT_ASSERTeq(allocated(pop), retained);
+	check_object(root, 4);
+
+	/* the logs are freed when no longer needed */
+	for (int i = 0; i < SMALL_TXS; ++i)
+		tx_snapshot(pop, root, SMALL_SNAPSHOT, 4, 0);
+	UT_ASSERTeq(allocated(pop), freed);
+
+	tx_snapshot(pop, root, OBJ_SIZE, 6, 0);
+	UT_ASSERTeq(allocated(pop), retained);
+
+	ret = ctl_set_ll(pop, "tx.log.retain_bytes", 0);
+	UT_ASSERTeq(ret, 0);
+
+	tx_snapshot(pop, root, OBJ_SIZE, 7, 0);
+	UT_ASSERTeq(allocated(pop), freed);
+	check_object(root, 7);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_tx_log");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* all transactions use the same lane */
+	int ret = ctl_set_ll(pop, "lane.runtime_nlanes", 1);
+	UT_ASSERTeq(ret, 0);
+
+	int enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	test_invalid(pop);
+	test_retain(pop);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
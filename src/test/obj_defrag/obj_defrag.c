@@ -0,0 +1,257 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_defrag.c -- tests for the pmemobj_defrag function
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "defrag"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 4)
+
+#define NOBJS 10000
+#define OBJ_SIZE 1000
+#define TYPE_NUM 1
+
+/* every one in this many objects is left allocated, the rest is freed */
+#define SPARSENESS 4
+
+struct node {
+	uint64_t value;
+	PMEMoid next;
+};
+
+struct root {
+	PMEMoid head;
+	PMEMoid dup; /* second reference to the head of the list */
+};
+
+/*
+ * test_defrag_objects -- relocates objects referenced from volatile memory
+ */
+static void
+test_defrag_objects(PMEMobjpool *pop)
+{
+	PMEMoid *oids = MALLOC(sizeof(*oids) * NOBJS);
+	PMEMoid *prev = MALLOC(sizeof(*prev) * NOBJS);
+	PMEMoid **oidv = MALLOC(sizeof(*oidv) * NOBJS);
+	size_t *usable = MALLOC(sizeof(*usable) * NOBJS);
+
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i], OBJ_SIZE, TYPE_NUM,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		uint64_t *value = pmemobj_direct(oids[i]);
+		*value = i;
+		pmemobj_persist(pop, value, sizeof(*value));
+
+		usable[i] = pmemobj_alloc_usable_size(oids[i]);
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < NOBJS; ++i) {
+		if (i % SPARSENESS == 0)
+			oidv[n++] = &oids[i];
+		else
+			pmemobj_free(&oids[i]);
+	}
+
+	memcpy(prev, oids, sizeof(*oids) * NOBJS);
+
+	struct pobj_defrag_result result;
+	int ret = pmemobj_defrag(pop, oidv, n, &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.total, n);
+	UT_ASSERT(result.relocated > 0);
+	UT_ASSERT(result.relocated <= result.total);
+
+	size_t relocated = 0;
+	for (uint64_t i = 0; i < NOBJS; i += SPARSENESS) {
+		if (!OID_EQUALS(oids[i], prev[i]))
+			relocated++;
+
+		uint64_t *value = pmemobj_direct(oids[i]);
+		UT_ASSERTeq(*value, i);
+		UT_ASSERTeq(pmemobj_type_num(oids[i]), TYPE_NUM);
+		UT_ASSERTeq(pmemobj_alloc_usable_size(oids[i]), usable[i]);
+	}
+	UT_ASSERTeq(relocated, result.relocated);
+
+	/* the objects are now denser, another pass has less to relocate */
+	ret = pmemobj_defrag(pop, oidv, n, &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.total, n);
+	UT_ASSERT(result.relocated < relocated);
+
+	for (uint64_t i = 0; i < NOBJS; i += SPARSENESS) {
+		uint64_t *value = pmemobj_direct(oids[i]);
+		UT_ASSERTeq(*value, i);
+
+		pmemobj_free(&oids[i]);
+	}
+
+	FREE(usable);
+	FREE(oidv);
+	FREE(prev);
+	FREE(oids);
+}
+
+/*
+ * test_defrag_list -- relocates objects of a list, with the references
+ *	residing in the relocated objects themselves
+ */
+static void
+test_defrag_list(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+
+	PMEMoid *fillers = MALLOC(sizeof(*fillers) * NOBJS);
+	PMEMoid **oidv = MALLOC(sizeof(*oidv) * (NOBJS + 2));
+
+	PMEMoid *next = &rootp->head;
+	size_t nfillers = 0;
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		if (i % SPARSENESS != 0) {
+			int ret = pmemobj_alloc(pop, &fillers[nfillers++],
+				sizeof(struct node), 0, NULL, NULL);
+			UT_ASSERTeq(ret, 0);
+			continue;
+		}
+
+		int ret = pmemobj_zalloc(pop, next, sizeof(struct node),
+			TYPE_NUM);
+		UT_ASSERTeq(ret, 0);
+
+		struct node *node = pmemobj_direct(*next);
+		node->value = i;
+		pmemobj_persist(pop, &node->value, sizeof(node->value));
+
+		next = &node->next;
+	}
+
+	for (size_t i = 0; i < nfillers; ++i)
+		pmemobj_free(&fillers[i]);
+
+	rootp->dup = rootp->head;
+	pmemobj_persist(pop, &rootp->dup, sizeof(rootp->dup));
+
+	size_t n = 0;
+	oidv[n++] = &rootp->head;
+	oidv[n++] = &rootp->dup;
+	for (PMEMoid oid = rootp->head; !OID_IS_NULL(oid);
+	    oid = ((struct node *)pmemobj_direct(oid))->next)
+		oidv[n++] = &((struct node *)pmemobj_direct(oid))->next;
+
+	struct pobj_defrag_result result;
+	int ret = pmemobj_defrag(pop, oidv, n, &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.total, NOBJS / SPARSENESS);
+	UT_ASSERT(result.relocated > 0);
+
+	UT_ASSERT(OID_EQUALS(rootp->head, rootp->dup));
+
+	uint64_t i = 0;
+	PMEMoid oid = rootp->head;
+	while (!OID_IS_NULL(oid)) {
+		struct node *node = pmemobj_direct(oid);
+		UT_ASSERTeq(node->value, i);
+		UT_ASSERTeq(pmemobj_type_num(oid), TYPE_NUM);
+
+		PMEMoid tmp = node->next;
+		pmemobj_free(&oid);
+		oid = tmp;
+
+		i += SPARSENESS;
+	}
+	UT_ASSERTeq(i, NOBJS);
+
+	FREE(oidv);
+	FREE(fillers);
+}
+
+/*
+ * test_defrag_invalid -- verifies handling of the invalid references
+ */
+static void
+test_defrag_invalid(PMEMobjpool *pop)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, TYPE_NUM, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid null_oid = OID_NULL;
+	PMEMoid *oidv[] = {&null_oid};
+
+	struct pobj_defrag_result result;
+	ret = pmemobj_defrag(pop, oidv, 1, &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.total, 0);
+	UT_ASSERTeq(result.relocated, 0);
+
+	PMEMoid foreign_oid = oid;
+	foreign_oid.pool_uuid_lo = ~oid.pool_uuid_lo;
+	oidv[0] = &foreign_oid;
+
+	ret = pmemobj_defrag(pop, oidv, 1, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_free(&oid);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_defrag");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_defrag_objects(pop);
+	test_defrag_list(pop);
+	test_defrag_invalid(pop);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -42,6 +42,7 @@
 
 #include "list.h"
 #include "obj.h"
+#include "stats.h"
 #include "tx.h"
 #include "unittest.h"
 #include "pmemcommon.h"
@@ -97,7 +98,7 @@ mock_drain(void *ctx)
 static void
 test_lane_boot_cleanup_ok(void)
 {
-	struct mock_pop *pop = MALLOC(sizeof(struct mock_pop));
+	struct mock_pop *pop = ZALLOC(sizeof(struct mock_pop));
 	pop->p.nlanes = MAX_MOCK_LANES;
 
 	base_ptr = &pop->p;
@@ -150,12 +151,13 @@ test_lane_hold_release(void)
 		.undo = ctx,
 	};
 
-	struct mock_pop *pop = MALLOC(sizeof(struct mock_pop));
+	struct mock_pop *pop = ZALLOC(sizeof(struct mock_pop));
 
 	pop->p.nlanes = 1;
 	pop->p.lanes_desc.runtime_nlanes = 1,
 	pop->p.lanes_desc.lane = &mock_lane;
 	pop->p.lanes_desc.next_lane_idx = 0;
+	pop->p.lanes_desc.nwaiters = 0;
 
 	pop->p.lanes_desc.lane_locks = CALLOC(OBJ_NLANES, sizeof(uint64_t));
 	pop->p.lanes_offset = (uint64_t)&pop->l - (uint64_t)&pop->p;
@@ -201,7 +203,8 @@ test_lane_sizes(void)
 
 enum thread_work_type {
 	LANE_INFO_DESTROY,
-	LANE_CLEANUP
+	LANE_CLEANUP,
+	LANE_HOLD_RELEASE
 };
 
 struct thread_data {
@@ -227,6 +230,11 @@ test_separate_thread(void *arg)
 		UT_ASSERTne(base_ptr, NULL);
 		lane_cleanup(base_ptr);
 		break;
+	case LANE_HOLD_RELEASE:
+		UT_ASSERTne(base_ptr, NULL);
+		lane_hold(base_ptr, NULL);
+		lane_release(base_ptr);
+		break;
 	default:
 		UT_FATAL("Unimplemented thread work type: %d", data->work);
 	}
@@ -260,7 +268,7 @@ test_lane_info_destroy_in_separate_thread(void)
 static void
 test_lane_cleanup_in_separate_thread(void)
 {
-	struct mock_pop *pop = MALLOC(sizeof(struct mock_pop));
+	struct mock_pop *pop = ZALLOC(sizeof(struct mock_pop));
 	pop->p.nlanes = MAX_MOCK_LANES;
 
 	pop->p.p_ops.base = pop;
@@ -295,6 +303,63 @@ test_lane_cleanup_in_separate_thread(void)
 	FREE(pop);
 }
 
+/*
+ * test_lane_wait -- a thread which cannot find a free lane waits until one
+ *	is released
+ */
+static void
+test_lane_wait(void)
+{
+	struct mock_pop *pop = ZALLOC(sizeof(struct mock_pop));
+	pop->p.nlanes = MAX_MOCK_LANES;
+
+	pop->p.p_ops.base = pop;
+	pop->p.p_ops.flush = mock_flush;
+	pop->p.p_ops.memset = mock_memset;
+	pop->p.p_ops.drain = mock_drain;
+	pop->p.p_ops.persist = mock_persist;
+
+	struct stats stats = { .enabled = 1 };
+	pop->p.stats = &stats;
+	pop->p.uuid_lo = 123456;
+
+	base_ptr = &pop->p;
+
+	pop->p.lanes_offset = (uint64_t)&pop->l - (uint64_t)&pop->p;
+
+	lane_init_data(&pop->p);
+	lane_info_boot();
+	UT_ASSERTeq(lane_boot(&pop->p), 0);
+
+	/* a single lane available at runtime */
+	pop->p.lanes_desc.runtime_nlanes = 1;
+
+	lane_hold(&pop->p, NULL);
+
+	struct thread_data data;
+	data.work = LANE_HOLD_RELEASE;
+	os_thread_t thread;
+
+	os_thread_create(&thread, NULL, test_separate_thread, &data);
+
+	/* the wait is counted right before the thread goes to sleep */
+	uint64_t nwaits = 0;
+	while (nwaits == 0) {
+		util_atomic_load_explicit64(&pop->p.lanes_desc.lane[0].nwaits,
+			&nwaits, memory_order_acquire);
+	}
+
+	lane_release(&pop->p);
+	os_thread_join(&thread, NULL);
+
+	UT_ASSERTeq(pop->p.lanes_desc.nwaiters, 0);
+	UT_ASSERTeq(pop->p.lanes_desc.lane[0].ncontended, 0);
+
+	lane_cleanup(&pop->p);
+
+	FREE(pop);
+}
+
 static void
 test_fault_injection()
 {
@@ -302,7 +367,7 @@ test_fault_injection()
 		return;
 	pmemobj_inject_fault_at(PMEM_MALLOC, 1, "lane_boot");
 
-	struct mock_pop *pop = MALLOC(sizeof(struct mock_pop));
+	struct mock_pop *pop = ZALLOC(sizeof(struct mock_pop));
 	pop->p.p_ops.base = pop;
 
 	int ret = lane_boot(&pop->p);
@@ -337,6 +402,7 @@ main(int argc, char *argv[])
 		/* multithreaded scenarios */
 		test_lane_info_destroy_in_separate_thread();
 		test_lane_cleanup_in_separate_thread();
+		test_lane_wait();
 		break;
 	case 'f':
 		/* fault injection */
@@ -1,5 +1,5 @@
 /*
- * Copyright 2015-2018, Intel Corporation
+ * Copyright 2015-2019, Intel Corporation
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -200,7 +200,7 @@ FUNC_MOCK_RUN_DEFAULT
 	Id = (int *)((uintptr_t)Pop + linear_alloc(&heap_offset, sizeof(*Id)));
 
 	/* Alloc lane layout */
-	Lane.layout = (struct lane_layout *)((uintptr_t)Pop +
+	Lane.layout = (void *)((uintptr_t)Pop +
 			linear_alloc(&heap_offset, LANE_TOTAL_SIZE));
 
 	/* Alloc in band lists */
@@ -234,7 +234,8 @@ FUNC_MOCK_RUN_DEFAULT
 	Pop->run_id += 2;
 	pmemops_persist(p_ops, &Pop->run_id, sizeof(Pop->run_id));
 
-	Lane.external = operation_new((struct ulog *)&Lane.layout->external,
+	struct lane_layout *lane_layout = Lane.layout;
+	Lane.external = operation_new((struct ulog *)&lane_layout->external,
 		LANE_REDO_EXTERNAL_SIZE, NULL, NULL, p_ops, LOG_TYPE_REDO);
 
 	return Pop;
@@ -332,8 +333,9 @@ FUNC_MOCK_RET_ALWAYS_VOID(lane_release, PMEMobjpool *pop);
  */
 FUNC_MOCK(lane_recover_and_section_boot, int, PMEMobjpool *pop)
 	FUNC_MOCK_RUN_DEFAULT {
-		ulog_recover((struct ulog *)&Lane.layout->external,
-			OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops);
+		struct lane_layout *lane_layout = Lane.layout;
+		ulog_recover((struct ulog *)&lane_layout->external,
+			OBJ_OFF_IS_VALID_FROM_CTX, 1, &pop->p_ops);
 		return 0;
 	}
 FUNC_MOCK_END
@@ -379,9 +381,10 @@ FUNC_MOCK_END
  * ulog_process -- ulog_process mock
  */
 FUNC_MOCK(ulog_process, void, struct ulog *ulog,
-	ulog_check_offset_fn check, const struct pmem_ops *p_ops)
+	ulog_check_offset_fn check, unsigned nthreads,
+	const struct pmem_ops *p_ops)
 		FUNC_MOCK_RUN_DEFAULT {
-			_FUNC_REAL(ulog_process)(ulog, check, p_ops);
+			_FUNC_REAL(ulog_process)(ulog, check, nthreads, p_ops);
 			if (Ulog_fail == FAIL_AFTER_PROCESS) {
 				DONEW(NULL);
 			}
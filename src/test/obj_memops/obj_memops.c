@@ -45,6 +45,10 @@
 
 #define TEST_VALUES 128
 
+/* enough entries for the redo log to be applied by 4 threads */
+#define TEST_SORTED_VALUES 8192
+#define TEST_SORTED_NTHREADS 4
+
 enum fail_types {
 	FAIL_NONE,
 	FAIL_CHECKSUM,
@@ -126,7 +130,7 @@ test_set_entries(PMEMobjpool *pop,
 		}
 
 		ulog_recover((struct ulog *)&object->redo,
-			OBJ_OFF_IS_VALID_FROM_CTX, &pop->p_ops);
+			OBJ_OFF_IS_VALID_FROM_CTX, 1, &pop->p_ops);
 
 		for (size_t i = 0; i < nentries; ++i)
 			UT_ASSERTeq(object->values[i], 0);
@@ -178,6 +182,284 @@ test_same_twice(struct operation_context *ctx, struct test_object *object)
 	UT_ASSERTeq(object->values[0], 10);
 }
 
+static void
+test_redo_buffer(PMEMobjpool *pop, struct operation_context *ctx,
+	struct test_object *object, enum fail_types fail)
+{
+	uint64_t buffer[TEST_VALUES];
+	for (size_t i = 0; i < TEST_VALUES; ++i)
+		buffer[i] = i + 1;
+
+	operation_start(ctx);
+
+	/* large enough to be split between the base and the next logs */
+	operation_add_buffer(ctx, object->values, buffer,
+		sizeof(uint64_t) * (TEST_VALUES - 1), ULOG_OPERATION_BUF_CPY);
+	operation_add_typed_entry(ctx,
+		&object->values[TEST_VALUES - 1], TEST_VALUES,
+		ULOG_OPERATION_SET, LOG_PERSISTENT);
+
+	if (fail != FAIL_NONE) {
+		UT_ASSERTeq(fail, FAIL_CHECKSUM);
+		operation_cancel(ctx);
+
+		object->redo.checksum += 1;
+
+		ulog_recover((struct ulog *)&object->redo,
+			OBJ_OFF_IS_VALID_FROM_CTX, 1, &pop->p_ops);
+
+		for (size_t i = 0; i < TEST_VALUES; ++i)
+			UT_ASSERTeq(object->values[i], 0);
+	} else {
+		operation_finish(ctx, 0);
+
+		for (size_t i = 0; i < TEST_VALUES; ++i)
+			UT_ASSERTeq(object->values[i], i + 1);
+	}
+}
+
+/*
+ * test_redo_sorted -- applies a large redo log whose entries are added in
+ *	the reverse order of their destinations
+ */
+static void
+test_redo_sorted(PMEMobjpool *pop, struct operation_context *ctx,
+	int nthreads)
+{
+	int ret = pmemobj_ctl_set(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oid;
+	ret = pmemobj_zalloc(pop, &oid,
+		sizeof(uint64_t) * TEST_SORTED_VALUES, 0);
+	UT_ASSERTeq(ret, 0);
+	uint64_t *values = pmemobj_direct(oid);
+
+	operation_start(ctx);
+
+	for (size_t i = TEST_SORTED_VALUES; i > 0; --i) {
+		operation_add_typed_entry(ctx,
+			&values[i - 1], i,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	/* every other word is modified twice */
+	for (size_t i = 0; i < TEST_SORTED_VALUES; i += 2) {
+		operation_add_typed_entry(ctx,
+			&values[i], 1ULL << 63,
+			ULOG_OPERATION_OR, LOG_PERSISTENT);
+	}
+
+	operation_reserve(ctx, TEST_SORTED_VALUES * 32);
+	operation_finish(ctx, 0);
+
+	for (size_t i = 0; i < TEST_SORTED_VALUES; ++i) {
+		uint64_t expected = i + 1;
+		if (i % 2 == 0)
+			expected |= 1ULL << 63;
+		UT_ASSERTeq(values[i], expected);
+	}
+
+	pmemobj_free(&oid);
+
+	nthreads = 1;
+	ret = pmemobj_ctl_set(NULL, "lane.redo.apply_threads", &nthreads);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * test_redo_sorted_overlap -- applies a large redo log in which a buffer
+ *	overwrites values set by the preceding entries
+ */
+static void
+test_redo_sorted_overlap(struct operation_context *ctx,
+	struct test_object *object)
+{
+	uint64_t buffer[8];
+	memset(buffer, 0xc, sizeof(buffer));
+
+	operation_start(ctx);
+
+	for (size_t i = 0; i < TEST_VALUES; ++i) {
+		operation_add_typed_entry(ctx,
+			&object->values[i], i + 1,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	operation_add_buffer(ctx, &object->values[0], buffer,
+		sizeof(buffer), ULOG_OPERATION_BUF_CPY);
+
+	operation_reserve(ctx, TEST_VALUES * 16 + sizeof(buffer) * 2);
+	operation_finish(ctx, 0);
+
+	for (size_t i = 0; i < TEST_VALUES; ++i) {
+		uint64_t expected = i < ARRAY_SIZE(buffer) ? buffer[i] : i + 1;
+		UT_ASSERTeq(object->values[i], expected);
+	}
+}
+
+static flush_fn Flush_orig;
+static const void *Flush_begin;
+static const void *Flush_end;
+static unsigned Flush_count;
+static size_t Flush_len_max;
+
+/*
+ * flush_count -- counts flushes of the test values
+ */
+static int
+flush_count(void *base, const void *addr, size_t len, unsigned flags)
+{
+	if (addr >= Flush_begin && addr < Flush_end) {
+		Flush_count++;
+		Flush_len_max = MAX(Flush_len_max, len);
+	}
+
+	return Flush_orig(base, addr, len, flags);
+}
+
+/*
+ * test_redo_flush_lines -- verifies that the values modified by a redo log
+ *	are flushed once per cache line, or one by one if whole lines cannot
+ *	be flushed
+ */
+static void
+test_redo_flush_lines(PMEMobjpool *pop, struct test_object *object,
+	int line_flush)
+{
+	struct pmem_ops ops = pop->p_ops;
+	Flush_orig = ops.flush;
+	ops.flush = flush_count;
+
+	struct operation_context *ctx = operation_new(
+		(struct ulog *)&object->redo, TEST_ENTRIES,
+		pmalloc_redo_extend, (ulog_free_fn)pfree,
+		&ops, LOG_TYPE_REDO);
+	operation_set_line_flush(ctx, line_flush);
+
+	/*
+	 * With whole line flushes, few enough entries for the log to be
+	 * applied in the log order. Otherwise, enough of them for the log to
+	 * be sorted by destination, unless that's disabled as well.
+	 */
+	size_t nvalues = line_flush ? 12 : 32;
+	Flush_begin = &object->values[0];
+	Flush_end = &object->values[nvalues];
+	Flush_count = 0;
+	Flush_len_max = 0;
+
+	unsigned nlines = 0;
+	uintptr_t last_line = 0;
+
+	operation_start(ctx);
+
+	for (size_t i = 0; i < nvalues; ++i) {
+		uintptr_t line = ALIGN_DOWN((uintptr_t)&object->values[i],
+			CACHELINE_SIZE);
+		if (line != last_line)
+			nlines++;
+		last_line = line;
+
+		operation_add_typed_entry(ctx,
+			&object->values[i], i + 1,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	/* modify the first line again */
+	operation_add_typed_entry(ctx,
+		&object->values[1], 1ULL << 63,
+		ULOG_OPERATION_OR, LOG_PERSISTENT);
+
+	operation_reserve(ctx, (nvalues + 1) * 16);
+	operation_finish(ctx, 0);
+
+	if (line_flush) {
+		UT_ASSERTeq(Flush_count, nlines);
+	} else {
+		UT_ASSERT(Flush_count >= nvalues);
+		UT_ASSERT(Flush_len_max <= sizeof(uint64_t));
+	}
+
+	for (size_t i = 0; i < nvalues; ++i) {
+		uint64_t expected = i + 1;
+		if (i == 1)
+			expected |= 1ULL << 63;
+		UT_ASSERTeq(object->values[i], expected);
+	}
+
+	operation_delete(ctx);
+}
+
+static memcpy_fn Memcpy_orig;
+static struct ulog *Clobber_ulog;
+static uint8_t Clobber_saved[SIZEOF_ULOG(TEST_ENTRIES)];
+
+/*
+ * memcpy_save_clobbered -- saves the content of the ulog right before its
+ *	metadata is zeroed, i.e., the state in which a crash during processing
+ *	leaves it
+ */
+static void *
+memcpy_save_clobbered(void *base, void *dest, const void *src, size_t len,
+	unsigned flags)
+{
+	if (dest == Clobber_ulog && len == sizeof(struct ulog))
+		memcpy(Clobber_saved, dest, sizeof(Clobber_saved));
+
+	return Memcpy_orig(base, dest, src, len, flags);
+}
+
+/*
+ * test_redo_grow_recover -- verifies that a redo log whose volatile shadow
+ *	had to grow past its initial size is still recovered after a crash
+ */
+static void
+test_redo_grow_recover(PMEMobjpool *pop, struct test_object *object)
+{
+	struct pmem_ops ops = pop->p_ops;
+	Memcpy_orig = ops.memcpy;
+	ops.memcpy = memcpy_save_clobbered;
+
+	struct operation_context *ctx = operation_new(
+		(struct ulog *)&object->redo, TEST_ENTRIES,
+		pmalloc_redo_extend, (ulog_free_fn)pfree,
+		&ops, LOG_TYPE_REDO);
+
+	Clobber_ulog = (struct ulog *)&object->redo;
+
+	operation_start(ctx);
+
+	/* enough entries to grow the shadow log past ULOG_BASE_SIZE */
+	for (size_t i = 0; i < TEST_VALUES; ++i) {
+		operation_add_typed_entry(ctx,
+			&object->values[i], i + 1,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	operation_reserve(ctx, TEST_VALUES * 16 + CACHELINE_SIZE);
+	operation_process(ctx);
+
+	for (size_t i = 0; i < TEST_VALUES; ++i)
+		UT_ASSERTeq(object->values[i], i + 1);
+
+	/* bring back the committed log, as if the processing was interrupted */
+	struct ulog *saved = (struct ulog *)Clobber_saved;
+	UT_ASSERTeq(saved->capacity, TEST_ENTRIES);
+
+	memcpy(&object->redo, Clobber_saved, sizeof(Clobber_saved));
+	pmemops_persist(&pop->p_ops, &object->redo, sizeof(Clobber_saved));
+	clear_test_values(object);
+
+	ulog_recover((struct ulog *)&object->redo,
+		OBJ_OFF_IS_VALID_FROM_CTX, 1, &pop->p_ops);
+
+	for (size_t i = 0; i < TEST_VALUES; ++i)
+		UT_ASSERTeq(object->values[i], i + 1);
+
+	operation_finish(ctx, 0);
+	operation_delete(ctx);
+}
+
 static void
 test_redo(PMEMobjpool *pop, struct test_object *object)
 {
@@ -186,6 +468,10 @@ test_redo(PMEMobjpool *pop, struct test_object *object)
 		pmalloc_redo_extend, (ulog_free_fn)pfree,
 		&pop->p_ops, LOG_TYPE_REDO);
 
+	test_redo_buffer(pop, ctx, object, FAIL_NONE);
+	clear_test_values(object);
+	test_redo_buffer(pop, ctx, object, FAIL_CHECKSUM);
+	clear_test_values(object);
 	test_set_entries(pop, ctx, object, 10, FAIL_NONE);
 	clear_test_values(object);
 	test_merge_op(ctx, object);
@@ -220,6 +506,29 @@ test_redo(PMEMobjpool *pop, struct test_object *object)
 	clear_test_values(object);
 
 	operation_delete(ctx);
+
+	/* large logs are applied in the order of their destinations */
+	ctx = operation_new(
+		(struct ulog *)&object->redo, TEST_ENTRIES,
+		pmalloc_redo_extend, (ulog_free_fn)pfree,
+		&pop->p_ops, LOG_TYPE_REDO);
+	operation_set_parallel_apply(ctx, 1);
+	operation_set_line_flush(ctx, 1);
+
+	test_redo_sorted_overlap(ctx, object);
+	clear_test_values(object);
+	test_redo_sorted(pop, ctx, 1);
+	test_redo_sorted(pop, ctx, TEST_SORTED_NTHREADS);
+
+	operation_delete(ctx);
+
+	test_redo_flush_lines(pop, object, 1);
+	clear_test_values(object);
+	test_redo_flush_lines(pop, object, 0);
+	clear_test_values(object);
+
+	test_redo_grow_recover(pop, object);
+	clear_test_values(object);
 }
 
 static void
@@ -790,6 +790,62 @@ do_tx_xadd_range_no_uninit_check_abort(PMEMobjpool *pop)
 	} TX_END
 }
 
+/*
+ * do_tx_add_range_many -- call pmemobj_tx_add_range with many disjoint
+ * ranges and then with ranges which overlap them
+ */
+static void
+do_tx_add_range_many(PMEMobjpool *pop)
+{
+	TOID(struct root) root;
+	TOID_ASSIGN(root, pmemobj_root(pop, sizeof(struct root)));
+
+	size_t nranges = 1024;
+	UT_ASSERT(nranges * 2 <= ROOT_TAB_SIZE);
+
+	TX_BEGIN(pop) {
+		for (size_t i = 0; i < nranges; ++i) {
+			TX_ADD_FIELD(root, tab[i * 2]);
+			D_RW(root)->tab[i * 2] = 1;
+		}
+
+		pmemobj_tx_add_range(root.oid, offsetof(struct root, tab),
+			nranges * 2 * sizeof(int));
+		for (size_t i = 0; i < nranges * 2; ++i)
+			D_RW(root)->tab[i] = 2;
+
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (size_t i = 0; i < nranges * 2; ++i)
+		UT_ASSERTeq(D_RO(root)->tab[i], 0);
+
+	TX_BEGIN(pop) {
+		for (size_t i = 0; i < nranges; ++i) {
+			TX_ADD_FIELD(root, tab[i * 2 + 1]);
+			D_RW(root)->tab[i * 2 + 1] = 1;
+		}
+
+		for (size_t i = 0; i < nranges; ++i) {
+			TX_ADD_FIELD(root, tab[i * 2]);
+			D_RW(root)->tab[i * 2] = 2;
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (size_t i = 0; i < nranges * 2; ++i)
+		UT_ASSERTeq(D_RO(root)->tab[i], i % 2 ? 1 : 2);
+
+	TX_BEGIN(pop) {
+		TX_MEMSET(D_RW(root)->tab, 0, nranges * 2 * sizeof(int));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
 /*
  * do_tx_add_range_overlapping -- call pmemobj_tx_add_range with overlapping
  */
@@ -1130,6 +1186,8 @@ main(int argc, char *argv[])
 		VALGRIND_WRITE_STATS;
 		do_tx_add_range_overlapping(pop);
 		VALGRIND_WRITE_STATS;
+		do_tx_add_range_many(pop);
+		VALGRIND_WRITE_STATS;
 		do_tx_add_range_too_large(pop);
 		VALGRIND_WRITE_STATS;
 		do_tx_add_huge_range_abort(pop);
@@ -35,6 +35,9 @@
  *
  * It checks that objects are removed from transactions before on abort/commit
  * phase.
+ *
+ * If the number of post commit workers is given, the post commit work of the
+ * transactions is performed by the workers.
  */
 #include "unittest.h"
 #include "sys_util.h"
@@ -80,6 +83,15 @@ tx_alloc_free(void *arg)
 	return NULL;
 }
 
+static void *
+tx_post_commit_worker(void *arg)
+{
+	int ret = pmemobj_ctl_get(pop, "tx.post_commit.worker", arg);
+	UT_ASSERTeq(ret, 0);
+
+	return NULL;
+}
+
 static void *
 tx_snap(void *arg)
 {
@@ -104,6 +116,26 @@ tx_snap(void *arg)
 	return NULL;
 }
 
+/*
+ * run_threads -- runs the transactional threads until they are done
+ */
+static void
+run_threads(void)
+{
+	int i = 0;
+	os_thread_t *threads = MALLOC(THREADS * sizeof(threads[0]));
+
+	for (int j = 0; j < THREADS / 2; ++j) {
+		PTHREAD_CREATE(&threads[i++], NULL, tx_alloc_free, NULL);
+		PTHREAD_CREATE(&threads[i++], NULL, tx_snap, NULL);
+	}
+
+	while (i > 0)
+		PTHREAD_JOIN(&threads[--i], NULL);
+
+	FREE(threads);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -111,29 +143,75 @@ main(int argc, char *argv[])
 
 	util_mutex_init(&mtx);
 
-	if (argc != 2)
-		UT_FATAL("usage: %s [file]", argv[0]);
+	if (argc < 2 || argc > 3)
+		UT_FATAL("usage: %s [file] [post commit workers]", argv[0]);
 
 	if ((pop = pmemobj_create(argv[1], "mt", PMEMOBJ_MIN_POOL,
 			S_IWUSR | S_IRUSR)) == NULL)
 		UT_FATAL("!pmemobj_create");
 
-	int i = 0;
-	os_thread_t *threads = MALLOC(THREADS * sizeof(threads[0]));
-
-	for (int j = 0; j < THREADS / 2; ++j) {
-		PTHREAD_CREATE(&threads[i++], NULL, tx_alloc_free, NULL);
-		PTHREAD_CREATE(&threads[i++], NULL, tx_snap, NULL);
+	int nworkers = argc == 3 ? atoi(argv[2]) : 0;
+	os_thread_t *workers = NULL;
+
+	if (nworkers > 0) {
+		int depth = THREADS;
+		int ret = pmemobj_ctl_set(pop, "tx.post_commit.queue_depth",
+			&depth);
+		UT_ASSERTeq(ret, 0);
+
+		depth = 0;
+		ret = pmemobj_ctl_get(pop, "tx.post_commit.queue_depth",
+			&depth);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(depth, THREADS);
+
+		workers = MALLOC((size_t)nworkers * sizeof(workers[0]));
+		for (int w = 0; w < nworkers; ++w)
+			PTHREAD_CREATE(&workers[w], NULL,
+				tx_post_commit_worker, pop);
 	}
 
-	while (i > 0)
-		PTHREAD_JOIN(&threads[--i], NULL);
+	run_threads();
+
+	if (nworkers > 0) {
+		/* the depth cannot be changed with running workers */
+		int depth = 1;
+		int ret = pmemobj_ctl_set(pop, "tx.post_commit.queue_depth",
+			&depth);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EBUSY);
+
+		ret = pmemobj_ctl_get(pop, "tx.post_commit.stop", pop);
+		UT_ASSERTeq(ret, 0);
+
+		for (int w = 0; w < nworkers; ++w)
+			PTHREAD_JOIN(&workers[w], NULL);
+
+		/* but it can be once they are stopped */
+		ret = pmemobj_ctl_set(pop, "tx.post_commit.queue_depth",
+			&depth);
+		UT_ASSERTeq(ret, 0);
+
+		/* closing the pool stops the worker */
+		PTHREAD_CREATE(&workers[0], NULL, tx_post_commit_worker, pop);
+
+		/* wait until the worker is running */
+		while (pmemobj_ctl_set(pop, "tx.post_commit.queue_depth",
+				&depth) == 0)
+			;
+		UT_ASSERTeq(errno, EBUSY);
+
+		run_threads();
+	}
 
 	pmemobj_close(pop);
 
-	util_mutex_destroy(&mtx);
+	if (nworkers > 0) {
+		PTHREAD_JOIN(&workers[0], NULL);
+		FREE(workers);
+	}
 
-	FREE(threads);
+	util_mutex_destroy(&mtx);
 
 	DONE(NULL);
 }
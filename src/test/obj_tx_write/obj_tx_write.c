@@ -0,0 +1,389 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_write.c -- unit test for pmemobj_tx_write and pmemobj_tx_read
+ */
+#include <string.h>
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "tx_write"
+
+#define OBJ_SIZE	1024
+#define LARGE_OBJ_SIZE	(64 * 1024)
+
+#define POOL_SIZE	(PMEMOBJ_MIN_POOL * 4)
+
+/*
+ * check_data -- verifies the contents of the object in the pool
+ */
+static void
+check_data(PMEMoid oid, const char *expected, size_t size)
+{
+	UT_ASSERTeq(memcmp(pmemobj_direct(oid), expected, size), 0);
+}
+
+/*
+ * check_tx_data -- verifies the contents of the object as seen by the
+ *	transaction
+ */
+static void
+check_tx_data(PMEMoid oid, const char *expected, size_t size)
+{
+	char *buf = MALLOC(size);
+	UT_ASSERTeq(pmemobj_tx_read(oid, 0, buf, size), 0);
+	UT_ASSERTeq(memcmp(buf, expected, size), 0);
+	FREE(buf);
+}
+
+/*
+ * do_tx_write_commit -- writes data in a transaction and commits it
+ */
+static void
+do_tx_write_commit(PMEMobjpool *pop, PMEMoid oid)
+{
+	char old[OBJ_SIZE];
+	char data[OBJ_SIZE];
+	memcpy(old, pmemobj_direct(oid), OBJ_SIZE);
+	memset(data, 0xc, OBJ_SIZE);
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_write(oid, 0, data, OBJ_SIZE), 0);
+
+		/* the pool is not modified until commit */
+		check_data(oid, old, OBJ_SIZE);
+		check_tx_data(oid, data, OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_data(oid, data, OBJ_SIZE);
+}
+
+/*
+ * do_tx_write_abort -- writes data in a transaction and aborts it
+ */
+static void
+do_tx_write_abort(PMEMobjpool *pop, PMEMoid oid)
+{
+	char old[OBJ_SIZE];
+	char data[OBJ_SIZE];
+	memcpy(old, pmemobj_direct(oid), OBJ_SIZE);
+	memset(data, 0xa, OBJ_SIZE);
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_write(oid, 0, data, OBJ_SIZE), 0);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_data(oid, old, OBJ_SIZE);
+}
+
+/*
+ * do_tx_write_merge -- performs overlapping, adjacent and disjoint writes
+ *	and verifies that the write set combines them correctly
+ */
+static void
+do_tx_write_merge(PMEMobjpool *pop, PMEMoid oid)
+{
+	char expected[OBJ_SIZE];
+	char data[OBJ_SIZE];
+	memset(expected, 0, OBJ_SIZE);
+	memset(data, 0, OBJ_SIZE);
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_write(oid, 0, data, OBJ_SIZE), 0);
+	} TX_END
+
+	struct {
+		uint64_t off;
+		size_t size;
+		char c;
+	} writes[] = {
+		{512, 64, 1}, /* disjoint */
+		{64, 64, 2}, /* disjoint, before the previous one */
+		{96, 64, 3}, /* overlaps the end of the previous one */
+		{160, 32, 4}, /* touches the end of the previous one */
+		{100, 10, 5}, /* contained in an existing one */
+		{32, 600, 6}, /* covers all existing ones */
+		{1000, 24, 7}, /* ends at the end of the object */
+		{0, 1, 8}, /* single byte */
+	};
+
+	TX_BEGIN(pop) {
+		for (size_t i = 0; i < ARRAY_SIZE(writes); ++i) {
+			memset(data, writes[i].c, writes[i].size);
+			UT_ASSERTeq(pmemobj_tx_write(oid, writes[i].off,
+				data, writes[i].size), 0);
+			memset(expected + writes[i].off, writes[i].c,
+				writes[i].size);
+
+			check_tx_data(oid, expected, OBJ_SIZE);
+		}
+
+		/* read of a range that is partially in the write set */
+		char buf[OBJ_SIZE - 990];
+		UT_ASSERTeq(pmemobj_tx_read(oid, 990, buf, sizeof(buf)), 0);
+		UT_ASSERTeq(memcmp(buf, expected + 990, sizeof(buf)), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_data(oid, expected, OBJ_SIZE);
+}
+
+/*
+ * do_tx_write_large -- writes more data than fits in the redo log of a lane
+ */
+static void
+do_tx_write_large(PMEMobjpool *pop)
+{
+	PMEMoid oid;
+	int ret = pmemobj_zalloc(pop, &oid, LARGE_OBJ_SIZE, 0);
+	UT_ASSERTeq(ret, 0);
+
+	char *data = MALLOC(LARGE_OBJ_SIZE);
+	for (size_t i = 0; i < LARGE_OBJ_SIZE; ++i)
+		data[i] = (char)i;
+
+	TX_BEGIN(pop) {
+		/* every other cache line, to create many log entries */
+		for (size_t off = 0; off < LARGE_OBJ_SIZE; off += 128) {
+			UT_ASSERTeq(pmemobj_tx_write(oid, off, data + off,
+				64), 0);
+		}
+
+		UT_ASSERTeq(pmemobj_tx_write(oid, LARGE_OBJ_SIZE / 2,
+			data + LARGE_OBJ_SIZE / 2, LARGE_OBJ_SIZE / 2), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	char *obj = pmemobj_direct(oid);
+	for (size_t off = 0; off < LARGE_OBJ_SIZE; off += 128) {
+		UT_ASSERTeq(memcmp(obj + off, data + off, 64), 0);
+		if (off < LARGE_OBJ_SIZE / 2) {
+			for (size_t i = off + 64; i < off + 128; ++i)
+				UT_ASSERTeq(obj[i], 0);
+		}
+	}
+	UT_ASSERTeq(memcmp(obj + LARGE_OBJ_SIZE / 2,
+		data + LARGE_OBJ_SIZE / 2, LARGE_OBJ_SIZE / 2), 0);
+
+	FREE(data);
+	pmemobj_free(&oid);
+}
+
+/*
+ * do_tx_write_sequential -- performs many small adjacent writes, in
+ *	ascending, descending and interleaved order
+ */
+static void
+do_tx_write_sequential(PMEMobjpool *pop)
+{
+	PMEMoid oid;
+	int ret = pmemobj_zalloc(pop, &oid, LARGE_OBJ_SIZE, 0);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t *data = MALLOC(LARGE_OBJ_SIZE);
+	size_t nwords = LARGE_OBJ_SIZE / sizeof(uint64_t);
+	for (size_t i = 0; i < nwords; ++i)
+		data[i] = i + 1;
+
+	size_t quarter = nwords / 4;
+
+	TX_BEGIN(pop) {
+		/* ascending, each write extends the entry */
+		for (size_t i = 0; i < quarter; ++i) {
+			UT_ASSERTeq(pmemobj_tx_write(oid, i * sizeof(uint64_t),
+				&data[i], sizeof(uint64_t)), 0);
+		}
+
+		/* descending, each write prepends to the entry */
+		for (size_t i = 2 * quarter; i > quarter; --i) {
+			UT_ASSERTeq(pmemobj_tx_write(oid,
+				(i - 1) * sizeof(uint64_t), &data[i - 1],
+				sizeof(uint64_t)), 0);
+		}
+
+		/*
+		 * Every other word first, then the gaps from the end, so that
+		 * the merged entries are moved and the buffer is compacted.
+		 */
+		for (size_t i = 2 * quarter; i < nwords; i += 2) {
+			UT_ASSERTeq(pmemobj_tx_write(oid, i * sizeof(uint64_t),
+				&data[i], sizeof(uint64_t)), 0);
+		}
+		for (size_t i = nwords - 1; i > 2 * quarter; i -= 2) {
+			UT_ASSERTeq(pmemobj_tx_write(oid, i * sizeof(uint64_t),
+				&data[i], sizeof(uint64_t)), 0);
+		}
+
+		check_tx_data(oid, (char *)data, LARGE_OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_data(oid, (char *)data, LARGE_OBJ_SIZE);
+
+	FREE(data);
+	pmemobj_free(&oid);
+}
+
+/*
+ * do_tx_write_alloc -- writes to an object allocated in the same
+ *	transaction
+ */
+static void
+do_tx_write_alloc(PMEMobjpool *pop)
+{
+	char data[OBJ_SIZE];
+	memset(data, 0xd, OBJ_SIZE);
+
+	PMEMoid oid = OID_NULL;
+	TX_BEGIN(pop) {
+		oid = pmemobj_tx_alloc(OBJ_SIZE, 0);
+		UT_ASSERTeq(pmemobj_tx_write(oid, 0, data, OBJ_SIZE), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_data(oid, data, OBJ_SIZE);
+	pmemobj_free(&oid);
+}
+
+/*
+ * do_tx_write_invalid -- writes outside of the pool
+ */
+static void
+do_tx_write_invalid(PMEMobjpool *pop, PMEMoid oid)
+{
+	char data[OBJ_SIZE];
+	memset(data, 0xe, OBJ_SIZE);
+
+	PMEMoid wrong = oid;
+	wrong.pool_uuid_lo = ~wrong.pool_uuid_lo;
+
+	TX_BEGIN(pop) {
+		int ret = pmemobj_tx_xwrite(wrong, 0, data, OBJ_SIZE,
+			POBJ_XWRITE_NO_ABORT);
+		UT_ASSERTeq(ret, EINVAL);
+		UT_ASSERTeq(errno, EINVAL);
+
+		ret = pmemobj_tx_xwrite(oid, 0, data, OBJ_SIZE,
+			POBJ_XWRITE_NO_ABORT << 1);
+		UT_ASSERT(0); /* not reached */
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+}
+
+/*
+ * do_tx_read_invalid -- reads of a size that wraps around the pool
+ */
+static void
+do_tx_read_invalid(PMEMobjpool *pop, PMEMoid oid)
+{
+	char data[OBJ_SIZE];
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_read(oid, 0, data, SIZE_MAX);
+		UT_ASSERT(0); /* not reached */
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+}
+
+/*
+ * do_tx_write_reopen -- verifies that the written data is persistent
+ */
+static void
+do_tx_write_reopen(PMEMobjpool *pop, const char *path)
+{
+	PMEMoid root = pmemobj_root(pop, OBJ_SIZE);
+	char data[OBJ_SIZE];
+	memset(data, 0xf, OBJ_SIZE);
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_write(root, 0, data, OBJ_SIZE), 0);
+	} TX_END
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	UT_ASSERTne(pop, NULL);
+
+	check_data(pmemobj_root(pop, OBJ_SIZE), data, OBJ_SIZE);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_write");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, POOL_SIZE,
+	    S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	do_tx_write_large(pop);
+	do_tx_write_sequential(pop);
+
+	PMEMoid oid;
+	int ret = pmemobj_zalloc(pop, &oid, OBJ_SIZE, 0);
+	UT_ASSERTeq(ret, 0);
+
+	do_tx_write_commit(pop, oid);
+	do_tx_write_abort(pop, oid);
+	do_tx_write_merge(pop, oid);
+	do_tx_write_alloc(pop);
+	do_tx_write_invalid(pop, oid);
+	do_tx_read_invalid(pop, oid);
+
+	pmemobj_free(&oid);
+
+	do_tx_write_reopen(pop, argv[1]);
+
+	DONE(NULL);
+}
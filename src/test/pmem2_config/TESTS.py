@@ -73,3 +73,19 @@ class TEST6(PMEM2_CONFIG):
 class TEST7(PMEM2_CONFIG):
     """deleting null pmem2_config"""
     test_case = "delete_null_config"
+
+class TEST8(PMEM2_CONFIG):
+    """setting offset which is too large"""
+    test_case = "set_offset_too_large"
+
+class TEST9(PMEM2_CONFIG):
+    """setting unknown sharing type"""
+    test_case = "set_invalid_sharing"
+
+class TEST10(PMEM2_CONFIG):
+    """setting unknown protection flags"""
+    test_case = "set_invalid_protection"
+
+class TEST11(PMEM2_CONFIG):
+    """setting invalid address requests"""
+    test_case = "set_invalid_address"
@@ -190,6 +190,84 @@ test_delete_null_config(const char *unused)
 	UT_ASSERTeq(cfg, NULL);
 }
 
+/*
+ * test_set_offset_too_large - test setting offset which is too large
+ */
+static void
+test_set_offset_too_large(const char *unused)
+{
+	struct pmem2_config cfg;
+	config_init(&cfg);
+
+	int ret = pmem2_config_set_offset(&cfg, (size_t)INT64_MAX + 1);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+	UT_ASSERTeq(cfg.offset, 0);
+
+	ret = pmem2_config_set_offset(&cfg, (size_t)INT64_MAX);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(cfg.offset, (size_t)INT64_MAX);
+}
+
+/*
+ * test_set_invalid_sharing - test setting an unknown sharing type
+ */
+static void
+test_set_invalid_sharing(const char *unused)
+{
+	struct pmem2_config cfg;
+	config_init(&cfg);
+
+	int ret = pmem2_config_set_sharing(&cfg, PMEM2_PRIVATE + 1);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+	UT_ASSERTeq(cfg.sharing, PMEM2_SHARED);
+
+	ret = pmem2_config_set_sharing(&cfg, PMEM2_PRIVATE);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(cfg.sharing, PMEM2_PRIVATE);
+}
+
+/*
+ * test_set_invalid_protection - test setting unknown protection flags
+ */
+static void
+test_set_invalid_protection(const char *unused)
+{
+	struct pmem2_config cfg;
+	config_init(&cfg);
+
+	int ret = pmem2_config_set_protection(&cfg, PMEM2_PROT_READ | 1);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+	UT_ASSERTeq(cfg.protection, PMEM2_PROT_FROM_FD);
+}
+
+/*
+ * test_set_invalid_address - test setting invalid address requests
+ */
+static void
+test_set_invalid_address(const char *unused)
+{
+	struct pmem2_config cfg;
+	config_init(&cfg);
+
+	/* address has to be NULL for PMEM2_ADDRESS_ANY */
+	int ret = pmem2_config_set_address(&cfg, PMEM2_ADDRESS_ANY,
+		(void *)Ut_mmap_align);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	/* fixed address cannot be NULL */
+	ret = pmem2_config_set_address(&cfg, PMEM2_ADDRESS_FIXED_NOREPLACE,
+		NULL);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	/* fixed address has to be page aligned */
+	ret = pmem2_config_set_address(&cfg, PMEM2_ADDRESS_FIXED_REPLACE,
+		(void *)(Ut_mmap_align + 1));
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	UT_ASSERTeq(cfg.addr_request, PMEM2_ADDRESS_ANY);
+	UT_ASSERTeq(cfg.addr, NULL);
+}
+
 typedef void (*test_fun)(const char *file);
 
 static struct test_list {
@@ -204,6 +282,10 @@ static struct test_list {
 	{"set_wronly_fd", test_set_wronly_fd},
 	{"alloc_cfg_enomem", test_alloc_cfg_enomem},
 	{"delete_null_config", test_delete_null_config},
+	{"set_offset_too_large", test_set_offset_too_large},
+	{"set_invalid_sharing", test_set_invalid_sharing},
+	{"set_invalid_protection", test_set_invalid_protection},
+	{"set_invalid_address", test_set_invalid_address},
 };
 
 int
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem2_map.c -- pmem2_map unittests
+ */
+
+#include "unittest.h"
+#include "ut_pmem2.h"
+
+/*
+ * prepare_config -- fill pmem2_config in minimal scope
+ */
+static void
+prepare_config(struct pmem2_config **cfg, int *fd, const char *file,
+	size_t offset, size_t length)
+{
+	*fd = OPEN(file, O_RDWR);
+
+	PMEM2_CONFIG_NEW(cfg);
+	PMEM2_CONFIG_SET_FD(*cfg, *fd);
+
+	int ret = pmem2_config_set_offset(*cfg, offset);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_length(*cfg, length);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+}
+
+/*
+ * cleanup -- delete the config and close the file
+ */
+static void
+cleanup(struct pmem2_config **cfg, int fd)
+{
+	PMEM2_CONFIG_DELETE(cfg);
+	CLOSE(fd);
+}
+
+/*
+ * test_map_whole_file -- map the whole file and verify its length
+ */
+static void
+test_map_whole_file(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	prepare_config(&cfg, &fd, file, 0, 0);
+
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	os_stat_t st;
+	FSTAT(fd, &st);
+	UT_ASSERTeq(pmem2_map_get_size(map), (size_t)st.st_size);
+	UT_ASSERTne(pmem2_map_get_address(map), NULL);
+	UT_ASSERTne(pmem2_get_config(map), NULL);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(map, NULL);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_part -- map a part of the file and verify the mapping shows
+ *	the contents of the requested range
+ */
+static void
+test_map_part(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	size_t offset = Ut_mmap_align;
+	size_t length = 2 * Ut_mmap_align;
+
+	prepare_config(&cfg, &fd, file, offset, length);
+
+	/* mark the beginning and the end of the requested range */
+	char pattern[] = "PMEM2";
+	LSEEK(fd, (os_off_t)offset, SEEK_SET);
+	WRITE(fd, pattern, sizeof(pattern));
+	LSEEK(fd, (os_off_t)(offset + length - sizeof(pattern)), SEEK_SET);
+	WRITE(fd, pattern, sizeof(pattern));
+
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	UT_ASSERTeq(pmem2_map_get_size(map), length);
+
+	char *addr = pmem2_map_get_address(map);
+	UT_ASSERTeq(memcmp(addr, pattern, sizeof(pattern)), 0);
+	UT_ASSERTeq(memcmp(addr + length - sizeof(pattern), pattern,
+		sizeof(pattern)), 0);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_unaligned_offset -- map the file with an unaligned offset
+ */
+static void
+test_map_unaligned_offset(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	prepare_config(&cfg, &fd, file, Ut_mmap_align - 1, 0);
+
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_beyond_eof -- map a range which exceeds the file size
+ */
+static void
+test_map_beyond_eof(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	os_stat_t st;
+	STAT(file, &st);
+	size_t file_size = (size_t)st.st_size;
+
+	/* offset at the end of the file */
+	prepare_config(&cfg, &fd, file, file_size, 0);
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_RANGE);
+
+	/* length reaching past the end of the file */
+	ret = pmem2_config_set_offset(cfg, Ut_mmap_align);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_length(cfg, file_size);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_RANGE);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_no_fd -- map using a config without a file
+ */
+static void
+test_map_no_fd(const char *unused)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+
+	PMEM2_CONFIG_NEW(&cfg);
+
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_HANDLE);
+
+	PMEM2_CONFIG_DELETE(&cfg);
+}
+
+/*
+ * test_map_private -- verify stores to a private mapping do not reach
+ *	the file
+ */
+static void
+test_map_private(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	prepare_config(&cfg, &fd, file, 0, Ut_mmap_align);
+
+	int ret = pmem2_config_set_sharing(cfg, PMEM2_PRIVATE);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	/* nothing has to be flushed for private mappings */
+	UT_ASSERTeq(pmem2_map_get_store_granularity(map),
+		PMEM2_GRANULARITY_BYTE);
+
+	char *addr = pmem2_map_get_address(map);
+	memset(addr, 0xFF, Ut_mmap_align);
+
+	char buf[64];
+	LSEEK(fd, 0, SEEK_SET);
+	UT_ASSERTeq(READ(fd, buf, sizeof(buf)), sizeof(buf));
+	for (size_t i = 0; i < sizeof(buf); ++i)
+		UT_ASSERTeq(buf[i], 0);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_granularity -- request a store granularity finer than the one
+ *	forced through PMEM2_FORCE_GRANULARITY
+ */
+static void
+test_map_granularity(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	int fd;
+
+	prepare_config(&cfg, &fd, file, 0, 0);
+
+	int ret = pmem2_config_set_required_store_granularity(cfg,
+		PMEM2_GRANULARITY_CACHE_LINE);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_GRANULARITY_NOT_SUPPORTED);
+
+	ret = pmem2_config_set_required_store_granularity(cfg,
+		PMEM2_GRANULARITY_PAGE);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(pmem2_map_get_store_granularity(map),
+		PMEM2_GRANULARITY_PAGE);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	cleanup(&cfg, fd);
+}
+
+/*
+ * test_map_fixed_noreplace -- map the file at an already occupied address
+ */
+static void
+test_map_fixed_noreplace(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	struct pmem2_map *map2;
+	int fd;
+
+	prepare_config(&cfg, &fd, file, 0, Ut_mmap_align);
+
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_config_set_address(cfg, PMEM2_ADDRESS_FIXED_NOREPLACE,
+		pmem2_map_get_address(map));
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_map(cfg, &map2);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_EXISTS);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	cleanup(&cfg, fd);
+}
+
+typedef void (*test_fun)(const char *file);
+
+static struct test_list {
+	const char *name;
+	test_fun test;
+} list[] = {
+	{"map_whole_file", test_map_whole_file},
+	{"map_part", test_map_part},
+	{"map_unaligned_offset", test_map_unaligned_offset},
+	{"map_beyond_eof", test_map_beyond_eof},
+	{"map_no_fd", test_map_no_fd},
+	{"map_private", test_map_private},
+	{"map_granularity", test_map_granularity},
+	{"map_fixed_noreplace", test_map_fixed_noreplace},
+};
+
+int
+main(int argc, char **argv)
+{
+	START(argc, argv, "pmem2_map");
+	if (argc != 3)
+		UT_FATAL("usage: %s test_case file", argv[0]);
+
+	char *test_case = argv[1];
+	char *file = argv[2];
+
+	for (int i = 0; i < ARRAY_SIZE(list); i++) {
+		if (strcmp(list[i].name, test_case) == 0) {
+			list[i].test(file);
+			goto end;
+		}
+	}
+	UT_FATAL("test: %s doesn't exist", test_case);
+end:
+	DONE(NULL);
+}
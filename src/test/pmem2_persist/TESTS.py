@@ -0,0 +1,88 @@
+#!../env.py
+#
+# Copyright 2019, Intel Corporation
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in
+#       the documentation and/or other materials provided with the
+#       distribution.
+#
+#     * Neither the name of the copyright holder nor the names of its
+#       contributors may be used to endorse or promote products derived
+#       from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+
+import testframework as t
+
+class PMEM2_PERSIST(t.BaseTest):
+    test_type = t.Short
+
+    def run(self, ctx):
+        filepath = ctx.create_holey_file(16 * t.MiB, 'testfile1')
+        ctx.env['PMEM2_FORCE_GRANULARITY'] = self.granularity
+        ctx.exec('pmem2_persist', self.granularity, filepath)
+
+class TEST0(PMEM2_PERSIST):
+    """persist a mapping with page granularity"""
+    granularity = 'PAGE'
+
+class TEST1(PMEM2_PERSIST):
+    """persist a mapping with cache line granularity"""
+    granularity = 'CACHE_LINE'
+
+class TEST2(PMEM2_PERSIST):
+    """persist a mapping with byte granularity"""
+    granularity = 'BYTE'
+
+class TEST3(PMEM2_PERSIST):
+    """persist a mapping with cache line granularity using clflush"""
+    granularity = 'CACHE_LINE'
+
+    def run(self, ctx):
+        ctx.env['PMEM_NO_CLWB'] = '1'
+        ctx.env['PMEM_NO_CLFLUSHOPT'] = '1'
+        super().run(ctx)
+
+class TEST4(PMEM2_PERSIST):
+    """persist a mapping with cache line granularity using AVX"""
+    granularity = 'CACHE_LINE'
+
+    def run(self, ctx):
+        ctx.env['PMEM_AVX'] = '1'
+        super().run(ctx)
+
+class TEST5(PMEM2_PERSIST):
+    """persist a mapping with cache line granularity using AVX512F"""
+    granularity = 'CACHE_LINE'
+
+    def run(self, ctx):
+        ctx.env['PMEM_AVX512F'] = '1'
+        super().run(ctx)
+
+class TEST6(PMEM2_PERSIST):
+    """persist a mapping with byte granularity without movnt"""
+    granularity = 'BYTE'
+
+    def run(self, ctx):
+        ctx.env['PMEM_NO_MOVNT'] = '1'
+        super().run(ctx)
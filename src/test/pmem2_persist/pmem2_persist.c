@@ -0,0 +1,284 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem2_persist.c -- pmem2_get_[persist|flush|drain]_fn and
+ *	pmem2_get_[memmove|memcpy|memset]_fn unittests
+ */
+
+#include "unittest.h"
+#include "ut_pmem2.h"
+
+#define PATTERN_SIZE 4096
+
+/*
+ * map_file -- map the whole file with the given store granularity
+ */
+static struct pmem2_map *
+map_file(struct pmem2_config **cfg, int *fd, const char *file)
+{
+	struct pmem2_map *map;
+
+	*fd = OPEN(file, O_RDWR);
+
+	PMEM2_CONFIG_NEW(cfg);
+	PMEM2_CONFIG_SET_FD(*cfg, *fd);
+
+	int ret = pmem2_map(*cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	UT_ASSERTne(pmem2_get_persist_fn(map), NULL);
+	UT_ASSERTne(pmem2_get_flush_fn(map), NULL);
+	UT_ASSERTne(pmem2_get_drain_fn(map), NULL);
+	UT_ASSERTne(pmem2_get_memmove_fn(map), NULL);
+	UT_ASSERTne(pmem2_get_memcpy_fn(map), NULL);
+	UT_ASSERTne(pmem2_get_memset_fn(map), NULL);
+
+	return map;
+}
+
+/*
+ * unmap_file -- unmap the file, delete the config and close the file
+ */
+static void
+unmap_file(struct pmem2_map **map, struct pmem2_config **cfg, int fd)
+{
+	int ret = pmem2_unmap(map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	PMEM2_CONFIG_DELETE(cfg);
+	CLOSE(fd);
+}
+
+/*
+ * verify_file -- verify the file contains the pattern at the given offset
+ */
+static void
+verify_file(const char *file, size_t offset, int c)
+{
+	char buf[PATTERN_SIZE];
+	char expected[PATTERN_SIZE];
+
+	memset(expected, c, sizeof(expected));
+
+	int fd = OPEN(file, O_RDONLY);
+	LSEEK(fd, (os_off_t)offset, SEEK_SET);
+	READ(fd, buf, sizeof(buf));
+	CLOSE(fd);
+
+	UT_ASSERTeq(memcmp(buf, expected, sizeof(buf)), 0);
+}
+
+/*
+ * test_persist -- store a pattern to the mapping, persist it with
+ *	the persist function and verify it reached the file
+ */
+static void
+test_persist(const char *file)
+{
+	struct pmem2_config *cfg;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	pmem2_persist_fn persist = pmem2_get_persist_fn(map);
+
+	/* unaligned range spanning several cache lines and pages */
+	size_t offset = Ut_mmap_align - PATTERN_SIZE / 2 + 1;
+	char *addr = (char *)pmem2_map_get_address(map) + offset;
+
+	memset(addr, 'A', PATTERN_SIZE);
+	persist(addr, PATTERN_SIZE);
+
+	unmap_file(&map, &cfg, fd);
+
+	verify_file(file, offset, 'A');
+}
+
+/*
+ * test_flush_drain -- store a pattern to the mapping, persist it with
+ *	the flush and drain functions and verify it reached the file
+ */
+static void
+test_flush_drain(const char *file)
+{
+	struct pmem2_config *cfg;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	pmem2_flush_fn flush = pmem2_get_flush_fn(map);
+	pmem2_drain_fn drain = pmem2_get_drain_fn(map);
+
+	char *addr = (char *)pmem2_map_get_address(map);
+	size_t offset[] = {0, PATTERN_SIZE, 3 * PATTERN_SIZE + 7};
+
+	for (int i = 0; i < ARRAY_SIZE(offset); i++) {
+		memset(addr + offset[i], 'B' + i, PATTERN_SIZE);
+		flush(addr + offset[i], PATTERN_SIZE);
+	}
+	drain();
+
+	unmap_file(&map, &cfg, fd);
+
+	for (int i = 0; i < ARRAY_SIZE(offset); i++)
+		verify_file(file, offset[i], 'B' + i);
+}
+
+static unsigned mem_flags[] = {
+	0,
+	PMEM2_F_MEM_NONTEMPORAL,
+	PMEM2_F_MEM_TEMPORAL,
+	PMEM2_F_MEM_WC,
+	PMEM2_F_MEM_WB,
+	PMEM2_F_MEM_NODRAIN,
+	PMEM2_F_MEM_NOFLUSH,
+};
+
+/*
+ * test_memset -- fill the mapping using the memset function with various
+ *	flags and verify the data reached the file
+ */
+static void
+test_memset(const char *file)
+{
+	struct pmem2_config *cfg;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	pmem2_memset_fn memset_fn = pmem2_get_memset_fn(map);
+	pmem2_persist_fn persist = pmem2_get_persist_fn(map);
+	pmem2_drain_fn drain = pmem2_get_drain_fn(map);
+
+	char *addr = (char *)pmem2_map_get_address(map);
+
+	for (int i = 0; i < ARRAY_SIZE(mem_flags); i++) {
+		/* odd offsets exercise the unaligned head and tail */
+		size_t offset = (size_t)i * 2 * PATTERN_SIZE + (size_t)i;
+		memset_fn(addr + offset, 'a' + i, PATTERN_SIZE, mem_flags[i]);
+
+		if (mem_flags[i] & PMEM2_F_MEM_NOFLUSH)
+			persist(addr + offset, PATTERN_SIZE);
+		else if (mem_flags[i] & PMEM2_F_MEM_NODRAIN)
+			drain();
+	}
+
+	unmap_file(&map, &cfg, fd);
+
+	for (int i = 0; i < ARRAY_SIZE(mem_flags); i++) {
+		size_t offset = (size_t)i * 2 * PATTERN_SIZE + (size_t)i;
+		verify_file(file, offset, 'a' + i);
+	}
+}
+
+/*
+ * test_memcpy -- copy a buffer to the mapping using the memcpy and memmove
+ *	functions with various flags and verify the data reached the file
+ */
+static void
+test_memcpy(const char *file)
+{
+	struct pmem2_config *cfg;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	pmem2_memcpy_fn memcpy_fn = pmem2_get_memcpy_fn(map);
+	pmem2_memmove_fn memmove_fn = pmem2_get_memmove_fn(map);
+	pmem2_persist_fn persist = pmem2_get_persist_fn(map);
+	pmem2_drain_fn drain = pmem2_get_drain_fn(map);
+
+	char *addr = (char *)pmem2_map_get_address(map);
+	char buf[PATTERN_SIZE];
+
+	for (int i = 0; i < ARRAY_SIZE(mem_flags); i++) {
+		size_t offset = (size_t)i * 2 * PATTERN_SIZE + (size_t)i;
+		memset(buf, 'A' + i, sizeof(buf));
+		memcpy_fn(addr + offset, buf, sizeof(buf), mem_flags[i]);
+
+		if (mem_flags[i] & PMEM2_F_MEM_NOFLUSH)
+			persist(addr + offset, sizeof(buf));
+		else if (mem_flags[i] & PMEM2_F_MEM_NODRAIN)
+			drain();
+	}
+
+	/* overlapping move of the first pattern by half of its size */
+	memmove_fn(addr + PATTERN_SIZE / 2, addr, PATTERN_SIZE, 0);
+
+	unmap_file(&map, &cfg, fd);
+
+	verify_file(file, PATTERN_SIZE / 2, 'A');
+	for (int i = 1; i < ARRAY_SIZE(mem_flags); i++) {
+		size_t offset = (size_t)i * 2 * PATTERN_SIZE + (size_t)i;
+		verify_file(file, offset, 'A' + i);
+	}
+}
+
+/*
+ * test_granularity -- verify the mapping reports the expected
+ *	store granularity
+ */
+static void
+test_granularity(const char *file, enum pmem2_granularity expected)
+{
+	struct pmem2_config *cfg;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	UT_ASSERTeq(pmem2_map_get_store_granularity(map), expected);
+
+	unmap_file(&map, &cfg, fd);
+}
+
+int
+main(int argc, char **argv)
+{
+	START(argc, argv, "pmem2_persist");
+	if (argc != 3)
+		UT_FATAL("usage: %s granularity file", argv[0]);
+
+	char *granularity = argv[1];
+	char *file = argv[2];
+
+	if (strcmp(granularity, "BYTE") == 0)
+		test_granularity(file, PMEM2_GRANULARITY_BYTE);
+	else if (strcmp(granularity, "CACHE_LINE") == 0)
+		test_granularity(file, PMEM2_GRANULARITY_CACHE_LINE);
+	else if (strcmp(granularity, "PAGE") == 0)
+		test_granularity(file, PMEM2_GRANULARITY_PAGE);
+	else
+		UT_FATAL("invalid granularity: %s", granularity);
+
+	test_persist(file);
+	test_flush_drain(file);
+	test_memset(file);
+	test_memcpy(file);
+
+	DONE(NULL);
+}
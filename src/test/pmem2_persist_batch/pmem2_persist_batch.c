@@ -0,0 +1,318 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem2_persist_batch.c -- pmem2_persist_batch_* unittests
+ */
+
+#include "unittest.h"
+#include "ut_pmem2.h"
+
+#define RECORD_SIZE 100
+#define NRECORDS 1000
+#define NTHREADS 8
+
+/*
+ * map_file -- map the whole file
+ */
+static struct pmem2_map *
+map_file(struct pmem2_config **cfg, int *fd, const char *file)
+{
+	struct pmem2_map *map;
+
+	*fd = OPEN(file, O_RDWR);
+
+	PMEM2_CONFIG_NEW(cfg);
+	PMEM2_CONFIG_SET_FD(*cfg, *fd);
+
+	int ret = pmem2_map(*cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	return map;
+}
+
+/*
+ * unmap_file -- unmap the file, delete the config and close the file
+ */
+static void
+unmap_file(struct pmem2_map **map, struct pmem2_config **cfg, int fd)
+{
+	int ret = pmem2_unmap(map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	PMEM2_CONFIG_DELETE(cfg);
+	CLOSE(fd);
+}
+
+/*
+ * verify_file -- verify the file contains len bytes of c at the given offset
+ */
+static void
+verify_file(const char *file, size_t offset, size_t len, int c)
+{
+	char *buf = MALLOC(len);
+
+	int fd = OPEN(file, O_RDONLY);
+	LSEEK(fd, (os_off_t)offset, SEEK_SET);
+	READ(fd, buf, len);
+	CLOSE(fd);
+
+	for (size_t i = 0; i < len; ++i)
+		UT_ASSERTeq(buf[i], c);
+
+	FREE(buf);
+}
+
+/*
+ * test_commit -- queue many small, adjacent and overlapping records,
+ *	commit them at once and verify they reached the file
+ */
+static void
+test_commit(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_persist_batch *batch;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	char *addr = pmem2_map_get_address(map);
+
+	int ret = pmem2_persist_batch_new(map, &batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	/* nothing was queued, so there is nothing to wait for */
+	uint64_t token;
+	ret = pmem2_persist_batch_commit(batch, &token);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERT(pmem2_persist_batch_poll(batch, token));
+
+	uint64_t first;
+	for (size_t i = 0; i < NRECORDS; ++i) {
+		memset(addr + i * RECORD_SIZE, 'A', RECORD_SIZE);
+		ret = pmem2_persist_batch_add(batch, addr + i * RECORD_SIZE,
+			RECORD_SIZE, &token);
+		UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+		if (i == 0)
+			first = token;
+		UT_ASSERTeq(token, first);
+	}
+
+	/* records queued in reverse order and overlapping each other */
+	size_t offset = 1 << 20;
+	for (size_t i = NRECORDS; i > 0; --i) {
+		char *rec = addr + offset + (i - 1) * RECORD_SIZE;
+		memset(rec, 'B', 2 * RECORD_SIZE);
+		ret = pmem2_persist_batch_add(batch, rec, 2 * RECORD_SIZE,
+			&token);
+		UT_PMEM2_EXPECT_RETURN(ret, 0);
+		UT_ASSERTeq(token, first);
+	}
+
+	UT_ASSERT(!pmem2_persist_batch_poll(batch, first));
+
+	ret = pmem2_persist_batch_commit(batch, &token);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(token, first);
+	UT_ASSERT(pmem2_persist_batch_poll(batch, first));
+
+	/* the next generation is not affected by the previous commit */
+	memset(addr + (2 << 20), 'C', RECORD_SIZE);
+	ret = pmem2_persist_batch_add(batch, addr + (2 << 20),
+		RECORD_SIZE, &token);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERT(token > first);
+	UT_ASSERT(!pmem2_persist_batch_poll(batch, token));
+
+	ret = pmem2_persist_batch_wait(batch, token);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERT(pmem2_persist_batch_poll(batch, token));
+
+	ret = pmem2_persist_batch_delete(&batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(batch, NULL);
+
+	unmap_file(&map, &cfg, fd);
+
+	verify_file(file, 0, NRECORDS * RECORD_SIZE, 'A');
+	verify_file(file, offset, (NRECORDS + 1) * RECORD_SIZE, 'B');
+	verify_file(file, (2 << 20), RECORD_SIZE, 'C');
+}
+
+/*
+ * test_delete -- verify deleting the batch persists the queued ranges
+ */
+static void
+test_delete(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_persist_batch *batch;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	char *addr = pmem2_map_get_address(map);
+
+	int ret = pmem2_persist_batch_new(map, &batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	memset(addr + RECORD_SIZE, 'D', RECORD_SIZE);
+	ret = pmem2_persist_batch_add(batch, addr + RECORD_SIZE, RECORD_SIZE,
+		NULL);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_persist_batch_delete(&batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	unmap_file(&map, &cfg, fd);
+
+	verify_file(file, RECORD_SIZE, RECORD_SIZE, 'D');
+}
+
+/*
+ * test_invalid -- verify ranges outside of the mapping and tokens which
+ *	were never handed out are rejected
+ */
+static void
+test_invalid(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_persist_batch *batch;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	char *addr = pmem2_map_get_address(map);
+	size_t size = pmem2_map_get_size(map);
+
+	int ret = pmem2_persist_batch_new(map, &batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_persist_batch_add(batch, addr - 1, 2, NULL);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	ret = pmem2_persist_batch_add(batch, addr + size - 1, 2, NULL);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	ret = pmem2_persist_batch_add(batch, addr + size - 1, 1, NULL);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_persist_batch_wait(batch, UINT64_MAX);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	ret = pmem2_persist_batch_delete(&batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	unmap_file(&map, &cfg, fd);
+}
+
+struct worker_args {
+	struct pmem2_persist_batch *batch;
+	char *addr;
+};
+
+/*
+ * worker -- write records, queue them in the shared batch and wait until
+ *	each of them is persistent
+ */
+static void *
+worker(void *arg)
+{
+	struct worker_args *args = arg;
+
+	for (size_t i = 0; i < NRECORDS; ++i) {
+		char *rec = args->addr + i * RECORD_SIZE;
+		memset(rec, 'E', RECORD_SIZE);
+
+		uint64_t token;
+		int ret = pmem2_persist_batch_add(args->batch, rec,
+			RECORD_SIZE, &token);
+		UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+		ret = pmem2_persist_batch_wait(args->batch, token);
+		UT_PMEM2_EXPECT_RETURN(ret, 0);
+		UT_ASSERT(pmem2_persist_batch_poll(args->batch, token));
+	}
+
+	return NULL;
+}
+
+/*
+ * test_mt -- share one batch between multiple writers
+ */
+static void
+test_mt(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_persist_batch *batch;
+	int fd;
+
+	struct pmem2_map *map = map_file(&cfg, &fd, file);
+	char *addr = pmem2_map_get_address(map);
+
+	int ret = pmem2_persist_batch_new(map, &batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	os_thread_t threads[NTHREADS];
+	struct worker_args args[NTHREADS];
+
+	for (int i = 0; i < NTHREADS; ++i) {
+		args[i].batch = batch;
+		args[i].addr = addr + (size_t)i * NRECORDS * RECORD_SIZE;
+		PTHREAD_CREATE(&threads[i], NULL, worker, &args[i]);
+	}
+
+	for (int i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	ret = pmem2_persist_batch_delete(&batch);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	unmap_file(&map, &cfg, fd);
+
+	verify_file(file, 0, NTHREADS * NRECORDS * RECORD_SIZE, 'E');
+}
+
+int
+main(int argc, char **argv)
+{
+	START(argc, argv, "pmem2_persist_batch");
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	char *file = argv[1];
+
+	test_commit(file);
+	test_delete(file);
+	test_invalid(file);
+	test_mt(file);
+
+	DONE(NULL);
+}
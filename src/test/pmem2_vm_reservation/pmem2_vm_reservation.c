@@ -0,0 +1,360 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem2_vm_reservation.c -- pmem2_vm_reservation unittests
+ */
+
+#include "unittest.h"
+#include "ut_pmem2.h"
+
+/*
+ * prepare_config -- fill pmem2_config mapping the given part of the file
+ *	into the reservation
+ */
+static void
+prepare_config(struct pmem2_config **cfg, int fd, size_t offset,
+	size_t length, struct pmem2_vm_reservation *rsv, size_t rsv_offset)
+{
+	PMEM2_CONFIG_NEW(cfg);
+	PMEM2_CONFIG_SET_FD(*cfg, fd);
+
+	int ret = pmem2_config_set_offset(*cfg, offset);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_length(*cfg, length);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_vm_reservation(*cfg, rsv, rsv_offset);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+}
+
+/*
+ * reserve -- create a reservation of the given size
+ */
+static struct pmem2_vm_reservation *
+reserve(void *addr, size_t size)
+{
+	struct pmem2_vm_reservation *rsv;
+
+	int ret = pmem2_vm_reservation_new(&rsv, addr, size);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTne(pmem2_vm_reservation_get_address(rsv), NULL);
+	UT_ASSERTeq(pmem2_vm_reservation_get_size(rsv), size);
+	if (addr)
+		UT_ASSERTeq(pmem2_vm_reservation_get_address(rsv), addr);
+
+	return rsv;
+}
+
+/*
+ * unreserve -- delete the reservation
+ */
+static void
+unreserve(struct pmem2_vm_reservation **rsv)
+{
+	int ret = pmem2_vm_reservation_delete(rsv);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(*rsv, NULL);
+}
+
+/*
+ * free_range -- find an address range of the given size which is not
+ *	occupied by anything
+ */
+static char *
+free_range(size_t size)
+{
+	struct pmem2_vm_reservation *rsv = reserve(NULL, size);
+	char *addr = pmem2_vm_reservation_get_address(rsv);
+	unreserve(&rsv);
+
+	return addr;
+}
+
+/*
+ * test_map_grow -- grow the file and map the new part right after
+ *	the existing mapping, without moving it
+ */
+static void
+test_map_grow(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map1;
+	struct pmem2_map *map2;
+	size_t size = Ut_mmap_align;
+
+	int fd = OPEN(file, O_RDWR);
+	FTRUNCATE(fd, (os_off_t)size);
+
+	char *base = free_range(2 * size);
+	struct pmem2_vm_reservation *rsv = reserve(base, size);
+
+	prepare_config(&cfg, fd, 0, size, rsv, 0);
+	int ret = pmem2_map(cfg, &map1);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	PMEM2_CONFIG_DELETE(&cfg);
+
+	char *addr1 = pmem2_map_get_address(map1);
+	UT_ASSERTeq(addr1, base);
+	memset(addr1, 'A', size);
+	pmem2_get_persist_fn(map1)(addr1, size);
+
+	/* the file grows, so does the reservation */
+	FTRUNCATE(fd, (os_off_t)(2 * size));
+	ret = pmem2_vm_reservation_extend(rsv, size);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(pmem2_vm_reservation_get_address(rsv), base);
+	UT_ASSERTeq(pmem2_vm_reservation_get_size(rsv), 2 * size);
+
+	prepare_config(&cfg, fd, size, size, rsv, size);
+	ret = pmem2_map(cfg, &map2);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	PMEM2_CONFIG_DELETE(&cfg);
+
+	char *addr2 = pmem2_map_get_address(map2);
+	UT_ASSERTeq(addr2, base + size);
+	memset(addr2, 'B', size);
+	pmem2_get_persist_fn(map2)(addr2, size);
+
+	/* the first part was not remapped */
+	for (size_t i = 0; i < 2 * size; ++i)
+		UT_ASSERTeq(base[i], i < size ? 'A' : 'B');
+
+	ret = pmem2_unmap(&map1);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_unmap(&map2);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	unreserve(&rsv);
+	CLOSE(fd);
+}
+
+/*
+ * test_map_overlap -- map ranges overlapping an existing mapping or
+ *	exceeding the reservation
+ */
+static void
+test_map_overlap(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	struct pmem2_map *map2;
+	size_t size = 2 * Ut_mmap_align;
+
+	int fd = OPEN(file, O_RDWR);
+	struct pmem2_vm_reservation *rsv = reserve(NULL, 2 * size);
+
+	prepare_config(&cfg, fd, 0, size, rsv, 0);
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_config_set_vm_reservation(cfg, rsv, size / 2);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map2);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_EXISTS);
+
+	ret = pmem2_config_set_vm_reservation(cfg, rsv, 2 * size);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map2);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_RANGE);
+
+	ret = pmem2_config_set_vm_reservation(cfg, rsv, size + Ut_pagesize);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map2);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_RANGE);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	PMEM2_CONFIG_DELETE(&cfg);
+	unreserve(&rsv);
+	CLOSE(fd);
+}
+
+/*
+ * test_delete_not_empty -- delete a reservation which still contains
+ *	a mapping and verify unmapping keeps the range reserved
+ */
+static void
+test_delete_not_empty(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_map *map;
+	size_t size = Ut_mmap_align;
+
+	int fd = OPEN(file, O_RDWR);
+	struct pmem2_vm_reservation *rsv = reserve(NULL, size);
+
+	prepare_config(&cfg, fd, 0, size, rsv, 0);
+	int ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	ret = pmem2_vm_reservation_delete(&rsv);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_VM_RESERVATION_NOT_EMPTY);
+	UT_ASSERTne(rsv, NULL);
+
+	ret = pmem2_unmap(&map);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+
+	/* the range still belongs to the reservation */
+	ret = pmem2_config_set_vm_reservation(cfg, NULL, 0);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_address(cfg, PMEM2_ADDRESS_FIXED_NOREPLACE,
+		pmem2_vm_reservation_get_address(rsv));
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_EXISTS);
+
+	unreserve(&rsv);
+
+	PMEM2_CONFIG_DELETE(&cfg);
+	CLOSE(fd);
+}
+
+/*
+ * test_reserve_fixed -- reserve ranges at the requested addresses
+ */
+static void
+test_reserve_fixed(const char *file)
+{
+	struct pmem2_vm_reservation *rsv2;
+	size_t size = Ut_mmap_align;
+
+	char *base = free_range(2 * size);
+	struct pmem2_vm_reservation *rsv = reserve(base, size);
+
+	int ret = pmem2_vm_reservation_new(&rsv2, base, size);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_EXISTS);
+
+	rsv2 = reserve(base + size, size);
+
+	/* the range right after the reservation is already occupied */
+	ret = pmem2_vm_reservation_extend(rsv, size);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_MAP_EXISTS);
+	UT_ASSERTeq(pmem2_vm_reservation_get_size(rsv), size);
+
+	unreserve(&rsv2);
+
+	ret = pmem2_vm_reservation_extend(rsv, size);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	UT_ASSERTeq(pmem2_vm_reservation_get_size(rsv), 2 * size);
+
+	unreserve(&rsv);
+}
+
+/*
+ * test_invalid -- pass invalid arguments to the reservation functions
+ */
+static void
+test_invalid(const char *file)
+{
+	struct pmem2_config *cfg;
+	struct pmem2_vm_reservation *rsv;
+	struct pmem2_map *map;
+	size_t size = Ut_mmap_align;
+
+	int ret = pmem2_vm_reservation_new(&rsv, NULL, 0);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	ret = pmem2_vm_reservation_new(&rsv, NULL, Ut_pagesize + 1);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	char *base = free_range(size);
+	ret = pmem2_vm_reservation_new(&rsv, base + 1, size);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	rsv = reserve(base, size);
+
+	ret = pmem2_vm_reservation_extend(rsv, Ut_pagesize - 1);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	int fd = OPEN(file, O_RDWR);
+	PMEM2_CONFIG_NEW(&cfg);
+	PMEM2_CONFIG_SET_FD(cfg, fd);
+
+	ret = pmem2_config_set_vm_reservation(cfg, NULL, Ut_pagesize);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	/* unaligned offset in the reservation */
+	ret = pmem2_config_set_length(cfg, Ut_pagesize);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_vm_reservation(cfg, rsv, 1);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	/* both the reservation and the address */
+	ret = pmem2_config_set_vm_reservation(cfg, rsv, 0);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_config_set_address(cfg, PMEM2_ADDRESS_FIXED_REPLACE, base);
+	UT_PMEM2_EXPECT_RETURN(ret, 0);
+	ret = pmem2_map(cfg, &map);
+	UT_PMEM2_EXPECT_RETURN(ret, PMEM2_E_INVALID_ARG);
+
+	PMEM2_CONFIG_DELETE(&cfg);
+	CLOSE(fd);
+
+	unreserve(&rsv);
+}
+
+typedef void (*test_fun)(const char *file);
+
+static struct test_list {
+	const char *name;
+	test_fun test;
+} list[] = {
+	{"map_grow", test_map_grow},
+	{"map_overlap", test_map_overlap},
+	{"delete_not_empty", test_delete_not_empty},
+	{"reserve_fixed", test_reserve_fixed},
+	{"invalid", test_invalid},
+};
+
+int
+main(int argc, char **argv)
+{
+	START(argc, argv, "pmem2_vm_reservation");
+	if (argc != 3)
+		UT_FATAL("usage: %s test_case file", argv[0]);
+
+	char *test_case = argv[1];
+	char *file = argv[2];
+
+	for (int i = 0; i < ARRAY_SIZE(list); i++) {
+		if (strcmp(list[i].name, test_case) == 0) {
+			list[i].test(file);
+			goto end;
+		}
+	}
+	UT_FATAL("test: %s doesn't exist", test_case);
+end:
+	DONE(NULL);
+}
@@ -0,0 +1,64 @@
+#!../env.py
+#
+# Copyright 2019, Intel Corporation
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in
+#       the documentation and/or other materials provided with the
+#       distribution.
+#
+#     * Neither the name of the copyright holder nor the names of its
+#       contributors may be used to endorse or promote products derived
+#       from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+
+import testframework as t
+
+class PMEM_MOVNT_THRESHOLD(t.BaseTest):
+    test_type = t.Short
+
+class TEST0(PMEM_MOVNT_THRESHOLD):
+    """get and set the threshold through ctl"""
+
+    def run(self, ctx):
+        ctx.exec('pmem_movnt_threshold', 'c')
+
+class TEST1(PMEM_MOVNT_THRESHOLD):
+    """calibrate the threshold, enabled through ctl"""
+
+    def run(self, ctx):
+        ctx.exec('pmem_movnt_threshold', 'a')
+
+class TEST2(PMEM_MOVNT_THRESHOLD):
+    """calibrate the threshold, enabled through the environment"""
+
+    def run(self, ctx):
+        ctx.env['PMEM_MOVNT_THRESHOLD'] = 'auto'
+        ctx.exec('pmem_movnt_threshold', 'a')
+
+class TEST3(PMEM_MOVNT_THRESHOLD):
+    """set the threshold through PMEM_CONF"""
+
+    def run(self, ctx):
+        ctx.env['PMEM_CONF'] = 'memcpy.movnt_threshold=4096'
+        ctx.exec('pmem_movnt_threshold', 'e', '4096')
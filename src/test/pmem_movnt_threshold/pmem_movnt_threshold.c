@@ -0,0 +1,160 @@
+/*
+ * Copyright 2019, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_movnt_threshold.c -- unit test for the memcpy.movnt_threshold ctl
+ *	namespace
+ *
+ * usage: pmem_movnt_threshold c|a|e [threshold]
+ *
+ * c - get and set the threshold and the auto-tuning flag
+ * a - enable auto-tuning and trigger it with a large copy
+ * e - check that the threshold matches the expected value
+ */
+
+#include "unittest.h"
+
+#define COPY_SIZE	(1 << 20)
+
+/*
+ * test_ctl -- get and set the threshold and the auto-tuning flag
+ */
+static void
+test_ctl(void)
+{
+	size_t threshold;
+	int enabled;
+
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold_auto", &enabled), 0);
+	UT_ASSERTeq(enabled, 0);
+
+	long long val = 1024;
+	UT_ASSERTeq(pmem_ctl_set("memcpy.movnt_threshold", &val), 0);
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold", &threshold), 0);
+	UT_ASSERTeq(threshold, 1024);
+
+	val = -1;
+	UT_ASSERTeq(pmem_ctl_set("memcpy.movnt_threshold", &val), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold", &threshold), 0);
+	UT_ASSERTeq(threshold, 1024);
+
+	enabled = 1;
+	UT_ASSERTeq(pmem_ctl_set("memcpy.movnt_threshold_auto", &enabled), 0);
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold_auto", &enabled), 0);
+	UT_ASSERTeq(enabled, 1);
+
+	/* setting the threshold explicitly disables the auto-tuning */
+	val = 0;
+	UT_ASSERTeq(pmem_ctl_set("memcpy.movnt_threshold", &val), 0);
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold_auto", &enabled), 0);
+	UT_ASSERTeq(enabled, 0);
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold", &threshold), 0);
+	UT_ASSERTeq(threshold, 0);
+
+	UT_ASSERTeq(pmem_ctl_get("memcpy.nonexistent", &threshold), -1);
+}
+
+/*
+ * test_auto -- enable auto-tuning and trigger it with a large copy
+ */
+static void
+test_auto(void)
+{
+	char *src = MEMALIGN(64, COPY_SIZE);
+	char *dst = MEMALIGN(64, COPY_SIZE + 64);
+
+	for (size_t i = 0; i < COPY_SIZE; ++i)
+		src[i] = (char)i;
+	memset(dst, 0, COPY_SIZE + 64);
+
+	int enabled = 1;
+	UT_ASSERTeq(pmem_ctl_set("memcpy.movnt_threshold_auto", &enabled), 0);
+
+	pmem_memcpy_persist(dst, src, COPY_SIZE);
+	UT_ASSERTeq(memcmp(dst, src, COPY_SIZE), 0);
+	UT_ASSERTeq(dst[COPY_SIZE], 0);
+
+	size_t threshold;
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold", &threshold), 0);
+
+	/* the result is one of the examined sizes or twice the largest one */
+	UT_ASSERT(threshold >= 256 && threshold <= (128 << 10));
+	UT_ASSERTeq(threshold & (threshold - 1), 0);
+
+	/* small copies are not affected by the calibration */
+	memset(dst, 0, COPY_SIZE);
+	pmem_memcpy_persist(dst, src, 100);
+	UT_ASSERTeq(memcmp(dst, src, 100), 0);
+	UT_ASSERTeq(dst[100], 0);
+
+	ALIGNED_FREE(dst);
+	ALIGNED_FREE(src);
+}
+
+/*
+ * test_expected -- check that the threshold matches the expected value
+ */
+static void
+test_expected(size_t expected)
+{
+	size_t threshold;
+	UT_ASSERTeq(pmem_ctl_get("memcpy.movnt_threshold", &threshold), 0);
+	UT_ASSERTeq(threshold, expected);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_movnt_threshold");
+
+	if (argc < 2)
+		UT_FATAL("usage: %s c|a|e [threshold]", argv[0]);
+
+	switch (argv[1][0]) {
+		case 'c':
+			test_ctl();
+			break;
+		case 'a':
+			test_auto();
+			break;
+		case 'e':
+			if (argc < 3)
+				UT_FATAL("usage: %s e threshold", argv[0]);
+			test_expected(ATOUL(argv[2]));
+			break;
+		default:
+			UT_FATAL("unknown test %s", argv[1]);
+	}
+
+	DONE(NULL);
+}
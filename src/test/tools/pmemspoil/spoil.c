@@ -1236,6 +1236,9 @@ pmemspoil_process_pmemobj(struct pmemspoil *psp,
 		PROCESS_FIELD(pop, nlanes, uint64_t);
 		PROCESS_FIELD(pop, heap_offset, uint64_t);
 		PROCESS_FIELD(pop, unused3, uint64_t);
+		PROCESS_FIELD(pop, lane_redo_internal_size, uint64_t);
+		PROCESS_FIELD(pop, lane_redo_external_size, uint64_t);
+		PROCESS_FIELD(pop, lane_undo_size, uint64_t);
 		PROCESS_FIELD(pop, unused, char);
 		PROCESS_FIELD(pop, checksum, uint64_t);
 		PROCESS_FIELD(pop, run_id, uint64_t);
@@ -60,11 +60,13 @@
  * lane_need_recovery -- return 1 if lane section needs recovery
  */
 static int
-lane_need_recovery(struct pmem_info *pip, struct lane_layout *lane)
+lane_need_recovery(struct pmem_info *pip, void *lane)
 {
-	return ulog_recovery_needed((struct ulog *)&lane->external, 1) ||
-		ulog_recovery_needed((struct ulog *)&lane->internal, 1) ||
-		ulog_recovery_needed((struct ulog *)&lane->undo, 0);
+	struct pmemobjpool *pop = pip->obj.pop;
+
+	return ulog_recovery_needed(OBJ_LANE_REDO_EXTERNAL(pop, lane), 1) ||
+		ulog_recovery_needed(OBJ_LANE_REDO_INTERNAL(pop, lane), 1) ||
+		ulog_recovery_needed(OBJ_LANE_UNDO(pop, lane), 0);
 }
 
 #define RUN_BITMAP_SEPARATOR_DISTANCE 8
@@ -231,25 +233,26 @@ info_obj_object_hdr(struct pmem_info *pip, int v, int vid,
  * info_obj_lane_section -- print lane's section
  */
 static void
-info_obj_lane(struct pmem_info *pip, int v, struct lane_layout *lane)
+info_obj_lane(struct pmem_info *pip, int v, void *lane)
 {
+	struct pmemobjpool *pop = pip->obj.pop;
 	struct pmem_ops p_ops;
-	p_ops.base = pip->obj.pop;
+	p_ops.base = pop;
 
 	outv_title(v, "Undo Log");
 	outv_indent(v, 1);
-	info_obj_ulog(pip, v, (struct ulog *)&lane->undo, &p_ops);
+	info_obj_ulog(pip, v, OBJ_LANE_UNDO(pop, lane), &p_ops);
 	outv_indent(v, -1);
 
 	outv_nl(v);
 	outv_title(v, "Internal Undo Log");
 	outv_indent(v, 1);
-	info_obj_ulog(pip, v, (struct ulog *)&lane->internal, &p_ops);
+	info_obj_ulog(pip, v, OBJ_LANE_REDO_INTERNAL(pop, lane), &p_ops);
 	outv_indent(v, -1);
 
 	outv_title(v, "External Undo Log");
 	outv_indent(v, 1);
-	info_obj_ulog(pip, v, (struct ulog *)&lane->external, &p_ops);
+	info_obj_ulog(pip, v, OBJ_LANE_REDO_EXTERNAL(pop, lane), &p_ops);
 	outv_indent(v, -1);
 }
 
@@ -269,8 +272,6 @@ info_obj_lanes(struct pmem_info *pip)
 	 * Iterate through all lanes from specified range and print
 	 * specified sections.
 	 */
-	struct lane_layout *lanes = (void *)((char *)pip->obj.pop +
-			pop->lanes_offset);
 	struct range *curp = NULL;
 	FOREACH_RANGE(curp, &pip->args.obj.lane_ranges) {
 		for (uint64_t i = curp->first;
@@ -278,14 +279,15 @@ info_obj_lanes(struct pmem_info *pip)
 
 			/* For -R check print lane only if needs recovery */
 			if (pip->args.obj.lanes_recovery &&
-				!lane_need_recovery(pip, &lanes[i]))
+				!lane_need_recovery(pip,
+					OBJ_LANE_LAYOUT(pop, i)))
 				continue;
 
 			outv_title(v, "Lane %" PRIu64, i);
 
 			outv_indent(v, 1);
 
-			info_obj_lane(pip, v, &lanes[i]);
+			info_obj_lane(pip, v, OBJ_LANE_LAYOUT(pop, i));
 
 			outv_indent(v, -1);
 		}
@@ -851,6 +851,14 @@ out_get_incompat_features_str(uint32_t incompat)
 				return "";
 		}
 
+		/* obj lane geometry cannot be changed with pmempool feature */
+		if (features.incompat & POOL_FEAT_LANES) {
+			features.incompat &= ~POOL_FEAT_LANES;
+			ret = out_concat(str_buff, &curr, &count, "LANES");
+			if (ret < 0)
+				return "";
+		}
+
 		/* check if any unknown flags are set */
 		if (!util_feature_is_zero(features)) {
 			if (out_concat(str_buff, &curr, &count,